@@ -159,7 +159,7 @@ PropertyDescriptorPtr AudioScene::getDescriptorByIndex(int aPropIndex, int aDoma
   if (aPropIndex<n)
     return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
   aPropIndex -= n; // rebase to 0 for my own first property
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&sceneproperties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&sceneproperties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -126,6 +126,7 @@ void BinaryInputBehaviour::updateInputState(InputState aNewState)
   if (changedState || now>lastPush+changesOnlyInterval) {
     // changed state or no update sent for more than changesOnlyInterval
     currentState = aNewState;
+    if (changedState) propertiesChanged(); // even if not pushed now
     if (lastPush==Never || now>lastPush+minPushInterval) {
       // push the new value
       if (pushBehaviourState()) {
@@ -299,7 +300,7 @@ const PropertyDescriptorPtr BinaryInputBehaviour::getDescDescriptorByIndex(int a
     { "updateInterval", apivalue_double, updateInterval_key+descriptions_key_offset, OKEY(binaryInput_key) },
     { "aliveSignInterval", apivalue_double, aliveSignInterval_key+descriptions_key_offset, OKEY(binaryInput_key) },
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -323,7 +324,7 @@ const PropertyDescriptorPtr BinaryInputBehaviour::getSettingsDescriptorByIndex(i
     { "changesOnlyInterval", apivalue_double, changesOnlyInterval_key+settings_key_offset, OKEY(binaryInput_key) },
     { "sensorFunction", apivalue_uint64, configuredInputType_key+settings_key_offset, OKEY(binaryInput_key) },
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 // state properties
@@ -344,7 +345,7 @@ const PropertyDescriptorPtr BinaryInputBehaviour::getStateDescriptorByIndex(int
     { "extendedValue", apivalue_uint64, extendedValue_key+states_key_offset, OKEY(binaryInput_key) },
     { "age", apivalue_double, age_key+states_key_offset, OKEY(binaryInput_key) },
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -686,7 +686,7 @@ const PropertyDescriptorPtr ButtonBehaviour::getDescDescriptorByIndex(int aPropI
     { "buttonElementID", apivalue_uint64, buttonElementID_key+descriptions_key_offset, OKEY(button_key) },
     { "combinables", apivalue_uint64, combinables_key+descriptions_key_offset, OKEY(button_key) },
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -720,7 +720,7 @@ const PropertyDescriptorPtr ButtonBehaviour::getSettingsDescriptorByIndex(int aP
     { "x-p44-buttonActionId", apivalue_uint64, buttonActionId_key+settings_key_offset, OKEY(button_key) },
     { "x-p44-stateMachineMode", apivalue_uint64, stateMachineMode_key+settings_key_offset, OKEY(button_key) },
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 // state properties
@@ -745,7 +745,7 @@ const PropertyDescriptorPtr ButtonBehaviour::getStateDescriptorByIndex(int aProp
     { "actionId", apivalue_uint64, actionId_key+states_key_offset, OKEY(button_key) },
     { "age", apivalue_double, age_key+states_key_offset, OKEY(button_key) },
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -574,7 +574,7 @@ const PropertyDescriptorPtr ClimateControlBehaviour::getDescDescriptorByIndex(in
     if (aPropIndex<n)
       return inherited::getDescDescriptorByIndex(aPropIndex, aParentDescriptor);
     aPropIndex -= n;
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 int ClimateControlBehaviour::numSettingsProps() { return inherited::numSettingsProps()+numSettingsProperties; }
@@ -588,7 +588,7 @@ const PropertyDescriptorPtr ClimateControlBehaviour::getSettingsDescriptorByInde
   if (aPropIndex<n)
     return inherited::getSettingsDescriptorByIndex(aPropIndex, aParentDescriptor);
   aPropIndex -= n;
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
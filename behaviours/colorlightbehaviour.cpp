@@ -1054,7 +1054,7 @@ const PropertyDescriptorPtr RGBColorLightBehaviour::getSettingsDescriptorByIndex
   if (aPropIndex<n)
     return inherited::getSettingsDescriptorByIndex(aPropIndex, aParentDescriptor);
   aPropIndex -= n;
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
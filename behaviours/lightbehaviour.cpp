@@ -569,7 +569,7 @@ const PropertyDescriptorPtr LightBehaviour::getSettingsDescriptorByIndex(int aPr
   if (aPropIndex<n)
     return inherited::getSettingsDescriptorByIndex(aPropIndex, aParentDescriptor);
   aPropIndex -= n;
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
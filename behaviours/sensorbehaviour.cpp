@@ -229,6 +229,7 @@ void SensorBehaviour::updateSensorValue(double aValue, double aMinChange, bool a
   }
   if (changedValue) {
     currentValue = aValue;
+    propertiesChanged(); // even if not pushed now
   }
   // possibly push
   if (aPush) {
@@ -425,7 +426,7 @@ const PropertyDescriptorPtr SensorBehaviour::getDescDescriptorByIndex(int aPropI
     { "updateInterval", apivalue_double, updateInterval_key+descriptions_key_offset, OKEY(sensor_key) },
     { "aliveSignInterval", apivalue_double, aliveSignInterval_key+descriptions_key_offset, OKEY(sensor_key) },
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -447,7 +448,7 @@ const PropertyDescriptorPtr SensorBehaviour::getSettingsDescriptorByIndex(int aP
     { "minPushInterval", apivalue_double, minPushInterval_key+settings_key_offset, OKEY(sensor_key) },
     { "changesOnlyInterval", apivalue_double, changesOnlyInterval_key+settings_key_offset, OKEY(sensor_key) },
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 // state properties
@@ -470,7 +471,7 @@ const PropertyDescriptorPtr SensorBehaviour::getStateDescriptorByIndex(int aProp
     { "contextId", apivalue_uint64, contextid_key+states_key_offset, OKEY(sensor_key) },
     { "contextMsg", apivalue_string, contextmsg_key+states_key_offset, OKEY(sensor_key) },
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -946,7 +946,7 @@ const PropertyDescriptorPtr ShadowBehaviour::getSettingsDescriptorByIndex(int aP
   if (aPropIndex<n)
     return inherited::getSettingsDescriptorByIndex(aPropIndex, aParentDescriptor);
   aPropIndex -= n;
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -258,7 +258,7 @@ PropertyDescriptorPtr EldatDevice::getDescriptorByIndex(int aPropIndex, int aDom
     if (aPropIndex<n)
       return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
     aPropIndex -= n; // rebase to 0 for my own first property
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   else {
     // other level
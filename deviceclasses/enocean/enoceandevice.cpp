@@ -589,7 +589,7 @@ PropertyDescriptorPtr EnoceanDevice::getDescriptorByIndex(int aPropIndex, int aD
     if (aPropIndex<n)
       return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
     aPropIndex -= n; // rebase to 0 for my own first property
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   else {
     // other level
@@ -258,8 +258,12 @@ HomeConnectDevice::HomeConnectDevice(HomeConnectVdc *aVdcP, JsonObjectPtr aHomeA
 
   string dir = getVdcHost().getConfigDir();
 
-  string fn = dir  + "singledevicesettings_homeconnect_" + vib + ".json";
-  JsonObjectPtr config = JsonObject::objFromFile(fn.c_str());
+  string cfn = "singledevicesettings_homeconnect_" + vib + ".json";
+  string fn = dir + cfn;
+  JsonObjectPtr config;
+  if (getVdcHost().getSettingsFileCache().fileExists(cfn)) {
+    config = JsonObject::objFromFile(fn.c_str());
+  }
   if (!config) {
     ALOG(LOG_WARNING, "Cannot read configuration file: '%s'", fn.c_str());
     return;
@@ -53,6 +53,9 @@ namespace p44 {
     /// @note setDefaultSceneValues() must be called to set default scene values
     virtual DsScenePtr newDefaultScene(SceneNo aSceneNo);
 
+    /// default scenes depend on this device's actions, cannot be shared with other devices
+    virtual string defaultScenesKey() P44_OVERRIDE { return ""; };
+
     string fireAction;
     string leaveHomeAction;
     string deepOffAction;
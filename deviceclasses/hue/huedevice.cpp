@@ -102,6 +102,20 @@ bool HueDevice::identifyDevice(IdentifyDeviceCB aIdentifyCB)
 }
 
 
+JsonObjectPtr HueDevice::snapshotInfo()
+{
+  JsonObjectPtr info = JsonObject::newObj();
+  info->add("lightID", JsonObject::newString(lightID));
+  if (!uniqueID.empty()) info->add("uniqueID", JsonObject::newString(uniqueID));
+  ColorLightBehaviourPtr cl = boost::dynamic_pointer_cast<ColorLightBehaviour>(output);
+  if (cl) {
+    info->add("color", JsonObject::newBool(!cl->isCtOnly()));
+    info->add("ctOnly", JsonObject::newBool(cl->isCtOnly()));
+  }
+  return info;
+}
+
+
 string HueDevice::getExtraInfo()
 {
   return string_format("Light #%s", lightID.c_str());
@@ -72,6 +72,9 @@ namespace p44 {
     /// identify a device up to the point that it knows its dSUID and internal structure. Possibly swap device object for a more specialized subclass.
     virtual bool identifyDevice(IdentifyDeviceCB aIdentifyCB) P44_OVERRIDE;
 
+    /// @return light ID and type, to re-create the device with HueVdc::restoreDevice()
+    virtual JsonObjectPtr snapshotInfo() P44_OVERRIDE;
+
     /// device type identifier
 		/// @return constant identifier for this type of device (one container might contain more than one type)
     virtual string deviceTypeIdentifier() const P44_OVERRIDE { return "hue"; };
@@ -152,16 +152,7 @@ void HueVdc::scanForDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
     removeDevices(aRescanFlags & rescanmode_clearsettings);
   }
   // load hue bridge uuid and token
-  sqlite3pp::query qry(db);
-  if (qry.prepare("SELECT hueBridgeUUID, hueBridgeUser, hueApiURL, fixedURL FROM globs")==SQLITE_OK) {
-    sqlite3pp::query::iterator i = qry.begin();
-    if (i!=qry.end()) {
-      bridgeUuid = nonNullCStr(i->get<const char *>(0));
-      bridgeUserName = nonNullCStr(i->get<const char *>(1));
-      bridgeApiURL = nonNullCStr(i->get<const char *>(2));
-      fixedURL = i->get<bool>(3);
-    }
-  }
+  loadBridgeSettings();
   if ((aRescanFlags & rescanmode_exhaustive) && !fixedURL) {
     // exhaustive rescan means we need to search for the bridge API
     bridgeApiURL.clear();
@@ -177,6 +168,40 @@ void HueVdc::scanForDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
 }
 
 
+void HueVdc::loadBridgeSettings()
+{
+  sqlite3pp::query qry(db);
+  if (qry.prepare("SELECT hueBridgeUUID, hueBridgeUser, hueApiURL, fixedURL FROM globs")==SQLITE_OK) {
+    sqlite3pp::query::iterator i = qry.begin();
+    if (i!=qry.end()) {
+      bridgeUuid = nonNullCStr(i->get<const char *>(0));
+      bridgeUserName = nonNullCStr(i->get<const char *>(1));
+      bridgeApiURL = nonNullCStr(i->get<const char *>(2));
+      fixedURL = i->get<bool>(3);
+    }
+  }
+}
+
+
+DevicePtr HueVdc::restoreDevice(JsonObjectPtr aSnapshotInfo)
+{
+  JsonObjectPtr o;
+  if (!aSnapshotInfo->get("lightID", o)) return DevicePtr();
+  string lightID = o->stringValue();
+  string uniqueID;
+  if (aSnapshotInfo->get("uniqueID", o)) uniqueID = o->stringValue();
+  bool isColor = aSnapshotInfo->get("color", o) && o->boolValue();
+  bool ctOnly = aSnapshotInfo->get("ctOnly", o) && o->boolValue();
+  if (hueComm.baseURL.empty()) {
+    // bridge will be refound when verifying restored devices, until then use the last known API URL
+    loadBridgeSettings();
+    hueComm.userName = bridgeUserName;
+    hueComm.baseURL = bridgeApiURL;
+  }
+  return DevicePtr(new HueDevice(this, lightID, isColor, ctOnly, uniqueID));
+}
+
+
 void HueVdc::handleGlobalEvent(VdchostEvent aEvent)
 {
   if (aEvent==vdchost_network_reconnected) {
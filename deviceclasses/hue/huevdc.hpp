@@ -138,8 +138,13 @@ namespace p44 {
     /// @param aEvent the event to handle
     virtual void handleGlobalEvent(VdchostEvent aEvent) P44_OVERRIDE;
 
+    /// re-create a hue light from a warm restart snapshot
+    /// @param aSnapshotInfo the information returned by HueDevice::snapshotInfo()
+    virtual DevicePtr restoreDevice(JsonObjectPtr aSnapshotInfo) P44_OVERRIDE;
+
   private:
 
+    void loadBridgeSettings();
     void refindBridge(StatusCB aCompletedCB);
     void refindResultHandler(StatusCB aCompletedCB, ErrorPtr aError);
     void searchResultHandler(Tristate aOnlyEstablish, ErrorPtr aError);
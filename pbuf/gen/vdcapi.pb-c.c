@@ -1125,7 +1125,7 @@ void   vdcapi__vdsm__notification_set_output_channel_value__free_unpacked
   assert(message->base.descriptor == &vdcapi__vdsm__notification_set_output_channel_value__descriptor);
   protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
 }
-static const ProtobufCFieldDescriptor vdcapi__vdsm__request_hello__field_descriptors[2] =
+static const ProtobufCFieldDescriptor vdcapi__vdsm__request_hello__field_descriptors[4] =
 {
   {
     "dSUID",
@@ -1151,15 +1151,42 @@ static const ProtobufCFieldDescriptor vdcapi__vdsm__request_hello__field_descrip
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "x_p44_fragmentation",
+    100,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_BOOL,
+    offsetof(Vdcapi__VdsmRequestHello, has_x_p44_fragmentation),
+    offsetof(Vdcapi__VdsmRequestHello, x_p44_fragmentation),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "x_p44_observer",
+    101,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_BOOL,
+    offsetof(Vdcapi__VdsmRequestHello, has_x_p44_observer),
+    offsetof(Vdcapi__VdsmRequestHello, x_p44_observer),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned vdcapi__vdsm__request_hello__field_indices_by_name[] = {
   1,   /* field[1] = api_version */
   0,   /* field[0] = dSUID */
+  2,   /* field[2] = x_p44_fragmentation */
+  3,   /* field[3] = x_p44_observer */
 };
-static const ProtobufCIntRange vdcapi__vdsm__request_hello__number_ranges[1 + 1] =
+static const ProtobufCIntRange vdcapi__vdsm__request_hello__number_ranges[2 + 1] =
 {
   { 1, 0 },
-  { 0, 2 }
+  { 100, 2 },
+  { 0, 4 }
 };
 const ProtobufCMessageDescriptor vdcapi__vdsm__request_hello__descriptor =
 {
@@ -1169,14 +1196,14 @@ const ProtobufCMessageDescriptor vdcapi__vdsm__request_hello__descriptor =
   "Vdcapi__VdsmRequestHello",
   "vdcapi",
   sizeof(Vdcapi__VdsmRequestHello),
-  2,
+  4,
   vdcapi__vdsm__request_hello__field_descriptors,
   vdcapi__vdsm__request_hello__field_indices_by_name,
-  1,  vdcapi__vdsm__request_hello__number_ranges,
+  2,  vdcapi__vdsm__request_hello__number_ranges,
   (ProtobufCMessageInit) vdcapi__vdsm__request_hello__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor vdcapi__vdc__response_hello__field_descriptors[1] =
+static const ProtobufCFieldDescriptor vdcapi__vdc__response_hello__field_descriptors[3] =
 {
   {
     "dSUID",
@@ -1190,14 +1217,41 @@ static const ProtobufCFieldDescriptor vdcapi__vdc__response_hello__field_descrip
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "x_p44_fragmentation",
+    100,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_BOOL,
+    offsetof(Vdcapi__VdcResponseHello, has_x_p44_fragmentation),
+    offsetof(Vdcapi__VdcResponseHello, x_p44_fragmentation),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "x_p44_observer",
+    101,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_BOOL,
+    offsetof(Vdcapi__VdcResponseHello, has_x_p44_observer),
+    offsetof(Vdcapi__VdcResponseHello, x_p44_observer),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned vdcapi__vdc__response_hello__field_indices_by_name[] = {
   0,   /* field[0] = dSUID */
+  1,   /* field[1] = x_p44_fragmentation */
+  2,   /* field[2] = x_p44_observer */
 };
-static const ProtobufCIntRange vdcapi__vdc__response_hello__number_ranges[1 + 1] =
+static const ProtobufCIntRange vdcapi__vdc__response_hello__number_ranges[2 + 1] =
 {
   { 1, 0 },
-  { 0, 1 }
+  { 100, 1 },
+  { 0, 3 }
 };
 const ProtobufCMessageDescriptor vdcapi__vdc__response_hello__descriptor =
 {
@@ -1207,10 +1261,10 @@ const ProtobufCMessageDescriptor vdcapi__vdc__response_hello__descriptor =
   "Vdcapi__VdcResponseHello",
   "vdcapi",
   sizeof(Vdcapi__VdcResponseHello),
-  1,
+  3,
   vdcapi__vdc__response_hello__field_descriptors,
   vdcapi__vdc__response_hello__field_indices_by_name,
-  1,  vdcapi__vdc__response_hello__number_ranges,
+  2,  vdcapi__vdc__response_hello__number_ranges,
   (ProtobufCMessageInit) vdcapi__vdc__response_hello__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
@@ -1622,7 +1676,7 @@ const ProtobufCMessageDescriptor vdcapi__property_element__descriptor =
   (ProtobufCMessageInit) vdcapi__property_element__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor vdcapi__vdsm__request_get_property__field_descriptors[2] =
+static const ProtobufCFieldDescriptor vdcapi__vdsm__request_get_property__field_descriptors[3] =
 {
   {
     "dSUID",
@@ -1648,15 +1702,29 @@ static const ProtobufCFieldDescriptor vdcapi__vdsm__request_get_property__field_
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "x_p44_since",
+    100,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(Vdcapi__VdsmRequestGetProperty, has_x_p44_since),
+    offsetof(Vdcapi__VdsmRequestGetProperty, x_p44_since),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned vdcapi__vdsm__request_get_property__field_indices_by_name[] = {
   0,   /* field[0] = dSUID */
   1,   /* field[1] = query */
+  2,   /* field[2] = x_p44_since */
 };
-static const ProtobufCIntRange vdcapi__vdsm__request_get_property__number_ranges[1 + 1] =
+static const ProtobufCIntRange vdcapi__vdsm__request_get_property__number_ranges[2 + 1] =
 {
   { 1, 0 },
-  { 0, 2 }
+  { 100, 2 },
+  { 0, 3 }
 };
 const ProtobufCMessageDescriptor vdcapi__vdsm__request_get_property__descriptor =
 {
@@ -1666,10 +1734,10 @@ const ProtobufCMessageDescriptor vdcapi__vdsm__request_get_property__descriptor
   "Vdcapi__VdsmRequestGetProperty",
   "vdcapi",
   sizeof(Vdcapi__VdsmRequestGetProperty),
-  2,
+  3,
   vdcapi__vdsm__request_get_property__field_descriptors,
   vdcapi__vdsm__request_get_property__field_indices_by_name,
-  1,  vdcapi__vdsm__request_get_property__number_ranges,
+  2,  vdcapi__vdsm__request_get_property__number_ranges,
   (ProtobufCMessageInit) vdcapi__vdsm__request_get_property__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
@@ -54,20 +54,28 @@ struct  _Vdcapi__VdsmRequestHello
   char *dsuid;
   protobuf_c_boolean has_api_version;
   uint32_t api_version;
+  protobuf_c_boolean has_x_p44_fragmentation;
+  protobuf_c_boolean x_p44_fragmentation;
+  protobuf_c_boolean has_x_p44_observer;
+  protobuf_c_boolean x_p44_observer;
 };
 #define VDCAPI__VDSM__REQUEST_HELLO__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&vdcapi__vdsm__request_hello__descriptor) \
-    , NULL, 0,0 }
+    , NULL, 0,0, 0,0, 0,0 }
 
 
 struct  _Vdcapi__VdcResponseHello
 {
   ProtobufCMessage base;
   char *dsuid;
+  protobuf_c_boolean has_x_p44_fragmentation;
+  protobuf_c_boolean x_p44_fragmentation;
+  protobuf_c_boolean has_x_p44_observer;
+  protobuf_c_boolean x_p44_observer;
 };
 #define VDCAPI__VDC__RESPONSE_HELLO__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&vdcapi__vdc__response_hello__descriptor) \
-    , NULL }
+    , NULL, 0,0, 0,0 }
 
 
 struct  _Vdcapi__VdcSendAnnounceDevice
@@ -170,10 +178,12 @@ struct  _Vdcapi__VdsmRequestGetProperty
   char *dsuid;
   size_t n_query;
   Vdcapi__PropertyElement **query;
+  protobuf_c_boolean has_x_p44_since;
+  uint64_t x_p44_since;
 };
 #define VDCAPI__VDSM__REQUEST_GET_PROPERTY__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&vdcapi__vdsm__request_get_property__descriptor) \
-    , NULL, 0,NULL }
+    , NULL, 0,NULL, 0,0 }
 
 
 struct  _Vdcapi__VdcResponseGetProperty
@@ -0,0 +1,155 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+
+// API value encoding benchmark: encodes and decodes the same property tree as JSON, protobuf and MessagePack
+//
+// Usage: apivalue_bench [<numdevices>] [<numrounds>]
+// - builds a getProperty-like result tree for <numdevices> devices
+// - reports encoded size and the time per encode and per decode for each encoding
+
+#include "jsonvdcapi.hpp"
+#include "pbufvdcapi.hpp"
+#include "msgpackvdcapi.hpp"
+
+using namespace p44;
+
+
+static ApiValuePtr buildTree(int aNumDevices)
+{
+  ApiValuePtr tree = ApiValuePtr(new JsonApiValue);
+  tree->setType(apivalue_object);
+  ApiValuePtr devices = tree->newObject();
+  for (int d=0; d<aNumDevices; d++) {
+    ApiValuePtr dev = tree->newObject();
+    dev->add("name", dev->newString(string_format("Device %d", d)));
+    dev->add("dSUID", dev->newString(string_format("%034X", d)));
+    dev->add("zoneID", dev->newUint64(d % 20));
+    dev->add("active", dev->newBool(true));
+    ApiValuePtr channels = dev->newObject();
+    for (int c=0; c<3; c++) {
+      ApiValuePtr ch = dev->newObject();
+      ch->add("value", ch->newDouble(c*33.3));
+      ch->add("age", ch->newDouble(0.5*d));
+      channels->add(string_format("%d", c), ch);
+    }
+    ApiValuePtr chst = dev->newObject();
+    chst->add("channelStates", channels);
+    dev->add("output", chst);
+    ApiValuePtr groups = dev->newArray();
+    groups->arrayAppend(groups->newUint64(1));
+    groups->arrayAppend(groups->newUint64(48));
+    dev->add("x-p44-groups", groups);
+    devices->add(string_format("%d", d), dev);
+  }
+  tree->add("x-p44-devices", devices);
+  return tree;
+}
+
+
+static void report(const char *aEncoding, size_t aSize, int aRounds, MLMicroSeconds aEncodeTime, MLMicroSeconds aDecodeTime)
+{
+  printf("%-10s %8zu bytes, encode %.3f mS, decode %.3f mS\n", aEncoding, aSize, (double)aEncodeTime/aRounds/MilliSecond, (double)aDecodeTime/aRounds/MilliSecond);
+}
+
+
+static void benchJson(ApiValuePtr aTree, int aRounds)
+{
+  JsonApiValuePtr tree = boost::dynamic_pointer_cast<JsonApiValue>(aTree);
+  string encoded;
+  MLMicroSeconds t = MainLoop::now();
+  for (int r=0; r<aRounds; r++) {
+    encoded = tree->jsonObject()->c_strValue();
+  }
+  MLMicroSeconds encodeTime = MainLoop::now()-t;
+  t = MainLoop::now();
+  for (int r=0; r<aRounds; r++) {
+    ApiValuePtr decoded = JsonApiValue::newValueFromJson(JsonObject::objFromText(encoded.c_str()));
+  }
+  report("JSON", encoded.size(), aRounds, encodeTime, MainLoop::now()-t);
+}
+
+
+static void benchPbuf(ApiValuePtr aTree, int aRounds)
+{
+  // convert into pbuf tree first, as the API would create it natively
+  PbufApiValuePtr tree = PbufApiValuePtr(new PbufApiValue);
+  static_cast<ApiValue &>(*tree) = *aTree;
+  string encoded;
+  MLMicroSeconds t = MainLoop::now();
+  for (int r=0; r<aRounds; r++) {
+    // same as a getProperty response: tree goes into the "properties" field
+    Vdcapi__VdcResponseGetProperty *msg = new Vdcapi__VdcResponseGetProperty;
+    vdcapi__vdc__response_get_property__init(msg);
+    tree->putValueIntoMessageField(msg->base.descriptor->fields[0], msg->base);
+    encoded.resize(vdcapi__vdc__response_get_property__get_packed_size(msg));
+    vdcapi__vdc__response_get_property__pack(msg, (uint8_t *)&encoded[0]);
+    protobuf_c_message_free_unpacked(&msg->base, NULL);
+  }
+  MLMicroSeconds encodeTime = MainLoop::now()-t;
+  t = MainLoop::now();
+  for (int r=0; r<aRounds; r++) {
+    Vdcapi__VdcResponseGetProperty *msg = vdcapi__vdc__response_get_property__unpack(NULL, encoded.size(), (const uint8_t *)encoded.c_str());
+    PbufApiValuePtr decoded = PbufApiValuePtr(new PbufApiValue);
+    decoded->getValueFromMessageField(msg->base.descriptor->fields[0], msg->base);
+    vdcapi__vdc__response_get_property__free_unpacked(msg, NULL);
+  }
+  report("protobuf", encoded.size(), aRounds, encodeTime, MainLoop::now()-t);
+}
+
+
+static void benchMsgpack(ApiValuePtr aTree, int aRounds)
+{
+  MsgpackApiValuePtr tree = MsgpackApiValuePtr(new MsgpackApiValue);
+  static_cast<ApiValue &>(*tree) = *aTree;
+  string encoded;
+  MLMicroSeconds t = MainLoop::now();
+  for (int r=0; r<aRounds; r++) {
+    encoded.clear();
+    tree->appendMsgpack(encoded);
+  }
+  MLMicroSeconds encodeTime = MainLoop::now()-t;
+  t = MainLoop::now();
+  for (int r=0; r<aRounds; r++) {
+    ErrorPtr err;
+    MsgpackApiValuePtr decoded = MsgpackApiValue::newValueFromMsgpack((const uint8_t *)encoded.c_str(), encoded.size(), err);
+    if (!decoded) {
+      printf("MessagePack decoding failed: %s\n", err ? err->description().c_str() : "unknown error");
+      return;
+    }
+  }
+  report("MessagePack", encoded.size(), aRounds, encodeTime, MainLoop::now()-t);
+}
+
+
+int main(int argc, char **argv)
+{
+  int numDevices = argc>1 ? atoi(argv[1]) : 1000;
+  int numRounds = argc>2 ? atoi(argv[2]) : 20;
+  SETLOGLEVEL(LOG_WARNING);
+  ApiValuePtr tree = buildTree(numDevices);
+  benchJson(tree, numRounds);
+  benchPbuf(tree, numRounds);
+  benchMsgpack(tree, numRounds);
+  return EXIT_SUCCESS;
+}
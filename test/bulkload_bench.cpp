@@ -0,0 +1,87 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// Startup benchmark: collecting and loading the persistent params of many simulated (console) devices
+//
+// Usage: bulkload_bench <datadir> [<numdevices>] [nobulk]
+// - the first run on an empty <datadir> creates the devices' records, subsequent runs load them
+// - "nobulk" makes devices load their params one by one, as they are added, for comparison
+
+#include "vdchost.hpp"
+#include "staticvdc.hpp"
+
+using namespace p44;
+
+
+static MLMicroSeconds startTime;
+
+
+static void collected(VdcHostPtr aVdcHost, ErrorPtr aError)
+{
+  MLMicroSeconds t = MainLoop::now()-startTime;
+  if (!Error::isOK(aError)) {
+    printf("collecting failed: %s\n", aError->description().c_str());
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+    return;
+  }
+  printf("collected, loaded and initialized devices in %.3f seconds\n", (double)t/Second);
+  // make sure everything is written for the next run
+  aVdcHost->saveAllNow();
+  MainLoop::currentMainLoop().terminate(EXIT_SUCCESS);
+}
+
+
+static void initialized(VdcHostPtr aVdcHost, ErrorPtr aError)
+{
+  if (!Error::isOK(aError)) {
+    printf("initialisation failed: %s\n", aError->description().c_str());
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+    return;
+  }
+  startTime = MainLoop::now();
+  aVdcHost->collectDevices(boost::bind(&collected, aVdcHost, _1), rescanmode_normal);
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc<2) {
+    fprintf(stderr, "Usage: %s <datadir> [<numdevices>] [nobulk]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  int numDevices = argc>2 ? atoi(argv[2]) : 1000;
+  bool bulk = !(argc>3 && strcmp(argv[3], "nobulk")==0);
+  SETLOGLEVEL(LOG_WARNING);
+  VdcHostPtr vdcHost = VdcHostPtr(new VdcHost);
+  vdcHost->setPersistentDataDir(argv[1]);
+  vdcHost->setBulkLoad(bulk);
+  vdcHost->prepareForVdcs(false);
+  DeviceConfigMap devices;
+  for (int i=0; i<numDevices; i++) {
+    devices.insert(make_pair("console", string_format("bench%04d:%s", i, i%2 ? "dimmer" : "button")));
+  }
+  StaticVdcPtr staticVdc = StaticVdcPtr(new StaticVdc(1, devices, vdcHost.get(), 1));
+  staticVdc->addVdcToVdcHost();
+  printf("%s load of %d devices\n", bulk ? "bulk" : "per-device", numDevices);
+  vdcHost->initialize(boost::bind(&initialized, vdcHost, _1), false);
+  return MainLoop::currentMainLoop().run();
+}
@@ -0,0 +1,186 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// Test of delta reads (x-p44-since): a read since a change generation must return exactly the devices changed after
+// it, including changes made below the device level (channels), and nothing when nothing has changed.
+//
+// Usage: deltaread_test <datadir> [<numdevices>]
+
+#include "vdchost.hpp"
+#include "staticvdc.hpp"
+#include "jsonvdcapi.hpp"
+#include "channelbehaviour.hpp"
+
+#include "testcheck.hpp"
+
+using namespace p44;
+
+
+#define DEVICES_QUERY "{ \"x-p44-vdcs\": { \"*\": { \"x-p44-devices\": { \"*\": null } } } }"
+
+
+class TestVdc : public StaticVdc
+{
+  typedef StaticVdc inherited;
+public:
+  TestVdc(DeviceConfigMap aDeviceConfigs, VdcHost *aVdcHostP) : inherited(1, aDeviceConfigs, aVdcHostP, 1) {};
+  DevicePtr getDevice(size_t aIndex) { return devices[aIndex]; };
+};
+typedef boost::intrusive_ptr<TestVdc> TestVdcPtr;
+
+
+static void storeResult(ApiValuePtr *aResultP, ErrorPtr *aErrP, ApiValuePtr aResult, ErrorPtr aError)
+{
+  *aResultP = aResult;
+  *aErrP = aError;
+}
+
+
+/// read properties
+/// @return the result, NULL if the read failed or did not complete synchronously
+static ApiValuePtr readProperties(PropertyContainerPtr aContainer, const char *aQuery, uint64_t aSince)
+{
+  ApiValuePtr result;
+  ErrorPtr err = TextError::err("not completed");
+  ApiValuePtr query = JsonApiValue::newValueFromJson(JsonObject::objFromText(aQuery));
+  aContainer->accessProperty(access_read, query, VDC_API_DOMAIN, VDC_API_VERSION_MAX, boost::bind(&storeResult, &result, &err, _1, _2), aSince);
+  TEST_CHECK(Error::isOK(err));
+  return Error::isOK(err) ? result : ApiValuePtr();
+}
+
+
+/// @return the indices of the devices in a result of DEVICES_QUERY, separated by commas
+static string resultDevices(ApiValuePtr aResult)
+{
+  string devs;
+  if (!aResult) return "<failed>";
+  ApiValuePtr vdcs = aResult->get("x-p44-vdcs");
+  if (!vdcs) return devs;
+  string vdcKey, devKey;
+  ApiValuePtr vdc, dev;
+  vdcs->resetKeyIteration();
+  while (vdcs->nextKeyValue(vdcKey, vdc)) {
+    ApiValuePtr devices = vdc->get("x-p44-devices");
+    if (!devices) continue;
+    devices->resetKeyIteration();
+    while (devices->nextKeyValue(devKey, dev)) {
+      if (!devs.empty()) devs += ",";
+      devs += devKey;
+    }
+  }
+  return devs;
+}
+
+
+static void testDeltaReads(VdcHostPtr aVdcHost, TestVdcPtr aVdc)
+{
+  // nothing changed
+  uint64_t gen = PropertyContainer::currentChangeGeneration();
+  ApiValuePtr result = readProperties(aVdcHost, DEVICES_QUERY, gen);
+  TEST_CHECK(result && resultDevices(result)=="");
+  // full read still returns all devices
+  result = readProperties(aVdcHost, DEVICES_QUERY, 0);
+  string all;
+  for (size_t i=0; i<aVdc->getNumberOfDevices(); i++) {
+    if (i>0) all += ",";
+    string_format_append(all, "%zu", i);
+  }
+  TEST_CHECK(resultDevices(result)==all);
+  // property written on device 1
+  ErrorPtr err = TextError::err("not completed");
+  ApiValuePtr w = JsonApiValue::newValueFromJson(JsonObject::objFromText("{ \"name\": \"changed by delta test\" }"));
+  aVdc->getDevice(1)->accessProperty(access_write, w, VDC_API_DOMAIN, VDC_API_VERSION_MAX, boost::bind(&storeResult, &result, &err, _1, _2));
+  TEST_CHECK(Error::isOK(err));
+  result = readProperties(aVdcHost, DEVICES_QUERY, gen);
+  TEST_CHECK(resultDevices(result)=="1");
+  if (result && resultDevices(result)=="1") {
+    // changed device is returned with its changed value
+    ApiValuePtr vdcs = result->get("x-p44-vdcs");
+    string key;
+    ApiValuePtr vdc;
+    vdcs->resetKeyIteration();
+    vdcs->nextKeyValue(key, vdc);
+    ApiValuePtr name = vdc->get("x-p44-devices")->get("1")->get("name");
+    TEST_CHECK(name && name->stringValue()=="changed by delta test");
+  }
+  // channel value set on device 2, must propagate up through output and device
+  uint64_t gen2 = PropertyContainer::currentChangeGeneration();
+  ChannelBehaviourPtr ch = aVdc->getDevice(2)->getChannelByIndex(0);
+  TEST_CHECK(ch);
+  if (ch) ch->setChannelValue(ch->getChannelValue()>50 ? 10 : 90);
+  result = readProperties(aVdcHost, DEVICES_QUERY, gen2);
+  TEST_CHECK(resultDevices(result)=="2");
+  // since the first generation, both changes are returned
+  result = readProperties(aVdcHost, DEVICES_QUERY, gen);
+  TEST_CHECK(resultDevices(result)=="1,2");
+  // reading a single device directly
+  result = readProperties(aVdc->getDevice(0), "{ \"name\": null }", gen);
+  TEST_CHECK(result && !result->get("name"));
+  result = readProperties(aVdc->getDevice(1), "{ \"name\": null }", gen);
+  TEST_CHECK(result && result->get("name"));
+  // nothing changed since now
+  result = readProperties(aVdcHost, DEVICES_QUERY, PropertyContainer::currentChangeGeneration());
+  TEST_CHECK(resultDevices(result)=="");
+}
+
+
+static void collected(VdcHostPtr aVdcHost, TestVdcPtr aVdc, ErrorPtr aError)
+{
+  TEST_CHECK(Error::isOK(aError));
+  TEST_CHECK(aVdc->getNumberOfDevices()>=3);
+  if (Error::isOK(aError) && aVdc->getNumberOfDevices()>=3) testDeltaReads(aVdcHost, aVdc);
+  MainLoop::currentMainLoop().terminate(EXIT_SUCCESS);
+}
+
+
+static void initialized(VdcHostPtr aVdcHost, TestVdcPtr aVdc, ErrorPtr aError)
+{
+  TEST_CHECK(Error::isOK(aError));
+  if (!Error::isOK(aError)) {
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+    return;
+  }
+  aVdcHost->collectDevices(boost::bind(&collected, aVdcHost, aVdc, _1), rescanmode_normal);
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc<2) {
+    fprintf(stderr, "Usage: %s <datadir> [<numdevices>]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  int numDevices = argc>2 ? atoi(argv[2]) : 5;
+  SETLOGLEVEL(LOG_WARNING);
+  VdcHostPtr vdcHost = VdcHostPtr(new VdcHost);
+  vdcHost->setPersistentDataDir(argv[1]);
+  vdcHost->prepareForVdcs(true);
+  DeviceConfigMap devices;
+  for (int i=0; i<numDevices; i++) {
+    devices.insert(make_pair("console", string_format("delta%04d:dimmer", i)));
+  }
+  TestVdcPtr vdc = TestVdcPtr(new TestVdc(devices, vdcHost.get()));
+  vdc->addVdcToVdcHost();
+  vdcHost->initialize(boost::bind(&initialized, vdcHost, vdc, _1), false);
+  MainLoop::currentMainLoop().run();
+  return testSummary("deltaread_test");
+}
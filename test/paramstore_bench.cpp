@@ -0,0 +1,142 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// Benchmark of saving and loading PersistentParams records, with statements prepared per call
+// (PersistentParams::saveToStore()/loadFromStore()) and with the statements cached by CachingParamStore
+//
+// Usage: paramstore_bench <dbfile> [<numrows>] [wal]
+
+#include "cachingparamstore.hpp"
+
+using namespace p44;
+
+
+class BenchRecord : public PersistentParams
+{
+  typedef PersistentParams inherited;
+public:
+  int intValue;
+  string textValue;
+  double doubleValue;
+
+  BenchRecord(ParamStore &aParamStore) : inherited(aParamStore), intValue(0), doubleValue(0) {};
+
+  virtual const char *tableName() P44_OVERRIDE { return "BenchRecords"; };
+
+  virtual size_t numFieldDefs() P44_OVERRIDE { return inherited::numFieldDefs()+3; };
+
+  virtual const FieldDefinition *getFieldDef(size_t aIndex) P44_OVERRIDE
+  {
+    static const FieldDefinition dataDefs[3] = {
+      { "intValue", SQLITE_INTEGER },
+      { "textValue", SQLITE_TEXT },
+      { "doubleValue", SQLITE_FLOAT }
+    };
+    if (aIndex<inherited::numFieldDefs()) return inherited::getFieldDef(aIndex);
+    aIndex -= inherited::numFieldDefs();
+    return aIndex<3 ? &dataDefs[aIndex] : NULL;
+  };
+
+  virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP) P44_OVERRIDE
+  {
+    inherited::loadFromRow(aRow, aIndex, aCommonFlagsP);
+    intValue = aRow->get<int>(aIndex++);
+    textValue = nonNullCStr(aRow->get<const char *>(aIndex++));
+    doubleValue = aRow->get<double>(aIndex++);
+  };
+
+  virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags) P44_OVERRIDE
+  {
+    inherited::bindToStatement(aStatement, aIndex, aParentIdentifier, aCommonFlags);
+    aStatement.bind(aIndex++, intValue);
+    aStatement.bind(aIndex++, textValue.c_str(), false);
+    aStatement.bind(aIndex++, doubleValue);
+  };
+};
+
+
+static void report(const char *aWhat, int aNumRows, MLMicroSeconds aStart)
+{
+  MLMicroSeconds t = MainLoop::now()-aStart;
+  printf("%-28s %8d rows %10.3f ms %8.2f uS/row\n", aWhat, aNumRows, (double)t/MilliSecond, (double)t/aNumRows);
+}
+
+
+static void run(CachingParamStore &aStore, int aNumRows, bool aCached, bool aInTransaction)
+{
+  string what = string(aCached ? "cached" : "per call")+(aInTransaction ? ", batched" : ", single");
+  // save
+  MLMicroSeconds start = MainLoop::now();
+  if (aInTransaction) aStore.execute("BEGIN");
+  for (int i=0; i<aNumRows; i++) {
+    BenchRecord r(aStore);
+    r.intValue = i;
+    r.textValue = string_format("record #%d", i);
+    r.doubleValue = i/3.0;
+    r.markDirty();
+    string parentId = string_format("bench%06d", i);
+    if (aCached) CachingParamStore::save(r, parentId.c_str(), false);
+    else r.saveToStore(parentId.c_str(), false);
+  }
+  if (aInTransaction) aStore.execute("COMMIT");
+  report(("save, "+what).c_str(), aNumRows, start);
+  // load
+  start = MainLoop::now();
+  for (int i=0; i<aNumRows; i++) {
+    BenchRecord r(aStore);
+    string parentId = string_format("bench%06d", i);
+    if (aCached) CachingParamStore::load(r, parentId.c_str());
+    else r.loadFromStore(parentId.c_str());
+  }
+  report(("load, "+what).c_str(), aNumRows, start);
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc<2) {
+    fprintf(stderr, "Usage: %s <dbfile> [<numrows>] [wal]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  int numRows = argc>2 ? atoi(argv[2]) : 1000;
+  SETLOGLEVEL(LOG_WARNING);
+  CachingParamStore store;
+  ErrorPtr err = store.connectAndInitialize(argv[1], 1, 1, true);
+  if (!Error::isOK(err)) {
+    fprintf(stderr, "cannot open DB: %s\n", err->description().c_str());
+    return EXIT_FAILURE;
+  }
+  if (argc>3 && strcmp(argv[3], "wal")==0) {
+    store.execute("PRAGMA journal_mode=WAL");
+    store.execute("PRAGMA synchronous=NORMAL");
+  }
+  // create the table
+  BenchRecord r(store);
+  r.markDirty();
+  r.saveToStore("bench-init", false);
+  // measure
+  run(store, numRows, false, false);
+  run(store, numRows, true, false);
+  run(store, numRows, false, true);
+  run(store, numRows, true, true);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,198 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// Test of the persistence worker: values written by the worker thread must arrive in the DB exactly as
+// bindToStatement() binds them, ROWIDs must be assigned on the main thread, and records whose write failed
+// must be dirty again, so the next save retries.
+//
+// Usage: persistenceworker_test <dbfile>
+// Note: <dbfile> is overwritten
+
+#include "persistenceworker.hpp"
+#include "cachingparamstore.hpp"
+
+#include "testcheck.hpp"
+
+using namespace p44;
+
+
+class TestRecord : public PersistentParams, public P44Obj
+{
+  typedef PersistentParams inherited;
+public:
+  long long intValue;
+  string textValue;
+  double doubleValue;
+
+  TestRecord(ParamStore &aParamStore) : inherited(aParamStore), intValue(0), doubleValue(0) {};
+
+  virtual const char *tableName() P44_OVERRIDE { return "TestRecords"; };
+
+  virtual size_t numFieldDefs() P44_OVERRIDE { return inherited::numFieldDefs()+3; };
+
+  virtual const FieldDefinition *getFieldDef(size_t aIndex) P44_OVERRIDE
+  {
+    static const FieldDefinition dataDefs[3] = {
+      { "intValue", SQLITE_INTEGER },
+      { "textValue", SQLITE_TEXT },
+      { "doubleValue", SQLITE_FLOAT }
+    };
+    if (aIndex<inherited::numFieldDefs()) return inherited::getFieldDef(aIndex);
+    aIndex -= inherited::numFieldDefs();
+    return aIndex<3 ? &dataDefs[aIndex] : NULL;
+  };
+
+  virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP) P44_OVERRIDE
+  {
+    inherited::loadFromRow(aRow, aIndex, aCommonFlagsP);
+    intValue = aRow->get<long long>(aIndex++);
+    textValue = nonNullCStr(aRow->get<const char *>(aIndex++));
+    doubleValue = aRow->get<double>(aIndex++);
+  };
+
+  virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags) P44_OVERRIDE
+  {
+    inherited::bindToStatement(aStatement, aIndex, aParentIdentifier, aCommonFlags);
+    aStatement.bind(aIndex++, intValue);
+    aStatement.bind(aIndex++, textValue.c_str(), false);
+    aStatement.bind(aIndex++, doubleValue);
+  };
+};
+typedef boost::intrusive_ptr<TestRecord> TestRecordPtr;
+
+
+static int countRows(ParamStore &aStore, const char *aParentId)
+{
+  sqlite3pp::query q(aStore);
+  if (q.prepare("SELECT count(*) FROM TestRecords WHERE parentID=?")!=SQLITE_OK) return -1;
+  q.bind(1, aParentId, false);
+  sqlite3pp::query::iterator row = q.begin();
+  return row!=q.end() ? row->get<int>(0) : -1;
+}
+
+
+static void storeError(ErrorPtr *aErrP, ErrorPtr aErr)
+{
+  *aErrP = aErr;
+}
+
+
+static void testRoundTrip(CachingParamStore &aStore, PersistenceWorker &aWorker)
+{
+  TestRecordPtr r = TestRecordPtr(new TestRecord(aStore));
+  r->intValue = (1LL<<53)+1; // not representable as double
+  r->textValue = "äöü \"quoted\" 'single'";
+  r->doubleValue = 1.0/3;
+  r->markDirty();
+  TEST_CHECK(Error::isOK(PersistenceWorker::save(&aWorker, *r, "roundtrip", false)));
+  TEST_CHECK(!r->isDirty()); // captured
+  TEST_CHECK(r->rowid!=0); // assigned on the main thread, before the write is done
+  aWorker.flush();
+  TEST_CHECK(!r->isDirty());
+  TestRecord l(aStore);
+  TEST_CHECK(Error::isOK(l.loadFromStore("roundtrip")));
+  TEST_CHECK(l.rowid==r->rowid);
+  TEST_CHECK(l.intValue==r->intValue);
+  TEST_CHECK(l.textValue==r->textValue);
+  TEST_CHECK(l.doubleValue==r->doubleValue);
+  // saving again must update the same record
+  r->intValue = -1;
+  r->markDirty();
+  PersistenceWorker::save(&aWorker, *r, "roundtrip", false);
+  aWorker.flush();
+  TEST_CHECK(countRows(aStore, "roundtrip")==1);
+  TEST_CHECK(Error::isOK(l.loadFromStore("roundtrip")));
+  TEST_CHECK(l.intValue==-1);
+}
+
+
+static void testRowIds(CachingParamStore &aStore, PersistenceWorker &aWorker)
+{
+  // new records saved before any write is done must still get distinct ROWIDs
+  TestRecordPtr r1 = TestRecordPtr(new TestRecord(aStore));
+  TestRecordPtr r2 = TestRecordPtr(new TestRecord(aStore));
+  r1->markDirty();
+  r2->markDirty();
+  PersistenceWorker::save(&aWorker, *r1, "multi", true);
+  PersistenceWorker::save(&aWorker, *r2, "multi", true);
+  TEST_CHECK(r1->rowid!=0 && r2->rowid!=0);
+  TEST_CHECK(r1->rowid!=r2->rowid);
+  aWorker.flush();
+  TEST_CHECK(countRows(aStore, "multi")==2);
+  // forgetting must delete exactly that record
+  PersistenceWorker::forget(&aWorker, *r1);
+  TEST_CHECK(r1->rowid==0);
+  aWorker.flush();
+  TEST_CHECK(countRows(aStore, "multi")==1);
+}
+
+
+static void testFailedWrite(CachingParamStore &aStore, PersistenceWorker &aWorker)
+{
+  // save once, so the statement is known to be valid
+  TestRecordPtr r = TestRecordPtr(new TestRecord(aStore));
+  r->markDirty();
+  PersistenceWorker::save(&aWorker, *r, "failing", false);
+  aWorker.flush();
+  TEST_CHECK(!r->isDirty());
+  // make the next write fail in the worker thread
+  ErrorPtr dropErr = TextError::err("not executed");
+  aWorker.write("DROP TABLE TestRecords", boost::bind(&storeError, &dropErr, _1));
+  r->intValue = 42;
+  r->markDirty();
+  TEST_CHECK(Error::isOK(PersistenceWorker::save(&aWorker, *r, "failing", false)));
+  TEST_CHECK(!r->isDirty()); // captured, not yet known to have failed
+  aWorker.flush();
+  TEST_CHECK(Error::isOK(dropErr));
+  TEST_CHECK(r->isDirty()); // must be saved again
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc<2) {
+    fprintf(stderr, "Usage: %s <dbfile>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  SETLOGLEVEL(LOG_CRIT); // failed writes are expected
+  unlink(argv[1]);
+  CachingParamStore store;
+  ErrorPtr err = store.connectAndInitialize(argv[1], 1, 1, true);
+  if (!Error::isOK(err)) {
+    fprintf(stderr, "cannot open DB: %s\n", err->description().c_str());
+    return EXIT_FAILURE;
+  }
+  store.execute("PRAGMA journal_mode=WAL");
+  // create the table
+  TestRecord init(store);
+  init.markDirty();
+  init.saveToStore("init", false);
+  // test
+  PersistenceWorker *worker = new PersistenceWorker(store, argv[1]);
+  PersistenceWorkerPtr keepWorker = PersistenceWorkerPtr(worker);
+  worker->start();
+  testRoundTrip(store, *worker);
+  testRowIds(store, *worker);
+  testFailedWrite(store, *worker);
+  worker->stop();
+  return testSummary("persistenceworker_test");
+}
@@ -0,0 +1,130 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+// Property access benchmark: repeated wildcard reads over many simulated (console) devices
+//
+// Usage: propertyaccess_bench <datadir> [<numdevices>] [<numreads>]
+// - reports the time per read for a full and a prefix wildcard query, and the descriptor statistics
+
+#include "vdchost.hpp"
+#include "staticvdc.hpp"
+#include "jsonvdcapi.hpp"
+
+using namespace p44;
+
+
+static const char *queries[] = {
+  "{ \"x-p44-vdcs\": { \"*\": { \"x-p44-devices\": { \"*\": null } } } }",
+  "{ \"x-p44-vdcs\": { \"*\": { \"x-p44-devices\": { \"*\": { \"name\":null, \"x-p44-*\":null, \"output*\":null } } } } }",
+  NULL
+};
+
+static int numReads;
+static int queryNo;
+static int readsDone;
+static ApiValuePtr query;
+static MLMicroSeconds startTime;
+
+
+static void nextQuery(VdcHostPtr aVdcHost);
+
+static void readDone(VdcHostPtr aVdcHost, ApiValuePtr aResult, ErrorPtr aError)
+{
+  if (!Error::isOK(aError)) {
+    printf("read failed: %s\n", aError->description().c_str());
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+    return;
+  }
+  if (++readsDone<numReads) {
+    // next read from mainloop, preparations might have completed synchronously
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&nextQuery, aVdcHost));
+    return;
+  }
+  MLMicroSeconds t = MainLoop::now()-startTime;
+  printf("query %d: %d reads, %.3f mS per read\n", queryNo, numReads, (double)t/numReads/MilliSecond);
+  printf("%s\n", PropertyDescriptor::poolStatistics().c_str());
+  queryNo++;
+  readsDone = 0;
+  if (!queries[queryNo]) {
+    MainLoop::currentMainLoop().terminate(EXIT_SUCCESS);
+    return;
+  }
+  query.reset();
+  MainLoop::currentMainLoop().executeOnce(boost::bind(&nextQuery, aVdcHost));
+}
+
+
+static void nextQuery(VdcHostPtr aVdcHost)
+{
+  if (!query) {
+    query = JsonApiValue::newValueFromJson(JsonObject::objFromText(queries[queryNo]));
+    startTime = MainLoop::now();
+  }
+  aVdcHost->accessProperty(access_read, query, VDC_API_DOMAIN, VDC_API_VERSION_MAX, boost::bind(&readDone, aVdcHost, _1, _2));
+}
+
+
+static void collected(VdcHostPtr aVdcHost, ErrorPtr aError)
+{
+  if (!Error::isOK(aError)) {
+    printf("collecting failed: %s\n", aError->description().c_str());
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+    return;
+  }
+  nextQuery(aVdcHost);
+}
+
+
+static void initialized(VdcHostPtr aVdcHost, ErrorPtr aError)
+{
+  if (!Error::isOK(aError)) {
+    printf("initialisation failed: %s\n", aError->description().c_str());
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+    return;
+  }
+  aVdcHost->collectDevices(boost::bind(&collected, aVdcHost, _1), rescanmode_normal);
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc<2) {
+    fprintf(stderr, "Usage: %s <datadir> [<numdevices>] [<numreads>]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  int numDevices = argc>2 ? atoi(argv[2]) : 1000;
+  numReads = argc>3 ? atoi(argv[3]) : 100;
+  SETLOGLEVEL(LOG_WARNING);
+  VdcHostPtr vdcHost = VdcHostPtr(new VdcHost);
+  vdcHost->setPersistentDataDir(argv[1]);
+  vdcHost->prepareForVdcs(false);
+  DeviceConfigMap devices;
+  for (int i=0; i<numDevices; i++) {
+    devices.insert(make_pair("console", string_format("bench%04d:%s", i, i%2 ? "dimmer" : "button")));
+  }
+  StaticVdcPtr staticVdc = StaticVdcPtr(new StaticVdc(1, devices, vdcHost.get(), 1));
+  staticVdc->addVdcToVdcHost();
+  printf("%d reads of %d devices per query\n", numReads, numDevices);
+  vdcHost->initialize(boost::bind(&initialized, vdcHost, _1), false);
+  return MainLoop::currentMainLoop().run();
+}
@@ -0,0 +1,192 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// Test of coalescing pushNotifications on a congested protobuf API connection: a peer that does not read for a while
+// must get fewer pushes, but for every device the pushed values must never go back in time, and the last value
+// pushed must always arrive.
+//
+// Usage: pushcoalescing_test [<port>] [<numdevices>] [<numrounds>]
+
+#include "pbufvdcapi.hpp"
+
+#include "testcheck.hpp"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+
+using namespace p44;
+
+
+#define TEST_API_PORT "8441"
+
+static int numDevices = 10;
+static int numRounds = 2000;
+
+static int clientFd = -1;
+static bool flooded = false;
+static string received; ///< received data not yet decoded
+static int numReceived = 0;
+static map<string, long long> lastValues; ///< last value received, by dSUID
+static bool inOrder = true;
+
+
+static long long pushedValue(const Vdcapi__VdcSendPushNotification *aPush)
+{
+  if (aPush->n_changedproperties<1 || !aPush->changedproperties[0]->value) return -1;
+  const Vdcapi__PropertyValue *v = aPush->changedproperties[0]->value;
+  if (v->has_v_uint64) return (long long)v->v_uint64;
+  if (v->has_v_int64) return v->v_int64;
+  return -1;
+}
+
+
+static bool allReceived()
+{
+  if ((int)lastValues.size()<numDevices) return false;
+  for (map<string, long long>::iterator pos = lastValues.begin(); pos!=lastValues.end(); ++pos) {
+    if (pos->second!=numRounds-1) return false;
+  }
+  return true;
+}
+
+
+static bool clientReadable(int aFD, int aPollFlags)
+{
+  uint8_t buf[4096];
+  ssize_t n = read(aFD, buf, sizeof(buf));
+  if (n<=0) {
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+    return true;
+  }
+  received.append((const char *)buf, n);
+  // decode complete frames
+  size_t pos = 0;
+  while (pos+2<=received.size()) {
+    size_t frameSize = ((uint8_t)received[pos]<<8) + (uint8_t)received[pos+1];
+    if (pos+2+frameSize>received.size()) break;
+    Vdcapi__Message *msg = vdcapi__message__unpack(NULL, frameSize, (const uint8_t *)received.c_str()+pos+2);
+    TEST_CHECK(msg && msg->type==VDCAPI__TYPE__VDC_SEND_PUSH_NOTIFICATION && msg->vdc_send_push_notification);
+    if (msg && msg->vdc_send_push_notification && msg->vdc_send_push_notification->dsuid) {
+      long long v = pushedValue(msg->vdc_send_push_notification);
+      string dsuid = msg->vdc_send_push_notification->dsuid;
+      map<string, long long>::iterator last = lastValues.find(dsuid);
+      if (last!=lastValues.end() && v<=last->second) inOrder = false;
+      lastValues[dsuid] = v;
+      numReceived++;
+    }
+    if (msg) vdcapi__message__free_unpacked(msg, NULL);
+    pos += 2+frameSize;
+  }
+  received.erase(0, pos);
+  if (allReceived()) MainLoop::currentMainLoop().terminate(EXIT_SUCCESS);
+  return true;
+}
+
+
+static void startReading()
+{
+  MainLoop::currentMainLoop().registerPollHandler(clientFd, POLLIN, boost::bind(&clientReadable, _1, _2));
+}
+
+
+static void flood(VdcApiConnectionPtr aApiConnection)
+{
+  // keep the socket buffers small, so the connection gets congested early
+  int sz = 4096;
+  setsockopt(aApiConnection->socketConnection()->getFd(), SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+  for (int r=0; r<numRounds; r++) {
+    for (int d=0; d<numDevices; d++) {
+      ApiValuePtr params = aApiConnection->newApiValue();
+      params->setType(apivalue_object);
+      string dsuid(17, 0);
+      dsuid[16] = (char)d;
+      params->add("dSUID", params->newBinary(dsuid));
+      ApiValuePtr props = params->newValue(apivalue_object);
+      props->add("progress", props->newUint64(r));
+      params->add("changedproperties", props);
+      ErrorPtr err = aApiConnection->sendRequest("pushNotification", params);
+      TEST_CHECK(Error::isOK(err));
+    }
+  }
+  // peer starts reading only when the pushes have piled up
+  MainLoop::currentMainLoop().executeOnce(boost::bind(&startReading), 100*MilliSecond);
+}
+
+
+static void connectionStatus(VdcApiConnectionPtr aApiConnection, ErrorPtr &aError)
+{
+  if (Error::isOK(aError) && !flooded) {
+    flooded = true;
+    flood(aApiConnection);
+  }
+}
+
+
+static void connectClient(const char *aPort)
+{
+  clientFd = socket(AF_INET, SOCK_STREAM, 0);
+  int sz = 4096;
+  setsockopt(clientFd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(atoi(aPort));
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  if (connect(clientFd, (struct sockaddr *)&addr, sizeof(addr))<0) {
+    fprintf(stderr, "cannot connect to port %s\n", aPort);
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+  }
+}
+
+
+static void timeout()
+{
+  fprintf(stderr, "timeout, not all pushes received\n");
+  MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+}
+
+
+int main(int argc, char **argv)
+{
+  const char *port = argc>1 ? argv[1] : TEST_API_PORT;
+  if (argc>2) numDevices = atoi(argv[2]);
+  if (argc>3) numRounds = atoi(argv[3]);
+  SETLOGLEVEL(LOG_WARNING);
+  VdcPbufApiServerPtr server = VdcPbufApiServerPtr(new VdcPbufApiServer);
+  server->setConnectionParams("127.0.0.1", port, SOCK_STREAM, AF_INET);
+  server->setConnectionStatusHandler(boost::bind(&connectionStatus, _1, _2));
+  server->start();
+  MainLoop::currentMainLoop().executeOnce(boost::bind(&connectClient, port));
+  MainLoop::currentMainLoop().executeOnce(boost::bind(&timeout), 20*Second);
+  int res = MainLoop::currentMainLoop().run();
+  TEST_CHECK(res==EXIT_SUCCESS);
+  TEST_CHECK(flooded);
+  TEST_CHECK(inOrder);
+  TEST_CHECK(allReceived());
+  TEST_CHECK(numReceived<numDevices*numRounds); // coalesced
+  printf("%d pushes sent, %d received\n", numDevices*numRounds, numReceived);
+  server->stop();
+  if (clientFd>=0) close(clientFd);
+  return testSummary("pushcoalescing_test");
+}
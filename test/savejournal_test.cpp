@@ -0,0 +1,172 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// Test of the save journal: records saved directly within a transaction that gets rolled back must be
+// dirty again after revert(), and must not keep ROWIDs the failed transaction had assigned.
+//
+// Usage: savejournal_test <dbfile>
+// Note: <dbfile> is overwritten
+
+#include "savejournal.hpp"
+#include "persistenceworker.hpp"
+#include "cachingparamstore.hpp"
+
+#include "testcheck.hpp"
+
+using namespace p44;
+
+
+class TestRecord : public PersistentParams
+{
+  typedef PersistentParams inherited;
+public:
+  int intValue;
+
+  TestRecord(ParamStore &aParamStore) : inherited(aParamStore), intValue(0) {};
+
+  virtual const char *tableName() P44_OVERRIDE { return "JournalRecords"; };
+
+  virtual size_t numFieldDefs() P44_OVERRIDE { return inherited::numFieldDefs()+1; };
+
+  virtual const FieldDefinition *getFieldDef(size_t aIndex) P44_OVERRIDE
+  {
+    static const FieldDefinition dataDefs[1] = {
+      { "intValue", SQLITE_INTEGER }
+    };
+    if (aIndex<inherited::numFieldDefs()) return inherited::getFieldDef(aIndex);
+    aIndex -= inherited::numFieldDefs();
+    return aIndex<1 ? &dataDefs[aIndex] : NULL;
+  };
+
+  virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP) P44_OVERRIDE
+  {
+    inherited::loadFromRow(aRow, aIndex, aCommonFlagsP);
+    intValue = aRow->get<int>(aIndex++);
+  };
+
+  virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags) P44_OVERRIDE
+  {
+    inherited::bindToStatement(aStatement, aIndex, aParentIdentifier, aCommonFlags);
+    aStatement.bind(aIndex++, intValue);
+  };
+};
+
+
+static int storedValue(ParamStore &aStore, const char *aParentId)
+{
+  TestRecord l(aStore);
+  if (!Error::isOK(l.loadFromStore(aParentId)) || l.rowid==0) return -1;
+  return l.intValue;
+}
+
+
+static void testRollback(CachingParamStore &aStore)
+{
+  // existing record, saved and committed
+  TestRecord existing(aStore);
+  existing.intValue = 1;
+  existing.markDirty();
+  PersistenceWorker::save(NULL, existing, "existing", false);
+  uint64_t existingRowId = existing.rowid;
+  TEST_CHECK(existingRowId!=0);
+  // a transaction changing the existing record and adding a new one fails
+  SaveJournal journal;
+  aStore.execute("BEGIN");
+  journal.start();
+  existing.intValue = 2;
+  existing.markDirty();
+  PersistenceWorker::save(NULL, existing, "existing", false);
+  TestRecord added(aStore);
+  added.intValue = 3;
+  added.markDirty();
+  PersistenceWorker::save(NULL, added, "added", false);
+  TestRecord unchanged(aStore);
+  PersistenceWorker::save(NULL, unchanged, "unchanged", false); // not dirty, not recorded
+  TEST_CHECK(added.rowid!=0);
+  TEST_CHECK(!existing.isDirty() && !added.isDirty());
+  journal.stop();
+  aStore.execute("ROLLBACK");
+  journal.revert();
+  // both must be saved again, the new one as a new record
+  TEST_CHECK(existing.isDirty());
+  TEST_CHECK(existing.rowid==existingRowId);
+  TEST_CHECK(added.isDirty());
+  TEST_CHECK(added.rowid==0);
+  TEST_CHECK(!unchanged.isDirty());
+  TEST_CHECK(storedValue(aStore, "existing")==1);
+  TEST_CHECK(storedValue(aStore, "added")==-1);
+  // the retry saves the values that were lost
+  PersistenceWorker::save(NULL, existing, "existing", false);
+  PersistenceWorker::save(NULL, added, "added", false);
+  TEST_CHECK(storedValue(aStore, "existing")==2);
+  TEST_CHECK(storedValue(aStore, "added")==3);
+}
+
+
+static void testCommit(CachingParamStore &aStore)
+{
+  SaveJournal journal;
+  aStore.execute("BEGIN");
+  journal.start();
+  TestRecord r(aStore);
+  r.intValue = 4;
+  r.markDirty();
+  PersistenceWorker::save(NULL, r, "committed", false);
+  journal.stop();
+  TEST_CHECK(aStore.execute("COMMIT")==SQLITE_OK);
+  journal.clear();
+  journal.revert(); // nothing recorded any more
+  TEST_CHECK(!r.isDirty());
+  TEST_CHECK(r.rowid!=0);
+  TEST_CHECK(storedValue(aStore, "committed")==4);
+  // saves outside a started journal are not recorded
+  r.intValue = 5;
+  r.markDirty();
+  PersistenceWorker::save(NULL, r, "committed", false);
+  journal.revert();
+  TEST_CHECK(!r.isDirty());
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc<2) {
+    fprintf(stderr, "Usage: %s <dbfile>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  SETLOGLEVEL(LOG_WARNING);
+  unlink(argv[1]);
+  CachingParamStore store;
+  ErrorPtr err = store.connectAndInitialize(argv[1], 1, 1, true);
+  if (!Error::isOK(err)) {
+    fprintf(stderr, "cannot open DB: %s\n", err->description().c_str());
+    return EXIT_FAILURE;
+  }
+  // create the table
+  TestRecord init(store);
+  init.markDirty();
+  init.saveToStore("init", false);
+  // test
+  testRollback(store);
+  testCommit(store);
+  return testSummary("savejournal_test");
+}
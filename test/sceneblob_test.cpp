@@ -0,0 +1,213 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// Test of the migration of scenes from the scene table to scene blobs: scene values must survive the
+// migration, a failed migration must leave the scene records in place, and scene records must only be
+// removed when the blob was written.
+// Each phase runs in a child process with a freshly started vdc host, like a restart of the vdc host would.
+//
+// Usage: sceneblob_test <datadir> [<numdevices>]
+// Note: the DB in <datadir> is overwritten
+
+#include "vdchost.hpp"
+#include "staticvdc.hpp"
+
+#include "testcheck.hpp"
+
+#include <sys/wait.h>
+
+using namespace p44;
+
+
+#define CHANGED_SCENE 5 // T0_S2
+#define BLOB_CHANGED_SCENE 6 // T0_S3
+
+
+class TestVdc : public StaticVdc
+{
+  typedef StaticVdc inherited;
+public:
+  TestVdc(DeviceConfigMap aDeviceConfigs, VdcHost *aVdcHostP) : inherited(1, aDeviceConfigs, aVdcHostP, 1) {};
+  DevicePtr getDevice(size_t aIndex) { return devices[aIndex]; };
+};
+typedef boost::intrusive_ptr<TestVdc> TestVdcPtr;
+
+
+typedef void (*TestPhase)(VdcHostPtr aVdcHost, TestVdcPtr aVdc);
+
+
+static double sceneValue(DevicePtr aDevice, SceneNo aSceneNo)
+{
+  return aDevice->getScenes()->getScene(aSceneNo)->sceneValue(0);
+}
+
+
+static void setSceneValue(DevicePtr aDevice, SceneNo aSceneNo, double aValue)
+{
+  SceneDeviceSettingsPtr scenes = aDevice->getScenes();
+  DsScenePtr scene = scenes->getSceneForUpdate(aSceneNo);
+  scene->setSceneValue(0, aValue);
+  scenes->updateScene(scene);
+}
+
+
+static int countRows(VdcHostPtr aVdcHost, const string &aTable)
+{
+  sqlite3pp::query q(aVdcHost->getDsParamStore());
+  if (q.prepare(string_format("SELECT count(*) FROM %s", aTable.c_str()).c_str())!=SQLITE_OK) return -1;
+  sqlite3pp::query::iterator row = q.begin();
+  return row!=q.end() ? row->get<int>(0) : -1;
+}
+
+
+static string sceneTable(TestVdcPtr aVdc)
+{
+  DsScenePtr scene = aVdc->getDevice(0)->getScenes()->getScene(CHANGED_SCENE);
+  return static_cast<PersistentParams &>(*scene).tableName();
+}
+
+
+static void checkChangedScenes(TestVdcPtr aVdc, bool aBlobChanged)
+{
+  for (size_t i=0; i<aVdc->getNumberOfDevices(); i++) {
+    DevicePtr dev = aVdc->getDevice(i);
+    TEST_CHECK(sceneValue(dev, CHANGED_SCENE)==10+i*0.5);
+    if (aBlobChanged) TEST_CHECK(sceneValue(dev, BLOB_CHANGED_SCENE)==20+i*0.25);
+  }
+}
+
+
+/// scenes stored as scene records
+static void storeScenes(VdcHostPtr aVdcHost, TestVdcPtr aVdc)
+{
+  for (size_t i=0; i<aVdc->getNumberOfDevices(); i++) {
+    setSceneValue(aVdc->getDevice(i), CHANGED_SCENE, 10+i*0.5);
+  }
+  aVdcHost->saveAllNow();
+  TEST_CHECK(countRows(aVdcHost, sceneTable(aVdc))==(int)aVdc->getNumberOfDevices());
+  TEST_CHECK(countRows(aVdcHost, "SceneBlobs")==0);
+}
+
+
+/// migration to scene blobs fails
+static void failMigration(VdcHostPtr aVdcHost, TestVdcPtr aVdc)
+{
+  checkChangedScenes(aVdc, false);
+  aVdcHost->getDsParamStore().execute("DROP TABLE SceneBlobs");
+  aVdcHost->saveAllNow();
+  // scene records still there, scenes must be saved again
+  TEST_CHECK(countRows(aVdcHost, sceneTable(aVdc))==(int)aVdc->getNumberOfDevices());
+  TEST_CHECK(aVdc->getDevice(0)->getScenes()->getScene(CHANGED_SCENE)->isDirty());
+  aVdcHost->getDsParamStore().execute("CREATE TABLE SceneBlobs (parentID TEXT PRIMARY KEY, scenes BLOB)");
+}
+
+
+/// migration to scene blobs
+static void migrate(VdcHostPtr aVdcHost, TestVdcPtr aVdc)
+{
+  checkChangedScenes(aVdc, false);
+  aVdcHost->saveAllNow();
+  TEST_CHECK(countRows(aVdcHost, sceneTable(aVdc))==0);
+  TEST_CHECK(countRows(aVdcHost, "SceneBlobs")==(int)aVdc->getNumberOfDevices());
+}
+
+
+/// scenes loaded from and changed in scene blobs
+static void changeBlobs(VdcHostPtr aVdcHost, TestVdcPtr aVdc)
+{
+  checkChangedScenes(aVdc, false);
+  for (size_t i=0; i<aVdc->getNumberOfDevices(); i++) {
+    setSceneValue(aVdc->getDevice(i), BLOB_CHANGED_SCENE, 20+i*0.25);
+  }
+  aVdcHost->saveAllNow();
+  TEST_CHECK(countRows(aVdcHost, "SceneBlobs")==(int)aVdc->getNumberOfDevices());
+}
+
+
+static void verifyBlobs(VdcHostPtr aVdcHost, TestVdcPtr aVdc)
+{
+  checkChangedScenes(aVdc, true);
+  TEST_CHECK(countRows(aVdcHost, sceneTable(aVdc))==0);
+}
+
+
+static void collected(VdcHostPtr aVdcHost, TestVdcPtr aVdc, TestPhase aPhase, ErrorPtr aError)
+{
+  TEST_CHECK(Error::isOK(aError));
+  TEST_CHECK(aVdc->getNumberOfDevices()>0);
+  if (Error::isOK(aError) && aVdc->getNumberOfDevices()>0) aPhase(aVdcHost, aVdc);
+  MainLoop::currentMainLoop().terminate(EXIT_SUCCESS);
+}
+
+
+static void initialized(VdcHostPtr aVdcHost, TestVdcPtr aVdc, TestPhase aPhase, ErrorPtr aError)
+{
+  TEST_CHECK(Error::isOK(aError));
+  if (!Error::isOK(aError)) {
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+    return;
+  }
+  aVdcHost->collectDevices(boost::bind(&collected, aVdcHost, aVdc, aPhase, _1), rescanmode_normal);
+}
+
+
+static int runPhase(const char *aName, const char *aDataDir, int aNumDevices, bool aBlobStorage, bool aFactoryReset, TestPhase aPhase)
+{
+  pid_t pid = fork();
+  if (pid<0) return EXIT_FAILURE;
+  if (pid>0) {
+    int status;
+    if (waitpid(pid, &status, 0)<0 || !WIFEXITED(status)) return EXIT_FAILURE;
+    return WEXITSTATUS(status);
+  }
+  // child: a freshly started vdc host
+  VdcHostPtr vdcHost = VdcHostPtr(new VdcHost);
+  vdcHost->setPersistentDataDir(aDataDir);
+  vdcHost->setSceneBlobStorage(aBlobStorage);
+  vdcHost->prepareForVdcs(aFactoryReset);
+  DeviceConfigMap devices;
+  for (int i=0; i<aNumDevices; i++) {
+    devices.insert(make_pair("console", string_format("scenes%04d:dimmer", i)));
+  }
+  TestVdcPtr vdc = TestVdcPtr(new TestVdc(devices, vdcHost.get()));
+  vdc->addVdcToVdcHost();
+  vdcHost->initialize(boost::bind(&initialized, vdcHost, vdc, aPhase, _1), false);
+  MainLoop::currentMainLoop().run();
+  exit(testSummary(aName));
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc<2) {
+    fprintf(stderr, "Usage: %s <datadir> [<numdevices>]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  int numDevices = argc>2 ? atoi(argv[2]) : 10;
+  SETLOGLEVEL(LOG_CRIT); // failed migration is expected to log errors
+  TEST_CHECK(runPhase("store scene records", argv[1], numDevices, false, true, &storeScenes)==EXIT_SUCCESS);
+  TEST_CHECK(runPhase("failed migration", argv[1], numDevices, true, false, &failMigration)==EXIT_SUCCESS);
+  TEST_CHECK(runPhase("migration", argv[1], numDevices, true, false, &migrate)==EXIT_SUCCESS);
+  TEST_CHECK(runPhase("change scene blobs", argv[1], numDevices, true, false, &changeBlobs)==EXIT_SUCCESS);
+  TEST_CHECK(runPhase("verify scene blobs", argv[1], numDevices, true, false, &verifyBlobs)==EXIT_SUCCESS);
+  return testSummary("sceneblob_test");
+}
@@ -0,0 +1,54 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// Minimal checks for the standalone tests in this directory: each test is a main() that runs its
+// checks with TEST_CHECK() and returns testSummary() as its exit code.
+
+#ifndef __p44vdc__testcheck__
+#define __p44vdc__testcheck__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int testChecks = 0;
+static int testFailures = 0;
+
+/// check a condition, report it when it fails
+#define TEST_CHECK(cond) \
+  do { \
+    testChecks++; \
+    if (!(cond)) { \
+      testFailures++; \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    } \
+  } while (0)
+
+/// report the result of a test
+/// @param aName name of the test
+/// @return exit code for main()
+static int testSummary(const char *aName)
+{
+  printf("%s: %d checks, %d failed\n", aName, testChecks, testFailures);
+  return testFailures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif /* defined(__p44vdc__testcheck__) */
@@ -0,0 +1,140 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+// vDC API replay driver: runs a vDC host with simulated (console) devices and replays a recorded vdSM session against it
+//
+// Usage:
+//   vdcapi_replay <datadir> <numdevices> record <pathprefix> [<port>]
+//   vdcapi_replay <datadir> <numdevices> replay <recording> [<speed>]
+// - "record" runs the vDC host with a protobuf API server on <port> (default 8440), recording every vdSM session
+//   into <pathprefix><timestamp>.vrec, until terminated
+// - "replay" runs the same vDC host, replays <recording> against its API (JSON or protobuf, as recorded) at <speed>
+//   (1 = original timing, 0 = as fast as possible, default 0) and prints the latency report
+// - devices' dSUIDs derive from the vDC host's dSUID, so use the same <datadir> and <numdevices> for
+//   recording and replaying
+
+#include "vdchost.hpp"
+#include "staticvdc.hpp"
+#include "pbufvdcapi.hpp"
+#include "jsonvdcapi.hpp"
+#include "vdcapireplayer.hpp"
+
+using namespace p44;
+
+
+#define REPLAY_API_PORT "8440"
+
+
+static StaticVdcPtr staticVdc;
+static VdcApiReplayerPtr replayer;
+static double replaySpeed = 0;
+
+
+static void replayed(ErrorPtr aError)
+{
+  if (!Error::isOK(aError)) {
+    printf("replay failed: %s\n", aError->description().c_str());
+  }
+  printf("%s", replayer->latencyReport().c_str());
+  MainLoop::currentMainLoop().terminate(Error::isOK(aError) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+static void collected(VdcHostPtr aVdcHost, ErrorPtr aError)
+{
+  if (!Error::isOK(aError)) {
+    printf("collecting failed: %s\n", aError->description().c_str());
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+    return;
+  }
+  printf("%zu devices ready\n", staticVdc->getNumberOfDevices());
+  if (replayer) {
+    replayer->replay("127.0.0.1", aVdcHost->vdcApiServer->getPort(), replaySpeed, boost::bind(&replayed, _1));
+  }
+}
+
+
+static void initialized(VdcHostPtr aVdcHost, ErrorPtr aError)
+{
+  if (!Error::isOK(aError)) {
+    printf("initialisation failed: %s\n", aError->description().c_str());
+    MainLoop::currentMainLoop().terminate(EXIT_FAILURE);
+    return;
+  }
+  aVdcHost->startRunning();
+  aVdcHost->collectDevices(boost::bind(&collected, aVdcHost, _1), rescanmode_normal);
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc<5 || (strcmp(argv[3], "record")!=0 && strcmp(argv[3], "replay")!=0)) {
+    fprintf(stderr, "Usage: %s <datadir> <numdevices> record <pathprefix> [<port>]\n", argv[0]);
+    fprintf(stderr, "       %s <datadir> <numdevices> replay <recording> [<speed>]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  int numDevices = atoi(argv[2]);
+  bool record = strcmp(argv[3], "record")==0;
+  SETLOGLEVEL(LOG_NOTICE);
+  VdcHostPtr vdcHost = VdcHostPtr(new VdcHost);
+  vdcHost->setPersistentDataDir(argv[1]);
+  // API server
+  VdcApiEncoding encoding = vdcapi_encoding_protobuf;
+  const char *port = REPLAY_API_PORT;
+  if (record) {
+    if (argc>5) port = argv[5];
+  }
+  else {
+    replayer = VdcApiReplayerPtr(new VdcApiReplayer);
+    ErrorPtr err = replayer->load(argv[4]);
+    if (!Error::isOK(err)) {
+      fprintf(stderr, "Cannot load recording: %s\n", err->description().c_str());
+      return EXIT_FAILURE;
+    }
+    encoding = replayer->getEncoding();
+    if (argc>5) replaySpeed = atof(argv[5]);
+  }
+  if (encoding==vdcapi_encoding_json)
+    vdcHost->vdcApiServer = VdcApiServerPtr(new VdcJsonApiServer());
+  else
+    vdcHost->vdcApiServer = VdcApiServerPtr(new VdcPbufApiServer());
+  vdcHost->vdcApiServer->setConnectionParams(record ? NULL : "127.0.0.1", port, SOCK_STREAM, AF_INET);
+  if (record) vdcHost->vdcApiServer->enableRecording(argv[4]);
+  // simulated devices
+  vdcHost->prepareForVdcs(false);
+  DeviceConfigMap devices;
+  for (int i=0; i<numDevices; i++) {
+    const char *mode;
+    switch (i%4) {
+      case 0: mode = "button"; break;
+      case 1: mode = "dimmer"; break;
+      case 2: mode = "colordimmer"; break;
+      default: mode = "sensor"; break;
+    }
+    devices.insert(make_pair("console", string_format("replay%04d:%s", i, mode)));
+  }
+  staticVdc = StaticVdcPtr(new StaticVdc(1, devices, vdcHost.get(), 1));
+  staticVdc->addVdcToVdcHost();
+  vdcHost->initialize(boost::bind(&initialized, vdcHost, _1), false);
+  return MainLoop::currentMainLoop().run();
+}
@@ -0,0 +1,213 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "cachingparamstore.hpp"
+
+
+using namespace p44;
+
+
+bool CachingParamStore::StatementKey::operator<(const StatementKey &aOther) const
+{
+  if (kind!=aOther.kind) return kind<aOther.kind;
+  if (numFields!=aOther.numFields) return numFields<aOther.numFields;
+  return table<aOther.table;
+}
+
+
+CachingParamStore::~CachingParamStore()
+{
+  // prepared statements must be finalized before the DB gets closed
+  clearStatementCache();
+}
+
+
+void CachingParamStore::clearStatementCache()
+{
+  for (QueryMap::iterator pos = queries.begin(); pos!=queries.end(); ++pos) {
+    delete pos->second;
+  }
+  queries.clear();
+  for (CommandMap::iterator pos = commands.begin(); pos!=commands.end(); ++pos) {
+    delete pos->second;
+  }
+  commands.clear();
+}
+
+
+string CachingParamStore::sqlFor(PersistentParams &aParams, StatementKind aKind)
+{
+  const char *table = aParams.tableName();
+  const char *parentKey = aParams.getKeyDef(0)->fieldName;
+  string fields;
+  string values;
+  for (size_t i=0; i<aParams.numKeyDefs(); i++) {
+    if (i>0) { fields += ","; values += ","; }
+    fields += aParams.getKeyDef(i)->fieldName;
+    values += "?";
+  }
+  for (size_t i=0; i<aParams.numFieldDefs(); i++) {
+    fields += ","; fields += aParams.getFieldDef(i)->fieldName;
+    values += ",?";
+  }
+  switch (aKind) {
+    case stmt_load: return string_format("SELECT ROWID,%s FROM %s WHERE %s=?", fields.c_str(), table, parentKey);
+    case stmt_findrow: return string_format("SELECT ROWID FROM %s WHERE %s=?", table, parentKey);
+    case stmt_insert: return string_format("INSERT INTO %s (%s) VALUES (%s)", table, fields.c_str(), values.c_str());
+    case stmt_replace: return string_format("INSERT OR REPLACE INTO %s (ROWID,%s) VALUES (?,%s)", table, fields.c_str(), values.c_str());
+    case stmt_delete: return string_format("DELETE FROM %s WHERE ROWID=?", table);
+  }
+  return "";
+}
+
+
+sqlite3pp::query *CachingParamStore::queryFor(PersistentParams &aParams, StatementKind aKind)
+{
+  StatementKey key;
+  key.table = aParams.tableName();
+  key.kind = aKind;
+  key.numFields = aParams.numKeyDefs()+aParams.numFieldDefs();
+  QueryMap::iterator pos = queries.find(key);
+  if (pos!=queries.end()) {
+    pos->second->reset();
+    return pos->second;
+  }
+  sqlite3pp::query *q = new sqlite3pp::query(*this);
+  if (q->prepare(sqlFor(aParams, aKind).c_str())!=SQLITE_OK) {
+    // table or columns might not exist yet: not cached, caller falls back to PersistentParams
+    delete q;
+    return NULL;
+  }
+  queries[key] = q;
+  return q;
+}
+
+
+sqlite3pp::command *CachingParamStore::commandFor(PersistentParams &aParams, StatementKind aKind)
+{
+  StatementKey key;
+  key.table = aParams.tableName();
+  key.kind = aKind;
+  key.numFields = aParams.numKeyDefs()+aParams.numFieldDefs();
+  CommandMap::iterator pos = commands.find(key);
+  if (pos!=commands.end()) {
+    pos->second->reset();
+    return pos->second;
+  }
+  sqlite3pp::command *c = new sqlite3pp::command(*this);
+  if (c->prepare(sqlFor(aParams, aKind).c_str())!=SQLITE_OK) {
+    delete c;
+    return NULL;
+  }
+  commands[key] = c;
+  return c;
+}
+
+
+ErrorPtr CachingParamStore::load(PersistentParams &aParams, const char *aParentId)
+{
+  CachingParamStore *store = dynamic_cast<CachingParamStore *>(&aParams.paramStore);
+  sqlite3pp::query *q = store && aParentId && aParams.numKeyDefs()>0 ? store->queryFor(aParams, stmt_load) : NULL;
+  if (!q) return aParams.loadFromStore(aParentId);
+  q->bind(1, aParentId, false);
+  sqlite3pp::query::iterator row = q->begin();
+  if (row!=q->end()) {
+    int index = 0;
+    aParams.loadFromRow(row, index, NULL);
+    aParams.markClean(); // just loaded, no need to save
+  }
+  q->reset(); // release the bound values and the read lock
+  return aParams.loadChildren();
+}
+
+
+ErrorPtr CachingParamStore::loadAll(PersistentParams &aTemplate, const char *aParentId, RowHandlerCB aRowHandler)
+{
+  CachingParamStore *store = dynamic_cast<CachingParamStore *>(&aTemplate.paramStore);
+  sqlite3pp::query *q = store && aParentId && aTemplate.numKeyDefs()>0 ? store->queryFor(aTemplate, stmt_load) : NULL;
+  bool cached = q!=NULL;
+  if (!cached) {
+    q = aTemplate.newLoadAllQuery(aParentId);
+    if (!q) return aTemplate.paramStore.error();
+  }
+  else {
+    q->bind(1, aParentId, false);
+  }
+  for (sqlite3pp::query::iterator row = q->begin(); row!=q->end(); ++row) {
+    aRowHandler(row);
+  }
+  if (cached) q->reset();
+  else delete q;
+  return ErrorPtr();
+}
+
+
+ErrorPtr CachingParamStore::save(PersistentParams &aParams, const char *aParentId, bool aMultipleInstancesAllowed)
+{
+  CachingParamStore *store = dynamic_cast<CachingParamStore *>(&aParams.paramStore);
+  if (!store || aParams.numKeyDefs()==0) return aParams.saveToStore(aParentId, aMultipleInstancesAllowed);
+  ErrorPtr err;
+  if (aParams.dirty) {
+    if (aParams.rowid==0 && !aMultipleInstancesAllowed) {
+      // single instance per parent: re-use an existing record
+      sqlite3pp::query *q = store->queryFor(aParams, stmt_findrow);
+      if (!q) return aParams.saveToStore(aParentId, aMultipleInstancesAllowed);
+      q->bind(1, aParentId, false);
+      sqlite3pp::query::iterator row = q->begin();
+      if (row!=q->end()) aParams.rowid = row->get<long long>(0);
+      q->reset();
+    }
+    sqlite3pp::command *c = store->commandFor(aParams, aParams.rowid==0 ? stmt_insert : stmt_replace);
+    if (!c) return aParams.saveToStore(aParentId, aMultipleInstancesAllowed);
+    int index = 1;
+    if (aParams.rowid!=0) c->bind(index++, (long long)aParams.rowid);
+    aParams.bindToStatement(*c, index, aParentId, 0);
+    if (c->execute()!=SQLITE_OK) {
+      err = store->error();
+    }
+    else {
+      if (aParams.rowid==0) aParams.rowid = store->last_insert_rowid();
+      aParams.markClean();
+    }
+    c->reset(); // release the bound values
+  }
+  // anyway, save children
+  if (Error::isOK(err)) err = aParams.saveChildren();
+  return err;
+}
+
+
+ErrorPtr CachingParamStore::forget(PersistentParams &aParams)
+{
+  CachingParamStore *store = dynamic_cast<CachingParamStore *>(&aParams.paramStore);
+  if (!store) return aParams.deleteFromStore();
+  ErrorPtr err = aParams.deleteChildren();
+  if (aParams.rowid!=0) {
+    sqlite3pp::command *c = store->commandFor(aParams, stmt_delete);
+    if (!c) return aParams.deleteFromStore();
+    c->bind(1, (long long)aParams.rowid);
+    if (c->execute()!=SQLITE_OK) err = store->error();
+    c->reset();
+    aParams.rowid = 0;
+  }
+  return err;
+}
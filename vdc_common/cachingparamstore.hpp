@@ -0,0 +1,116 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __p44vdc__cachingparamstore__
+#define __p44vdc__cachingparamstore__
+
+#include "p44utils_common.hpp"
+
+#include "persistentparams.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  /// Param store keeping the statements for loading, saving and deleting PersistentParams records prepared for re-use.
+  /// PersistentParams::loadFromStore(), saveToStore() and deleteFromStore() build the SQL text and prepare a new
+  /// statement on every call. The static load(), save() and forget() methods do the same operations with statements
+  /// prepared once per table and operation, when the record's param store is a CachingParamStore.
+  /// @note the statements use the same row layout as the PersistentParams methods: ROWID, key fields, data fields
+  class CachingParamStore : public ParamStore
+  {
+    typedef ParamStore inherited;
+
+  public:
+
+    /// row handler for loadAll()
+    typedef boost::function<void (sqlite3pp::query::iterator &aRow)> RowHandlerCB;
+
+  private:
+
+    typedef enum {
+      stmt_load, ///< SELECT all fields by first key (parent ID)
+      stmt_findrow, ///< SELECT ROWID by first key (parent ID)
+      stmt_insert, ///< INSERT new record, ROWID assigned by the DB
+      stmt_replace, ///< INSERT OR REPLACE record with known ROWID
+      stmt_delete ///< DELETE record by ROWID
+    } StatementKind;
+
+    /// identifies a statement: table, operation, and the number of fields (in case subclasses extend a record)
+    class StatementKey
+    {
+    public:
+      string table;
+      StatementKind kind;
+      size_t numFields;
+      bool operator<(const StatementKey &aOther) const;
+    };
+    typedef map<StatementKey, sqlite3pp::query *> QueryMap;
+    typedef map<StatementKey, sqlite3pp::command *> CommandMap;
+
+    QueryMap queries; ///< prepared queries (load, findrow)
+    CommandMap commands; ///< prepared commands (insert, replace, delete)
+
+  public:
+
+    virtual ~CachingParamStore();
+
+    /// load a record (and its children), like PersistentParams::loadFromStore() does
+    /// @param aParams the record
+    /// @param aParentId the parent identifier
+    /// @return ok or error
+    static ErrorPtr load(PersistentParams &aParams, const char *aParentId);
+
+    /// load all records of a parent
+    /// @param aTemplate an object of the type of the records, only used for creating the statement
+    /// @param aParentId the parent identifier
+    /// @param aRowHandler called for every record found
+    /// @return ok or error
+    static ErrorPtr loadAll(PersistentParams &aTemplate, const char *aParentId, RowHandlerCB aRowHandler);
+
+    /// save a record (and its children), like PersistentParams::saveToStore() does
+    /// @param aParams the record
+    /// @param aParentId the parent identifier, can be NULL
+    /// @param aMultipleInstancesAllowed if set, multiple records with the same parent identifier can exist
+    /// @return ok or error
+    static ErrorPtr save(PersistentParams &aParams, const char *aParentId, bool aMultipleInstancesAllowed);
+
+    /// delete a record (and its children), like PersistentParams::deleteFromStore() does
+    /// @param aParams the record
+    /// @return ok or error
+    static ErrorPtr forget(PersistentParams &aParams);
+
+    /// forget all prepared statements
+    /// @note statements are re-prepared automatically when the schema changes, so this is only needed to free resources
+    void clearStatementCache();
+
+  private:
+
+    sqlite3pp::query *queryFor(PersistentParams &aParams, StatementKind aKind);
+    sqlite3pp::command *commandFor(PersistentParams &aParams, StatementKind aKind);
+    static string sqlFor(PersistentParams &aParams, StatementKind aKind);
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__p44vdc__cachingparamstore__) */
@@ -66,6 +66,13 @@ bool ChannelBehaviour::isPrimary()
 }
 
 
+void ChannelBehaviour::propertiesChanged()
+{
+  inherited::propertiesChanged();
+  output.propertiesChanged();
+}
+
+
 string ChannelBehaviour::description()
 {
   return string_format(
@@ -211,6 +218,7 @@ void ChannelBehaviour::syncChannelValue(double aActualChannelValue, bool aAlways
     transitionProgress = 1; // not in transition
     channelUpdatePending = false; // we are in sync
     channelLastSync = MainLoop::now(); // value is current
+    propertiesChanged();
   }
 }
 
@@ -277,6 +285,7 @@ void ChannelBehaviour::setChannelValue(double aNewValue, MLMicroSeconds aTransit
     cachedChannelValue = aNewValue;
     nextTransitionTime = aTransitionTime;
     channelUpdatePending = true; // pending to be sent to the device
+    propertiesChanged();
   }
 }
 
@@ -311,6 +320,7 @@ double ChannelBehaviour::dimChannelValue(double aIncrement, MLMicroSeconds aTran
     cachedChannelValue = newValue;
     nextTransitionTime = aTransitionTime;
     channelUpdatePending = true; // pending to be sent to the device
+    propertiesChanged();
   }
   return newValue;
 }
@@ -322,6 +332,7 @@ void ChannelBehaviour::channelValueApplied(bool aAnyWay)
   if (channelUpdatePending || aAnyWay) {
     channelUpdatePending = false; // applied (might still be in transition, though)
     channelLastSync = MainLoop::now(); // now we know that we are in sync
+    propertiesChanged();
     if (!aAnyWay) {
       // only log when actually of importance (to prevent messages for devices that apply mostly immediately)
       SALOG(output.device, LOG_INFO,
@@ -398,11 +409,11 @@ PropertyDescriptorPtr ChannelBehaviour::getDescriptorByIndex(int aPropIndex, int
     return NULL;
   switch (aParentDescriptor->parentDescriptor->fieldKey()) {
     case descriptions_key_offset:
-      return PropertyDescriptorPtr(new StaticPropertyDescriptor(&channelDescProperties[aPropIndex], aParentDescriptor));
+      return StaticPropertyDescriptor::descriptorFor(&channelDescProperties[aPropIndex], aParentDescriptor);
       //case settings_key_offset:
-      //  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&channelSettingsProperties[aPropIndex], aParentDescriptor));
+      //  return StaticPropertyDescriptor::descriptorFor(&channelSettingsProperties[aPropIndex], aParentDescriptor);
     case states_key_offset:
-      return PropertyDescriptorPtr(new StaticPropertyDescriptor(&channelStateProperties[aPropIndex], aParentDescriptor));
+      return StaticPropertyDescriptor::descriptorFor(&channelStateProperties[aPropIndex], aParentDescriptor);
     default:
       return NULL;
   }
@@ -226,6 +226,9 @@ namespace p44 {
 
     /// @}
 
+    /// mark properties changed, including the output
+    virtual void propertiesChanged() P44_OVERRIDE;
+
     /// description of object, mainly for debug and logging
     /// @return textual description of object, may contain LFs
     virtual string description();
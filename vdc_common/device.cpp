@@ -63,7 +63,7 @@ PropertyDescriptorPtr DeviceConfigurationDescriptor::getDescriptorByIndex(int aP
   };
   if (aParentDescriptor->isRootOfObject()) {
     // root level property of this object hierarchy
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   return PropertyDescriptorPtr();
 }
@@ -781,6 +781,89 @@ void Device::handleNotification(VdcApiConnectionPtr aApiConnection, const string
 }
 
 
+void Device::handleDirectNotification(VdcApiConnectionPtr aApiConnection, const VdcApiDirectNotification &aNotification)
+{
+  ErrorPtr err;
+  // all scene related notifications need the scene parameter
+  switch (aNotification.type) {
+    case directnotification_callScene:
+    case directnotification_saveScene:
+    case directnotification_undoScene:
+    case directnotification_setLocalPriority:
+    case directnotification_callSceneMin:
+      if (aNotification.scene<0) {
+        err = Error::err<VdcApiError>(400, "Invalid Parameters - missing 'scene'");
+      }
+      break;
+    default:
+      break;
+  }
+  if (Error::isOK(err)) {
+    switch (aNotification.type) {
+      case directnotification_callScene:
+        if (aNotification.force<0) {
+          err = Error::err<VdcApiError>(400, "Invalid Parameters - missing 'force'");
+          break;
+        }
+        callScene((SceneNo)aNotification.scene, aNotification.force>0);
+        break;
+      case directnotification_saveScene:
+        saveScene((SceneNo)aNotification.scene);
+        break;
+      case directnotification_undoScene:
+        undoScene((SceneNo)aNotification.scene);
+        break;
+      case directnotification_setLocalPriority:
+        setLocalPriority((SceneNo)aNotification.scene);
+        break;
+      case directnotification_callSceneMin:
+        callSceneMin((SceneNo)aNotification.scene);
+        break;
+      case directnotification_setControlValue:
+        if (!aNotification.name) {
+          err = Error::err<VdcApiError>(400, "Invalid Parameters - missing 'name'");
+        }
+        else if (!aNotification.hasValue) {
+          err = Error::err<VdcApiError>(400, "Invalid Parameters - missing 'value'");
+        }
+        else if (processControlValue(aNotification.name, aNotification.value)) {
+          // apply the values
+          ALOG(LOG_NOTICE, "processControlValue(%s, %f) completed -> requests applying channels now", aNotification.name, aNotification.value);
+          stopSceneActions();
+          requestApplyingChannels(NULL, false);
+        }
+        break;
+      case directnotification_setOutputChannelValue: {
+        ChannelBehaviourPtr channel;
+        if (aNotification.channel>=0) {
+          channel = getChannelByType(aNotification.channel);
+        }
+        else if (aNotification.channelId) {
+          channel = getChannelById(aNotification.channelId);
+        }
+        if (!channel) {
+          err = Error::err<VdcApiError>(400, "Need to specify channel(type) or channelId");
+        }
+        else if (!aNotification.hasValue) {
+          err = Error::err<VdcApiError>(400, "Invalid Parameters - missing 'value'");
+        }
+        else {
+          // same as writing channelStates.<channel>.value, default transition time
+          channel->setChannelValue(aNotification.value, output->transitionTime, true);
+          if (aNotification.applyNow) {
+            requestApplyingChannels(NULL, false);
+          }
+        }
+        break;
+      }
+    }
+  }
+  if (!Error::isOK(err)) {
+    ALOG(LOG_WARNING, "%s error: %s", aNotification.method, err->description().c_str());
+  }
+}
+
+
 void Device::disconnect(bool aForgetParams, DisconnectCB aDisconnectResultHandler)
 {
   // remove from container management
@@ -1285,6 +1368,7 @@ void Device::callScene(SceneNo aSceneNo, bool aForce)
     }
     // we get here only if callScene is not legacy dimming
     ALOG(LOG_NOTICE, "CallScene(%d) (non-dimming!):", aSceneNo);
+    MLMicroSeconds calledAt = MainLoop::now(); // for scene apply latency statistics
     // make sure dimming stops for any non-dimming scene call
     if (currentDimMode!=dimmode_stop) {
       // any non-dimming scene call stops dimming
@@ -1335,7 +1419,7 @@ void Device::callScene(SceneNo aSceneNo, bool aForce)
         // Note: the actual updating might happen later (when the hardware responds) but
         //   implementations must make sure access to the hardware is serialized such that
         //   the values are captured before values from applyScene() below are applied.
-        output->captureScene(previousState, true, boost::bind(&Device::outputUndoStateSaved,this,output,scene)); // apply only after capture is complete
+        output->captureScene(previousState, true, boost::bind(&Device::outputUndoStateSaved,this,output,scene,calledAt)); // apply only after capture is complete
       } // if output
     } // not dontCare
     else {
@@ -1384,7 +1468,7 @@ bool Device::prepareSceneApply(DsScenePtr aScene)
 
 
 // deferred applying of state, after current state has been captured for this output
-void Device::outputUndoStateSaved(DsBehaviourPtr aOutput, DsScenePtr aScene)
+void Device::outputUndoStateSaved(DsBehaviourPtr aOutput, DsScenePtr aScene, MLMicroSeconds aCalledAt)
 {
   if (prepareSceneCall(aScene)) {
     OutputBehaviourPtr output = boost::dynamic_pointer_cast<OutputBehaviour>(aOutput);
@@ -1394,12 +1478,12 @@ void Device::outputUndoStateSaved(DsBehaviourPtr aOutput, DsScenePtr aScene)
         // prepare for apply
         if (prepareSceneApply(aScene)) {
           // now apply values to hardware
-          requestApplyingChannels(boost::bind(&Device::sceneValuesApplied, this, aScene), false);
+          requestApplyingChannels(boost::bind(&Device::sceneValuesApplied, this, aScene, aCalledAt), false);
         }
       }
       else {
         // no apply to hardware needed, directly proceed to actions
-        sceneValuesApplied(aScene);
+        sceneValuesApplied(aScene, aCalledAt);
       }
     }
   }
@@ -1409,8 +1493,10 @@ void Device::outputUndoStateSaved(DsBehaviourPtr aOutput, DsScenePtr aScene)
 }
 
 
-void Device::sceneValuesApplied(DsScenePtr aScene)
+void Device::sceneValuesApplied(DsScenePtr aScene, MLMicroSeconds aCalledAt)
 {
+  // update scene apply latency statistics
+  getVdcHost().recordSceneApplyLatency(deviceTypeIdentifier(), MainLoop::now()-aCalledAt);
   // now perform scene special actions such as blinking
   performSceneActions(aScene, boost::bind(&Device::sceneActionsComplete, this, aScene));
 }
@@ -1498,8 +1584,8 @@ void Device::saveScene(SceneNo aSceneNo)
   ALOG(LOG_NOTICE, "SaveScene(%d)", aSceneNo);
   SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
   if (scenes) {
-    // we have a device-wide scene table, get the scene object
-    DsScenePtr scene = scenes->getScene(aSceneNo);
+    // we have a device-wide scene table, get a modifiable scene object (capturing runs asynchronously)
+    DsScenePtr scene = scenes->getSceneForUpdate(aSceneNo);
     if (scene) {
       // scene found, now capture to all of our outputs
       if (output) {
@@ -1527,7 +1613,7 @@ void Device::outputSceneValueSaved(DsScenePtr aScene)
         aScene->setDontCare(mustBeDontCare);
         // also update the off scene's dontCare
         SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
-        DsScenePtr offScene = scenes->getScene(offSceneForArea(area));
+        DsScenePtr offScene = scenes->getSceneForUpdate(offSceneForArea(area));
         if (offScene) {
           offScene->setDontCare(mustBeDontCare);
           // update scene in scene table and DB if dirty
@@ -1576,7 +1662,7 @@ ErrorPtr Device::load()
   }
   // load the device settings
   if (deviceSettings) {
-    err = deviceSettings->loadFromStore(dSUID.getString().c_str());
+    err = SettingsBulkLoader::loadParams(getVdcHost().getBulkLoader(), *deviceSettings, dSUID.getString());
     if (!Error::isOK(err)) ALOG(LOG_ERR,"Error loading settings: %s", err->description().c_str());
   }
   // load the behaviours
@@ -1590,11 +1676,26 @@ ErrorPtr Device::load()
 }
 
 
+void Device::prepareBulkLoad(SettingsBulkLoader &aLoader, bool aChildren)
+{
+  if (!aChildren) {
+    if (deviceSettings) aLoader.expect(*deviceSettings, dSUID.getString());
+    for (BehaviourVector::iterator pos = buttons.begin(); pos!=buttons.end(); ++pos) (*pos)->prepareBulkLoad(aLoader);
+    for (BehaviourVector::iterator pos = binaryInputs.begin(); pos!=binaryInputs.end(); ++pos) (*pos)->prepareBulkLoad(aLoader);
+    for (BehaviourVector::iterator pos = sensors.begin(); pos!=sensors.end(); ++pos) (*pos)->prepareBulkLoad(aLoader);
+    if (output) output->prepareBulkLoad(aLoader);
+  }
+  else {
+    if (deviceSettings) deviceSettings->prepareBulkLoadChildren(aLoader);
+  }
+}
+
+
 ErrorPtr Device::save()
 {
   ErrorPtr err;
   // save the device settings
-  if (deviceSettings) err = deviceSettings->saveToStore(dSUID.getString().c_str(), false); // only one record per device
+  if (deviceSettings) err = PersistenceWorker::save(getVdcHost().getPersistenceWorker(), *deviceSettings, dSUID.getString().c_str(), false); // only one record per device
   if (!Error::isOK(err)) ALOG(LOG_ERR,"Error saving settings: %s", err->description().c_str());
   // save the behaviours
   for (BehaviourVector::iterator pos = buttons.begin(); pos!=buttons.end(); ++pos) (*pos)->save();
@@ -1631,7 +1732,7 @@ void Device::markClean()
 ErrorPtr Device::forget()
 {
   // delete the device settings
-  if (deviceSettings) deviceSettings->deleteFromStore();
+  if (deviceSettings) PersistenceWorker::forget(getVdcHost().getPersistenceWorker(), *deviceSettings);
   // delete the behaviours
   for (BehaviourVector::iterator pos = buttons.begin(); pos!=buttons.end(); ++pos) (*pos)->forget();
   for (BehaviourVector::iterator pos = binaryInputs.begin(); pos!=binaryInputs.end(); ++pos) (*pos)->forget();
@@ -1641,27 +1742,56 @@ ErrorPtr Device::forget()
 }
 
 
-void Device::loadSettingsFromFiles()
+static const int numDeviceSettingsLevels = 4;
+
+string Device::settingsFileName(int aLevel)
 {
-  string dir = getVdcHost().getConfigDir();
-  const int numLevels = 4;
-  string levelids[numLevels];
+  string levelid;
   // Level strategy: most specialized will be active, unless lower levels specify explicit override
   // - Baselines are hardcoded defaults plus settings (already) loaded from persistent store
   // - Level 0 are settings related to the device instance (dSUID)
   // - Level 1 are settings related to the device class/version (deviceClass()_deviceClassVersion())
   // - Level 2 are settings related to the device type (deviceTypeIdentifier())
   // - Level 3 are settings related to the vDC (vdcClassIdentifier())
-  levelids[0] = "vdsd_" + getDsUid().getString();
-  levelids[1] = string_format("%s_%d_class", deviceClass().c_str(), deviceClassVersion());
-  levelids[2] = string_format("%s_device", deviceTypeIdentifier().c_str());
-  levelids[3] = vdcP->vdcClassIdentifier();
-  for(int i=0; i<numLevels; ++i) {
-    // try to open config file
-    string fn = dir+"devicesettings_"+levelids[i]+".csv";
+  switch (aLevel) {
+    case 0: levelid = "vdsd_" + getDsUid().getString(); break;
+    case 1: levelid = string_format("%s_%d_class", deviceClass().c_str(), deviceClassVersion()); break;
+    case 2: levelid = string_format("%s_device", deviceTypeIdentifier().c_str()); break;
+    default: levelid = vdcP->vdcClassIdentifier(); break;
+  }
+  return "devicesettings_"+levelid+".csv";
+}
+
+
+void Device::loadSettingsFromFiles()
+{
+  for(int i=0; i<numDeviceSettingsLevels; ++i) {
+    // apply config file, if any
     // if device has already stored properties, only explicitly marked properties will be applied
-    if (loadSettingsFromFile(fn.c_str(), deviceSettings->rowid!=0)) markClean();
+    if (loadSettingsFromConfigFile(settingsFileName(i), deviceSettings->rowid!=0)) markClean();
+  }
+}
+
+
+bool Device::configFileChanged(const string &aFileName, bool aRemoved)
+{
+  bool usesSettingsFile = false;
+  for(int i=0; i<numDeviceSettingsLevels && !usesSettingsFile; ++i) {
+    usesSettingsFile = aFileName.empty() || aFileName==settingsFileName(i);
   }
+  SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+  bool usesSceneFile = scenes && scenes->usesSceneFile(aFileName);
+  if (!usesSettingsFile && !usesSceneFile) return false; // not affected
+  if (aRemoved) {
+    // values replaced by the file's settings are not known any more, so these cannot be reverted
+    ALOG(LOG_NOTICE, "config file %s removed - settings applied from it remain in effect until changed", aFileName.c_str());
+  }
+  // reloading marks settings clean, so pending changes must be saved first
+  save();
+  if (usesSettingsFile) loadSettingsFromFiles();
+  if (usesSceneFile) scenes->loadScenesFromFiles();
+  ALOG(LOG_INFO, "reloaded settings from changed config file %s", aFileName.empty() ? "(all)" : aFileName.c_str());
+  return true;
 }
 
 
@@ -1800,7 +1930,7 @@ PropertyDescriptorPtr Device::getDescriptorByIndex(int aPropIndex, int aDomain,
     if (aPropIndex<n)
       return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
     aPropIndex -= n; // rebase to 0 for my own first property
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   else if (aParentDescriptor->hasObjectKey(device_modelFeatures_key)) {
     // model features - distinct set of boolean flags
@@ -1942,6 +2072,19 @@ PropertyContainerPtr Device::getContainer(const PropertyDescriptorPtr &aProperty
 }
 
 
+PropertyContainerPtr Device::getContainerForWrite(const PropertyDescriptorPtr &aPropertyDescriptor, int &aDomain)
+{
+  if (aPropertyDescriptor->hasObjectKey(device_scenes_key)) {
+    // default scenes are shared, write into stored scene or private copy, writtenProperty() will post it via updateScene()
+    SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+    if (scenes) {
+      return scenes->getSceneForUpdate(aPropertyDescriptor->fieldKey());
+    }
+  }
+  return inherited::getContainerForWrite(aPropertyDescriptor, aDomain);
+}
+
+
 
 void Device::prepareAccess(PropertyAccessMode aMode, PropertyDescriptorPtr aPropertyDescriptor, StatusCB aPreparedCB)
 {
@@ -2047,6 +2190,13 @@ ErrorPtr Device::writtenProperty(PropertyAccessMode aMode, PropertyDescriptorPtr
 // MARK: ===== Device description/shortDesc/status
 
 
+void Device::propertiesChanged()
+{
+  inherited::propertiesChanged();
+  if (vdcP) vdcP->propertiesChanged();
+}
+
+
 string Device::description()
 {
   string s = inherited::description(); // DsAdressable
@@ -26,6 +26,8 @@
 
 #include "dsscene.hpp"
 
+#include "jsonobject.hpp"
+
 using namespace std;
 
 namespace p44 {
@@ -180,15 +182,35 @@ namespace p44 {
     /// utility: confirm identification
     void identificationOK(IdentifyDeviceCB aIdentifyCB, Device *aActualDevice = NULL);
 
+    /// get the information needed to re-create this device from a warm restart snapshot (without scanning for it)
+    /// @return JSON object which will be passed to Vdc::restoreDevice() at next startup, NULL if the device cannot
+    ///   be restored from a snapshot (which is the default)
+    /// @note devices should only support this when their vdc implements Vdc::restoreDevice()
+    virtual JsonObjectPtr snapshotInfo() { return JsonObjectPtr(); };
+
 
 
     /// load parameters from persistent DB
     /// @note this is usually called from the device container when device is added (detected), before initializeDevice() and after identifyDevice()
     virtual ErrorPtr load();
 
+    /// register persistent records with a bulk loader, to be loaded together with those of other devices
+    /// @param aLoader the bulk loader
+    /// @param aChildren if set, register child records (which can only be located after the parent records are loaded)
+    /// @note this is called by the device container for all collected devices before load(), which then only
+    ///   needs to load from the DB what the bulk load could not deliver.
+    virtual void prepareBulkLoad(SettingsBulkLoader &aLoader, bool aChildren);
+
     // load additional settings from files
     void loadSettingsFromFiles();
 
+    /// reload settings from config files after one of them has changed
+    /// @param aFileName name of the changed config file (without directory), empty if any file might have changed
+    /// @param aRemoved set if the file was removed. Settings it had applied are not reverted, as the values they replaced
+    ///   are not known any more, but remain in effect until changed otherwise.
+    /// @return true if the device uses that file and has reloaded its settings from files
+    bool configFileChanged(const string &aFileName, bool aRemoved);
+
     /// initializes the physical device for being used
     /// @param aFactoryReset if set, the device will be inititalized as thoroughly as possible (factory reset, default settings etc.)
     /// @note this is called after persistent settings have been loaded
@@ -198,7 +220,7 @@ namespace p44 {
 
     /// save unsaved parameters to persistent DB
     /// @note this is usually called from the device container in regular intervals
-    virtual ErrorPtr save();
+    virtual ErrorPtr save() P44_OVERRIDE;
 
     /// forget any parameters stored in persistent DB
     virtual ErrorPtr forget();
@@ -385,6 +407,13 @@ namespace p44 {
     ///   used already to route the notification to this device.
     virtual void handleNotification(VdcApiConnectionPtr aApiConnection, const string &aMethod, ApiValuePtr aParams) P44_OVERRIDE;
 
+    /// called to let device handle a directly decoded device-level notification
+    /// @param aApiConnection this is the API connection from which the notification originates
+    /// @param aNotification the notification with its parameters
+    /// @note this is the equivalent of handleNotification() for the frequently used notifications
+    ///   which API implementations can decode without building an ApiValue parameter tree.
+    void handleDirectNotification(VdcApiConnectionPtr aApiConnection, const VdcApiDirectNotification &aNotification);
+
     /// call scene on this device
     /// @param aSceneNo the scene to call.
     void callScene(SceneNo aSceneNo, bool aForce);
@@ -508,6 +537,9 @@ namespace p44 {
 
     /// @}
 
+    /// mark properties changed, including the vDC containing the device
+    virtual void propertiesChanged() P44_OVERRIDE;
+
     /// description of object, mainly for debug and logging
     /// @return textual description of object, may contain LFs
     virtual string description() P44_OVERRIDE;
@@ -604,6 +636,7 @@ namespace p44 {
     virtual PropertyDescriptorPtr getDescriptorByIndex(int aPropIndex, int aDomain, PropertyDescriptorPtr aParentDescriptor) P44_OVERRIDE;
     virtual PropertyDescriptorPtr getDescriptorByName(string aPropMatch, int &aStartIndex, int aDomain, PropertyAccessMode aMode, PropertyDescriptorPtr aParentDescriptor) P44_OVERRIDE;
     virtual PropertyContainerPtr getContainer(const PropertyDescriptorPtr &aPropertyDescriptor, int &aDomain) P44_OVERRIDE;
+    virtual PropertyContainerPtr getContainerForWrite(const PropertyDescriptorPtr &aPropertyDescriptor, int &aDomain) P44_OVERRIDE;
     virtual void prepareAccess(PropertyAccessMode aMode, PropertyDescriptorPtr aPropertyDescriptor, StatusCB aPreparedCB) P44_OVERRIDE;
     virtual bool accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, PropertyDescriptorPtr aPropertyDescriptor) P44_OVERRIDE;
     virtual void finishAccess(PropertyAccessMode aMode, PropertyDescriptorPtr aPropertyDescriptor) P44_OVERRIDE;
@@ -621,6 +654,7 @@ namespace p44 {
   private:
 
     DsGroupMask behaviourGroups();
+    string settingsFileName(int aLevel);
 
     ErrorPtr checkChannel(ApiValuePtr aParams, ChannelBehaviourPtr &aChannel);
 
@@ -628,8 +662,8 @@ namespace p44 {
     void dimHandler(ChannelBehaviourPtr aChannel, double aIncrement, MLMicroSeconds aNow);
     void dimDoneHandler(ChannelBehaviourPtr aChannel, double aIncrement, MLMicroSeconds aNextDimAt);
     void outputSceneValueSaved(DsScenePtr aScene);
-    void outputUndoStateSaved(DsBehaviourPtr aOutput, DsScenePtr aScene);
-    void sceneValuesApplied(DsScenePtr aScene);
+    void outputUndoStateSaved(DsBehaviourPtr aOutput, DsScenePtr aScene, MLMicroSeconds aCalledAt);
+    void sceneValuesApplied(DsScenePtr aScene, MLMicroSeconds aCalledAt);
     void sceneActionsComplete(DsScenePtr aScene);
 
     void applyingChannelsComplete();
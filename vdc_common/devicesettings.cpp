@@ -89,3 +89,13 @@ void DeviceSettings::bindToStatement(sqlite3pp::statement &aStatement, int &aInd
   aStatement.bind(aIndex++, device.getAssignedName().c_str(), false);  // c_str() ist not static in general -> do not rely on it (even if static here)
   aStatement.bind(aIndex++, (int)zoneID);
 }
+
+
+void DeviceSettings::markDirty()
+{
+  inherited::markDirty();
+  // settings are properties of the device
+  device.propertiesChanged();
+  // settings are saved as part of their device
+  device.getVdcHost().scheduleSave(device.getDsUid());
+}
@@ -33,6 +33,7 @@ namespace p44 {
   class Device;
   class DeviceSettings;
   class DsScene;
+  class SettingsBulkLoader;
 
 
   /// Base class for persistent settings common to all devices.
@@ -65,6 +66,13 @@ namespace p44 {
     virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP);
     virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags);
 
+    /// mark settings dirty and schedule saving the device
+    virtual void markDirty() P44_OVERRIDE;
+
+    /// register child records for being loaded in bulk, see Device::prepareBulkLoad()
+    /// @note base class has no children
+    virtual void prepareBulkLoadChildren(SettingsBulkLoader &aLoader) { /* NOP */ };
+
     /// @}
 
   };
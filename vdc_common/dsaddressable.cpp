@@ -155,11 +155,36 @@ ErrorPtr DsAddressable::handleMethod(VdcApiRequestPtr aRequest, const string &aM
     // query must be present
     ApiValuePtr query;
     if (Error::isOK(respErr = checkParam(aParams, "query", query))) {
-      // now read
-      accessProperty(
-        access_read, query, VDC_API_DOMAIN, aRequest->getApiVersion(),
-        boost::bind(&DsAddressable::propertyAccessed, this, aRequest, _1, _2)
-      );
+      ApiValuePtr o = aParams->get("x-p44-since");
+      if (!o) o = aParams->get("x_p44_since"); // pbuf field name
+      if (o) {
+        // delta read: only return what has changed since the given generation
+        // Note: current generation must be captured before reading, changes that happen during the read will be reported again next time
+        uint64_t since = o->uint64Value();
+        // - removed elements cannot be reported as changes, so a client that missed a structure change needs a full read
+        bool fullRead = since<structureChangeGeneration();
+        accessProperty(
+          access_read, query, VDC_API_DOMAIN, aRequest->getApiVersion(),
+          boost::bind(&DsAddressable::deltaPropertyAccessed, this, aRequest, currentChangeGeneration(), fullRead, _1, _2),
+          fullRead ? 0 : since
+        );
+      }
+      else {
+        ApiValuePtr parts;
+        if (aRequest->canStreamResult()) parts = propertyReadParts(aRequest, query);
+        if (parts) {
+          // read and send the result one top-level property at a time, so the result tree for all of them
+          // never needs to be in memory at once
+          readNextPropertyPart(aRequest, parts, 0);
+        }
+        else {
+          // now read
+          accessProperty(
+            access_read, query, VDC_API_DOMAIN, aRequest->getApiVersion(),
+            boost::bind(&DsAddressable::propertyAccessed, this, aRequest, _1, _2)
+          );
+        }
+      }
     }
   }
   else if (aMethod=="setProperty") {
@@ -215,6 +240,96 @@ void DsAddressable::propertyAccessed(VdcApiRequestPtr aRequest, ApiValuePtr aRes
 
 
 
+// split a read query into one query per top-level property
+// @return array of queries, or NULL if the query cannot be split into more than one part
+ApiValuePtr DsAddressable::propertyReadParts(VdcApiRequestPtr aRequest, ApiValuePtr aQuery)
+{
+  if (!aQuery->isNull() && !aQuery->isType(apivalue_object)) return ApiValuePtr(); // let accessProperty() report the error
+  ApiValuePtr parts = aQuery->newValue(apivalue_array);
+  ApiValuePtr allValue; // set if the query contains a match-all "" element
+  set<string> names;
+  if (aQuery->isNull()) {
+    // NULL query is like query { "":NULL }
+    allValue = aQuery->newNull();
+  }
+  else {
+    string name;
+    ApiValuePtr value;
+    aQuery->resetKeyIteration();
+    while (aQuery->nextKeyValue(name, value)) {
+      if (name.empty()) {
+        allValue = value;
+        continue;
+      }
+      // named, count or other wildcard elements are read as they are
+      ApiValuePtr part = aQuery->newObject();
+      part->add(name, value);
+      parts->arrayAppend(part);
+      names.insert(name);
+    }
+  }
+  if (allValue) {
+    // expand match-all into the top-level properties it would return
+    PropertyDescriptorPtr rootDescriptor = RootPropertyDescriptor::forApiVersion(aRequest->getApiVersion());
+    int n = numProps(VDC_API_DOMAIN, rootDescriptor);
+    for (int i=0; i<n; i++) {
+      PropertyDescriptorPtr propDesc = getDescriptorByIndex(i, VDC_API_DOMAIN, rootDescriptor);
+      if (!propDesc || names.count(propDesc->name())>0) continue; // suppressed, or already read by name
+      if (propDesc->isStructured() && !propDesc->isWildcardAddressable()) continue; // match-all does not return it
+      ApiValuePtr part = aQuery->newObject();
+      part->add(propDesc->name(), allValue);
+      parts->arrayAppend(part);
+    }
+  }
+  if (parts->arrayLength()<2) return ApiValuePtr(); // nothing to gain
+  return parts;
+}
+
+
+void DsAddressable::readNextPropertyPart(VdcApiRequestPtr aRequest, ApiValuePtr aParts, size_t aNextPart)
+{
+  if ((int)aNextPart>=aParts->arrayLength()) {
+    // all parts sent, complete the result
+    ApiValuePtr rest = aRequest->newApiValue();
+    rest->setType(apivalue_object);
+    aRequest->sendResult(rest);
+    return;
+  }
+  accessProperty(
+    access_read, aParts->arrayGet((int)aNextPart), VDC_API_DOMAIN, aRequest->getApiVersion(),
+    boost::bind(&DsAddressable::propertyPartAccessed, this, aRequest, aParts, aNextPart, _1, _2)
+  );
+}
+
+
+void DsAddressable::propertyPartAccessed(VdcApiRequestPtr aRequest, ApiValuePtr aParts, size_t aNextPart, ApiValuePtr aResultObject, ErrorPtr aError)
+{
+  if (Error::isOK(aError)) {
+    // send this part, its result tree is not needed any more afterwards
+    aError = aRequest->sendResultPart(aResultObject);
+  }
+  if (!Error::isOK(aError)) {
+    aRequest->sendStatus(aError);
+    return;
+  }
+  readNextPropertyPart(aRequest, aParts, aNextPart+1);
+}
+
+
+void DsAddressable::deltaPropertyAccessed(VdcApiRequestPtr aRequest, uint64_t aGeneration, bool aFullRead, ApiValuePtr aResultObject, ErrorPtr aError)
+{
+  if (Error::isOK(aError)) {
+    // add the generation to pass as x-p44-since in the next delta read
+    aResultObject->add("x-p44-generation", aResultObject->newUint64(aGeneration));
+    if (aFullRead) {
+      // complete result, client must replace (not merge into) the tree it knows
+      aResultObject->add("x-p44-fullRead", aResultObject->newBool(true));
+    }
+  }
+  propertyAccessed(aRequest, aResultObject, aError);
+}
+
+
 void DsAddressable::methodCompleted(VdcApiRequestPtr aRequest, ErrorPtr aError)
 {
   // method completed, return status
@@ -269,7 +384,16 @@ void DsAddressable::pushPropertyReady(ApiValuePtr aEvents, ApiValuePtr aResultOb
       if (!pushParams) pushParams = aEvents->newValue(apivalue_object);
       pushParams->add("deviceevents", aEvents);
     }
-    sendRequest("pushNotification", pushParams);
+    // - send to vdSM and observers
+    VdcApiConnectionPtr api = getVdcHost().getSessionConnection();
+    if (api) {
+      if (!pushParams) {
+        pushParams = api->newApiValue();
+        pushParams->setType(apivalue_object);
+      }
+      pushParams->add("dSUID", pushParams->newBinary(getDsUid().getBinary()));
+      getVdcHost().broadcastApiNotification("pushNotification", pushParams);
+    }
   }
   else {
     ALOG(LOG_WARNING, "push failed because to-be-pushed property could not be accessed: %s", aError->description().c_str());
@@ -401,7 +525,7 @@ PropertyDescriptorPtr DsAddressable::getDescriptorByIndex(int aPropIndex, int aD
   if (aPropIndex<n)
     return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
   aPropIndex -= n; // rebase to 0 for my own first property
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -570,32 +694,14 @@ string DsAddressable::webuiURLString()
 // MARK: ===== load addressable settings from files
 
 
-bool DsAddressable::loadSettingsFromFile(const char *aCSVFilepath, bool aOnlyExplicitlyOverridden)
+bool DsAddressable::loadSettingsFromConfigFile(const string &aFileName, bool aOnlyExplicitlyOverridden)
 {
-  bool anySettingsApplied = false;
-  string line;
-  int lineNo = 0;
-  FILE *file = fopen(aCSVFilepath, "r");
-  if (!file) {
-    int syserr = errno;
-    if (syserr!=ENOENT) {
-      // file not existing is ok, all other errors must be reported
-      LOG(LOG_ERR, "failed opening file %s - %s", aCSVFilepath, strerror(syserr));
-    }
-    // NOP
-  }
-  else {
-    // file opened
-    while (string_fgetline(file, line)) {
-      lineNo++;
-      const char *p = line.c_str();
-      // process CSV line as property name/value pairs
-      anySettingsApplied = readPropsFromCSV(VDC_API_DOMAIN, aOnlyExplicitlyOverridden, p, aCSVFilepath, lineNo) || anySettingsApplied;
-    }
-    fclose(file);
-    if (anySettingsApplied) {
-      ALOG(LOG_INFO, "Customized settings from config file %s", aCSVFilepath);
-    }
+  const CompiledPropertySettingsList *settings = getVdcHost().getSettingsFileCache().settingsFor(aFileName);
+  if (!settings) return false; // no such file
+  string fn = getVdcHost().getConfigDir()+aFileName;
+  bool anySettingsApplied = applyCompiledProps(VDC_API_DOMAIN, aOnlyExplicitlyOverridden, *settings, fn.c_str());
+  if (anySettingsApplied) {
+    ALOG(LOG_INFO, "Customized settings from config file %s", fn.c_str());
   }
   return anySettingsApplied;
 }
@@ -105,6 +105,10 @@ namespace p44 {
     /// @note only addressables that have been announced on the vDC API will send a vanish message
     void reportVanished();
 
+    /// save unsaved parameters to persistent DB
+    /// @note base class has nothing to save
+    virtual ErrorPtr save() { return ErrorPtr(); };
+
     /// @name vDC API
     /// @{
 
@@ -345,12 +349,12 @@ namespace p44 {
     /// @}
 
 
-    /// load settings from CSV file
-    /// @param aCSVFilepath full file path to a CSV file to read. If file does not exist, the function does nothing. If
-    ///   an error occurs loading the file, the error is logged
+    /// load settings from CSV file in the config directory
+    /// @param aFileName name of the CSV file within the config directory. If file does not exist, the function does nothing.
     /// @param aOnlyExplicitlyOverridden if set, only properties are applied which are explicitly marked with a exclamation mark prefix
     /// @return true if some settings were applied
-    bool loadSettingsFromFile(const char *aCSVFilepath, bool aOnlyExplicitlyOverridden);
+    /// @note the file is not read directly, but from the vdc host's cache of already compiled settings files
+    bool loadSettingsFromConfigFile(const string &aFileName, bool aOnlyExplicitlyOverridden);
 
     // property access implementation
     virtual int numProps(int aDomain, PropertyDescriptorPtr aParentDescriptor);
@@ -360,6 +364,10 @@ namespace p44 {
   private:
 
     void propertyAccessed(VdcApiRequestPtr aRequest, ApiValuePtr aResultObject, ErrorPtr aError);
+    void deltaPropertyAccessed(VdcApiRequestPtr aRequest, uint64_t aGeneration, bool aFullRead, ApiValuePtr aResultObject, ErrorPtr aError);
+    ApiValuePtr propertyReadParts(VdcApiRequestPtr aRequest, ApiValuePtr aQuery);
+    void readNextPropertyPart(VdcApiRequestPtr aRequest, ApiValuePtr aParts, size_t aNextPart);
+    void propertyPartAccessed(VdcApiRequestPtr aRequest, ApiValuePtr aParts, size_t aNextPart, ApiValuePtr aResultObject, ErrorPtr aError);
     void pushPropertyReady(ApiValuePtr aEvents, ApiValuePtr aResultObject, ErrorPtr aError);
     void presenceResultHandler(bool aIsPresent);
 
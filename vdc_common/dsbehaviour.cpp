@@ -58,8 +58,16 @@ void DsBehaviour::setHardwareError(VdcHardwareError aHardwareError)
 }
 
 
+void DsBehaviour::propertiesChanged()
+{
+  inheritedProps::propertiesChanged();
+  device.propertiesChanged();
+}
+
+
 bool DsBehaviour::pushBehaviourState()
 {
+  propertiesChanged();
   VdcApiConnectionPtr api = device.getVdcHost().getSessionConnection();
   if (api) {
     ApiValuePtr query = api->newApiValue();
@@ -82,15 +90,21 @@ string DsBehaviour::getDbKey()
 
 ErrorPtr DsBehaviour::load()
 {
-  ErrorPtr err = loadFromStore(getDbKey().c_str());
+  ErrorPtr err = SettingsBulkLoader::loadParams(device.getVdcHost().getBulkLoader(), *this, getDbKey());
   if (!Error::isOK(err)) BLOG(LOG_ERR,"Error loading behaviour %s: %s", shortDesc().c_str(), err->description().c_str());
   return err;
 }
 
 
+void DsBehaviour::prepareBulkLoad(SettingsBulkLoader &aLoader)
+{
+  aLoader.expect(*this, getDbKey());
+}
+
+
 ErrorPtr DsBehaviour::save()
 {
-  ErrorPtr err = saveToStore(getDbKey().c_str(), false); // only one record per dbkey (=per device+behaviourindex)
+  ErrorPtr err = PersistenceWorker::save(device.getVdcHost().getPersistenceWorker(), *this, getDbKey().c_str(), false); // only one record per dbkey (=per device+behaviourindex)
   if (!Error::isOK(err)) BLOG(LOG_ERR,"Error saving behaviour %s: %s", shortDesc().c_str(), err->description().c_str());
   return err;
 }
@@ -98,7 +112,17 @@ ErrorPtr DsBehaviour::save()
 
 ErrorPtr DsBehaviour::forget()
 {
-  return deleteFromStore();
+  return PersistenceWorker::forget(device.getVdcHost().getPersistenceWorker(), *this);
+}
+
+
+void DsBehaviour::markDirty()
+{
+  inheritedParams::markDirty();
+  // persistent settings are properties, too
+  propertiesChanged();
+  // behaviours are saved as part of their device
+  device.getVdcHost().scheduleSave(device.getDsUid());
 }
 
 
@@ -204,7 +228,7 @@ PropertyDescriptorPtr DsBehaviour::getDescriptorByIndex(int aPropIndex, int aDom
     case descriptions_key_offset:
       // check for generic description properties
       if (aPropIndex<numDsBehaviourDescProperties)
-        return PropertyDescriptorPtr(new StaticPropertyDescriptor(&descProperties[aPropIndex], aParentDescriptor));
+        return StaticPropertyDescriptor::descriptorFor(&descProperties[aPropIndex], aParentDescriptor);
       aPropIndex -= numDsBehaviourDescProperties;
       // check type-specific descriptions
       return getDescDescriptorByIndex(aPropIndex, aParentDescriptor);
@@ -215,7 +239,7 @@ PropertyDescriptorPtr DsBehaviour::getDescriptorByIndex(int aPropIndex, int aDom
     case states_key_offset:
       // check for generic state properties
       if (aPropIndex<numDsBehaviourStateProperties)
-        return PropertyDescriptorPtr(new StaticPropertyDescriptor(&stateProperties[aPropIndex], aParentDescriptor));
+        return StaticPropertyDescriptor::descriptorFor(&stateProperties[aPropIndex], aParentDescriptor);
       aPropIndex -= numDsBehaviourStateProperties;
       // check type-specific states
       return getStateDescriptorByIndex(aPropIndex, aParentDescriptor);
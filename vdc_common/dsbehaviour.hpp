@@ -145,8 +145,12 @@ namespace p44 {
 
     /// push state
     /// @return true if API was connected and push could be sent
+    /// @note also marks the behaviour's properties changed, even if no push is possible
     bool pushBehaviourState();
 
+    /// mark properties changed, including the device
+    virtual void propertiesChanged() P44_OVERRIDE;
+
     /// check for defined state
     /// @return true if behaviour has a defined (non-NULL) state
     virtual bool hasDefinedState() { return false; };
@@ -162,12 +166,18 @@ namespace p44 {
     /// load behaviour parameters from persistent DB
     ErrorPtr load();
 
+    /// register behaviour parameters for being loaded in bulk, see Device::prepareBulkLoad()
+    void prepareBulkLoad(SettingsBulkLoader &aLoader);
+
     /// save unsaved behaviour parameters to persistent DB
     ErrorPtr save();
 
     /// forget any parameters stored in persistent DB
     ErrorPtr forget();
 
+    /// mark parameters dirty and schedule saving the device
+    virtual void markDirty() P44_OVERRIDE;
+
     /// @}
 
     /// get the index value
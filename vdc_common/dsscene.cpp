@@ -26,6 +26,8 @@
 #include "simplescene.hpp"
 #include "jsonvdcapi.hpp"
 
+#include <typeinfo>
+
 using namespace p44;
 
 static char dsscene_key;
@@ -82,7 +84,7 @@ protected:
       return descP;
     }
     // Note: SceneChannels is private an can't be derived, so no subclass adding properties must be considered
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&valueproperties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&valueproperties[aPropIndex], aParentDescriptor);
   }
 
 
@@ -135,7 +137,7 @@ typedef boost::intrusive_ptr<SceneChannels> SceneChannelsPtr;
 
 DsScene::DsScene(SceneDeviceSettings &aSceneDeviceSettings, SceneNo aSceneNo) :
   inheritedParams(aSceneDeviceSettings.paramStore),
-  sceneDeviceSettings(aSceneDeviceSettings),
+  sceneDeviceSettings(&aSceneDeviceSettings),
   sceneNo(aSceneNo),
   sceneArea(0), // not area scene by default
   sceneCmd(scene_cmd_invoke), // simple invoke command by default
@@ -147,13 +149,20 @@ DsScene::DsScene(SceneDeviceSettings &aSceneDeviceSettings, SceneNo aSceneNo) :
 
 Device &DsScene::getDevice()
 {
-  return sceneDeviceSettings.device;
+  return sceneDeviceSettings->device;
+}
+
+
+void DsScene::propertiesChanged()
+{
+  inheritedProps::propertiesChanged();
+  getDevice().propertiesChanged();
 }
 
 
 OutputBehaviourPtr DsScene::getOutputBehaviour()
 {
-  return sceneDeviceSettings.device.output;
+  return sceneDeviceSettings->device.output;
 }
 
 
@@ -253,6 +262,16 @@ void DsScene::bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, con
 }
 
 
+void DsScene::markDirty()
+{
+  inheritedParams::markDirty();
+  // persistent settings are properties, too
+  propertiesChanged();
+  // scenes are saved as part of their device
+  getDevice().getVdcHost().scheduleSave(getDevice().getDsUid());
+}
+
+
 // MARK: ===== scene flags
 
 
@@ -370,7 +389,7 @@ PropertyDescriptorPtr DsScene::getDescriptorByIndex(int aPropIndex, int aDomain,
   if (aPropIndex<n)
     return inheritedProps::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
   aPropIndex -= n; // rebase to 0 for my own first property
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&sceneproperties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&sceneproperties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -414,15 +433,109 @@ bool DsScene::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Prop
 
 
 
+// MARK: ===== shared default scenes
+
+namespace p44 {
+
+  /// default scene objects shared by all devices with the same SceneDeviceSettings::defaultScenesKey()
+  /// @note the scene objects are created on first use via newDefaultScene() of the first user, and are
+  ///   handed over to the next user when that one goes away. The last user deletes the shared defaults.
+  class SharedDefaultScenes
+  {
+    typedef map<string, SharedDefaultScenes *> DefaultScenesMap;
+    static DefaultScenesMap sharedDefaults;
+
+    DefaultScenesMap::iterator pos;
+    list<SceneDeviceSettings *> users; ///< the settings using these defaults, the first one creates and owns the scene objects
+    DsScenePtr scenes[SCENE_TABLE_SIZE]; ///< the default scenes, NULL for scenes not yet used
+
+  public:
+
+    /// get the shared default scenes for a key, create them if not yet existing
+    /// @param aKey the default scenes key
+    /// @param aUser the settings to register as a user of the default scenes
+    static SharedDefaultScenes *use(const string &aKey, SceneDeviceSettings &aUser)
+    {
+      SharedDefaultScenes *&defaults = sharedDefaults[aKey];
+      if (!defaults) {
+        defaults = new SharedDefaultScenes;
+        defaults->pos = sharedDefaults.find(aKey);
+      }
+      defaults->users.push_back(&aUser);
+      return defaults;
+    }
+
+    /// unregister a user, hand over scene objects it has created to the next user
+    /// @param aUser the settings that no longer use the default scenes
+    /// @note deletes the shared defaults when the last user is gone
+    void release(SceneDeviceSettings &aUser)
+    {
+      users.remove(&aUser);
+      if (users.empty()) {
+        sharedDefaults.erase(pos);
+        delete this;
+        return;
+      }
+      for (int i=0; i<SCENE_TABLE_SIZE; i++) {
+        if (scenes[i] && scenes[i]->sceneDeviceSettings==&aUser) {
+          scenes[i]->sceneDeviceSettings = users.front();
+        }
+      }
+    }
+
+    /// get a default scene, materialize it on first use
+    /// @param aSceneNo the scene number, must be < SCENE_TABLE_SIZE
+    /// @return the shared, immutable default scene
+    DsScenePtr getScene(SceneNo aSceneNo)
+    {
+      DsScenePtr &scene = scenes[aSceneNo];
+      if (!scene) {
+        scene = users.front()->newDefaultScene(aSceneNo);
+      }
+      return scene;
+    }
+
+  };
+
+} // namespace p44
+
+SharedDefaultScenes::DefaultScenesMap SharedDefaultScenes::sharedDefaults;
+
+
 // MARK: ===== scene device settings base class
 
 
 SceneDeviceSettings::SceneDeviceSettings(Device &aDevice) :
-  inherited(aDevice)
+  inherited(aDevice),
+  sharedDefaults(NULL),
+  sceneBlobMigration(false)
 {
 }
 
 
+SceneDeviceSettings::~SceneDeviceSettings()
+{
+  if (sharedDefaults) sharedDefaults->release(*this);
+}
+
+
+string SceneDeviceSettings::defaultScenesKey()
+{
+  // default scene values depend on the scene class (determined by the settings class),
+  // and on the output behaviour and its channels
+  string key = typeid(*this).name();
+  OutputBehaviourPtr o = device.output;
+  if (o) {
+    string_format_append(key, "|%s:%d", typeid(*o).name(), (int)o->getOutputFunction());
+    for (int i=0; i<(int)o->numChannels(); i++) {
+      ChannelBehaviourPtr ch = o->getChannelByIndex(i);
+      string_format_append(key, "|%d:%s", (int)ch->getChannelType(), ch->getChannelId().c_str());
+    }
+  }
+  return key;
+}
+
+
 DsScenePtr SceneDeviceSettings::newDefaultScene(SceneNo aSceneNo)
 {
   SimpleScenePtr simpleScene = SimpleScenePtr(new SimpleScene(*this, aSceneNo));
@@ -446,16 +559,33 @@ DsScenePtr SceneDeviceSettings::newUndoStateScene()
 
 DsScenePtr SceneDeviceSettings::getScene(SceneNo aSceneNo)
 {
-  // see if we have a stored version different from the default
-  DsSceneMap::iterator pos = scenes.find(aSceneNo);
-  if (pos!=scenes.end()) {
-    // found scene params in map
-    return pos->second;
-  }
-  else {
-    // just return default values for this scene
+  if (aSceneNo>=SCENE_TABLE_SIZE) {
+    // not a valid scene number, cannot be in the table
     return newDefaultScene(aSceneNo);
   }
+  // see if we have a stored version different from the default
+  DsScenePtr scene = scenes[aSceneNo];
+  if (scene) return scene;
+  // use the shared default scene
+  if (!sharedDefaults) {
+    string key = defaultScenesKey();
+    if (key.empty()) {
+      // defaults depend on this device's state, cannot be shared
+      return newDefaultScene(aSceneNo);
+    }
+    sharedDefaults = SharedDefaultScenes::use(key, *this);
+  }
+  return sharedDefaults->getScene(aSceneNo);
+}
+
+
+DsScenePtr SceneDeviceSettings::getSceneForUpdate(SceneNo aSceneNo)
+{
+  // see if we have a stored version different from the default
+  DsScenePtr scene = storedScene(aSceneNo);
+  if (scene) return scene;
+  // private copy of the default values, shared defaults must not be modified
+  return newDefaultScene(aSceneNo);
 }
 
 
@@ -463,16 +593,45 @@ DsScenePtr SceneDeviceSettings::getScene(SceneNo aSceneNo)
 void SceneDeviceSettings::updateScene(DsScenePtr aScene)
 {
   if (aScene->rowid==0) {
-    // unstored so far, add to map of non-default scenes
-    scenes[aScene->sceneNo] = aScene;
+    // unstored so far, put into the table as non-default scene
+    if (!setStoredScene(aScene)) {
+      SALOG(device, LOG_ERR, "cannot store scene %d - invalid scene number", aScene->sceneNo);
+      return;
+    }
   }
   // anyway, mark scene dirty
   aScene->markDirty();
+  aScene->propertiesChanged();
   // as we need the ROWID of the settings as parentID, make sure we get saved if we don't have one
   if (rowid==0) markDirty();
 }
 
 
+DsScenePtr SceneDeviceSettings::storedScene(int aSceneNo)
+{
+  if (aSceneNo<0 || aSceneNo>=SCENE_TABLE_SIZE) return DsScenePtr();
+  return scenes[aSceneNo];
+}
+
+
+bool SceneDeviceSettings::setStoredScene(DsScenePtr aScene)
+{
+  if (aScene->sceneNo>=SCENE_TABLE_SIZE) return false;
+  scenes[aScene->sceneNo] = aScene;
+  return true;
+}
+
+
+size_t SceneDeviceSettings::numStoredScenes()
+{
+  size_t n = 0;
+  for (int i=0; i<SCENE_TABLE_SIZE; i++) {
+    if (storedScene(i)) n++;
+  }
+  return n;
+}
+
+
 
 
 
@@ -497,6 +656,59 @@ string SceneDeviceSettings::parentIdForScenes()
 
 
 
+// All non-default scenes of a device can be stored as a single record in the SceneBlobs table (instead of one
+// record per scene in the scene table). Scenes are converted using their regular bindToStatement()/loadFromRow()
+// implementation, by binding them to/loading them from a "SELECT ?,?,..." query that involves no table at all.
+// Scene blob format (all integers little endian):
+// - uint8: format version
+// - uint16: number of values per scene, followed by the names of the values (uint8 length + chars) in the order
+//   bindToStatement() binds them. Values are matched by name when loading, so scene classes can add fields
+//   later (missing values load as NULL, like a column added to a table).
+// - uint16: number of scenes, followed by the values of each scene (uint8 SQLite type + data):
+//   SQLITE_INTEGER and SQLITE_FLOAT: 8 bytes, SQLITE_TEXT and SQLITE_BLOB: uint32 length + bytes, SQLITE_NULL: nothing
+#define SCENE_BLOB_VERSION 1
+
+static void appendBlobUInt(string &aBlob, uint64_t aValue, int aBytes)
+{
+  for (int i=0; i<aBytes; i++) {
+    aBlob += (char)(aValue & 0xFF);
+    aValue >>= 8;
+  }
+}
+
+
+static bool getBlobUInt(const string &aBlob, size_t &aPos, int aBytes, uint64_t &aValue)
+{
+  if (aPos+aBytes>aBlob.size()) return false;
+  aValue = 0;
+  for (int i=aBytes-1; i>=0; i--) aValue = (aValue<<8) | (uint8_t)aBlob[aPos+i];
+  aPos += aBytes;
+  return true;
+}
+
+
+static bool getBlobString(const string &aBlob, size_t &aPos, int aLenBytes, string &aString)
+{
+  uint64_t len;
+  if (!getBlobUInt(aBlob, aPos, aLenBytes, len) || aPos+len>aBlob.size()) return false;
+  aString.assign(aBlob, aPos, (size_t)len);
+  aPos += len;
+  return true;
+}
+
+
+static string sqlString(const string &aString)
+{
+  string s = "'";
+  for (size_t i=0; i<aString.size(); i++) {
+    if (aString[i]=='\'') s += '\'';
+    s += aString[i];
+  }
+  s += "'";
+  return s;
+}
+
+
 ErrorPtr SceneDeviceSettings::loadChildren()
 {
   ErrorPtr err;
@@ -504,25 +716,25 @@ ErrorPtr SceneDeviceSettings::loadChildren()
   string parentID = parentIdForScenes();
   // create a template
   DsScenePtr scene = newDefaultScene(0);
-  // get the query
-  sqlite3pp::query *queryP = scene->newLoadAllQuery(parentID.c_str());
-  if (queryP==NULL) {
-    // real error preparing query
-    err = paramStore.error();
+  if (device.getVdcHost().usesSceneBlobStorage() && loadSceneBlob(parentID)) {
+    // all scenes loaded from a single record
+    loadScenesFromFiles();
+    return err;
   }
-  else {
-    for (sqlite3pp::query::iterator row = queryP->begin(); row!=queryP->end(); ++row) {
-      // got record
-      // - load record fields into scene object
-      int index = 0;
-      uint64_t flags;
-      scene->loadFromRow(row, index, &flags);
-      // - put scene into map of non-default scenes
-      scenes[scene->sceneNo] = scene;
-      // - fresh object for next row
-      scene = newDefaultScene(0);
+  SettingsBulkLoader *bulkLoader = device.getVdcHost().getBulkLoader();
+  if (bulkLoader && bulkLoader->covers(scene->tableName(), parentID)) {
+    // scenes have already been delivered by the bulk load
+    loadScenesFromFiles();
+    return err;
+  }
+  // load the scene records
+  err = CachingParamStore::loadAll(*scene, parentID.c_str(), boost::bind(&SceneDeviceSettings::sceneRowLoaded, this, _1));
+  if (Error::isOK(err)) {
+    if (device.getVdcHost().usesSceneBlobStorage() && numStoredScenes()>0) {
+      // scenes still stored as individual records: migrate to scene blob
+      sceneBlobMigration = true;
+      device.getVdcHost().scheduleSave(device.getDsUid());
     }
-    delete queryP; queryP = NULL;
     // Now check for default settings from files
     loadScenesFromFiles();
   }
@@ -530,6 +742,32 @@ ErrorPtr SceneDeviceSettings::loadChildren()
 }
 
 
+void SceneDeviceSettings::sceneRowLoaded(sqlite3pp::query::iterator &aRow)
+{
+  // - load record fields into fresh scene object
+  DsScenePtr scene = newDefaultScene(0);
+  int index = 0;
+  uint64_t flags;
+  scene->loadFromRow(aRow, index, &flags);
+  // - put scene into table as non-default scene
+  if (!setStoredScene(scene)) {
+    SALOG(device, LOG_ERR, "ignoring stored scene with invalid scene number %d", scene->sceneNo);
+  }
+}
+
+
+void SceneDeviceSettings::prepareBulkLoadChildren(SettingsBulkLoader &aLoader)
+{
+  // scene blobs are loaded by loadChildren(), as a single record per device anyway
+  if (device.getVdcHost().usesSceneBlobStorage()) return;
+  // the parent ID of the scenes is derived from my own ROWID, which is only known here when my own record was bulk loaded
+  if (aLoader.covers(tableName(), device.getDsUid().getString())) {
+    DsScenePtr scene = newDefaultScene(0);
+    aLoader.expectChildren(*scene, parentIdForScenes(), boost::bind(&SceneDeviceSettings::sceneRowLoaded, this, _1));
+  }
+}
+
+
 ErrorPtr SceneDeviceSettings::saveChildren()
 {
   ErrorPtr err;
@@ -537,10 +775,18 @@ ErrorPtr SceneDeviceSettings::saveChildren()
   if (rowid!=0) {
     // my own ROWID is the parent key for the children
     string parentID = parentIdForScenes();
-    // save all elements of the map (only dirty ones will be actually stored to DB
-    for (DsSceneMap::iterator pos = scenes.begin(); pos!=scenes.end(); ++pos) {
-      err = pos->second->saveToStore(parentID.c_str(), true); // multiple children of same parent allowed
-      if (!Error::isOK(err)) SALOG(device, LOG_ERR,"Error saving scene %d: %s", pos->second->sceneNo, err->description().c_str());
+    if (device.getVdcHost().usesSceneBlobStorage()) {
+      // all scenes in a single record
+      err = saveSceneBlob(parentID);
+      if (!Error::isOK(err)) SALOG(device, LOG_ERR,"Error saving scene blob: %s", err->description().c_str());
+      return err;
+    }
+    // save all non-default scenes (only dirty ones will be actually stored to DB
+    for (int i=0; i<SCENE_TABLE_SIZE; i++) {
+      DsScenePtr scene = storedScene(i);
+      if (!scene) continue;
+      err = PersistenceWorker::save(device.getVdcHost().getPersistenceWorker(), *scene, parentID.c_str(), true); // multiple children of same parent allowed
+      if (!Error::isOK(err)) SALOG(device, LOG_ERR,"Error saving scene %d: %s", scene->sceneNo, err->description().c_str());
     }
   }
   return err;
@@ -550,22 +796,241 @@ ErrorPtr SceneDeviceSettings::saveChildren()
 ErrorPtr SceneDeviceSettings::deleteChildren()
 {
   ErrorPtr err;
-  for (DsSceneMap::iterator pos = scenes.begin(); pos!=scenes.end(); ++pos) {
-    err = pos->second->deleteFromStore();
+  for (int i=0; i<SCENE_TABLE_SIZE; i++) {
+    DsScenePtr scene = storedScene(i);
+    if (scene) err = PersistenceWorker::forget(device.getVdcHost().getPersistenceWorker(), *scene);
+  }
+  if (rowid!=0 && device.getVdcHost().usesSceneBlobStorage()) {
+    err = PersistenceWorker::execute(
+      device.getVdcHost().getPersistenceWorker(), paramStore,
+      string_format("DELETE FROM SceneBlobs WHERE parentID=%s", sqlString(parentIdForScenes()).c_str())
+    );
+  }
+  return err;
+}
+
+
+// MARK: ===== scene blob storage
+
+bool SceneDeviceSettings::loadSceneBlob(const string &aParentId)
+{
+  string blob;
+  sqlite3pp::query blobQuery(paramStore);
+  if (blobQuery.prepare("SELECT scenes FROM SceneBlobs WHERE parentID=?")!=SQLITE_OK) return false;
+  blobQuery.bind(1, aParentId.c_str(), false);
+  sqlite3pp::query::iterator blobRow = blobQuery.begin();
+  if (blobRow==blobQuery.end()) return false; // no scene blob (yet)
+  const char *p = (const char *)blobRow->get<const void *>(0);
+  if (p) blob.assign(p, blobRow->column_bytes(0));
+  // header
+  size_t pos = 0;
+  uint64_t v;
+  if (!getBlobUInt(blob, pos, 1, v) || v!=SCENE_BLOB_VERSION) {
+    SALOG(device, LOG_ERR, "unsupported scene blob version -> loading scenes from scene table");
+    return false;
+  }
+  uint64_t numStored;
+  if (!getBlobUInt(blob, pos, 2, numStored)) return false;
+  vector<string> storedNames(numStored);
+  for (size_t i=0; i<numStored; i++) {
+    if (!getBlobString(blob, pos, 1, storedNames[i])) return false;
+  }
+  // map the stored values to the current layout of the scene's values
+  DsScenePtr scene = newDefaultScene(0);
+  size_t numKeys = scene->numKeyDefs();
+  size_t numValues = numKeys+scene->numFieldDefs();
+  vector<int> valueMap(numValues, -1);
+  for (size_t i=0; i<numValues; i++) {
+    const FieldDefinition *fd = i<numKeys ? scene->getKeyDef(i) : scene->getFieldDef(i-numKeys);
+    for (size_t j=0; j<numStored; j++) {
+      if (storedNames[j]==fd->fieldName) { valueMap[i] = (int)j; break; }
+    }
+  }
+  // the row to load scenes from: ROWID (none), followed by the values
+  sqlite3pp::query rowQuery(paramStore);
+  string sql = "SELECT ?1";
+  for (size_t i=0; i<numValues; i++) string_format_append(sql, ",?%zu", i+2);
+  if (rowQuery.prepare(sql.c_str())!=SQLITE_OK) return false;
+  uint64_t numScenes;
+  if (!getBlobUInt(blob, pos, 2, numScenes)) return false;
+  vector<int> types(numStored);
+  vector<uint64_t> numbers(numStored);
+  vector<string> strings(numStored);
+  bool corrupt = false;
+  for (size_t s=0; s<numScenes && !corrupt; s++) {
+    // decode the stored values
+    for (size_t j=0; j<numStored && !corrupt; j++) {
+      uint64_t t;
+      if (!getBlobUInt(blob, pos, 1, t)) { corrupt = true; break; }
+      types[j] = (int)t;
+      if (t==SQLITE_INTEGER || t==SQLITE_FLOAT) {
+        corrupt = !getBlobUInt(blob, pos, 8, numbers[j]);
+      }
+      else if (t==SQLITE_TEXT || t==SQLITE_BLOB) {
+        corrupt = !getBlobString(blob, pos, 4, strings[j]);
+      }
+      else if (t!=SQLITE_NULL) {
+        corrupt = true;
+      }
+    }
+    if (corrupt) break;
+    // bind them
+    rowQuery.reset();
+    rowQuery.bind(1, 0LL); // scenes in a blob have no ROWID of their own
+    for (size_t i=0; i<numValues; i++) {
+      int j = valueMap[i];
+      int idx = (int)i+2;
+      if (j<0 || types[j]==SQLITE_NULL) {
+        rowQuery.bind(idx);
+      }
+      else if (types[j]==SQLITE_INTEGER) {
+        rowQuery.bind(idx, (long long)numbers[j]);
+      }
+      else if (types[j]==SQLITE_FLOAT) {
+        double d;
+        memcpy(&d, &numbers[j], sizeof(d));
+        rowQuery.bind(idx, d);
+      }
+      else if (types[j]==SQLITE_TEXT) {
+        rowQuery.bind(idx, strings[j].c_str(), false);
+      }
+      else {
+        rowQuery.bind(idx, strings[j].data(), (int)strings[j].size(), false);
+      }
+    }
+    // load the scene
+    sqlite3pp::query::iterator row = rowQuery.begin();
+    if (row!=rowQuery.end()) {
+      sceneRowLoaded(row);
+    }
+  }
+  if (corrupt) {
+    SALOG(device, LOG_ERR, "corrupt scene blob, only %zu scenes could be loaded", numStoredScenes());
+  }
+  // just loaded, nothing to save
+  for (int i=0; i<SCENE_TABLE_SIZE; i++) {
+    DsScenePtr scene = storedScene(i);
+    if (scene) scene->markClean();
+  }
+  return true;
+}
+
+
+ErrorPtr SceneDeviceSettings::saveSceneBlob(const string &aParentId)
+{
+  ErrorPtr err;
+  bool changed = sceneBlobMigration;
+  for (int i=0; i<SCENE_TABLE_SIZE; i++) {
+    DsScenePtr scene = storedScene(i);
+    if (scene && scene->dirty) changed = true;
+  }
+  if (!changed) return err; // nothing to save
+  // header
+  DsScenePtr scene = newDefaultScene(0);
+  size_t numKeys = scene->numKeyDefs();
+  size_t numValues = numKeys+scene->numFieldDefs();
+  string blob;
+  appendBlobUInt(blob, SCENE_BLOB_VERSION, 1);
+  appendBlobUInt(blob, numValues, 2);
+  for (size_t i=0; i<numValues; i++) {
+    const FieldDefinition *fd = i<numKeys ? scene->getKeyDef(i) : scene->getFieldDef(i-numKeys);
+    size_t n = strlen(fd->fieldName);
+    appendBlobUInt(blob, n, 1);
+    blob.append(fd->fieldName, n);
+  }
+  appendBlobUInt(blob, numStoredScenes(), 2);
+  // the query to capture the values bound by the scenes
+  sqlite3pp::query valueQuery(paramStore);
+  string sql = "SELECT ?1";
+  for (size_t i=1; i<numValues; i++) string_format_append(sql, ",?%zu", i+1);
+  if (valueQuery.prepare(sql.c_str())!=SQLITE_OK) return paramStore.error();
+  for (int si=0; si<SCENE_TABLE_SIZE; si++) {
+    DsScenePtr sc = storedScene(si);
+    if (!sc) continue;
+    valueQuery.reset();
+    int index = 1;
+    sc->bindToStatement(valueQuery, index, aParentId.c_str(), 0);
+    sqlite3pp::query::iterator row = valueQuery.begin();
+    if (row==valueQuery.end()) return paramStore.error();
+    for (int i=0; i<(int)numValues; i++) {
+      int t = row->column_type(i);
+      appendBlobUInt(blob, t, 1);
+      if (t==SQLITE_INTEGER) {
+        appendBlobUInt(blob, (uint64_t)row->get<long long>(i), 8);
+      }
+      else if (t==SQLITE_FLOAT) {
+        double d = row->get<double>(i);
+        uint64_t u;
+        memcpy(&u, &d, sizeof(u));
+        appendBlobUInt(blob, u, 8);
+      }
+      else if (t==SQLITE_TEXT || t==SQLITE_BLOB) {
+        const char *p = (const char *)row->get<const void *>(i);
+        size_t n = p ? row->column_bytes(i) : 0;
+        appendBlobUInt(blob, n, 4);
+        if (n>0) blob.append(p, n);
+      }
+    }
   }
+  // store it
+  PersistenceWorker *worker = device.getVdcHost().getPersistenceWorker();
+  if (!worker) {
+    // written directly: scenes must be saved again when the enclosing transaction fails
+    for (int i=0; i<SCENE_TABLE_SIZE; i++) {
+      DsScenePtr s = storedScene(i);
+      if (s) SaveJournal::recordSave(*s);
+    }
+  }
+  sql = string_format(
+    "INSERT OR REPLACE INTO SceneBlobs (parentID, scenes) VALUES (%s, X'%s')",
+    sqlString(aParentId).c_str(), binaryToHexString(blob).c_str()
+  );
+  if (sceneBlobMigration) {
+    // scenes are now in the blob, remove the individual scene records
+    // Note: part of the same SQL, which stops at the first failing statement, so the scene records
+    //   are only deleted when the blob was actually written
+    string_format_append(sql, "; DELETE FROM %s WHERE parentID=%s", scene->tableName(), sqlString(aParentId).c_str());
+  }
+  for (int i=0; i<SCENE_TABLE_SIZE; i++) {
+    DsScenePtr s = storedScene(i);
+    if (s) s->markClean();
+  }
+  err = PersistenceWorker::execute(worker, paramStore, sql, boost::bind(&SceneDeviceSettings::sceneBlobWritten, SceneDeviceSettingsPtr(this), sceneBlobMigration, _1));
   return err;
 }
 
 
+void SceneDeviceSettings::sceneBlobWritten(bool aMigrated, ErrorPtr aError)
+{
+  if (Error::isOK(aError)) {
+    if (aMigrated) {
+      // the individual scene records are gone now
+      sceneBlobMigration = false;
+      for (int i=0; i<SCENE_TABLE_SIZE; i++) {
+        DsScenePtr s = storedScene(i);
+        if (s) s->rowid = 0;
+      }
+    }
+  }
+  else {
+    // blob not written: scenes must be saved again (and, if migrating, scene records are still in place)
+    for (int i=0; i<SCENE_TABLE_SIZE; i++) {
+      DsScenePtr s = storedScene(i);
+      if (s) s->markDirty();
+    }
+  }
+}
+
+
 
 // MARK: ===== additional scene defaults from files
 
 
-void SceneDeviceSettings::loadScenesFromFiles()
+static const int numSceneFileLevels = 5;
+
+string SceneDeviceSettings::sceneFileName(int aLevel)
 {
-  string dir = device.getVdcHost().getConfigDir();
-  const int numLevels = 5;
-  string levelids[numLevels];
+  string levelid;
   // Level strategy: most specialized will be active, unless lower levels specify explicit override
   // - Baselines are hardcoded defaults plus settings (already) loaded from persistent store
   // - Level 0 are scenes related to the device instance (dSUID)
@@ -573,14 +1038,41 @@ void SceneDeviceSettings::loadScenesFromFiles()
   // - Level 2 are scenes related to the device class/version (deviceClass()_deviceClassVersion())
   // - Level 3 are scenes related to the behaviour (behaviourTypeIdentifier())
   // - Level 4 are scenes related to the vDC (vdcClassIdentifier())
-  levelids[0] = "vdsd_" + device.getDsUid().getString();
-  levelids[1] = string(device.deviceTypeIdentifier()) + "_device";
-  levelids[2] = string_format("%s_%d_class", device.deviceClass().c_str(), device.deviceClassVersion());
-  levelids[3] = string(device.output->behaviourTypeIdentifier()) + "_behaviour";
-  levelids[4] = device.vdcP->vdcClassIdentifier();
-  for(int i=0; i<numLevels; ++i) {
+  switch (aLevel) {
+    case 0: levelid = "vdsd_" + device.getDsUid().getString(); break;
+    case 1: levelid = string(device.deviceTypeIdentifier()) + "_device"; break;
+    case 2: levelid = string_format("%s_%d_class", device.deviceClass().c_str(), device.deviceClassVersion()); break;
+    case 3: levelid = string(device.output->behaviourTypeIdentifier()) + "_behaviour"; break;
+    default: levelid = device.vdcP->vdcClassIdentifier(); break;
+  }
+  return "scenes_"+levelid+".csv";
+}
+
+
+bool SceneDeviceSettings::usesSceneFile(const string &aFileName)
+{
+  if (aFileName.empty()) return true; // any file might have changed
+  if (aFileName.compare(0, 7, "scenes_")!=0) return false; // not a scene file at all
+  for(int i=0; i<numSceneFileLevels; ++i) {
+    if (aFileName==sceneFileName(i)) return true;
+  }
+  return false;
+}
+
+
+void SceneDeviceSettings::loadScenesFromFiles()
+{
+  string dir = device.getVdcHost().getConfigDir();
+  SettingsFileCache &configFiles = device.getVdcHost().getSettingsFileCache();
+  for(int i=0; i<numSceneFileLevels; ++i) {
+    string sfn = sceneFileName(i);
+    // the config dir index tells which files exist, no need to try opening files that don't
+    if (!configFiles.fileExists(sfn)) {
+      SALOG(device, LOG_DEBUG, "loadScenesFromFiles: no '%s'", sfn.c_str());
+      continue;
+    }
     // try to open config file
-    string fn = dir+"scenes_"+levelids[i]+".csv";
+    string fn = dir+sfn;
     string line;
     int lineNo = 0;
     FILE *file = fopen(fn.c_str(), "r");
@@ -621,13 +1113,15 @@ void SceneDeviceSettings::loadScenesFromFiles()
             SALOG(device, LOG_ERR, "%s:%d - no or invalid scene number", fn.c_str(), lineNo);
             continue; // no valid scene number -> invalid line
           }
-          // check if this scene is already in the list (i.e. already has non-hardwired settings)
-          DsSceneMap::iterator pos = scenes.find(sceneNo);
-          DsScenePtr scene;
-          if (pos!=scenes.end()) {
+          if (sceneNo<0 || sceneNo>=SCENE_TABLE_SIZE) {
+            SALOG(device, LOG_ERR, "%s:%d - invalid scene number %d", fn.c_str(), lineNo, sceneNo);
+            continue; // scene number out of range -> invalid line
+          }
+          // check if this scene is already in the table (i.e. already has non-hardwired settings)
+          DsScenePtr scene = storedScene(sceneNo);
+          if (scene) {
             // this scene already has settings, only apply if this is an overridden
             if (!overridden) continue; // scene already configured by more specialized level -> dont apply
-            scene = pos->second;
           }
           else {
             // no settings yet, create the scene object
@@ -638,7 +1132,7 @@ void SceneDeviceSettings::loadScenesFromFiles()
           // these changes are NOT to be made persistent in DB!
           scene->markClean();
           // put scene into table
-          scenes[sceneNo] = scene;
+          setStoredScene(scene);
           SALOG(device, LOG_INFO, "Customized scene %d %sfrom config file %s", sceneNo, overridden ? "(with override) " : "", fn.c_str());
         }
       }
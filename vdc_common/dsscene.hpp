@@ -82,6 +82,7 @@ namespace p44 {
 
 
   class SceneDeviceSettings;
+  class SharedDefaultScenes;
   class Device;
   class DeviceSettings;
 
@@ -103,8 +104,9 @@ namespace p44 {
     typedef PropertyContainer inheritedProps;
 
     friend class SceneDeviceSettings;
+    friend class SharedDefaultScenes;
 
-    SceneDeviceSettings &sceneDeviceSettings;
+    SceneDeviceSettings *sceneDeviceSettings; ///< the settings this scene belongs to (shared default scenes are handed over to another user when it goes away)
 
   protected:
 
@@ -192,6 +194,9 @@ namespace p44 {
     /// @return the device this scene belongs to
     Device &getDevice();
 
+    /// mark properties changed, including the device
+    virtual void propertiesChanged() P44_OVERRIDE;
+
     /// get device
     /// @return the output behaviour controlled by this scene
     OutputBehaviourPtr getOutputBehaviour();
@@ -216,6 +221,7 @@ namespace p44 {
     virtual const FieldDefinition *getFieldDef(size_t aIndex);
     virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP);
     virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags);
+    virtual void markDirty() P44_OVERRIDE;
 
   private:
 
@@ -223,7 +229,10 @@ namespace p44 {
 
   };
   typedef boost::intrusive_ptr<DsScene> DsScenePtr;
-  typedef map<SceneNo, DsScenePtr> DsSceneMap;
+
+
+  /// number of slots in the scene table (covers all dS scene numbers)
+  #define SCENE_TABLE_SIZE 128
 
 
 
@@ -235,6 +244,9 @@ namespace p44 {
   ///   most DsScene objects are created on the fly via the newDefaultScene() factory method only when
   ///   needed e.g. for calling a scene. Only scenes that were explicitly configured to differ from the
   ///   standard scene values for the behaviour are actually persisted into the database.
+  /// @note Default scenes are materialized once on first use and then shared by all devices with the
+  ///   same defaultScenesKey(), so calling unmodified scenes does not allocate. Shared default scenes
+  ///   are immutable, modifications always go to a private copy obtained via getSceneForUpdate().
   class SceneDeviceSettings : public DeviceSettings
   {
     typedef DeviceSettings inherited;
@@ -243,10 +255,12 @@ namespace p44 {
     friend class Device;
     friend class SceneChannels;
 
-    DsSceneMap scenes; ///< the user defined scenes (default scenes will be created on the fly)
+    DsScenePtr scenes[SCENE_TABLE_SIZE]; ///< the scene table, indexed by scene number (NULL for scenes with default values)
+    SharedDefaultScenes *sharedDefaults; ///< the default scenes shared with other devices of the same kind, NULL if not yet used
 
   public:
     SceneDeviceSettings(Device &aDevice);
+    virtual ~SceneDeviceSettings();
 
 
     /// @name Access scenes
@@ -254,10 +268,16 @@ namespace p44 {
 
     /// get the parameters for the scene
     /// @param aSceneNo the scene to get current settings for.
-    /// @note the object returned may not be attached to a container (if it is a default scene
-    ///   created on the fly). Scene modifications must be posted using updateScene()
+    /// @note the object returned may be a default scene shared by all devices with the same defaultScenesKey().
+    ///   Use it for reading only, to modify a scene use getSceneForUpdate() instead.
     DsScenePtr getScene(SceneNo aSceneNo);
 
+    /// get the parameters for the scene for modifying them
+    /// @param aSceneNo the scene to get settings for.
+    /// @return the stored scene, or a private copy of the default scene which can be modified freely
+    /// @note Scene modifications must be posted using updateScene()
+    DsScenePtr getSceneForUpdate(SceneNo aSceneNo);
+
     /// update scene (mark dirty, add to list of non-default scene objects)
     /// @param aScene the scene to save modified settings for.
     /// @note call updateScene only if scene values are changed from defaults, because
@@ -282,6 +302,13 @@ namespace p44 {
     ///   Derived classes might need to pre-configure other things, such as flags (e.g. fixvol for audio)
     virtual DsScenePtr newUndoStateScene();
 
+    /// key identifying the default scene values, devices with the same key share their default scene objects
+    /// @return key, or empty string if default scenes depend on this device's state and cannot be shared
+    /// @note base class derives the key from the settings class, the output behaviour class and function
+    ///   and the channel layout. Subclasses with default scene values depending on more than that must
+    ///   extend the key or return an empty string.
+    virtual string defaultScenesKey();
+
     /// @}
 
   protected:
@@ -305,8 +332,29 @@ namespace p44 {
     /// delete scenes
     virtual ErrorPtr deleteChildren() P44_FINAL;
 
+    /// register scene records for being loaded in bulk
+    virtual void prepareBulkLoadChildren(SettingsBulkLoader &aLoader) P44_OVERRIDE;
+
     /// load additional defaults for scenes from files
     void loadScenesFromFiles();
+
+    /// check if scenes are loaded from a config file
+    /// @param aFileName name of the config file (without directory), empty to match any file
+    /// @return true if loadScenesFromFiles() would load from that file
+    bool usesSceneFile(const string &aFileName);
+
+  private:
+
+    bool sceneBlobMigration; ///< set when scenes were loaded from the scene table and must be migrated to a scene blob
+
+    void sceneRowLoaded(sqlite3pp::query::iterator &aRow);
+    string sceneFileName(int aLevel);
+    DsScenePtr storedScene(int aSceneNo);
+    bool setStoredScene(DsScenePtr aScene);
+    size_t numStoredScenes();
+    bool loadSceneBlob(const string &aParentId);
+    ErrorPtr saveSceneBlob(const string &aParentId);
+    void sceneBlobWritten(bool aMigrated, ErrorPtr aError);
     
     /// @}
   };
@@ -170,7 +170,10 @@ ErrorPtr VdcJsonApiRequest::sendResult(ApiValuePtr aResult)
 {
   LOG(LOG_INFO, "vdSM <- vDC (JSON) result sent: requestid='%s', result=%s", requestId().c_str(), aResult ? aResult->description().c_str() : "<none>");
   JsonApiValuePtr result = boost::dynamic_pointer_cast<JsonApiValue>(aResult);
-  return jsonConnection->jsonRpcComm->sendResult(requestId().c_str(), result ? result->jsonObject() : NULL);
+  jsonConnection->recordJsonRpc(true, requestId().c_str(), NULL, "result", result ? result->jsonObject() : JsonObjectPtr());
+  ErrorPtr err = jsonConnection->jsonRpcComm->sendResult(requestId().c_str(), result ? result->jsonObject() : NULL);
+  answered();
+  return err;
 }
 
 
@@ -188,7 +191,16 @@ ErrorPtr VdcJsonApiRequest::sendError(uint32_t aErrorCode, string aErrorMessage,
   else if (aErrorData) {
     errorData = boost::dynamic_pointer_cast<JsonApiValue>(aErrorData);
   }
-  return jsonConnection->jsonRpcComm->sendError(requestId().c_str(), aErrorCode, aErrorMessage.size()>0 ? aErrorMessage.c_str() : NULL, errorData ? errorData->jsonObject() : JsonObjectPtr());
+  if (jsonConnection->recorder) {
+    JsonObjectPtr errorObj = JsonObject::newObj();
+    errorObj->add("code", JsonObject::newInt32(aErrorCode));
+    errorObj->add("message", JsonObject::newString(aErrorMessage));
+    if (errorData) errorObj->add("data", errorData->jsonObject());
+    jsonConnection->recordJsonRpc(true, requestId().c_str(), NULL, "error", errorObj);
+  }
+  ErrorPtr err = jsonConnection->jsonRpcComm->sendError(requestId().c_str(), aErrorCode, aErrorMessage.size()>0 ? aErrorMessage.c_str() : NULL, errorData ? errorData->jsonObject() : JsonObjectPtr());
+  answered();
+  return err;
 }
 
 
@@ -205,9 +217,24 @@ VdcJsonApiConnection::VdcJsonApiConnection()
 
 
 
+void VdcJsonApiConnection::recordJsonRpc(bool aOutbound, const char *aId, const char *aMethod, const char *aMember, JsonObjectPtr aValue)
+{
+  if (!recorder) return;
+  // reconstruct the JSON-RPC message (JsonRpcComm does not expose the raw text)
+  JsonObjectPtr msg = JsonObject::newObj();
+  msg->add("jsonrpc", JsonObject::newString("2.0"));
+  if (aMethod) msg->add("method", JsonObject::newString(aMethod));
+  if (aId) msg->add("id", JsonObject::newString(aId));
+  msg->add(aMember, aValue ? aValue : JsonObject::newNull());
+  const char *text = msg->c_strValue();
+  recorder->recordMessage(aOutbound, text, strlen(text));
+}
+
+
 void VdcJsonApiConnection::jsonRequestHandler(const char *aMethod, const char *aJsonRpcId, JsonObjectPtr aParams)
 {
   ErrorPtr respErr;
+  recordJsonRpc(false, aJsonRpcId, aMethod, "params", aParams);
   if (apiRequestHandler) {
     // create params API value
     ApiValuePtr params = JsonApiValue::newValueFromJson(aParams);
@@ -223,7 +250,7 @@ void VdcJsonApiConnection::jsonRequestHandler(const char *aMethod, const char *a
       LOG(LOG_INFO, "vdSM -> vDC (JSON) notification '%s' received: params=%s", aMethod, params ? params->description().c_str() : "<none>");
     }
     // call handler
-    apiRequestHandler(VdcJsonApiConnectionPtr(this), request, aMethod, params);
+    dispatchRequest(request, aMethod, params);
   }
 }
 
@@ -241,11 +268,13 @@ ErrorPtr VdcJsonApiConnection::sendRequest(const string &aMethod, ApiValuePtr aP
   if (aResponseHandler) {
     // method call expecting response
     err = jsonRpcComm->sendRequest(aMethod.c_str(), params->jsonObject(), boost::bind(&VdcJsonApiConnection::jsonResponseHandler, this, aResponseHandler, _1, _2, _3));
+    if (recorder) recordJsonRpc(true, string_format("%d", jsonRpcComm->lastRequestId()).c_str(), aMethod.c_str(), "params", params->jsonObject());
     LOG(LOG_INFO, "vdSM <- vDC (JSON) method call sent: requestid='%d', method='%s', params=%s", jsonRpcComm->lastRequestId(), aMethod.c_str(), aParams ? aParams->description().c_str() : "<none>");
   }
   else {
     // notification
     err = jsonRpcComm->sendRequest(aMethod.c_str(), params->jsonObject(), NULL);
+    recordJsonRpc(true, NULL, aMethod.c_str(), "params", params->jsonObject());
     LOG(LOG_INFO, "vdSM <- vDC (JSON) notification sent: method='%s', params=%s", aMethod.c_str(), aParams ? aParams->description().c_str() : "<none>");
   }
   return err;
@@ -259,6 +288,7 @@ void VdcJsonApiConnection::jsonResponseHandler(VdcApiResponseCB aResponseHandler
     string respId = string_format("%d", aResponseId);
     ApiValuePtr resultOrErrorData = JsonApiValue::newValueFromJson(aResultOrErrorData);
     VdcApiRequestPtr request = VdcJsonApiRequestPtr(new VdcJsonApiRequest(VdcJsonApiConnectionPtr(this), respId.c_str()));
+    recordJsonRpc(false, respId.c_str(), NULL, Error::isOK(aError) ? "result" : "error", aResultOrErrorData);
     if (Error::isOK(aError)) {
       LOG(LOG_INFO, "vdSM -> vDC (JSON) result received: id='%s', result=%s", request->requestId().c_str(), resultOrErrorData ? resultOrErrorData->description().c_str() : "<none>");
     }
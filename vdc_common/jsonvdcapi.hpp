@@ -187,6 +187,17 @@ namespace p44 {
     /// @return empty or Error object in case of error
     virtual ErrorPtr sendRequest(const string &aMethod, ApiValuePtr aParams, VdcApiResponseCB aResponseHandler = VdcApiResponseCB());
 
+    /// @return JSON encoding
+    virtual VdcApiEncoding apiEncoding() P44_OVERRIDE { return vdcapi_encoding_json; };
+
+    /// record a JSON-RPC message, if this connection is being recorded
+    /// @param aOutbound true for messages sent by the vDC host
+    /// @param aId JSON-RPC id, NULL for notifications
+    /// @param aMethod method or notification name, NULL for responses
+    /// @param aMember name of the member containing aValue ("params", "result" or "error")
+    /// @param aValue the params, result or error object
+    void recordJsonRpc(bool aOutbound, const char *aId, const char *aMethod, const char *aMember, JsonObjectPtr aValue);
+
   private:
 
     void jsonRequestHandler(const char *aMethod, const char *aJsonRpcId, JsonObjectPtr aParams);
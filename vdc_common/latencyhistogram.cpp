@@ -0,0 +1,115 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "latencyhistogram.hpp"
+
+
+using namespace p44;
+
+
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+
+void LatencyHistogram::reset()
+{
+  memset(buckets, 0, sizeof(buckets));
+  numSamples = 0;
+  minLatency = 0;
+  maxLatency = 0;
+  totalLatency = 0;
+}
+
+
+// Bucket layout: values below LATENCY_HISTOGRAM_SUBBUCKETS uS have one bucket each. Above, every
+// power of two range is split into LATENCY_HISTOGRAM_SUBBUCKETS linear buckets.
+int LatencyHistogram::bucketIndex(MLMicroSeconds aLatency)
+{
+  if (aLatency<LATENCY_HISTOGRAM_SUBBUCKETS) return aLatency<0 ? 0 : (int)aLatency;
+  // find range
+  int range = 0;
+  uint64_t v = aLatency;
+  while (v>=2*LATENCY_HISTOGRAM_SUBBUCKETS) {
+    v >>= 1;
+    range++;
+  }
+  if (range>=LATENCY_HISTOGRAM_RANGES) return LATENCY_HISTOGRAM_BUCKETS-1; // saturate
+  // v is now in LATENCY_HISTOGRAM_SUBBUCKETS..2*LATENCY_HISTOGRAM_SUBBUCKETS-1
+  return LATENCY_HISTOGRAM_SUBBUCKETS*(range+1) + (int)(v-LATENCY_HISTOGRAM_SUBBUCKETS);
+}
+
+
+MLMicroSeconds LatencyHistogram::bucketValue(int aIndex)
+{
+  if (aIndex<LATENCY_HISTOGRAM_SUBBUCKETS) return aIndex;
+  int range = aIndex/LATENCY_HISTOGRAM_SUBBUCKETS-1;
+  int sub = aIndex%LATENCY_HISTOGRAM_SUBBUCKETS;
+  // middle of the bucket
+  MLMicroSeconds lower = (MLMicroSeconds)(LATENCY_HISTOGRAM_SUBBUCKETS+sub)<<range;
+  return lower + ((MLMicroSeconds)1<<range)/2;
+}
+
+
+void LatencyHistogram::record(MLMicroSeconds aLatency)
+{
+  if (aLatency<0) aLatency = 0;
+  buckets[bucketIndex(aLatency)]++;
+  if (numSamples==0 || aLatency<minLatency) minLatency = aLatency;
+  if (aLatency>maxLatency) maxLatency = aLatency;
+  totalLatency += aLatency;
+  numSamples++;
+}
+
+
+MLMicroSeconds LatencyHistogram::percentile(double aFraction) const
+{
+  if (numSamples==0) return 0;
+  long threshold = (long)(aFraction*numSamples+0.5);
+  if (threshold<1) threshold = 1;
+  long seen = 0;
+  for (int i=0; i<LATENCY_HISTOGRAM_BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen>=threshold) {
+      // bucket found, report its value but never beyond the actual extremes
+      MLMicroSeconds v = bucketValue(i);
+      if (v<minLatency) v = minLatency;
+      if (v>maxLatency) v = maxLatency;
+      return v;
+    }
+  }
+  return maxLatency;
+}
+
+
+void LatencyHistogram::addToApiValue(ApiValuePtr aObject) const
+{
+  aObject->setType(apivalue_object);
+  aObject->add("count", aObject->newInt64(numSamples));
+  aObject->add("min", aObject->newDouble((double)minLatency/MilliSecond));
+  aObject->add("mean", aObject->newDouble(numSamples>0 ? (double)totalLatency/numSamples/MilliSecond : 0));
+  aObject->add("p50", aObject->newDouble((double)percentile(0.5)/MilliSecond));
+  aObject->add("p90", aObject->newDouble((double)percentile(0.9)/MilliSecond));
+  aObject->add("p99", aObject->newDouble((double)percentile(0.99)/MilliSecond));
+  aObject->add("p999", aObject->newDouble((double)percentile(0.999)/MilliSecond));
+  aObject->add("max", aObject->newDouble((double)maxLatency/MilliSecond));
+}
@@ -0,0 +1,82 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44vdc__latencyhistogram__
+#define __p44vdc__latencyhistogram__
+
+#include "p44utils_common.hpp"
+
+#include "apivalue.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  // number of linear sub-buckets per power of two (resolution is 1/LATENCY_HISTOGRAM_SUBBUCKETS = ~6%)
+  #define LATENCY_HISTOGRAM_SUBBUCKETS 16
+  // number of powers of two covered above the linear range (16uS * 2^32 = ~19h)
+  #define LATENCY_HISTOGRAM_RANGES 32
+  #define LATENCY_HISTOGRAM_BUCKETS (LATENCY_HISTOGRAM_SUBBUCKETS*(LATENCY_HISTOGRAM_RANGES+1))
+
+  /// Latency histogram with logarithmic buckets of constant relative precision (like HdrHistogram).
+  /// Recording is O(1) and needs no allocation, memory is constant (~2kB) regardless of the number of samples.
+  class LatencyHistogram
+  {
+    uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+    long numSamples;
+    MLMicroSeconds minLatency;
+    MLMicroSeconds maxLatency;
+    MLMicroSeconds totalLatency;
+
+  public:
+
+    LatencyHistogram();
+
+    /// forget all samples
+    void reset();
+
+    /// record a sample
+    /// @param aLatency the latency to record
+    void record(MLMicroSeconds aLatency);
+
+    /// @return number of samples recorded
+    long count() const { return numSamples; };
+
+    /// get a percentile
+    /// @param aFraction fraction of samples (0..1) that have a latency at or below the returned value
+    /// @return latency, precise within the bucket resolution
+    MLMicroSeconds percentile(double aFraction) const;
+
+    /// add statistics as fields to an API object value
+    /// @param aObject the object to add count, min, mean, p50, p90, p99, p999 and max to
+    /// @note all latencies are in milliseconds
+    void addToApiValue(ApiValuePtr aObject) const;
+
+  private:
+
+    static int bucketIndex(MLMicroSeconds aLatency);
+    static MLMicroSeconds bucketValue(int aIndex);
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__p44vdc__latencyhistogram__) */
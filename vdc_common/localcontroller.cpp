@@ -129,6 +129,14 @@ void ZoneDescriptor::bindToStatement(sqlite3pp::statement &aStatement, int &aInd
 }
 
 
+void ZoneDescriptor::markDirty()
+{
+  inheritedParams::markDirty();
+  propertiesChanged();
+  VdcHost::sharedVdcHost()->scheduleLocalControllerSave();
+}
+
+
 // MARK: ===== ZoneDescriptor property access implementation
 
 enum {
@@ -155,7 +163,7 @@ PropertyDescriptorPtr ZoneDescriptor::getDescriptorByIndex(int aPropIndex, int a
   };
   if (aParentDescriptor->isRootOfObject()) {
     // root level property of this object hierarchy
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   return PropertyDescriptorPtr();
 }
@@ -241,7 +249,7 @@ ErrorPtr ZoneList::save()
 
   // save all elements (only dirty ones will be actually stored to DB)
   for (ZonesVector::iterator pos = zones.begin(); pos!=zones.end(); ++pos) {
-    err = (*pos)->saveToStore(NULL, true); // multiple instances allowed, it's a *list*!
+    err = PersistenceWorker::save(VdcHost::sharedVdcHost()->getPersistenceWorker(), **pos, NULL, true); // multiple instances allowed, it's a *list*!
     if (!Error::isOK(err)) LOG(LOG_ERR,"Error saving zone %d: %s", (*pos)->zoneID, err->description().c_str());
   }
   return err;
@@ -305,7 +313,7 @@ bool ZoneList::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Pro
   if (aPropertyDescriptor->hasObjectKey(zonelist_key) && aMode==access_delete) {
     // only field-level access is deleting a zone
     ZoneDescriptorPtr dz = zones[aPropertyDescriptor->fieldKey()];
-    dz->deleteFromStore(); // remove from store
+    PersistenceWorker::forget(VdcHost::sharedVdcHost()->getPersistenceWorker(), *dz); // remove from store
     zones.erase(zones.begin()+aPropertyDescriptor->fieldKey()); // remove from container
     return true;
   }
@@ -409,6 +417,14 @@ void SceneDescriptor::bindToStatement(sqlite3pp::statement &aStatement, int &aIn
 }
 
 
+void SceneDescriptor::markDirty()
+{
+  inheritedParams::markDirty();
+  propertiesChanged();
+  VdcHost::sharedVdcHost()->scheduleLocalControllerSave();
+}
+
+
 // MARK: ===== ZoneDescriptor property access implementation
 
 enum {
@@ -433,7 +449,7 @@ PropertyDescriptorPtr SceneDescriptor::getDescriptorByIndex(int aPropIndex, int
   };
   if (aParentDescriptor->isRootOfObject()) {
     // root level property of this object hierarchy
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   return PropertyDescriptorPtr();
 }
@@ -518,7 +534,7 @@ ErrorPtr SceneList::save()
 
   // save all elements (only dirty ones will be actually stored to DB)
   for (ScenesVector::iterator pos = scenes.begin(); pos!=scenes.end(); ++pos) {
-    err = (*pos)->saveToStore(NULL, true); // multiple instances allowed, it's a *list*!
+    err = PersistenceWorker::save(VdcHost::sharedVdcHost()->getPersistenceWorker(), **pos, NULL, true); // multiple instances allowed, it's a *list*!
     if (!Error::isOK(err)) LOG(LOG_ERR,"Error saving scene %d: %s", (*pos)->sceneNo, err->description().c_str());
   }
   return err;
@@ -579,7 +595,7 @@ bool SceneList::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Pr
   if (aPropertyDescriptor->hasObjectKey(scenelist_key) && aMode==access_delete) {
     // only field-level access is deleting a zone
     SceneDescriptorPtr ds = scenes[aPropertyDescriptor->fieldKey()];
-    ds->deleteFromStore(); // remove from store
+    PersistenceWorker::forget(VdcHost::sharedVdcHost()->getPersistenceWorker(), *ds); // remove from store
     scenes.erase(scenes.begin()+aPropertyDescriptor->fieldKey()); // remove from container
     return true;
   }
@@ -613,6 +629,16 @@ LocalController::~LocalController()
 }
 
 
+void LocalController::propertiesChanged()
+{
+  inherited::propertiesChanged();
+  // the lists are containers in between this and the zones and scenes
+  localZones.propertiesChanged();
+  localScenes.propertiesChanged();
+  vdcHost.propertiesChanged();
+}
+
+
 
 void LocalController::processGlobalEvent(VdchostEvent aActivity)
 {
@@ -715,7 +741,7 @@ PropertyDescriptorPtr LocalController::getDescriptorByIndex(int aPropIndex, int
     if (aPropIndex<n)
       return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
     aPropIndex -= n; // rebase to 0 for my own first property
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor);
 }
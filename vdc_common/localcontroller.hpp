@@ -80,6 +80,7 @@ namespace p44 {
     virtual const FieldDefinition *getFieldDef(size_t aIndex) P44_OVERRIDE;
     virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP) P44_OVERRIDE;
     virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags) P44_OVERRIDE;
+    virtual void markDirty() P44_OVERRIDE;
 
   };
   typedef boost::intrusive_ptr<ZoneDescriptor> ZoneDescriptorPtr;
@@ -161,6 +162,7 @@ namespace p44 {
     virtual const FieldDefinition *getFieldDef(size_t aIndex) P44_OVERRIDE;
     virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP) P44_OVERRIDE;
     virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags) P44_OVERRIDE;
+    virtual void markDirty() P44_OVERRIDE;
 
   };
   typedef boost::intrusive_ptr<SceneDescriptor> SceneDescriptorPtr;
@@ -220,6 +222,9 @@ namespace p44 {
     LocalController(VdcHost &aVdcHost);
     virtual ~LocalController();
 
+    /// mark properties changed, including the zone and scene lists and the vdc host
+    virtual void propertiesChanged() P44_OVERRIDE;
+
     /// @name following vdchost activity
     /// @{
 
@@ -0,0 +1,311 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "msgpackvdcapi.hpp"
+
+
+using namespace p44;
+
+
+// maximum nesting depth accepted when decoding
+#ifndef MSGPACK_MAX_NESTING
+  #define MSGPACK_MAX_NESTING 32
+#endif
+
+
+// MARK: ===== MessagePack encoding
+
+
+static void appendBigEndian(string &aBuffer, uint64_t aValue, int aNumBytes)
+{
+  while (aNumBytes>0) {
+    aNumBytes--;
+    aBuffer.push_back((char)((aValue>>(8*aNumBytes)) & 0xFF));
+  }
+}
+
+
+static void appendSizedHeader(string &aBuffer, size_t aSize, uint8_t aFixMarker, size_t aFixMax, uint8_t aMarker8, uint8_t aMarker16, uint8_t aMarker32)
+{
+  if (aFixMarker && aSize<=aFixMax) {
+    aBuffer.push_back((char)(aFixMarker | aSize));
+  }
+  else if (aMarker8 && aSize<=0xFF) {
+    aBuffer.push_back((char)aMarker8);
+    appendBigEndian(aBuffer, aSize, 1);
+  }
+  else if (aSize<=0xFFFF) {
+    aBuffer.push_back((char)aMarker16);
+    appendBigEndian(aBuffer, aSize, 2);
+  }
+  else {
+    aBuffer.push_back((char)aMarker32);
+    appendBigEndian(aBuffer, aSize, 4);
+  }
+}
+
+
+static void appendUnsigned(string &aBuffer, uint64_t aValue)
+{
+  if (aValue<=0x7F) {
+    aBuffer.push_back((char)aValue); // positive fixint
+  }
+  else if (aValue<=0xFF) {
+    aBuffer.push_back((char)0xCC);
+    appendBigEndian(aBuffer, aValue, 1);
+  }
+  else if (aValue<=0xFFFF) {
+    aBuffer.push_back((char)0xCD);
+    appendBigEndian(aBuffer, aValue, 2);
+  }
+  else if (aValue<=0xFFFFFFFF) {
+    aBuffer.push_back((char)0xCE);
+    appendBigEndian(aBuffer, aValue, 4);
+  }
+  else {
+    aBuffer.push_back((char)0xCF);
+    appendBigEndian(aBuffer, aValue, 8);
+  }
+}
+
+
+static void appendSigned(string &aBuffer, int64_t aValue)
+{
+  if (aValue>=0) {
+    appendUnsigned(aBuffer, aValue);
+  }
+  else if (aValue>=-32) {
+    aBuffer.push_back((char)(aValue & 0xFF)); // negative fixint
+  }
+  else if (aValue>=INT8_MIN) {
+    aBuffer.push_back((char)0xD0);
+    appendBigEndian(aBuffer, (uint64_t)aValue, 1);
+  }
+  else if (aValue>=INT16_MIN) {
+    aBuffer.push_back((char)0xD1);
+    appendBigEndian(aBuffer, (uint64_t)aValue, 2);
+  }
+  else if (aValue>=INT32_MIN) {
+    aBuffer.push_back((char)0xD2);
+    appendBigEndian(aBuffer, (uint64_t)aValue, 4);
+  }
+  else {
+    aBuffer.push_back((char)0xD3);
+    appendBigEndian(aBuffer, (uint64_t)aValue, 8);
+  }
+}
+
+
+void MsgpackApiValue::appendMsgpack(string &aBuffer)
+{
+  switch (allocatedType) {
+    case apivalue_bool:
+      aBuffer.push_back((char)(objectValue.boolVal ? 0xC3 : 0xC2));
+      break;
+    case apivalue_uint64:
+      appendUnsigned(aBuffer, objectValue.uint64Val);
+      break;
+    case apivalue_int64:
+      appendSigned(aBuffer, objectValue.int64Val);
+      break;
+    case apivalue_double: {
+      uint64_t bits;
+      memcpy(&bits, &objectValue.doubleVal, sizeof(bits));
+      aBuffer.push_back((char)0xCB);
+      appendBigEndian(aBuffer, bits, 8);
+      break;
+    }
+    case apivalue_string:
+      appendSizedHeader(aBuffer, objectValue.stringP->size(), 0xA0, 31, 0xD9, 0xDA, 0xDB);
+      aBuffer.append(*objectValue.stringP);
+      break;
+    case apivalue_binary:
+      appendSizedHeader(aBuffer, objectValue.stringP->size(), 0, 0, 0xC4, 0xC5, 0xC6);
+      aBuffer.append(*objectValue.stringP);
+      break;
+    case apivalue_object:
+      appendSizedHeader(aBuffer, objectValue.objectFieldsP->size(), 0x80, 15, 0, 0xDE, 0xDF);
+      for (FieldList::iterator pos = objectValue.objectFieldsP->begin(); pos!=objectValue.objectFieldsP->end(); ++pos) {
+        appendSizedHeader(aBuffer, pos->first.size(), 0xA0, 31, 0xD9, 0xDA, 0xDB);
+        aBuffer.append(pos->first);
+        pos->second->appendMsgpack(aBuffer);
+      }
+      break;
+    case apivalue_array:
+      appendSizedHeader(aBuffer, objectValue.arrayVectorP->size(), 0x90, 15, 0, 0xDC, 0xDD);
+      for (NodeArray::iterator pos = objectValue.arrayVectorP->begin(); pos!=objectValue.arrayVectorP->end(); ++pos) {
+        (*pos)->appendMsgpack(aBuffer);
+      }
+      break;
+    default:
+      // null, or typed but not yet allocated value
+      aBuffer.push_back((char)0xC0);
+      break;
+  }
+}
+
+
+// MARK: ===== MessagePack decoding
+
+
+static bool readBigEndian(const uint8_t *&aDataP, const uint8_t *aEndP, int aNumBytes, uint64_t &aValue)
+{
+  if (aEndP-aDataP<aNumBytes) return false;
+  aValue = 0;
+  while (aNumBytes-->0) {
+    aValue = (aValue<<8) | *aDataP++;
+  }
+  return true;
+}
+
+
+static bool readBytes(const uint8_t *&aDataP, const uint8_t *aEndP, uint64_t aSize, string &aString)
+{
+  if ((uint64_t)(aEndP-aDataP)<aSize) return false;
+  aString.assign((const char *)aDataP, (size_t)aSize);
+  aDataP += aSize;
+  return true;
+}
+
+
+MsgpackApiValuePtr MsgpackApiValue::newValueFromMsgpack(const uint8_t *aData, size_t aSize, ErrorPtr &aError)
+{
+  MsgpackApiValuePtr val = MsgpackApiValuePtr(new MsgpackApiValue);
+  const uint8_t *p = aData;
+  const uint8_t *e = aData+aSize;
+  if (!val->readMsgpack(p, e, 0)) {
+    aError = TextError::err("invalid MessagePack data at offset %zu", (size_t)(p-aData));
+    return MsgpackApiValuePtr();
+  }
+  if (p!=e) {
+    aError = TextError::err("%zu extra bytes after MessagePack value", (size_t)(e-p));
+    return MsgpackApiValuePtr();
+  }
+  return val;
+}
+
+
+bool MsgpackApiValue::readMsgpack(const uint8_t *&aDataP, const uint8_t *aEndP, int aNestingLevel)
+{
+  if (aDataP>=aEndP || aNestingLevel>MSGPACK_MAX_NESTING) return false;
+  uint8_t m = *aDataP++;
+  uint64_t v;
+  uint64_t count;
+  ApiValueType containerType;
+  // scalars and fixed size headers
+  if (m<=0x7F) {
+    // positive fixint
+    setType(apivalue_uint64); setUint64Value(m);
+    return true;
+  }
+  else if (m>=0xE0) {
+    // negative fixint
+    setType(apivalue_int64); setInt64Value((int8_t)m);
+    return true;
+  }
+  else if (m>=0xA0 && m<=0xBF) {
+    // fixstr
+    setType(apivalue_string); allocate();
+    return readBytes(aDataP, aEndP, m & 0x1F, *objectValue.stringP);
+  }
+  else if (m>=0x80 && m<=0x8F) {
+    containerType = apivalue_object; count = m & 0x0F;
+  }
+  else if (m>=0x90 && m<=0x9F) {
+    containerType = apivalue_array; count = m & 0x0F;
+  }
+  else {
+    switch (m) {
+      case 0xC0: setType(apivalue_null); return true;
+      case 0xC2: setType(apivalue_bool); setBoolValue(false); return true;
+      case 0xC3: setType(apivalue_bool); setBoolValue(true); return true;
+      case 0xCC: case 0xCD: case 0xCE: case 0xCF:
+        if (!readBigEndian(aDataP, aEndP, 1<<(m-0xCC), v)) return false;
+        setType(apivalue_uint64); setUint64Value(v);
+        return true;
+      case 0xD0: case 0xD1: case 0xD2: case 0xD3: {
+        int n = 1<<(m-0xD0);
+        if (!readBigEndian(aDataP, aEndP, n, v)) return false;
+        if (n<8 && (v & (1ull<<(n*8-1)))) v |= ~((1ull<<(n*8))-1); // sign extend
+        setType(apivalue_int64); setInt64Value((int64_t)v);
+        return true;
+      }
+      case 0xCA: {
+        if (!readBigEndian(aDataP, aEndP, 4, v)) return false;
+        uint32_t bits = (uint32_t)v;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        setType(apivalue_double); setDoubleValue(f);
+        return true;
+      }
+      case 0xCB: {
+        if (!readBigEndian(aDataP, aEndP, 8, v)) return false;
+        double d;
+        memcpy(&d, &v, sizeof(d));
+        setType(apivalue_double); setDoubleValue(d);
+        return true;
+      }
+      case 0xD9: case 0xDA: case 0xDB:
+        if (!readBigEndian(aDataP, aEndP, 1<<(m-0xD9), v)) return false;
+        setType(apivalue_string); allocate();
+        return readBytes(aDataP, aEndP, v, *objectValue.stringP);
+      case 0xC4: case 0xC5: case 0xC6:
+        if (!readBigEndian(aDataP, aEndP, 1<<(m-0xC4), v)) return false;
+        setType(apivalue_binary); allocate();
+        return readBytes(aDataP, aEndP, v, *objectValue.stringP);
+      case 0xDC: case 0xDD:
+        if (!readBigEndian(aDataP, aEndP, m==0xDC ? 2 : 4, count)) return false;
+        containerType = apivalue_array;
+        break;
+      case 0xDE: case 0xDF:
+        if (!readBigEndian(aDataP, aEndP, m==0xDE ? 2 : 4, count)) return false;
+        containerType = apivalue_object;
+        break;
+      default:
+        return false; // extension types and reserved markers are not supported
+    }
+  }
+  // container
+  // - every element needs at least one byte, reject bogus counts before allocating anything
+  if (count>(uint64_t)(aEndP-aDataP)) return false;
+  setType(containerType);
+  allocate();
+  if (containerType==apivalue_array) {
+    objectValue.arrayVectorP->reserve((size_t)count);
+    while (count-->0) {
+      MsgpackApiValuePtr element = MsgpackApiValuePtr(new MsgpackApiValue);
+      if (!element->readMsgpack(aDataP, aEndP, aNestingLevel+1)) return false;
+      objectValue.arrayVectorP->push_back(element);
+    }
+  }
+  else {
+    objectValue.objectFieldsP->reserve((size_t)count);
+    while (count-->0) {
+      // keys must be strings
+      MsgpackApiValue key;
+      if (!key.readMsgpack(aDataP, aEndP, aNestingLevel+1) || key.allocatedType!=apivalue_string) return false;
+      MsgpackApiValuePtr element = MsgpackApiValuePtr(new MsgpackApiValue);
+      if (!element->readMsgpack(aDataP, aEndP, aNestingLevel+1)) return false;
+      objectValue.objectFieldsP->push_back(Field(*key.objectValue.stringP, element));
+    }
+  }
+  return true;
+}
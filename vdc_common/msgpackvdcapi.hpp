@@ -0,0 +1,73 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44vdc__msgpackvdcapi__
+#define __p44vdc__msgpackvdcapi__
+
+#include "p44utils_common.hpp"
+
+#include "treeapivalue.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+
+  class MsgpackApiValue;
+
+  typedef boost::intrusive_ptr<MsgpackApiValue> MsgpackApiValuePtr;
+
+  /// MessagePack specific implementation of ApiValue
+  /// @note values are kept as a plain tree of nodes, so accessing members does not create any wrapper objects.
+  ///   The tree is decoded from and encoded into MessagePack (see http://msgpack.org) in a single pass,
+  ///   without any intermediate text representation.
+  class MsgpackApiValue : public TreeApiValue<MsgpackApiValue>
+  {
+    typedef TreeApiValue<MsgpackApiValue> inherited;
+
+  public:
+
+    /// @name MessagePack interfacing
+    /// @{
+
+    /// decode a MessagePack encoded value
+    /// @param aData pointer to the MessagePack data
+    /// @param aSize number of bytes available at aData
+    /// @param aError will be set to an error if the data is not a single, valid MessagePack value
+    /// @return new value, NULL in case of error
+    static MsgpackApiValuePtr newValueFromMsgpack(const uint8_t *aData, size_t aSize, ErrorPtr &aError);
+
+    /// append the MessagePack encoded representation of this value
+    /// @param aBuffer the encoded value will be appended to this buffer
+    void appendMsgpack(string &aBuffer);
+
+    /// @}
+
+  private:
+
+    bool readMsgpack(const uint8_t *&aDataP, const uint8_t *aEndP, int aNestingLevel);
+
+  };
+
+
+} // namespace p44
+
+#endif /* defined(__p44vdc__msgpackvdcapi__) */
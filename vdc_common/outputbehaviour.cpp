@@ -478,7 +478,7 @@ const PropertyDescriptorPtr OutputBehaviour::getDescDescriptorByIndex(int aPropI
     { "variableRamp", apivalue_bool, variableRamp_key+descriptions_key_offset, OKEY(output_key) },
     { "maxPower", apivalue_double, maxPower_key+descriptions_key_offset, OKEY(output_key) },
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -500,7 +500,7 @@ const PropertyDescriptorPtr OutputBehaviour::getSettingsDescriptorByIndex(int aP
     { "pushChanges", apivalue_bool, pushChanges_key+settings_key_offset, OKEY(output_key) },
     { "groups", apivalue_bool+propflag_container, groups_key+settings_key_offset, OKEY(output_groups_key) }
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -520,7 +520,7 @@ const PropertyDescriptorPtr OutputBehaviour::getStateDescriptorByIndex(int aProp
     { "localPriority", apivalue_bool, localPriority_key+states_key_offset, OKEY(output_key) },
     { "transitionTime", apivalue_double, transitiontime_key+states_key_offset, OKEY(output_key) }
   };
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -25,6 +25,7 @@
 #include "device.hpp"
 
 #include "jsonvdcapi.hpp"
+#include "msgpackvdcapi.hpp"
 
 #include "macaddress.hpp"
 
@@ -97,6 +98,226 @@ ErrorPtr P44JsonApiRequest::sendError(uint32_t aErrorCode, string aErrorMessage,
 }
 
 
+// MARK: ===== config API - P44MsgpackApiConnection
+
+// max size of a single MessagePack config API message
+#ifndef MAX_MSGPACK_CFGAPI_MESSAGE_SIZE
+  #define MAX_MSGPACK_CFGAPI_MESSAGE_SIZE (1024*1024)
+#endif
+
+
+P44MsgpackApiConnection::P44MsgpackApiConnection() :
+  closeWhenSent(false)
+{
+  setApiVersion(VDC_API_VERSION_MAX);
+  socketComm = SocketCommPtr(new SocketComm(MainLoop::currentMainLoop()));
+  // install data handler
+  socketComm->setReceiveHandler(boost::bind(&P44MsgpackApiConnection::gotData, this, _1));
+}
+
+
+void P44MsgpackApiConnection::setMessageHandler(MsgpackApiMessageCB aMessageHandler)
+{
+  messageHandler = aMessageHandler;
+}
+
+
+ApiValuePtr P44MsgpackApiConnection::newApiValue()
+{
+  return ApiValuePtr(new MsgpackApiValue);
+}
+
+
+void P44MsgpackApiConnection::closeAfterSend()
+{
+  if (transmitBuffer.empty()) {
+    // nothing pending, close right now
+    closeConnection();
+  }
+  else {
+    closeWhenSent = true;
+  }
+}
+
+
+void P44MsgpackApiConnection::gotData(ErrorPtr aError)
+{
+  P44MsgpackApiConnectionPtr keepAlive = P44MsgpackApiConnectionPtr(this); // handlers might close the connection
+  if (Error::isOK(aError)) {
+    size_t dataSz = socketComm->numBytesReady();
+    if (dataSz>0) {
+      size_t oldSz = receivedData.size();
+      receivedData.resize(oldSz+dataSz);
+      size_t receivedBytes = socketComm->receiveBytes(dataSz, (uint8_t *)&receivedData[oldSz], aError);
+      receivedData.resize(oldSz+receivedBytes);
+      // process all complete messages
+      size_t pos = 0;
+      while (Error::isOK(aError) && receivedData.size()-pos>=4) {
+        const uint8_t *sz = (const uint8_t *)receivedData.c_str()+pos;
+        size_t msgSize =
+          ((size_t)sz[0]<<24) +
+          ((size_t)sz[1]<<16) +
+          ((size_t)sz[2]<<8) +
+          sz[3];
+        if (msgSize>MAX_MSGPACK_CFGAPI_MESSAGE_SIZE) {
+          aError = Error::err<VdcApiError>(413, "message exceeds maximum length of %d bytes", MAX_MSGPACK_CFGAPI_MESSAGE_SIZE);
+          break;
+        }
+        if (receivedData.size()-pos-4<msgSize) break; // message not yet complete
+        // negotiate encoding per message: JSON requests are objects in text form, a MessagePack map never starts with '{'
+        ApiValuePtr message;
+        VdcApiEncoding encoding;
+        if (msgSize>0 && sz[4]=='{') {
+          encoding = vdcapi_encoding_json;
+          JsonObjectPtr j = JsonObject::objFromText(string((const char *)sz+4, msgSize).c_str());
+          if (j) message = JsonApiValue::newValueFromJson(j);
+          else aError = Error::err<VdcApiError>(400, "invalid JSON message");
+        }
+        else {
+          encoding = vdcapi_encoding_msgpack;
+          message = MsgpackApiValue::newValueFromMsgpack(sz+4, msgSize, aError);
+        }
+        pos += 4+msgSize;
+        if (message && messageHandler) {
+          messageHandler(P44MsgpackApiConnectionPtr(this), message, encoding);
+        }
+      }
+      receivedData.erase(0, pos);
+    }
+  }
+  if (!Error::isOK(aError)) {
+    // framing cannot be resynchronized, close connection
+    LOG(LOG_WARNING, "Error occurred on framed config API connection - closing: %s", aError->description().c_str());
+    closeConnection();
+  }
+}
+
+
+void P44MsgpackApiConnection::sendResponse(ApiValuePtr aResult, ErrorPtr aError, VdcApiEncoding aEncoding)
+{
+  // create response in the encoding of the request
+  ApiValuePtr response;
+  if (aEncoding==vdcapi_encoding_json) {
+    response = ApiValuePtr(new JsonApiValue);
+  }
+  else {
+    response = newApiValue();
+  }
+  response->setType(apivalue_object);
+  if (!Error::isOK(aError)) {
+    // error, return error response
+    response->add("error", response->newInt64(aError->getErrorCode()));
+    response->add("errormessage", response->newString(aError->getErrorMessage()));
+    response->add("errordomain", response->newString(aError->getErrorDomain()));
+    VdcApiErrorPtr ve = boost::dynamic_pointer_cast<VdcApiError>(aError);
+    if (ve) {
+      response->add("errortype", response->newInt64(ve->getErrorType()));
+      response->add("userfacingmessage", response->newString(ve->getUserFacingMessage()));
+    }
+  }
+  else {
+    // no error, return result (null if none)
+    ApiValuePtr result = aResult;
+    bool sameEncoding = aEncoding==vdcapi_encoding_json ?
+      boost::dynamic_pointer_cast<JsonApiValue>(aResult)!=NULL :
+      boost::dynamic_pointer_cast<MsgpackApiValue>(aResult)!=NULL;
+    if (!sameEncoding) {
+      // no result, or created in another encoding: convert
+      result = response->newNull();
+      if (aResult) *result = *aResult;
+    }
+    response->add("result", result);
+  }
+  // append frame with 4-byte length header to transmit buffer
+  size_t hdrPos = transmitBuffer.size();
+  transmitBuffer.append(4, 0);
+  if (aEncoding==vdcapi_encoding_json) {
+    JsonApiValuePtr jr = boost::dynamic_pointer_cast<JsonApiValue>(response);
+    transmitBuffer.append(jr->jsonObject()->c_strValue());
+  }
+  else {
+    MsgpackApiValuePtr mr = boost::dynamic_pointer_cast<MsgpackApiValue>(response);
+    mr->appendMsgpack(transmitBuffer);
+  }
+  size_t msgSize = transmitBuffer.size()-hdrPos-4;
+  transmitBuffer[hdrPos] = (char)((msgSize>>24) & 0xFF);
+  transmitBuffer[hdrPos+1] = (char)((msgSize>>16) & 0xFF);
+  transmitBuffer[hdrPos+2] = (char)((msgSize>>8) & 0xFF);
+  transmitBuffer[hdrPos+3] = (char)(msgSize & 0xFF);
+  canSendData(ErrorPtr());
+}
+
+
+void P44MsgpackApiConnection::canSendData(ErrorPtr aError)
+{
+  size_t bytesToSend = transmitBuffer.size();
+  if (bytesToSend>0 && Error::isOK(aError)) {
+    size_t sentBytes = socketComm->transmitBytes(bytesToSend, (const uint8_t *)transmitBuffer.c_str(), aError);
+    if (Error::isOK(aError)) {
+      transmitBuffer.erase(0, sentBytes);
+      if (transmitBuffer.empty()) {
+        // all sent, disable transmit handler
+        socketComm->setTransmitHandler(NULL);
+        if (closeWhenSent) {
+          closeWhenSent = false;
+          closeConnection();
+        }
+      }
+      else {
+        // enable callback for ready-for-send
+        socketComm->setTransmitHandler(boost::bind(&P44MsgpackApiConnection::canSendData, this, _1));
+      }
+    }
+    else {
+      LOG(LOG_WARNING, "Error sending data on framed config API connection: %s", aError->description().c_str());
+    }
+  }
+}
+
+
+
+// MARK: ===== config API - P44MsgpackApiRequest
+
+
+P44MsgpackApiRequest::P44MsgpackApiRequest(P44MsgpackApiConnectionPtr aConnection, VdcApiEncoding aEncoding) :
+  msgpackConnection(aConnection),
+  encoding(aEncoding)
+{
+}
+
+
+ApiValuePtr P44MsgpackApiRequest::newApiValue()
+{
+  if (encoding==vdcapi_encoding_json) {
+    return ApiValuePtr(new JsonApiValue);
+  }
+  return msgpackConnection->newApiValue();
+}
+
+
+ErrorPtr P44MsgpackApiRequest::sendResult(ApiValuePtr aResult)
+{
+  LOG(LOG_DEBUG, "cfg <- vdcd (framed %c) result sent: result=%s", encoding, aResult ? aResult->description().c_str() : "<none>");
+  msgpackConnection->sendResponse(aResult, ErrorPtr(), encoding);
+  return ErrorPtr();
+}
+
+
+ErrorPtr P44MsgpackApiRequest::sendError(uint32_t aErrorCode, string aErrorMessage, ApiValuePtr aErrorData, VdcErrorType aErrorType, string aUserFacingMessage)
+{
+  ErrorPtr err;
+  LOG(LOG_DEBUG, "cfg <- vdcd (framed %c) error sent: error=%d (%s)", encoding, aErrorCode, aErrorMessage.c_str());
+  if (aErrorType!=0 || !aUserFacingMessage.empty()) {
+    err = VdcApiErrorPtr(new VdcApiError(aErrorCode, aErrorMessage, aErrorType, aUserFacingMessage));
+  }
+  else {
+    err = ErrorPtr(new Error(aErrorCode, aErrorMessage)); // re-pack into error object
+  }
+  msgpackConnection->sendResponse(ApiValuePtr(), err, encoding);
+  return ErrorPtr();
+}
+
+
 // MARK: ===== self test runner
 
 #if SELFTESTING_ENABLED
@@ -246,6 +467,9 @@ void P44VdcHost::initialize(StatusCB aCompletedCB, bool aFactoryReset)
   if (configApiServer) {
     configApiServer->startServer(boost::bind(&P44VdcHost::configApiConnectionHandler, this, _1), 3);
   }
+  if (msgpackConfigApiServer) {
+    msgpackConfigApiServer->startServer(boost::bind(&P44VdcHost::msgpackConfigApiConnectionHandler, this, _1), 3);
+  }
   // now init rest of vdc host
   inherited::initialize(aCompletedCB, aFactoryReset);
 }
@@ -263,6 +487,18 @@ void P44VdcHost::enableConfigApi(const char *aServiceOrPort, bool aNonLocalAllow
 
 
 
+void P44VdcHost::enableMsgpackConfigApi(const char *aServiceOrPort, bool aNonLocalAllowed)
+{
+  if (!msgpackConfigApiServer) {
+    // can be enabled only once
+    msgpackConfigApiServer = SocketCommPtr(new SocketComm(MainLoop::currentMainLoop()));
+    msgpackConfigApiServer->setConnectionParams(NULL, aServiceOrPort, SOCK_STREAM, AF_INET);
+    msgpackConfigApiServer->setAllowNonlocalConnections(aNonLocalAllowed);
+  }
+}
+
+
+
 SocketCommPtr P44VdcHost::configApiConnectionHandler(SocketCommPtr aServerSocketCommP)
 {
   JsonCommPtr conn = JsonCommPtr(new JsonComm(MainLoop::currentMainLoop()));
@@ -332,6 +568,58 @@ void P44VdcHost::configApiRequestHandler(JsonCommPtr aJsonComm, ErrorPtr aError,
 }
 
 
+SocketCommPtr P44VdcHost::msgpackConfigApiConnectionHandler(SocketCommPtr aServerSocketComm)
+{
+  P44MsgpackApiConnectionPtr conn = P44MsgpackApiConnectionPtr(new P44MsgpackApiConnection);
+  conn->setMessageHandler(boost::bind(&P44VdcHost::msgpackConfigApiRequestHandler, this, _1, _2, _3));
+  SocketCommPtr socketComm = conn->socketConnection();
+  socketComm->setClearHandlersAtClose(); // close must break retain cycles so this object won't cause a mem leak
+  socketComm->relatedObject = conn; // keep connection object alive as long as the socket is open
+  socketComm->setConnectionStatusHandler(boost::bind(&P44VdcHost::msgpackConfigApiConnectionStatusHandler, this, _1, _2));
+  return socketComm;
+}
+
+
+void P44VdcHost::msgpackConfigApiConnectionStatusHandler(SocketCommPtr aSocketComm, ErrorPtr aError)
+{
+  if (!Error::isOK(aError)) {
+    // connection closed, detach connection object
+    aSocketComm->relatedObject.reset();
+  }
+}
+
+
+void P44VdcHost::msgpackConfigApiRequestHandler(P44MsgpackApiConnectionPtr aConnection, ApiValuePtr aMessage, VdcApiEncoding aEncoding)
+{
+  ErrorPtr err;
+  // messages have the same structure as on the JSON config API
+  LOG(LOG_DEBUG, "cfg -> vdcd (framed %c) request received: %s", aEncoding, aMessage->description().c_str());
+  ApiValuePtr request = aMessage->get("data");
+  if (!request) {
+    request = aMessage->get("uri_params");
+  }
+  if (!request) {
+    err = Error::err<P44VdcError>(415, "empty request");
+  }
+  else {
+    string apiselector;
+    ApiValuePtr uri = aMessage->get("uri");
+    if (uri) apiselector = uri->stringValue();
+    if (apiselector=="vdc") {
+      err = processVdcApiRequest(P44MsgpackApiRequestPtr(new P44MsgpackApiRequest(aConnection, aEncoding)), request);
+    }
+    else {
+      // Note: p44 specific requests are bound to the JSON connection, and not needed at high rates
+      err = Error::err<P44VdcError>(400, "invalid URI, only 'vdc' API available on framed config API");
+    }
+  }
+  // if error or explicit OK, send response now. Otherwise, request processing will create and send the response
+  if (err) {
+    aConnection->sendResponse(ApiValuePtr(), err, aEncoding);
+  }
+}
+
+
 void P44VdcHost::sendCfgApiResponse(JsonCommPtr aJsonComm, JsonObjectPtr aResult, ErrorPtr aError)
 {
   // create response
@@ -358,19 +646,28 @@ void P44VdcHost::sendCfgApiResponse(JsonCommPtr aJsonComm, JsonObjectPtr aResult
 
 // access to vdc API methods and notifications via web requests
 ErrorPtr P44VdcHost::processVdcRequest(JsonCommPtr aJsonComm, JsonObjectPtr aRequest)
+{
+  // Note: the "method" or "notification" param will also be in the params, but should not cause any problem
+  ApiValuePtr params = JsonApiValue::newValueFromJson(aRequest);
+  P44JsonApiRequestPtr request = P44JsonApiRequestPtr(new P44JsonApiRequest(aJsonComm));
+  return processVdcApiRequest(request, params);
+}
+
+
+ErrorPtr P44VdcHost::processVdcApiRequest(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
 {
   ErrorPtr err;
   string cmd;
   bool isMethod = false;
   // get method/notification and params
-  JsonObjectPtr m = aRequest->get("method");
+  ApiValuePtr m = aParams->get("method");
   if (m) {
     // is a method call, expects answer
     isMethod = true;
   }
   else {
     // not method, may be notification
-    m = aRequest->get("notification");
+    m = aParams->get("notification");
   }
   if (!m) {
     err = Error::err<P44VdcError>(400, "invalid request, must specify 'method' or 'notification'");
@@ -378,41 +675,34 @@ ErrorPtr P44VdcHost::processVdcRequest(JsonCommPtr aJsonComm, JsonObjectPtr aReq
   else {
     // get method/notification name
     cmd = m->stringValue();
-    // get params
-    // Note: the "method" or "notification" param will also be in the params, but should not cause any problem
-    ApiValuePtr params = JsonApiValue::newValueFromJson(aRequest);
-    P44JsonApiRequestPtr request = P44JsonApiRequestPtr(new P44JsonApiRequest(aJsonComm));
-    if (Error::isOK(err)) {
-      // operation method
-      if (isMethod) {
-        // create request
-        // check for old-style name/index and generate basic query (1 or 2 levels)
-        ApiValuePtr query = params->newObject();
-        ApiValuePtr name = params->get("name");
-        if (name) {
-          ApiValuePtr index = params->get("index");
-          ApiValuePtr subquery = params->newNull();
-          if (index) {
-            // subquery
-            subquery->setType(apivalue_object);
-            subquery->add(index->stringValue(), subquery->newNull());
-          }
-          string nm = trimWhiteSpace(name->stringValue()); // to allow a single space for deep recursing wildcard
-          query->add(nm, subquery);
-          params->add("query", query);
+    // operation method
+    if (isMethod) {
+      // check for old-style name/index and generate basic query (1 or 2 levels)
+      ApiValuePtr query = aParams->newObject();
+      ApiValuePtr name = aParams->get("name");
+      if (name) {
+        ApiValuePtr index = aParams->get("index");
+        ApiValuePtr subquery = aParams->newNull();
+        if (index) {
+          // subquery
+          subquery->setType(apivalue_object);
+          subquery->add(index->stringValue(), subquery->newNull());
         }
-        // have method handled
-        err = handleMethodForParams(request, cmd, params);
-        // Note: if method returns NULL, it has sent or will send results itself.
-        //   Otherwise, even if Error is ErrorOK we must send a generic response
+        string nm = trimWhiteSpace(name->stringValue()); // to allow a single space for deep recursing wildcard
+        query->add(nm, subquery);
+        aParams->add("query", query);
       }
-      else {
-        // handle notification
-        err = handleNotificationForParams(request->connection(), cmd, params);
-        // Notifications are always immediately confirmed, so make sure there's an explicit ErrorOK
-        if (!err) {
-          err = ErrorPtr(new Error(Error::OK));
-        }
+      // have method handled
+      err = handleMethodForParams(aRequest, cmd, aParams);
+      // Note: if method returns NULL, it has sent or will send results itself.
+      //   Otherwise, even if Error is ErrorOK we must send a generic response
+    }
+    else {
+      // handle notification
+      err = handleNotificationForParams(aRequest->connection(), cmd, aParams);
+      // Notifications are always immediately confirmed, so make sure there's an explicit ErrorOK
+      if (!err) {
+        err = ErrorPtr(new Error(Error::OK));
       }
     }
   }
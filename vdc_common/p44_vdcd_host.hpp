@@ -25,6 +25,7 @@
 #include "vdchost.hpp"
 
 #include "jsoncomm.hpp"
+#include "msgpackvdcapi.hpp"
 
 
 using namespace std;
@@ -116,6 +117,113 @@ namespace p44 {
 
 
 
+  class P44MsgpackApiConnection;
+  typedef boost::intrusive_ptr<P44MsgpackApiConnection> P44MsgpackApiConnectionPtr;
+
+  /// callback for delivering a received framed config API message
+  typedef boost::function<void (P44MsgpackApiConnectionPtr aConnection, ApiValuePtr aMessage, VdcApiEncoding aEncoding)> MsgpackApiMessageCB;
+
+  /// framed config API connection for tools, MessagePack or JSON encoded
+  /// @note messages have the same structure as on the JSON config API, but each message is sent as a 4-byte
+  ///   big endian length header followed by the encoded message. Only the "vdc" API is available.
+  /// @note the encoding is negotiated per message by its content: messages starting with '{' are JSON text,
+  ///   all others are MessagePack (where a request map never starts with that byte). Responses are sent in
+  ///   the encoding of the request.
+  class P44MsgpackApiConnection : public VdcApiConnection
+  {
+    typedef VdcApiConnection inherited;
+
+    SocketCommPtr socketComm;
+    MsgpackApiMessageCB messageHandler;
+
+    string receivedData; ///< data received but not yet processed
+    string transmitBuffer; ///< data not yet sent
+    bool closeWhenSent;
+
+  public:
+
+    P44MsgpackApiConnection();
+
+    /// install callback for received messages
+    /// @param aMessageHandler will be called when a complete message has been received
+    void setMessageHandler(MsgpackApiMessageCB aMessageHandler);
+
+    /// The underlying socket connection
+    /// @return socket connection
+    virtual SocketCommPtr socketConnection() P44_OVERRIDE { return socketComm; };
+
+    /// Cannot send a API request
+    /// @return empty or Error object in case of error
+    virtual ErrorPtr sendRequest(const string &aMethod, ApiValuePtr aParams, VdcApiResponseCB aResponseHandler = VdcApiResponseCB()) P44_OVERRIDE
+      { return TextError::err("cant send request to config API"); };
+
+    /// request closing connection after last message has been sent
+    virtual void closeAfterSend() P44_OVERRIDE;
+
+    /// get a new API value suitable for this connection
+    /// @return new API value of suitable internal implementation to be used on this API connection
+    virtual ApiValuePtr newApiValue() P44_OVERRIDE;
+
+    /// send a config API response
+    /// @param aResult the result, can be NULL
+    /// @param aError if not OK, an error response is sent instead of the result
+    /// @param aEncoding the encoding to send the response in (that of the request)
+    void sendResponse(ApiValuePtr aResult, ErrorPtr aError, VdcApiEncoding aEncoding);
+
+  private:
+
+    void gotData(ErrorPtr aError);
+    void canSendData(ErrorPtr aError);
+
+  };
+
+
+
+  /// plan44 specific framed config API request
+  class P44MsgpackApiRequest : public VdcApiRequest
+  {
+    typedef VdcApiRequest inherited;
+    P44MsgpackApiConnectionPtr msgpackConnection;
+    VdcApiEncoding encoding; ///< encoding of the request, response will use the same
+
+  public:
+
+    /// constructor
+    /// @param aConnection the connection the request was received on
+    /// @param aEncoding the encoding of the request
+    P44MsgpackApiRequest(P44MsgpackApiConnectionPtr aConnection, VdcApiEncoding aEncoding);
+
+    /// get a new API value suitable for answering this request
+    /// @return new API value of the request's encoding
+    virtual ApiValuePtr newApiValue() P44_OVERRIDE;
+
+    /// return the request ID as a string
+    /// @return request ID as string
+    virtual string requestId()  P44_OVERRIDE { return ""; }
+
+    /// get the API connection this request originates from
+    /// @return API connection
+    virtual VdcApiConnectionPtr connection() P44_OVERRIDE { return msgpackConnection; };
+
+    /// send a vDC API result (answer for successful method call)
+    /// @param aResult the result as a ApiValue. Can be NULL for procedure calls without return value
+    /// @result empty or Error object in case of error sending result response
+    virtual ErrorPtr sendResult(ApiValuePtr aResult) P44_OVERRIDE;
+
+    /// send a vDC API error (answer for unsuccesful method call)
+    /// @param aErrorCode the error code
+    /// @param aErrorMessage the error message or NULL to generate a standard text
+    /// @param aErrorData the optional "data" member for the vDC API error object (in JSON only)
+    /// @param aErrorType the optional "errorType"
+    /// @param aUserFacingMessage the optional user facing message
+    /// @result empty or Error object in case of error sending error response
+    virtual ErrorPtr sendError(uint32_t aErrorCode, string aErrorMessage = "", ApiValuePtr aErrorData = ApiValuePtr(), uint8_t aErrorType = 0, string aUserFacingMessage = "") P44_OVERRIDE;
+
+  };
+  typedef boost::intrusive_ptr<P44MsgpackApiRequest> P44MsgpackApiRequestPtr;
+
+
+
   /// plan44 specific implementation of a vdc host, with a separate API used by WebUI components.
   class P44VdcHost : public VdcHost
   {
@@ -126,6 +234,7 @@ namespace p44 {
     JsonCommPtr learnIdentifyRequest;
 
     SocketCommPtr configApiServer; ///< JSON API for web interface
+    SocketCommPtr msgpackConfigApiServer; ///< framed variant of the config API for tools, MessagePack or JSON
 
   public:
 
@@ -139,6 +248,14 @@ namespace p44 {
     /// @note API server will be started only at initialize()
     void enableConfigApi(const char *aServiceOrPort, bool aNonLocalAllowed);
 
+    /// enable framed config API
+    /// @param aServiceOrPort port number or service string
+    /// @param aNonLocalAllowed if set, non-local clients are allowed to connect to the config API
+    /// @note API server will be started only at initialize()
+    /// @note this is a framed variant of the "vdc" part of the config API for tools that need to access
+    ///   properties at high rates. Clients can use MessagePack or JSON, see P44MsgpackApiConnection
+    void enableMsgpackConfigApi(const char *aServiceOrPort, bool aNonLocalAllowed);
+
 		/// perform self testing
     /// @param aCompletedCB will be called when the entire self test is done
     /// @param aButton button for interacting with tests
@@ -162,7 +279,12 @@ namespace p44 {
     void identifyHandler(JsonCommPtr aJsonComm, DevicePtr aDevice);
     void endIdentify();
 
+    SocketCommPtr msgpackConfigApiConnectionHandler(SocketCommPtr aServerSocketComm);
+    void msgpackConfigApiConnectionStatusHandler(SocketCommPtr aSocketComm, ErrorPtr aError);
+    void msgpackConfigApiRequestHandler(P44MsgpackApiConnectionPtr aConnection, ApiValuePtr aMessage, VdcApiEncoding aEncoding);
+
     ErrorPtr processVdcRequest(JsonCommPtr aJsonComm, JsonObjectPtr aRequest);
+    ErrorPtr processVdcApiRequest(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
     ErrorPtr processP44Request(JsonCommPtr aJsonComm, JsonObjectPtr aRequest);
 
     static void sendCfgApiResponse(JsonCommPtr aJsonComm, JsonObjectPtr aResult, ErrorPtr aError);
@@ -27,6 +27,7 @@
 #define FOCUSLOGLEVEL 0
 
 #include "pbufvdcapi.hpp"
+#include "recyclingpool.hpp"
 
 
 using namespace p44;
@@ -39,357 +40,24 @@ void protobufMessagePrint(FILE *aOutFile, const ProtobufCMessage *aMessageP, int
 
 // MARK: ===== PbufApiValue
 
-PbufApiValue::PbufApiValue() :
-  allocatedType(apivalue_null)
-{
-}
-
-
-PbufApiValue::~PbufApiValue()
-{
-  clear();
-}
-
-
-ApiValuePtr PbufApiValue::newValue(ApiValueType aObjectType)
-{
-  ApiValuePtr newVal = ApiValuePtr(new PbufApiValue);
-  newVal->setType(aObjectType);
-  return newVal;
-}
-
-
-void PbufApiValue::operator=(ApiValue &aApiValue)
-{
-  setNull(); // forget old content
-  PbufApiValue *pavP = dynamic_cast<PbufApiValue *>(&aApiValue);
-  if (pavP) {
-    setType(aApiValue.getType());
-    allocate();
-    switch (allocatedType) {
-      case apivalue_string:
-      case apivalue_binary:
-        objectValue.stringP = new string(*(pavP->objectValue.stringP));
-        break;
-      case apivalue_object:
-        objectValue.objectMapP = new ApiValueFieldMap(*(pavP->objectValue.objectMapP));
-        break;
-      case apivalue_array:
-        objectValue.arrayVectorP = new ApiValueArray(*(pavP->objectValue.arrayVectorP));
-        break;
-      default:
-        objectValue = pavP->objectValue; // copy union containing a scalar value
-        break;
-    }
-  }
-  else
-    inherited::operator=(aApiValue); // cross-type assignment, needs more expensive generic assignment
-}
-
-
-
-
-void PbufApiValue::clear()
-{
-  // forget allocated type
-  if (allocatedType!=apivalue_null) {
-    switch (allocatedType) {
-      case apivalue_string:
-      case apivalue_binary:
-        if (objectValue.stringP) delete objectValue.stringP;
-        break;
-      case apivalue_object:
-        if (objectValue.objectMapP) delete objectValue.objectMapP;
-        break;
-      case apivalue_array:
-        if (objectValue.arrayVectorP) delete objectValue.arrayVectorP;
-        break;
-      default:
-        break;
-    }
-    // zero out union
-    memset(&objectValue, 0, sizeof(objectValue));
-    // is now a NULL object
-    allocatedType = apivalue_null;
-  }
-}
-
-
-void PbufApiValue::allocate()
-{
-  if (allocatedType!=getType() && allocatedType==apivalue_null) {
-    allocatedType = getType();
-    switch (allocatedType) {
-      case apivalue_string:
-      case apivalue_binary:
-        objectValue.stringP = new string;
-        break;
-      case apivalue_object:
-        objectValue.objectMapP = new ApiValueFieldMap;
-        break;
-      case apivalue_array:
-        objectValue.arrayVectorP = new ApiValueArray;
-        break;
-      default:
-        break;
-    }
-  }
-}
-
-
-bool PbufApiValue::allocateIf(ApiValueType aIsType)
-{
-  if (getType()==aIsType) {
-    allocate();
-    return true;
-  }
-  return false;
-}
-
-
-
-void PbufApiValue::add(const string &aKey, ApiValuePtr aObj)
-{
-  PbufApiValuePtr val = boost::dynamic_pointer_cast<PbufApiValue>(aObj);
-  if (val && allocateIf(apivalue_object)) {
-    (*(objectValue.objectMapP))[aKey] = val;
-  }
-}
-
-
-ApiValuePtr PbufApiValue::get(const string &aKey)
-{
-  if (allocatedType==apivalue_object) {
-    ApiValueFieldMap::iterator pos = objectValue.objectMapP->find(aKey);
-    if (pos!=objectValue.objectMapP->end())
-      return pos->second;
-  }
-  return ApiValuePtr();
-}
-
-
-void PbufApiValue::del(const string &aKey)
-{
-  if (allocatedType==apivalue_object) {
-    objectValue.objectMapP->erase(aKey);
-  }
-}
-
-
-int PbufApiValue::arrayLength()
-{
-  if (allocatedType==apivalue_array) {
-    return (int)objectValue.arrayVectorP->size();
-  }
-  return 0;
-}
-
-
-void PbufApiValue::arrayAppend(ApiValuePtr aObj)
-{
-  PbufApiValuePtr val = boost::dynamic_pointer_cast<PbufApiValue>(aObj);
-  if (val && allocateIf(apivalue_array)) {
-    objectValue.arrayVectorP->push_back(val);
-  }
-}
-
-
-ApiValuePtr PbufApiValue::arrayGet(int aAtIndex)
-{
-  if (allocatedType==apivalue_array) {
-    if (aAtIndex<objectValue.arrayVectorP->size()) {
-      return objectValue.arrayVectorP->at(aAtIndex);
-    }
-  }
-  return ApiValuePtr();
-}
-
-
-void PbufApiValue::arrayPut(int aAtIndex, ApiValuePtr aObj)
-{
-  PbufApiValuePtr val = boost::dynamic_pointer_cast<PbufApiValue>(aObj);
-  if (val && allocateIf(apivalue_array)) {
-    if (aAtIndex<objectValue.arrayVectorP->size()) {
-      ApiValueArray::iterator i = objectValue.arrayVectorP->begin() + aAtIndex;
-      objectValue.arrayVectorP->erase(i);
-      objectValue.arrayVectorP->insert(i, val);
-    }
-  }
-}
-
+// max number of released PbufApiValue nodes kept for re-use
+#ifndef PBUF_APIVALUE_POOL_MAX
+  #define PBUF_APIVALUE_POOL_MAX 8192
+#endif
 
 
-size_t PbufApiValue::numObjectFields()
-{
-  if (allocatedType==apivalue_object) {
-    return objectValue.objectMapP->size();
-  }
-  return 0;
-}
-
-
-bool PbufApiValue::resetKeyIteration()
-{
-  if (allocatedType==apivalue_object) {
-    keyIterator = objectValue.objectMapP->begin();
-  }
-  return false; // cannot be iterated
-}
-
-
-bool PbufApiValue::nextKeyValue(string &aKey, ApiValuePtr &aValue)
-{
-  if (allocatedType==apivalue_object) {
-    if (keyIterator!=objectValue.objectMapP->end()) {
-      aKey = keyIterator->first;
-      aValue = keyIterator->second;
-      keyIterator++;
-      return true;
-    }
-  }
-  return false;
-}
-
-
-
-uint64_t PbufApiValue::uint64Value()
-{
-  if (allocatedType==apivalue_uint64) {
-    return objectValue.uint64Val;
-  }
-  else if (allocatedType==apivalue_int64 && objectValue.int64Val>=0) {
-    return objectValue.int64Val; // only return positive values
-  }
-  else if (allocatedType==apivalue_double) {
-    // we can get a double as uint (for JSON compatibility needed in upper dSS levels (VDCE, August 2016)
-    return objectValue.doubleVal;
-  }
-  return 0;
-}
-
+static RecyclingPool<sizeof(PbufApiValue), PBUF_APIVALUE_POOL_MAX> pbufApiValuePool;
 
 
-int64_t PbufApiValue::int64Value()
+void *PbufApiValue::operator new(size_t aSize)
 {
-  if (allocatedType==apivalue_int64) {
-    return objectValue.int64Val;
-  }
-  else if (allocatedType==apivalue_uint64) {
-    return objectValue.uint64Val & 0x7FFFFFFFFFFFFFFFll; // prevent returning sign
-  }
-  else if (allocatedType==apivalue_double) {
-    // we can get a double as int (for JSON compatibility needed in upper dSS levels (VDCE, August 2016)
-    return objectValue.doubleVal;
-  }
-  return 0;
+  return pbufApiValuePool.allocate(aSize);
 }
 
 
-double PbufApiValue::doubleValue()
+void PbufApiValue::operator delete(void *aPtr, size_t aSize)
 {
-  if (allocatedType==apivalue_double) {
-    return objectValue.doubleVal;
-  }
-  else {
-    return int64Value(); // int (or int derived from uint) can also be read as double
-  }
-}
-
-
-bool PbufApiValue::boolValue()
-{
-  if (allocatedType==apivalue_bool) {
-    return objectValue.boolVal;
-  }
-  else {
-    return int64Value()!=0; // non-zero int is also true
-  }
-}
-
-
-string PbufApiValue::binaryValue()
-{
-  if (allocatedType==apivalue_binary) {
-    return *(objectValue.stringP);
-  }
-  else if (allocatedType==apivalue_string) {
-    return hexToBinaryString(objectValue.stringP->c_str());
-  }
-  else {
-    return ""; // not binary
-  }
-}
-
-
-string PbufApiValue::stringValue()
-{
-  if (allocatedType==apivalue_string) {
-    return *(objectValue.stringP);
-  }
-  else if (allocatedType==apivalue_binary) {
-    // render as hex string
-    return binaryToHexString(*(objectValue.stringP));
-  }
-  // let base class render the contents as string
-  return inherited::stringValue();
-}
-
-
-void PbufApiValue::setUint64Value(uint64_t aUint64)
-{
-  if (allocateIf(apivalue_uint64)) {
-    objectValue.uint64Val = aUint64;
-  }
-}
-
-
-void PbufApiValue::setInt64Value(int64_t aInt64)
-{
-  if (allocateIf(apivalue_int64)) {
-    objectValue.int64Val = aInt64;
-  }
-}
-
-
-void PbufApiValue::setDoubleValue(double aDouble)
-{
-  if (allocateIf(apivalue_double)) {
-    objectValue.doubleVal = aDouble;
-  }
-}
-
-
-void PbufApiValue::setBoolValue(bool aBool)
-{
-  if (allocateIf(apivalue_bool)) {
-    objectValue.boolVal = aBool;
-  }
-}
-
-
-void PbufApiValue::setBinaryValue(const string &aBinary)
-{
-  if (allocateIf(apivalue_binary)) {
-    objectValue.stringP->assign(aBinary);
-  }
-}
-
-
-bool PbufApiValue::setStringValue(const string &aString)
-{
-  if (allocateIf(apivalue_string)) {
-    objectValue.stringP->assign(aString);
-    return true;
-  }
-  else if (allocateIf(apivalue_binary)) {
-    // parse string as hex
-    objectValue.stringP->assign(hexToBinaryString(aString.c_str()));
-    return true;
-  }
-  else {
-    // let base class try to convert to type of object
-    return inherited::setStringValue(aString);
-  }
+  pbufApiValuePool.release(aPtr, aSize);
 }
 
 
@@ -478,12 +146,8 @@ void PbufApiValue::putValueIntoMessageField(const ProtobufCFieldDescriptor &aFie
         elems = new Vdcapi__PropertyElement *[numElems];
         Vdcapi__PropertyElement **elemP = elems;
         // fill in fields
-        resetKeyIteration();
-        string key;
-        ApiValuePtr val;
-        while (nextKeyValue(key, val)) {
-          PbufApiValuePtr pval = boost::dynamic_pointer_cast<PbufApiValue>(val);
-          pval->storeKeyValIntoPropertyElementField(key, *(elemP++));
+        for (FieldList::iterator pos = objectValue.objectFieldsP->begin(); pos!=objectValue.objectFieldsP->end(); ++pos) {
+          pos->second->storeKeyValIntoPropertyElementField(pos->first, *(elemP++));
         }
       }
       *((Vdcapi__PropertyElement ***)fieldBaseP) = elems;
@@ -972,6 +636,7 @@ VdcPbufApiRequest::VdcPbufApiRequest(VdcPbufApiConnectionPtr aConnection, uint32
   pbufConnection = aConnection;
   reqId = aRequestId;
   responseType = VDCAPI__TYPE__GENERIC_RESPONSE;
+  resultStreamed = false;
 }
 
 
@@ -982,10 +647,61 @@ VdcApiConnectionPtr VdcPbufApiRequest::connection()
 
 
 
+static void appendVarint(string &aBuffer, uint64_t aValue)
+{
+  do {
+    uint8_t b = aValue & 0x7F;
+    aValue >>= 7;
+    if (aValue) b |= 0x80;
+    aBuffer.push_back((char)b);
+  } while (aValue);
+}
+
+
+ErrorPtr VdcPbufApiRequest::sendResultPart(ApiValuePtr aResultPart)
+{
+  PbufApiValuePtr part = boost::dynamic_pointer_cast<PbufApiValue>(aResultPart);
+  if (!part || !canStreamResult()) return Error::err<VdcApiError>(500, "result cannot be sent in parts");
+  // Note: the packed elements of a repeated field just follow each other, so the "properties" of all parts
+  //   packed one after the other are the packed "properties" of the complete result
+  Vdcapi__VdcResponseGetProperty *resp = new Vdcapi__VdcResponseGetProperty;
+  vdcapi__vdc__response_get_property__init(resp);
+  part->putValueIntoMessageField(resp->base.descriptor->fields[0], resp->base);
+  size_t packedSize = vdcapi__vdc__response_get_property__get_packed_size(resp);
+  size_t start = streamedResult.size();
+  streamedResult.resize(start+packedSize);
+  if (packedSize>0) vdcapi__vdc__response_get_property__pack(resp, (uint8_t *)&streamedResult[start]);
+  protobuf_c_message_free_unpacked(&resp->base, NULL);
+  resultStreamed = true;
+  return ErrorPtr();
+}
+
+
 ErrorPtr VdcPbufApiRequest::sendResult(ApiValuePtr aResult)
 {
   ErrorPtr err;
-  if (!aResult || aResult->isNull()) {
+  if (resultStreamed) {
+    // result was sent in parts, add the final one and send all of them
+    if (aResult && aResult->isType(apivalue_object)) sendResultPart(aResult);
+    Vdcapi__Message msg = VDCAPI__MESSAGE__INIT;
+    msg.has_message_id = true; // is response to a previous method call message
+    msg.message_id = reqId; // use same message id as in method call
+    msg.type = responseType;
+    string hdr;
+    hdr.resize(vdcapi__message__get_packed_size(&msg));
+    vdcapi__message__pack(&msg, (uint8_t *)&hdr[0]);
+    // the packed parts form the vdc_response_get_property submessage, which is a length delimited field
+    const ProtobufCFieldDescriptor *fd = protobuf_c_message_descriptor_get_field_by_name(&vdcapi__message__descriptor, "vdc_response_get_property");
+    appendVarint(hdr, ((uint64_t)fd->id<<3) | 2);
+    appendVarint(hdr, streamedResult.size());
+    streamedResult.insert(0, hdr);
+    err = pbufConnection->sendEncoded(streamedResult);
+    LOG(LOG_INFO, "vdSM <- vDC (pbuf) result sent: requestid='%d', result streamed in parts, %zu bytes", reqId, streamedResult.size());
+    streamedResult.clear();
+    resultStreamed = false;
+    answered();
+  }
+  else if (!aResult || aResult->isNull()) {
     // empty result is like sending no error
     err = sendError(0);
     LOG(LOG_INFO, "vdSM <- vDC (pbuf) result sent: requestid='%d', result=NULL", reqId);
@@ -1007,6 +723,8 @@ ErrorPtr VdcPbufApiRequest::sendResult(ApiValuePtr aResult)
         subMessageP = &(msg.vdc_response_hello->base);
         if (result) {
           result->putObjectFieldIntoMessage(*subMessageP, "dSUID");
+          result->putObjectFieldIntoMessage(*subMessageP, "x_p44_fragmentation");
+          result->putObjectFieldIntoMessage(*subMessageP, "x_p44_observer");
         }
         break;
       case VDCAPI__TYPE__VDC_RESPONSE_GET_PROPERTY:
@@ -1029,6 +747,7 @@ ErrorPtr VdcPbufApiRequest::sendResult(ApiValuePtr aResult)
     protobuf_c_message_free_unpacked(subMessageP, NULL);
     // log
     LOG(LOG_INFO, "vdSM <- vDC (pbuf) result sent: requestid='%d', result=%s", reqId, aResult ? aResult->description().c_str() : "<none>");
+    answered();
   }
   return err;
 }
@@ -1037,6 +756,9 @@ ErrorPtr VdcPbufApiRequest::sendResult(ApiValuePtr aResult)
 ErrorPtr VdcPbufApiRequest::sendError(uint32_t aErrorCode, string aErrorMessage, ApiValuePtr aErrorData, VdcErrorType aErrorType, string aUserFacingMessage)
 {
   ErrorPtr err;
+  // parts of a result sent so far are obsolete
+  streamedResult.clear();
+  resultStreamed = false;
   // create a message
   Vdcapi__Message msg = VDCAPI__MESSAGE__INIT;
   Vdcapi__GenericResponse resp = VDCAPI__GENERIC_RESPONSE__INIT;
@@ -1054,6 +776,7 @@ ErrorPtr VdcPbufApiRequest::sendError(uint32_t aErrorCode, string aErrorMessage,
   if (aErrorCode!=Error::OK) {
     LOG(LOG_INFO, "vdSM <- vDC (pbuf) error sent: requestid='%d', error=%d (%s) - type=%d (%s)", reqId, aErrorCode, aErrorMessage.c_str(), aErrorType, aUserFacingMessage.c_str());
   }
+  answered();
   // done
   return err;
 }
@@ -1063,19 +786,81 @@ ErrorPtr VdcPbufApiRequest::sendError(uint32_t aErrorCode, string aErrorMessage,
 // MARK: ===== VdcPbufApiConnection
 
 
+// max message size accepted - everything bigger must be an error
+#define MAX_DATA_SIZE 16384
+
+// p44 fragmentation extension (negotiated in hello via x_p44_fragmentation):
+// messages larger than MAX_DATA_SIZE are split into frames of max MAX_DATA_SIZE bytes. All but
+// the last frame have FRAGMENT_CONTINUES set in the 2-byte length header.
+#define FRAGMENT_CONTINUES 0x8000
+
+// max size of a reassembled fragmented message
+#ifndef MAX_FRAGMENTED_MESSAGE_SIZE
+  #define MAX_FRAGMENTED_MESSAGE_SIZE (1024*1024)
+#endif
+
+// size of the receive buffer
+// Note: must be able to hold at least one maximum size message plus its 2-byte header.
+//   Making it larger reduces the number of times a partially received message needs to be moved
+//   to the beginning of the buffer.
+#ifndef RECEIVE_BUFFER_SIZE
+  #define RECEIVE_BUFFER_SIZE (2*(MAX_DATA_SIZE+2))
+#endif
+#if RECEIVE_BUFFER_SIZE<MAX_DATA_SIZE+2
+  #error "RECEIVE_BUFFER_SIZE must be at least MAX_DATA_SIZE+2"
+#endif
+
+
+// default time outgoing messages may wait to be coalesced with other messages into a single transmit call
+#ifndef DEFAULT_TRANSMIT_FLUSH_DELAY
+  #define DEFAULT_TRANSMIT_FLUSH_DELAY 0 // just until end of current mainloop cycle
+#endif
+
+// number of pending bytes that causes an immediate flush, regardless of flush delay
+#ifndef TRANSMIT_FLUSH_THRESHOLD
+  #define TRANSMIT_FLUSH_THRESHOLD (4*(MAX_DATA_SIZE+2))
+#endif
+
+// number of bytes queued while the socket is congested above which pushNotifications for the same
+// device and properties replace each other instead of being queued all
+#ifndef TRANSMIT_HIGH_WATERMARK
+  #define TRANSMIT_HIGH_WATERMARK (64*1024)
+#endif
+
+// max number of bytes queued while the socket is congested. Pushes are dropped (oldest first) to make room
+// for other messages, when there are no more pushes to drop, sending fails.
+#ifndef TRANSMIT_MAX_QUEUED
+  #define TRANSMIT_MAX_QUEUED (512*1024)
+#endif
+
+
 VdcPbufApiConnection::VdcPbufApiConnection() :
   closeWhenSent(false),
   expectedMsgBytes(0),
+  receiveStart(0),
+  receiveEnd(0),
+  fragmentation(false),
+  fragmentContinues(false),
+  transmitStart(0),
+  waitingForTransmit(false),
+  queuedBytes(0),
+  flushTicket(0),
+  flushDelay(DEFAULT_TRANSMIT_FLUSH_DELAY),
   requestIdCounter(0)
 {
+  receiveBuffer = new uint8_t[RECEIVE_BUFFER_SIZE];
+  statisticsReset();
   socketComm = SocketCommPtr(new SocketComm(MainLoop::currentMainLoop()));
   // install data handler
   socketComm->setReceiveHandler(boost::bind(&VdcPbufApiConnection::gotData, this, _1));
 }
 
 
-// max message size accepted - everything bigger must be an error
-#define MAX_DATA_SIZE 16384
+VdcPbufApiConnection::~VdcPbufApiConnection()
+{
+  MainLoop::currentMainLoop().cancelExecutionTicket(flushTicket);
+  delete[] receiveBuffer; receiveBuffer = NULL;
+}
 
 
 void VdcPbufApiConnection::gotData(ErrorPtr aError)
@@ -1085,54 +870,86 @@ void VdcPbufApiConnection::gotData(ErrorPtr aError)
     // no error
     size_t dataSz = socketComm->numBytesReady();
     DBGFOCUSLOG("gotData: numBytesReady()=%d", dataSz);
-    // read data we've got so far
-    if (dataSz>0) {
-      // temporary buffer
-      uint8_t *buf = new uint8_t[dataSz];
-      size_t receivedBytes = socketComm->receiveBytes(dataSz, buf, aError);
-      DBGFOCUSLOG("gotData: receiveBytes(%d)=%d", dataSz, receivedBytes);
-      DBGFOCUSLOG("gotData: before appending: receivedMessage.size()=%d", receivedMessage.size());
-      if (Error::isOK(aError)) {
-        // append to receive buffer
-        receivedMessage.append((const char *)buf, receivedBytes);
-        DBGFOCUSLOG("gotData: after appending: receivedMessage.size()=%d", receivedMessage.size());
-        // single message extraction
-        while(true) {
-          DBGFOCUSLOG("gotData: processing loop beginning, expectedMsgBytes=%d", expectedMsgBytes);
-          if(expectedMsgBytes==0 && receivedMessage.size()>=2) {
-            // got 2-byte length header, decode it
-            const uint8_t *sz = (const uint8_t *)receivedMessage.c_str();
-            expectedMsgBytes =
-              (sz[0]<<8) +
-              sz[1];
-            receivedMessage.erase(0,2);
-            FOCUSLOG("gotData: parsed new header, now expectedMsgBytes=%d", expectedMsgBytes);
-            DBGFOCUSLOG("gotData: after removing header: receivedMessage.size()=%d", receivedMessage.size());
-            if (expectedMsgBytes>MAX_DATA_SIZE) {
-              aError = Error::err<VdcApiError>(413, "message exceeds maximum length of 16kB");
+    // read data we've got so far, directly into the receive buffer
+    while (dataSz>0 && Error::isOK(aError)) {
+      size_t pendingBytes = receiveEnd-receiveStart;
+      if (pendingBytes==0) {
+        // nothing pending, restart at beginning of buffer (no copying needed)
+        receiveStart = 0;
+        receiveEnd = 0;
+      }
+      else if (receiveStart>0) {
+        // check if the message currently being received will fit into the remaining space
+        size_t msgBytes = expectedMsgBytes ? expectedMsgBytes : 2; // message or header
+        if (receiveStart+msgBytes>RECEIVE_BUFFER_SIZE) {
+          // no: move the incomplete part to the beginning of the buffer
+          DBGFOCUSLOG("gotData: moving %d incomplete message bytes to beginning of buffer", pendingBytes);
+          memmove(receiveBuffer, receiveBuffer+receiveStart, pendingBytes);
+          receiveStart = 0;
+          receiveEnd = pendingBytes;
+        }
+      }
+      size_t bytesToRead = RECEIVE_BUFFER_SIZE-receiveEnd;
+      if (bytesToRead>dataSz) bytesToRead = dataSz;
+      size_t receivedBytes = socketComm->receiveBytes(bytesToRead, receiveBuffer+receiveEnd, aError);
+      DBGFOCUSLOG("gotData: receiveBytes(%d)=%d", bytesToRead, receivedBytes);
+      if (!Error::isOK(aError) || receivedBytes==0) break;
+      receiveEnd += receivedBytes;
+      dataSz = receivedBytes<dataSz ? dataSz-receivedBytes : 0;
+      DBGFOCUSLOG("gotData: after receiving: %d bytes pending in buffer", receiveEnd-receiveStart);
+      // single message extraction
+      while(true) {
+        DBGFOCUSLOG("gotData: processing loop beginning, expectedMsgBytes=%d", expectedMsgBytes);
+        if(expectedMsgBytes==0 && receiveEnd-receiveStart>=2) {
+          // got 2-byte length header, decode it
+          const uint8_t *sz = receiveBuffer+receiveStart;
+          expectedMsgBytes =
+            (sz[0]<<8) +
+            sz[1];
+          receiveStart += 2;
+          fragmentContinues = false;
+          if (fragmentation && (expectedMsgBytes & FRAGMENT_CONTINUES)) {
+            // this frame is followed by more frames of the same message
+            fragmentContinues = true;
+            expectedMsgBytes &= ~FRAGMENT_CONTINUES;
+          }
+          FOCUSLOG("gotData: parsed new header, now expectedMsgBytes=%d%s", expectedMsgBytes, fragmentContinues ? " (fragment)" : "");
+          if (expectedMsgBytes>MAX_DATA_SIZE) {
+            aError = Error::err<VdcApiError>(413, "message exceeds maximum length of 16kB");
+            break;
+          }
+        }
+        // check for complete message
+        if (expectedMsgBytes && (receiveEnd-receiveStart>=expectedMsgBytes)) {
+          FOCUSLOG("gotData: %d bytes in buffer >= expectedMsgBytes=%d -> process", receiveEnd-receiveStart, expectedMsgBytes);
+          // process message in place
+          size_t msgStart = receiveStart;
+          receiveStart += expectedMsgBytes; // consume the message
+          if (fragmentContinues || !fragmentedMessage.empty()) {
+            // part of a fragmented message, collect
+            if (fragmentedMessage.size()+expectedMsgBytes>MAX_FRAGMENTED_MESSAGE_SIZE) {
+              aError = Error::err<VdcApiError>(413, "fragmented message exceeds maximum length of %d bytes", MAX_FRAGMENTED_MESSAGE_SIZE);
               break;
             }
-          }
-          // check for complete message
-          if (expectedMsgBytes && (receivedMessage.size()>=expectedMsgBytes)) {
-            FOCUSLOG("gotData: receivedMessage.size()=%d >= expectedMsgBytes=%d -> process", receivedMessage.size(), expectedMsgBytes);
-            // process message
-            aError = processMessage((uint8_t *)receivedMessage.c_str(),expectedMsgBytes);
-            // erase processed message
-            receivedMessage.erase(0,expectedMsgBytes);
-            DBGFOCUSLOG("gotData: after removing message: receivedMessage.size()=%d", receivedMessage.size());
-            expectedMsgBytes = 0; // reset to unknown
-            // repeat evaluation with remaining bytes (could be another message)
+            fragmentedMessage.append((const char *)receiveBuffer+msgStart, expectedMsgBytes);
+            if (!fragmentContinues) {
+              // last fragment, process entire message
+              aError = processMessage((const uint8_t *)fragmentedMessage.c_str(), fragmentedMessage.size());
+              fragmentedMessage.clear();
+            }
           }
           else {
-            // no complete message yet, done for now
-            break;
+            aError = processMessage(receiveBuffer+msgStart, expectedMsgBytes);
           }
+          expectedMsgBytes = 0; // reset to unknown
+          // repeat evaluation with remaining bytes (could be another message)
+        }
+        else {
+          // no complete message yet, done for now
+          break;
         }
-        DBGFOCUSLOG("gotData: end of processing loop: receivedMessage.size()=%d", receivedMessage.size());
       }
-      // forget buffer
-      delete[] buf; buf = NULL;
+      DBGFOCUSLOG("gotData: end of processing loop: %d bytes pending in buffer", receiveEnd-receiveStart);
     } // some data seems to be ready
   } // no connection error
   if (!Error::isOK(aError)) {
@@ -1144,6 +961,44 @@ void VdcPbufApiConnection::gotData(ErrorPtr aError)
 }
 
 
+bool VdcPbufApiConnection::enableFragmentation()
+{
+  fragmentation = true;
+  return true;
+}
+
+
+// protobuf-c output buffer which splits the packed message into frames with FRAGMENT_CONTINUES headers
+typedef struct {
+  ProtobufCBuffer base;
+  string *outputP; ///< where to append the frames
+  size_t remaining; ///< number of message bytes not yet appended
+  size_t frameRemaining; ///< number of bytes that still fit into the current frame
+} FragmentingBuffer;
+
+
+static void fragmentingBufferAppend(ProtobufCBuffer *aBuffer, size_t aLen, const uint8_t *aData)
+{
+  FragmentingBuffer *fb = (FragmentingBuffer *)aBuffer;
+  while (aLen>0) {
+    if (fb->frameRemaining==0) {
+      // start new frame
+      size_t frameSize = fb->remaining>MAX_DATA_SIZE ? MAX_DATA_SIZE : fb->remaining;
+      uint16_t hdr = frameSize | (fb->remaining>frameSize ? FRAGMENT_CONTINUES : 0);
+      fb->outputP->push_back((char)((hdr>>8) & 0xFF));
+      fb->outputP->push_back((char)(hdr & 0xFF));
+      fb->frameRemaining = frameSize;
+    }
+    size_t n = aLen<fb->frameRemaining ? aLen : fb->frameRemaining;
+    fb->outputP->append((const char *)aData, n);
+    aData += n;
+    aLen -= n;
+    fb->remaining -= n;
+    fb->frameRemaining -= n;
+  }
+}
+
+
 ErrorPtr VdcPbufApiConnection::sendMessage(const Vdcapi__Message *aVdcApiMessage)
 {
   ErrorPtr err;
@@ -1152,76 +1007,340 @@ ErrorPtr VdcPbufApiConnection::sendMessage(const Vdcapi__Message *aVdcApiMessage
     protobufMessagePrint(stdout, &aVdcApiMessage->base, 0);
   }
   #endif
-  // generate the binary message
+  // generate the binary message directly into the transmit buffer, behind data that might still be waiting.
+  // When the socket is congested, generate into a separate string to be queued by priority.
+  bool congested = waitingForTransmit;
+  string queuedFrames;
+  string &output = congested ? queuedFrames : transmitBuffer;
   size_t packedSize = vdcapi__message__get_packed_size(aVdcApiMessage);
-  uint8_t *packedMsg = new uint8_t[packedSize+2]; // leave room for header
-  // - add the header
-  packedMsg[0] = (packedSize>>8) & 0xFF;
-  packedMsg[1] = packedSize & 0xFF;
-  // - add the message data
-  vdcapi__message__pack(aVdcApiMessage, packedMsg+2);
-  // - adjust the total message length
-  packedSize += 2;
-  // send the message
-  if (transmitBuffer.size()>0) {
-    // other messages are already waiting, append entire message
-    transmitBuffer.append((const char *)packedMsg, packedSize);
+  if (packedSize>MAX_DATA_SIZE && fragmentation) {
+    // too large for a single frame, pack into a sequence of frames
+    FragmentingBuffer fb;
+    fb.base.append = fragmentingBufferAppend;
+    fb.outputP = &output;
+    fb.remaining = packedSize;
+    fb.frameRemaining = 0;
+    output.reserve(output.size()+packedSize+2*(packedSize/MAX_DATA_SIZE+1));
+    vdcapi__message__pack_to_buffer(aVdcApiMessage, &fb.base);
+    FOCUSLOG("sendMessage: sent message of %d bytes in %d fragments", packedSize, packedSize/MAX_DATA_SIZE+1);
+    if (recorder && !congested) {
+      // frames are interleaved with headers in the transmit buffer, record from a separately packed copy
+      string packedMsg;
+      packedMsg.resize(packedSize);
+      vdcapi__message__pack(aVdcApiMessage, (uint8_t *)&packedMsg[0]);
+      recorder->recordMessage(true, packedMsg.c_str(), packedSize);
+    }
   }
   else {
-    // nothing in buffer yet, start new send
-    size_t sentBytes = socketComm->transmitBytes(packedSize, packedMsg, err);
-    if (Error::isOK(err)) {
-      // check if all could be sent
-      if (sentBytes<packedSize) {
-        // Not everything (or maybe nothing, transmitBytes() can return 0) was sent
-        // - enable callback for ready-for-send
-        socketComm->setTransmitHandler(boost::bind(&VdcPbufApiConnection::canSendData, this, _1));
-        // buffer the rest, canSendData handler will take care of writing it out
-        transmitBuffer.assign((char *)packedMsg+sentBytes, packedSize-sentBytes);
-      }
-			else {
-				// all sent
-				// - disable transmit handler
-        socketComm->setTransmitHandler(NULL);
-			}
+    if (packedSize>0xFFFF) {
+      // cannot be represented in 2-byte header
+      return Error::err<VdcApiError>(413, "message of %d bytes too large to be sent, peer does not support fragmentation", (int)packedSize);
+    }
+    size_t msgStart = output.size();
+    output.resize(msgStart+packedSize+2); // leave room for header
+    uint8_t *packedMsg = (uint8_t *)&output[msgStart];
+    // - add the header
+    packedMsg[0] = (packedSize>>8) & 0xFF;
+    packedMsg[1] = packedSize & 0xFF;
+    // - add the message data
+    vdcapi__message__pack(aVdcApiMessage, packedMsg+2);
+    if (recorder && !congested) recorder->recordMessage(true, packedMsg+2, packedSize);
+  }
+  if (congested) {
+    // Note: queued messages are recorded when they are actually transmitted
+    TransmitLane lane = transmitLaneFor(aVdcApiMessage->type);
+    string coalesceKey;
+    if (lane==lane_push) {
+      // every queued push needs its key, later pushes might replace it
+      coalesceKey = pushCoalesceKey(aVdcApiMessage);
     }
+    return queueMessage(lane, queuedFrames, coalesceKey, queuedBytes+queuedFrames.size()>TRANSMIT_HIGH_WATERMARK);
   }
-  // return the buffer
-  delete[] packedMsg;
-  // done
+  messageQueued();
   return err;
 }
 
 
+ErrorPtr VdcPbufApiConnection::sendEncoded(const string &aEncodedMessage)
+{
+  bool congested = waitingForTransmit;
+  string queuedFrames;
+  string &output = congested ? queuedFrames : transmitBuffer;
+  size_t packedSize = aEncodedMessage.size();
+  if (packedSize>MAX_DATA_SIZE && fragmentation) {
+    // too large for a single frame, split into a sequence of frames
+    FragmentingBuffer fb;
+    fb.base.append = fragmentingBufferAppend;
+    fb.outputP = &output;
+    fb.remaining = packedSize;
+    fb.frameRemaining = 0;
+    output.reserve(output.size()+packedSize+2*(packedSize/MAX_DATA_SIZE+1));
+    fragmentingBufferAppend(&fb.base, packedSize, (const uint8_t *)aEncodedMessage.c_str());
+  }
+  else {
+    if (packedSize>0xFFFF) {
+      // cannot be represented in 2-byte header
+      return Error::err<VdcApiError>(413, "message of %d bytes too large to be sent, peer does not support fragmentation", (int)packedSize);
+    }
+    output.push_back((char)((packedSize>>8) & 0xFF));
+    output.push_back((char)(packedSize & 0xFF));
+    output.append(aEncodedMessage);
+  }
+  if (congested) {
+    // Note: queued messages are recorded when they are actually transmitted
+    TransmitLane lane = transmitLaneFor(packedMessageType(aEncodedMessage));
+    string coalesceKey;
+    if (lane==lane_push) {
+      // every queued push needs its key, later pushes might replace it
+      Vdcapi__Message *msg = vdcapi__message__unpack(NULL, packedSize, (const uint8_t *)aEncodedMessage.c_str());
+      if (msg) {
+        coalesceKey = pushCoalesceKey(msg);
+        vdcapi__message__free_unpacked(msg, NULL);
+      }
+    }
+    return queueMessage(lane, queuedFrames, coalesceKey, queuedBytes+queuedFrames.size()>TRANSMIT_HIGH_WATERMARK);
+  }
+  if (recorder) recorder->recordMessage(true, aEncodedMessage.c_str(), packedSize);
+  messageQueued();
+  return ErrorPtr();
+}
+
+
+void VdcPbufApiConnection::messageQueued()
+{
+  statTransmittedMessages++;
+  // send the message
+  if (waitingForTransmit) {
+    // socket is not ready for more data, canSendData handler will take care of writing it out
+  }
+  else if (transmitBuffer.size()-transmitStart>=TRANSMIT_FLUSH_THRESHOLD) {
+    // enough data collected, send now
+    flushTransmitBuffer();
+  }
+  else if (!flushTicket) {
+    // send later, possibly together with more messages
+    flushTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcPbufApiConnection::flushTransmitBuffer, this), flushDelay);
+  }
+}
+
+
+VdcPbufApiConnection::TransmitLane VdcPbufApiConnection::transmitLaneFor(int aMessageType)
+{
+  switch (aMessageType) {
+    case VDCAPI__TYPE__GENERIC_RESPONSE:
+    case VDCAPI__TYPE__VDC_RESPONSE_HELLO:
+    case VDCAPI__TYPE__VDC_RESPONSE_GET_PROPERTY:
+      return lane_response;
+    case VDCAPI__TYPE__VDC_SEND_PUSH_NOTIFICATION:
+      return lane_push;
+    default:
+      return lane_request;
+  }
+}
+
+
+int VdcPbufApiConnection::packedMessageType(const string &aPackedMessage)
+{
+  // protobuf-c packs fields in field number order, so the (required) type is always the first field: tag 0x08 followed by a varint
+  const uint8_t *p = (const uint8_t *)aPackedMessage.c_str();
+  size_t n = aPackedMessage.size();
+  if (n<2 || p[0]!=0x08) return 0; // unknown
+  int type = 0;
+  for (size_t i=1, shift=0; i<n && i<5; i++, shift+=7) {
+    type |= (p[i] & 0x7F)<<shift;
+    if ((p[i] & 0x80)==0) break;
+  }
+  return type;
+}
+
+
+static void appendPropertyNames(string &aKey, Vdcapi__PropertyElement **aElements, size_t aNumElements)
+{
+  for (size_t i=0; i<aNumElements; i++) {
+    if (i>0) aKey += ',';
+    if (aElements[i]->name) aKey += aElements[i]->name;
+    if (aElements[i]->n_elements>0) {
+      aKey += '(';
+      appendPropertyNames(aKey, aElements[i]->elements, aElements[i]->n_elements);
+      aKey += ')';
+    }
+  }
+}
+
+
+string VdcPbufApiConnection::pushCoalesceKey(const Vdcapi__Message *aMessage)
+{
+  string key;
+  const Vdcapi__VdcSendPushNotification *push = aMessage->vdc_send_push_notification;
+  // events are discrete occurrences and must never be coalesced, only pure property state pushes
+  if (push && push->dsuid && push->n_deviceevents==0 && push->n_changedproperties>0) {
+    key = push->dsuid;
+    key += ':';
+    appendPropertyNames(key, push->changedproperties, push->n_changedproperties);
+  }
+  return key;
+}
+
+
+ErrorPtr VdcPbufApiConnection::queueMessage(TransmitLane aLane, string &aFrames, const string &aCoalesceKey, bool aCoalesce)
+{
+  QueuedMessageList &queue = transmitLanes[aLane];
+  if (aCoalesce && !aCoalesceKey.empty()) {
+    // above high watermark: an older push of the same properties of the same device is obsolete now, replace it
+    // Note: must be the most recent one, so the peer never gets an older state after this one
+    for (QueuedMessageList::reverse_iterator pos = queue.rbegin(); pos!=queue.rend(); ++pos) {
+      if (pos->coalesceKey==aCoalesceKey) {
+        queuedBytes -= pos->frames.size();
+        pos->frames.swap(aFrames);
+        queuedBytes += pos->frames.size();
+        statCoalescedPushes++;
+        return ErrorPtr();
+      }
+    }
+  }
+  // make room by dropping the oldest pushes if needed
+  QueuedMessageList &pushes = transmitLanes[lane_push];
+  while (queuedBytes+aFrames.size()>TRANSMIT_MAX_QUEUED && !pushes.empty()) {
+    queuedBytes -= pushes.front().frames.size();
+    pushes.pop_front();
+    statDroppedPushes++;
+  }
+  if (queuedBytes+aFrames.size()>TRANSMIT_MAX_QUEUED) {
+    if (aLane==lane_push) statDroppedPushes++;
+    return Error::err<VdcApiError>(503, "transmit queue full (%lu bytes pending), peer does not receive data", queuedBytes);
+  }
+  queue.push_back(QueuedMessage());
+  queue.back().frames.swap(aFrames);
+  queue.back().coalesceKey = aCoalesceKey;
+  queuedBytes += queue.back().frames.size();
+  return ErrorPtr();
+}
+
+
+void VdcPbufApiConnection::refillTransmitBuffer()
+{
+  // move queued messages into the transmit buffer in priority order, but only as much as one transmit call can take
+  for (int lane=0; lane<numTransmitLanes; lane++) {
+    QueuedMessageList &queue = transmitLanes[lane];
+    while (!queue.empty()) {
+      if (transmitBuffer.size()-transmitStart>=TRANSMIT_FLUSH_THRESHOLD) return;
+      if (recorder) {
+        // record what is actually sent (messages might have been coalesced or dropped while queued)
+        string packedMsg;
+        unframeMessage(queue.front().frames, packedMsg);
+        recorder->recordMessage(true, packedMsg.c_str(), packedMsg.size());
+      }
+      transmitBuffer.append(queue.front().frames);
+      queuedBytes -= queue.front().frames.size();
+      queue.pop_front();
+      statTransmittedMessages++;
+    }
+  }
+}
+
+
+void VdcPbufApiConnection::unframeMessage(const string &aFrames, string &aPackedMessage)
+{
+  // concatenate the data of all frames, without the 2-byte headers
+  aPackedMessage.clear();
+  aPackedMessage.reserve(aFrames.size());
+  size_t i = 0;
+  while (i+2<=aFrames.size()) {
+    size_t frameSize = (((uint8_t)aFrames[i]<<8) + (uint8_t)aFrames[i+1]) & ~FRAGMENT_CONTINUES;
+    aPackedMessage.append(aFrames, i+2, frameSize);
+    i += 2+frameSize;
+  }
+}
+
+
+void VdcPbufApiConnection::flushTransmitBuffer()
+{
+  MainLoop::currentMainLoop().cancelExecutionTicket(flushTicket);
+  canSendData(ErrorPtr());
+}
+
+
 void VdcPbufApiConnection::canSendData(ErrorPtr aError)
 {
-  size_t bytesToSend = transmitBuffer.size();
+  // queued messages (if any) go out now, most important first
+  if (queuedBytes>0) refillTransmitBuffer();
+  size_t bytesToSend = transmitBuffer.size()-transmitStart;
   if (bytesToSend>0 && Error::isOK(aError)) {
     // send data from transmit buffer
-    size_t sentBytes = socketComm->transmitBytes(bytesToSend, (const uint8_t *)transmitBuffer.c_str(), aError);
+    size_t sentBytes = socketComm->transmitBytes(bytesToSend, (const uint8_t *)transmitBuffer.c_str()+transmitStart, aError);
+    statTransmitCalls++;
     if (Error::isOK(aError)) {
+      statTransmittedBytes += sentBytes;
       if (sentBytes==bytesToSend) {
-        // all sent
-        transmitBuffer.erase();
-				// - disable transmit handler
-        socketComm->setTransmitHandler(NULL);
+        // all sent, buffer can be re-used from start (capacity is retained)
+        transmitBuffer.clear();
+        transmitStart = 0;
+        // - disable transmit handler, unless there are more queued messages
+        if (waitingForTransmit && queuedBytes==0) {
+          socketComm->setTransmitHandler(NULL);
+          waitingForTransmit = false;
+        }
       }
       else {
-        // partially sent, remove sent bytes
-        transmitBuffer.erase(0, sentBytes);
+        // Not everything (or maybe nothing, transmitBytes() can return 0) was sent
+        transmitStart += sentBytes;
+        if (transmitStart>transmitBuffer.size()/2) {
+          // more sent than pending, remove sent bytes
+          transmitBuffer.erase(0, transmitStart);
+          transmitStart = 0;
+        }
+        // - enable callback for ready-for-send
+        if (!waitingForTransmit) {
+          socketComm->setTransmitHandler(boost::bind(&VdcPbufApiConnection::canSendData, this, _1));
+          waitingForTransmit = true;
+        }
       }
       // check for closing connection when no data pending to be sent any more
-      if (closeWhenSent && transmitBuffer.size()==0) {
+      if (closeWhenSent && transmitBuffer.size()==0 && queuedBytes==0) {
         closeWhenSent = false; // done
         LOG(LOG_NOTICE, "vDC API request demands ending connection now");
         closeConnection();
       }
     }
+    else {
+      LOG(LOG_WARNING, "Error sending data on protobuf connection: %s", aError->description().c_str());
+    }
   }
 }
 
 
+string VdcPbufApiConnection::statisticsInfo()
+{
+  string s = inherited::statisticsInfo();
+  double secs = (double)(MainLoop::now()-statisticsStart)/Second;
+  if (secs<=0) return s;
+  string_format_append(s,
+    ", %.1f transmit calls/sec, %.1f bytes/sec, %.1f messages/sec (%.1f messages/call)",
+    (double)statTransmitCalls/secs,
+    (double)statTransmittedBytes/secs,
+    (double)statTransmittedMessages/secs,
+    statTransmitCalls>0 ? (double)statTransmittedMessages/statTransmitCalls : 0.0
+  );
+  if (statCoalescedPushes>0 || statDroppedPushes>0 || queuedBytes>0) {
+    string_format_append(s,
+      ", congestion: %lu bytes queued, %ld pushes coalesced, %ld pushes dropped",
+      queuedBytes, statCoalescedPushes, statDroppedPushes
+    );
+  }
+  return s;
+}
+
 
+void VdcPbufApiConnection::statisticsReset()
+{
+  inherited::statisticsReset();
+  statisticsStart = MainLoop::now();
+  statTransmitCalls = 0;
+  statTransmittedBytes = 0;
+  statTransmittedMessages = 0;
+  statCoalescedPushes = 0;
+  statDroppedPushes = 0;
+}
 
 
 ErrorCode VdcPbufApiConnection::pbufToInternalError(Vdcapi__ResultCode aVdcApiResultCode)
@@ -1274,14 +1393,19 @@ ErrorPtr VdcPbufApiConnection::processMessage(const uint8_t *aPackedMessageP, si
 {
   Vdcapi__Message *decodedMsg;
   ProtobufCMessage *paramsMsg = NULL;
-  PbufApiValuePtr msgFieldsObj = PbufApiValuePtr(new PbufApiValue);
+  PbufApiValuePtr msgFieldsObj;
 
   ErrorPtr err;
 
+  if (recorder) recorder->recordMessage(false, aPackedMessageP, aPackedMessageSize);
   decodedMsg = vdcapi__message__unpack(NULL, aPackedMessageSize, aPackedMessageP); // Deserialize the serialized input
   if (decodedMsg == NULL) {
     err = Error::err<VdcApiError>(400,"error unpacking incoming message");
   }
+  else if (!decodedMsg->has_message_id && processDirectNotification(decodedMsg)) {
+    // frequently used notification, was delivered directly from the decoded message
+    vdcapi__message__free_unpacked(decodedMsg, NULL); // Free the message from unpack()
+  }
   else {
     // print it
     #if FOCUSLOGGING
@@ -1290,6 +1414,7 @@ ErrorPtr VdcPbufApiConnection::processMessage(const uint8_t *aPackedMessageP, si
     }
     #endif
     // successful message decoding
+    msgFieldsObj = PbufApiValuePtr(new PbufApiValue);
     string method;
     int responseType = 0; // none
     int32_t responseForId = -1; // none
@@ -1489,7 +1614,7 @@ ErrorPtr VdcPbufApiConnection::processMessage(const uint8_t *aPackedMessageP, si
       }
       else {
         // call handler
-        apiRequestHandler(VdcPbufApiConnectionPtr(this), request, method, msgFieldsObj);
+        dispatchRequest(request, method, msgFieldsObj);
       }
     }
     // free the unpacked message
@@ -1500,64 +1625,164 @@ ErrorPtr VdcPbufApiConnection::processMessage(const uint8_t *aPackedMessageP, si
 }
 
 
+// get audience and scene number fields common to all scene related notifications
+template<class SceneNotificationMsg> static void getSceneNotificationFields(VdcApiDirectNotification &aNotification, const SceneNotificationMsg *aMsg)
+{
+  aNotification.numDsUids = aMsg->n_dsuid;
+  aNotification.dsUids = aMsg->dsuid;
+  if (aMsg->has_zone_id) aNotification.zoneId = aMsg->zone_id;
+  if (aMsg->has_group) aNotification.group = aMsg->group;
+  if (aMsg->has_scene) aNotification.scene = aMsg->scene;
+}
+
+
+bool VdcPbufApiConnection::processDirectNotification(const Vdcapi__Message *aDecodedMsg)
+{
+  if (!apiDirectNotificationHandler) return false; // no direct path available
+  // Note: messages with missing submessages are left to the generic path, which reports them
+  switch (aDecodedMsg->type) {
+    case VDCAPI__TYPE__VDSM_NOTIFICATION_CALL_SCENE: {
+      const Vdcapi__VdsmNotificationCallScene *m = aDecodedMsg->vdsm_send_call_scene;
+      if (!m) return false;
+      VdcApiDirectNotification n(directnotification_callScene, "callScene");
+      getSceneNotificationFields(n, m);
+      if (m->has_force) n.force = m->force;
+      return deliverDirectNotification(n);
+    }
+    case VDCAPI__TYPE__VDSM_NOTIFICATION_SAVE_SCENE: {
+      const Vdcapi__VdsmNotificationSaveScene *m = aDecodedMsg->vdsm_send_save_scene;
+      if (!m) return false;
+      VdcApiDirectNotification n(directnotification_saveScene, "saveScene");
+      getSceneNotificationFields(n, m);
+      return deliverDirectNotification(n);
+    }
+    case VDCAPI__TYPE__VDSM_NOTIFICATION_UNDO_SCENE: {
+      const Vdcapi__VdsmNotificationUndoScene *m = aDecodedMsg->vdsm_send_undo_scene;
+      if (!m) return false;
+      VdcApiDirectNotification n(directnotification_undoScene, "undoScene");
+      getSceneNotificationFields(n, m);
+      return deliverDirectNotification(n);
+    }
+    case VDCAPI__TYPE__VDSM_NOTIFICATION_SET_LOCAL_PRIO: {
+      const Vdcapi__VdsmNotificationSetLocalPrio *m = aDecodedMsg->vdsm_send_set_local_prio;
+      if (!m) return false;
+      VdcApiDirectNotification n(directnotification_setLocalPriority, "setLocalPriority");
+      getSceneNotificationFields(n, m);
+      return deliverDirectNotification(n);
+    }
+    case VDCAPI__TYPE__VDSM_NOTIFICATION_CALL_MIN_SCENE: {
+      const Vdcapi__VdsmNotificationCallMinScene *m = aDecodedMsg->vdsm_send_call_min_scene;
+      if (!m) return false;
+      VdcApiDirectNotification n(directnotification_callSceneMin, "callSceneMin");
+      getSceneNotificationFields(n, m);
+      return deliverDirectNotification(n);
+    }
+    case VDCAPI__TYPE__VDSM_NOTIFICATION_SET_CONTROL_VALUE: {
+      const Vdcapi__VdsmNotificationSetControlValue *m = aDecodedMsg->vdsm_send_set_control_value;
+      if (!m) return false;
+      VdcApiDirectNotification n(directnotification_setControlValue, "setControlValue");
+      n.numDsUids = m->n_dsuid;
+      n.dsUids = m->dsuid;
+      if (m->has_zone_id) n.zoneId = m->zone_id;
+      if (m->has_group) n.group = m->group;
+      n.name = m->name;
+      n.hasValue = m->has_value;
+      n.value = m->value;
+      return deliverDirectNotification(n);
+    }
+    case VDCAPI__TYPE__VDSM_NOTIFICATION_SET_OUTPUT_CHANNEL_VALUE: {
+      const Vdcapi__VdsmNotificationSetOutputChannelValue *m = aDecodedMsg->vdsm_send_output_channel_value;
+      if (!m) return false;
+      VdcApiDirectNotification n(directnotification_setOutputChannelValue, "setOutputChannelValue");
+      n.numDsUids = m->n_dsuid;
+      n.dsUids = m->dsuid;
+      if (m->has_channel) n.channel = m->channel;
+      n.channelId = m->channelid;
+      n.hasValue = m->has_value;
+      n.value = m->value;
+      if (m->has_apply_now) n.applyNow = m->apply_now;
+      return deliverDirectNotification(n);
+    }
+    default:
+      // all other messages use the generic path
+      return false;
+  }
+}
+
+
+bool VdcPbufApiConnection::deliverDirectNotification(const VdcApiDirectNotification &aNotification)
+{
+  LOG(LOG_INFO, "vdSM -> vDC (pbuf) notification received: method='%s' (direct)", aNotification.method);
+  return apiDirectNotificationHandler(VdcPbufApiConnectionPtr(this), aNotification);
+}
+
+
+
 void VdcPbufApiConnection::closeAfterSend()
 {
   closeWhenSent = true;
 }
 
 
-ErrorPtr VdcPbufApiConnection::sendRequest(const string &aMethod, ApiValuePtr aParams, VdcApiResponseCB aResponseHandler)
+ErrorPtr VdcPbufApiConnection::initRequestMessage(const string &aMethod, Vdcapi__Message &aMsg, ProtobufCMessage *&aSubMessageP)
 {
-  PbufApiValuePtr params = boost::dynamic_pointer_cast<PbufApiValue>(aParams);
-  ErrorPtr err;
-
-  // create a message
-  Vdcapi__Message msg = VDCAPI__MESSAGE__INIT;
   // find out which type and which submessage applies
-  ProtobufCMessage *subMessageP = NULL;
   if (aMethod=="pong") {
-    msg.type = VDCAPI__TYPE__VDC_SEND_PONG;
-    msg.vdc_send_pong = new Vdcapi__VdcSendPong;
-    vdcapi__vdc__send_pong__init(msg.vdc_send_pong);
-    subMessageP = &(msg.vdc_send_pong->base);
+    aMsg.type = VDCAPI__TYPE__VDC_SEND_PONG;
+    aMsg.vdc_send_pong = new Vdcapi__VdcSendPong;
+    vdcapi__vdc__send_pong__init(aMsg.vdc_send_pong);
+    aSubMessageP = &(aMsg.vdc_send_pong->base);
   }
   else if (aMethod=="announcedevice") {
-    msg.type = VDCAPI__TYPE__VDC_SEND_ANNOUNCE_DEVICE;
-    msg.vdc_send_announce_device = new Vdcapi__VdcSendAnnounceDevice;
-    vdcapi__vdc__send_announce_device__init(msg.vdc_send_announce_device);
-    subMessageP = &(msg.vdc_send_announce_device->base);
+    aMsg.type = VDCAPI__TYPE__VDC_SEND_ANNOUNCE_DEVICE;
+    aMsg.vdc_send_announce_device = new Vdcapi__VdcSendAnnounceDevice;
+    vdcapi__vdc__send_announce_device__init(aMsg.vdc_send_announce_device);
+    aSubMessageP = &(aMsg.vdc_send_announce_device->base);
   }
   else if (aMethod=="announcevdc") {
-    msg.type = VDCAPI__TYPE__VDC_SEND_ANNOUNCE_VDC;
-    msg.vdc_send_announce_vdc = new Vdcapi__VdcSendAnnounceVdc;
-    vdcapi__vdc__send_announce_vdc__init(msg.vdc_send_announce_vdc);
-    subMessageP = &(msg.vdc_send_announce_vdc->base);
+    aMsg.type = VDCAPI__TYPE__VDC_SEND_ANNOUNCE_VDC;
+    aMsg.vdc_send_announce_vdc = new Vdcapi__VdcSendAnnounceVdc;
+    vdcapi__vdc__send_announce_vdc__init(aMsg.vdc_send_announce_vdc);
+    aSubMessageP = &(aMsg.vdc_send_announce_vdc->base);
   }
   else if (aMethod=="vanish") {
-    msg.type = VDCAPI__TYPE__VDC_SEND_VANISH;
-    msg.vdc_send_vanish = new Vdcapi__VdcSendVanish;
-    vdcapi__vdc__send_vanish__init(msg.vdc_send_vanish);
-    subMessageP = &(msg.vdc_send_vanish->base);
+    aMsg.type = VDCAPI__TYPE__VDC_SEND_VANISH;
+    aMsg.vdc_send_vanish = new Vdcapi__VdcSendVanish;
+    vdcapi__vdc__send_vanish__init(aMsg.vdc_send_vanish);
+    aSubMessageP = &(aMsg.vdc_send_vanish->base);
   }
   else if (aMethod=="pushNotification") {
-    msg.type = VDCAPI__TYPE__VDC_SEND_PUSH_NOTIFICATION;
-    msg.vdc_send_push_notification = new Vdcapi__VdcSendPushNotification;
-    vdcapi__vdc__send_push_notification__init(msg.vdc_send_push_notification);
-    subMessageP = &(msg.vdc_send_push_notification->base);
+    aMsg.type = VDCAPI__TYPE__VDC_SEND_PUSH_NOTIFICATION;
+    aMsg.vdc_send_push_notification = new Vdcapi__VdcSendPushNotification;
+    vdcapi__vdc__send_push_notification__init(aMsg.vdc_send_push_notification);
+    aSubMessageP = &(aMsg.vdc_send_push_notification->base);
   }
   else if (aMethod=="identify") {
     // Note: this method has the same (JSON) name as the method from the vdsm used to identify (blink) a device.
     //   In protobuf API however this is a different message type
-    msg.type = VDCAPI__TYPE__VDC_SEND_IDENTIFY;
-    msg.vdc_send_identify = new Vdcapi__VdcSendIdentify;
-    vdcapi__vdc__send_identify__init(msg.vdc_send_identify);
-    subMessageP = &(msg.vdc_send_identify->base);
+    aMsg.type = VDCAPI__TYPE__VDC_SEND_IDENTIFY;
+    aMsg.vdc_send_identify = new Vdcapi__VdcSendIdentify;
+    vdcapi__vdc__send_identify__init(aMsg.vdc_send_identify);
+    aSubMessageP = &(aMsg.vdc_send_identify->base);
   }
   else {
     // no suitable submessage, cannot send
     LOG(LOG_INFO, "vdSM <- vDC (pbuf) method '%s' cannot be sent because no message is implemented for it at the pbuf level", aMethod.c_str());
     return Error::err<VdcApiError>(500, "Error: Method is not implemented in the pbuf API");
   }
+  return ErrorPtr();
+}
+
+
+ErrorPtr VdcPbufApiConnection::sendRequest(const string &aMethod, ApiValuePtr aParams, VdcApiResponseCB aResponseHandler)
+{
+  PbufApiValuePtr params = boost::dynamic_pointer_cast<PbufApiValue>(aParams);
+  ErrorPtr err;
+
+  // create a message
+  Vdcapi__Message msg = VDCAPI__MESSAGE__INIT;
+  ProtobufCMessage *subMessageP = NULL;
+  err = initRequestMessage(aMethod, msg, subMessageP);
   if (Error::isOK(err)) {
     if (aResponseHandler) {
       // method call expecting response
@@ -1587,6 +1812,29 @@ ErrorPtr VdcPbufApiConnection::sendRequest(const string &aMethod, ApiValuePtr aP
 }
 
 
+ErrorPtr VdcPbufApiConnection::encodeNotification(const string &aMethod, ApiValuePtr aParams, string &aEncodedMessage)
+{
+  PbufApiValuePtr params = boost::dynamic_pointer_cast<PbufApiValue>(aParams);
+  ErrorPtr err;
+
+  Vdcapi__Message msg = VDCAPI__MESSAGE__INIT;
+  ProtobufCMessage *subMessageP = NULL;
+  err = initRequestMessage(aMethod, msg, subMessageP);
+  if (Error::isOK(err)) {
+    if (params) {
+      params->putObjectIntoMessageFields(*subMessageP);
+    }
+    // pack without frame header, sendEncoded() frames it according to the receiving connection's capabilities
+    aEncodedMessage.resize(vdcapi__message__get_packed_size(&msg));
+    if (aEncodedMessage.size()>0) {
+      vdcapi__message__pack(&msg, (uint8_t *)&aEncodedMessage[0]);
+    }
+    protobuf_c_message_free_unpacked(subMessageP, NULL);
+  }
+  return err;
+}
+
+
 // MARK: ===== generic protobuf-C message printing
 
 #if FOCUSLOGGING
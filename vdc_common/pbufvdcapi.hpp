@@ -25,6 +25,7 @@
 #include "p44utils_common.hpp"
 
 #include "vdcapi.hpp"
+#include "treeapivalue.hpp"
 
 #include "vdcapi.pb-c.h"
 #include "messages.pb-c.h"
@@ -47,62 +48,19 @@ namespace p44 {
 
   typedef boost::intrusive_ptr<PbufApiValue> PbufApiValuePtr;
 
-  typedef map<string, PbufApiValuePtr> ApiValueFieldMap;
-  typedef vector<PbufApiValuePtr> ApiValueArray;
-
   /// Protocol buffer specific implementation of ApiValue
-  class PbufApiValue : public ApiValue
+  class PbufApiValue : public TreeApiValue<PbufApiValue>
   {
-    typedef ApiValue inherited;
+    typedef TreeApiValue<PbufApiValue> inherited;
     friend class VdcPbufApiConnection;
 
-    // the actual storage
-    ApiValueType allocatedType;
-    union {
-      bool boolVal;
-      uint64_t uint64Val;
-      int64_t int64Val;
-      double doubleVal;
-      string *stringP; // for strings and binary values
-      ApiValueFieldMap *objectMapP;
-      ApiValueArray *arrayVectorP;
-    } objectValue;
-
-    ApiValueFieldMap::iterator keyIterator;
-
   public:
 
-    PbufApiValue();
-    virtual ~PbufApiValue();
-
-    virtual ApiValuePtr newValue(ApiValueType aObjectType) P44_OVERRIDE;
-
-    virtual void clear() P44_OVERRIDE;
-    virtual void operator=(ApiValue &aApiValue) P44_OVERRIDE;
-
-    virtual void add(const string &aKey, ApiValuePtr aObj) P44_OVERRIDE;
-    virtual ApiValuePtr get(const string &aKey) P44_OVERRIDE;
-    virtual void del(const string &aKey) P44_OVERRIDE;
-    virtual int arrayLength() P44_OVERRIDE;
-    virtual void arrayAppend(const ApiValuePtr aObj) P44_OVERRIDE;
-    virtual ApiValuePtr arrayGet(int aAtIndex) P44_OVERRIDE;
-    virtual void arrayPut(int aAtIndex, ApiValuePtr aObj) P44_OVERRIDE;
-    virtual bool resetKeyIteration() P44_OVERRIDE;
-    virtual bool nextKeyValue(string &aKey, ApiValuePtr &aValue) P44_OVERRIDE;
-
-    virtual uint64_t uint64Value() P44_OVERRIDE;
-    virtual int64_t int64Value() P44_OVERRIDE;
-    virtual double doubleValue() P44_OVERRIDE;
-    virtual bool boolValue() P44_OVERRIDE;
-    virtual string binaryValue() P44_OVERRIDE;
-    virtual string stringValue() P44_OVERRIDE;
-
-    virtual void setUint64Value(uint64_t aUint64) P44_OVERRIDE;
-    virtual void setInt64Value(int64_t aInt64) P44_OVERRIDE;
-    virtual void setDoubleValue(double aDouble) P44_OVERRIDE;
-    virtual void setBoolValue(bool aBool) P44_OVERRIDE;
-    virtual void setBinaryValue(const string &aString) P44_OVERRIDE;
-    virtual bool setStringValue(const string &aString) P44_OVERRIDE;
+    /// PbufApiValue nodes are allocated from a recycling pool
+    /// @note building a property tree for a getProperty response creates and destroys many nodes,
+    ///   recycling them avoids most of the malloc/free traffic and keeps nodes close together in memory.
+    static void *operator new(size_t aSize);
+    static void operator delete(void *aPtr, size_t aSize);
 
     /// @name protobuf-c interfacing
     /// @{
@@ -140,9 +98,6 @@ namespace p44 {
 
   private:
 
-    void allocate();
-    bool allocateIf(ApiValueType aIsType);
-
     void setValueFromField(const ProtobufCFieldDescriptor &aFieldDescriptor, const void *aData, size_t aIndex, ssize_t aArraySize);
     void putValueIntoField(const ProtobufCFieldDescriptor &aFieldDescriptor, void *aData, size_t aIndex, ssize_t aArraySize);
 
@@ -153,8 +108,6 @@ namespace p44 {
     void getValueFromPropVal(Vdcapi__PropertyValue &aPropVal);
     void putValueIntoPropVal(Vdcapi__PropertyValue &aPropVal);
 
-    size_t numObjectFields();
-
   };
 
 
@@ -186,6 +139,8 @@ namespace p44 {
     uint32_t reqId;
     VdcPbufApiConnectionPtr pbufConnection;
     Vdcapi__Type responseType; ///< which response message to send back
+    bool resultStreamed; ///< set when parts of the result have been sent with sendResultPart()
+    string streamedResult; ///< packed properties of the result parts sent so far
 
   public:
 
@@ -205,6 +160,16 @@ namespace p44 {
     /// @result empty or Error object in case of error sending result response
     virtual ErrorPtr sendResult(ApiValuePtr aResult) P44_OVERRIDE;
 
+    /// check if the result can be sent in parts
+    /// @return true for getProperty, which can pack its result properties one part at a time
+    virtual bool canStreamResult() P44_OVERRIDE { return responseType==VDCAPI__TYPE__VDC_RESPONSE_GET_PROPERTY; };
+
+    /// send part of the result object
+    /// @param aResultPart object containing some of the result's properties. These are packed right away, and
+    ///   sent together with the other parts by the final sendResult()
+    /// @result empty or Error object in case of error
+    virtual ErrorPtr sendResultPart(ApiValuePtr aResultPart) P44_OVERRIDE;
+
     /// send a vDC API error (answer for unsuccesful method call)
     /// @param aErrorCode the error code
     /// @param aErrorMessage the error message or NULL to generate a standard text
@@ -229,12 +194,44 @@ namespace p44 {
 
     // receiving
     uint32_t expectedMsgBytes; ///< number of bytes expected of next message
-    string receivedMessage; ///< accumulated message bytes, including 4-byte length header
+    uint8_t *receiveBuffer; ///< fixed size receive buffer, socket data is read directly into it and messages are decoded in place
+    size_t receiveStart; ///< index of first not yet processed byte in receiveBuffer
+    size_t receiveEnd; ///< index of first free byte in receiveBuffer
+    bool fragmentation; ///< set when messages larger than one frame are sent and received as continuation frames
+    bool fragmentContinues; ///< set when the frame currently being received is followed by continuation frames
+    string fragmentedMessage; ///< accumulated data of a fragmented message
 
     // sending
-    string transmitBuffer; ///< binary buffer for data to be sent
+    string transmitBuffer; ///< binary buffer for data to be sent, re-used for all messages
+    size_t transmitStart; ///< index of first byte in transmitBuffer not yet sent
+    bool waitingForTransmit; ///< set when socket could not accept all data, canSendData() will continue sending
+
+    // congestion handling: while waitingForTransmit, new messages are queued by priority
+    typedef enum {
+      lane_response, ///< answers to method calls
+      lane_request, ///< method calls and notifications other than pushNotification
+      lane_push, ///< pushNotifications
+      numTransmitLanes
+    } TransmitLane;
+    typedef struct {
+      string frames; ///< the framed message, ready to be sent
+      string coalesceKey; ///< for pushNotification of properties: dSUID and property names, empty otherwise
+    } QueuedMessage;
+    typedef list<QueuedMessage> QueuedMessageList;
+    QueuedMessageList transmitLanes[numTransmitLanes]; ///< messages waiting for the socket to accept data again
+    size_t queuedBytes; ///< total size of all messages in transmitLanes
+    MLTicket flushTicket; ///< pending flush of the transmit buffer
+    MLMicroSeconds flushDelay; ///< how long messages may wait in transmitBuffer to be coalesced with others
     bool closeWhenSent;
 
+    // statistics
+    MLMicroSeconds statisticsStart; ///< when statistics were last reset
+    long statTransmitCalls; ///< number of transmit calls to the socket
+    long statTransmittedBytes; ///< number of bytes transmitted
+    long statTransmittedMessages; ///< number of messages transmitted
+    long statCoalescedPushes; ///< number of queued pushNotifications replaced by a newer one
+    long statDroppedPushes; ///< number of pushNotifications dropped because the transmit queue was full
+
     // pending requests
     int32_t requestIdCounter;
     typedef map<int32_t, VdcApiResponseCB> PendingAnswerMap;
@@ -243,6 +240,7 @@ namespace p44 {
   public:
 
     VdcPbufApiConnection();
+    virtual ~VdcPbufApiConnection();
 
     /// The underlying socket connection
     /// @return socket connection
@@ -260,13 +258,55 @@ namespace p44 {
     /// @return empty or Error object in case of error
     virtual ErrorPtr sendRequest(const string &aMethod, ApiValuePtr aParams, VdcApiResponseCB aResponseHandler = VdcApiResponseCB());
 
+    /// encode a notification once, for sending it to multiple connections
+    /// @param aMethod the vDC API notification name
+    /// @param aParams the parameters for the notification. Can be NULL.
+    /// @param aEncodedMessage will receive the packed protobuf message (without frame header)
+    /// @return empty or Error object in case of error
+    virtual ErrorPtr encodeNotification(const string &aMethod, ApiValuePtr aParams, string &aEncodedMessage) P44_OVERRIDE;
+
+    /// send a message encoded by encodeNotification() of any protobuf connection
+    /// @param aEncodedMessage the packed protobuf message
+    /// @return empty or Error object in case of error
+    virtual ErrorPtr sendEncoded(const string &aEncodedMessage) P44_OVERRIDE;
+
+    /// enable sending and receiving messages exceeding the frame size limit as sequence of continuation frames
+    /// @return true (protobuf API supports fragmentation)
+    virtual bool enableFragmentation() P44_OVERRIDE;
+
+    /// set the maximum time outgoing messages may wait to be sent together with other messages
+    /// @param aFlushDelay max delay, 0 means messages are sent at the end of the current mainloop cycle
+    void setFlushDelay(MLMicroSeconds aFlushDelay) { flushDelay = aFlushDelay; };
+
+    /// get traffic statistics of this connection
+    /// @return transmit calls, bytes and messages per second since last reset
+    virtual string statisticsInfo() P44_OVERRIDE;
+
+    /// reset traffic statistics of this connection
+    virtual void statisticsReset() P44_OVERRIDE;
+
+    /// @return protobuf encoding
+    virtual VdcApiEncoding apiEncoding() P44_OVERRIDE { return vdcapi_encoding_protobuf; };
+
   private:
 
     void gotData(ErrorPtr aError);
     void canSendData(ErrorPtr aError);
+    void flushTransmitBuffer();
 
     ErrorPtr processMessage(const uint8_t *aPackedMessageP, size_t aPackedMessageSize);
+    bool processDirectNotification(const Vdcapi__Message *aDecodedMsg);
+    bool deliverDirectNotification(const VdcApiDirectNotification &aNotification);
+    ErrorPtr initRequestMessage(const string &aMethod, Vdcapi__Message &aMsg, ProtobufCMessage *&aSubMessageP);
     ErrorPtr sendMessage(const Vdcapi__Message *aVdcApiMessage);
+    void messageQueued();
+
+    static TransmitLane transmitLaneFor(int aMessageType);
+    static int packedMessageType(const string &aPackedMessage);
+    static string pushCoalesceKey(const Vdcapi__Message *aMessage);
+    ErrorPtr queueMessage(TransmitLane aLane, string &aFrames, const string &aCoalesceKey, bool aCoalesce);
+    static void unframeMessage(const string &aFrames, string &aPackedMessage);
+    void refillTransmitBuffer();
 
     static ErrorCode pbufToInternalError(Vdcapi__ResultCode aVdcApiResultCode);
     static Vdcapi__ResultCode internalToPbufError(ErrorCode aErrorCode);
@@ -0,0 +1,418 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "persistenceworker.hpp"
+#include "savejournal.hpp"
+#include "cachingparamstore.hpp"
+
+
+using namespace p44;
+
+
+void PersistenceWorker::WriteCommand::bindValues(const SnapshotValues &aValues)
+{
+  for (int i=0; i<(int)aValues.size(); i++) {
+    const SnapshotValue &v = aValues[i];
+    switch (v.type) {
+      case SQLITE_INTEGER: sqlite3_bind_int64(stmt_, i+1, v.intValue); break;
+      case SQLITE_FLOAT: sqlite3_bind_double(stmt_, i+1, v.doubleValue); break;
+      case SQLITE_TEXT: sqlite3_bind_text(stmt_, i+1, v.data.c_str(), (int)v.data.size(), SQLITE_STATIC); break;
+      case SQLITE_BLOB: sqlite3_bind_blob(stmt_, i+1, v.data.data(), (int)v.data.size(), SQLITE_STATIC); break;
+      default: sqlite3_bind_null(stmt_, i+1); break;
+    }
+  }
+}
+
+
+PersistenceWorker::PersistenceWorker(ParamStore &aParamStore, const string aDbPath) :
+  paramStore(aParamStore),
+  dbPath(aDbPath),
+  busy(false),
+  terminating(false)
+{
+  pthread_mutex_init(&queueAccess, NULL);
+  pthread_cond_init(&queueChanged, NULL);
+}
+
+
+PersistenceWorker::~PersistenceWorker()
+{
+  // make sure nothing gets lost
+  if (workerThread) stop();
+  // prepared statements must be finalized before the DB gets closed
+  for (CaptureQueryMap::iterator pos = captureQueries.begin(); pos!=captureQueries.end(); ++pos) {
+    delete pos->second;
+  }
+  captureQueries.clear();
+  pthread_cond_destroy(&queueChanged);
+  pthread_mutex_destroy(&queueAccess);
+}
+
+
+// MARK: ===== worker thread
+
+
+void PersistenceWorker::start()
+{
+  if (workerThread) return; // already running
+  terminating = false;
+  workerThread = MainLoop::currentMainLoop().executeInThread(
+    boost::bind(&PersistenceWorker::workerThreadRoutine, this, _1),
+    boost::bind(&PersistenceWorker::workerThreadSignal, this, _1, _2)
+  );
+}
+
+
+void PersistenceWorker::stop()
+{
+  if (!workerThread) return;
+  flush();
+  pthread_mutex_lock(&queueAccess);
+  terminating = true;
+  pthread_cond_broadcast(&queueChanged);
+  pthread_mutex_unlock(&queueAccess);
+  workerThread->terminate();
+  workerThread.reset();
+}
+
+
+void PersistenceWorker::workerThreadRoutine(ChildThreadWrapper &aThread)
+{
+  // the worker has its own connection to the DB
+  sqlite3pp::database db;
+  WriteCommandMap commands; // prepared on this thread's connection, by SQL text
+  bool connected = db.connect(dbPath.c_str())==SQLITE_OK;
+  if (connected) {
+    db.execute(string_format("PRAGMA busy_timeout=%d", PERSISTENCE_BUSY_TIMEOUT).c_str()); // the main thread might be reading
+    db.execute("PRAGMA synchronous=NORMAL"); // per connection setting
+  }
+  pthread_mutex_lock(&queueAccess);
+  while (true) {
+    while (pending.empty() && !terminating && !aThread.shouldTerminate()) {
+      pthread_cond_wait(&queueChanged, &queueAccess);
+    }
+    if (pending.empty()) break; // asked to terminate, and nothing left to write
+    // take a batch
+    WriteJobList batch;
+    WriteJobList::iterator end = pending.begin();
+    for (int n=0; end!=pending.end() && n<PERSISTENCE_WORKER_BATCH_SIZE; n++) ++end;
+    batch.splice(batch.begin(), pending, pending.begin(), end);
+    busy = true;
+    pthread_mutex_unlock(&queueAccess);
+    // write the batch in a single transaction, without holding the lock
+    if (connected) db.execute("BEGIN");
+    for (WriteJobList::iterator pos = batch.begin(); pos!=batch.end(); ++pos) {
+      if (pos->sql.empty()) continue; // sync barrier only
+      if (!connected) {
+        pos->err = TextError::err("cannot open DB '%s'", dbPath.c_str());
+      }
+      else if (executeJob(db, commands, *pos)!=SQLITE_OK) {
+        pos->err = TextError::err("%s", db.error_msg());
+      }
+    }
+    if (connected && db.execute("COMMIT")!=SQLITE_OK) {
+      ErrorPtr err = TextError::err("commit failed: %s", db.error_msg());
+      db.execute("ROLLBACK");
+      for (WriteJobList::iterator pos = batch.begin(); pos!=batch.end(); ++pos) {
+        if (Error::isOK(pos->err)) pos->err = err;
+      }
+    }
+    // hand back to main thread
+    pthread_mutex_lock(&queueAccess);
+    completed.splice(completed.end(), batch);
+    busy = false;
+    pthread_cond_broadcast(&queueChanged);
+    pthread_mutex_unlock(&queueAccess);
+    aThread.signalParentThread(threadSignalUserSignal);
+    pthread_mutex_lock(&queueAccess);
+  }
+  pthread_mutex_unlock(&queueAccess);
+  // statements must be finalized before the DB gets closed
+  for (WriteCommandMap::iterator pos = commands.begin(); pos!=commands.end(); ++pos) {
+    delete pos->second;
+  }
+}
+
+
+int PersistenceWorker::executeJob(sqlite3pp::database &aDb, WriteCommandMap &aCommands, const WriteJob &aJob)
+{
+  if (aJob.values.empty()) return aDb.execute(aJob.sql.c_str());
+  WriteCommand *c;
+  WriteCommandMap::iterator pos = aCommands.find(aJob.sql);
+  if (pos!=aCommands.end()) {
+    c = pos->second;
+  }
+  else {
+    c = new WriteCommand(aDb);
+    int rc = c->prepare(aJob.sql.c_str());
+    if (rc!=SQLITE_OK) {
+      delete c;
+      return rc;
+    }
+    aCommands[aJob.sql] = c;
+  }
+  c->bindValues(aJob.values);
+  int rc = c->execute();
+  c->reset(); // release the bound values
+  return rc;
+}
+
+
+void PersistenceWorker::workerThreadSignal(ChildThreadWrapper &aChildThread, ThreadSignals aSignalCode)
+{
+  if (aSignalCode==threadSignalUserSignal) {
+    runCompletedCallbacks();
+  }
+}
+
+
+void PersistenceWorker::runCompletedCallbacks()
+{
+  WriteJobList done;
+  pthread_mutex_lock(&queueAccess);
+  done.swap(completed);
+  pthread_mutex_unlock(&queueAccess);
+  for (WriteJobList::iterator pos = done.begin(); pos!=done.end(); ++pos) {
+    if (!Error::isOK(pos->err)) {
+      LOG(LOG_ERR, "PersistenceWorker: write failed: %s -- SQL: %s", pos->err->description().c_str(), pos->sql.c_str());
+      // the captured values did not make it to the DB, so the record must be saved again
+      if (pos->params) pos->params->markDirty();
+    }
+    if (pos->doneCB) pos->doneCB(pos->err);
+  }
+}
+
+
+// MARK: ===== queueing writes
+
+
+void PersistenceWorker::write(const string &aSql, StatusCB aDoneCB)
+{
+  WriteJob job;
+  job.sql = aSql;
+  job.doneCB = aDoneCB;
+  queueJob(job);
+}
+
+
+void PersistenceWorker::queueJob(const WriteJob &aJob)
+{
+  pthread_mutex_lock(&queueAccess);
+  pending.push_back(aJob);
+  pthread_cond_broadcast(&queueChanged);
+  pthread_mutex_unlock(&queueAccess);
+}
+
+
+void PersistenceWorker::sync(StatusCB aSyncedCB)
+{
+  // an empty job is a barrier, which is done when all jobs before it are done
+  write("", aSyncedCB);
+}
+
+
+bool PersistenceWorker::hasPendingWrites()
+{
+  pthread_mutex_lock(&queueAccess);
+  bool p = !pending.empty() || busy || !completed.empty();
+  pthread_mutex_unlock(&queueAccess);
+  return p;
+}
+
+
+void PersistenceWorker::flush()
+{
+  if (!workerThread) return; // nothing will get written
+  pthread_mutex_lock(&queueAccess);
+  while (!pending.empty() || busy) {
+    pthread_cond_wait(&queueChanged, &queueAccess);
+  }
+  pthread_mutex_unlock(&queueAccess);
+  runCompletedCallbacks();
+}
+
+
+// MARK: ===== snapshots of persistent params
+
+
+bool PersistenceWorker::isValidStatement(const string &aSql)
+{
+  if (validStatements.find(aSql)!=validStatements.end()) return true;
+  // preparing checks the statement against the current schema, without writing anything
+  sqlite3pp::command c(paramStore);
+  if (c.prepare(aSql.c_str())!=SQLITE_OK) return false;
+  validStatements.insert(aSql);
+  return true;
+}
+
+
+sqlite3pp::query *PersistenceWorker::captureQueryFor(int aNumValues)
+{
+  CaptureQueryMap::iterator pos = captureQueries.find(aNumValues);
+  if (pos!=captureQueries.end()) return pos->second;
+  // a query involving no table at all, just returning the values bound to it
+  string sql = "SELECT ?1";
+  for (int i=1; i<aNumValues; i++) string_format_append(sql, ",?%d", i+1);
+  sqlite3pp::query *q = new sqlite3pp::query(paramStore);
+  if (q->prepare(sql.c_str())!=SQLITE_OK) {
+    delete q;
+    return NULL;
+  }
+  captureQueries[aNumValues] = q;
+  return q;
+}
+
+
+long long PersistenceWorker::newRowId(const char *aTableName)
+{
+  RowIdMap::iterator pos = nextRowIds.find(aTableName);
+  if (pos==nextRowIds.end()) {
+    // first new record in this table: continue after the highest ROWID in the DB
+    // Note: from now on, all new records of this table get their ROWID from here
+    long long maxRowId = 0;
+    sqlite3pp::query q(paramStore);
+    if (q.prepare(string_format("SELECT max(ROWID) FROM %s", aTableName).c_str())==SQLITE_OK) {
+      sqlite3pp::query::iterator row = q.begin();
+      if (row!=q.end()) row->getIfNotNull<long long>(0, maxRowId);
+    }
+    pos = nextRowIds.insert(make_pair(string(aTableName), maxRowId+1)).first;
+  }
+  return pos->second++;
+}
+
+
+ErrorPtr PersistenceWorker::saveParams(PersistentParams &aParams, const char *aParentId, bool aMultipleInstancesAllowed)
+{
+  ErrorPtr err;
+  if (aParams.dirty) {
+    const char *table = aParams.tableName();
+    // the statement: ROWID, keys, fields (in the order bindToStatement() binds them)
+    string sql = string_format("INSERT OR REPLACE INTO %s (ROWID", table);
+    string values = "?";
+    for (size_t i=0; i<aParams.numKeyDefs(); i++) {
+      sql += ","; sql += aParams.getKeyDef(i)->fieldName;
+      values += ",?";
+    }
+    for (size_t i=0; i<aParams.numFieldDefs(); i++) {
+      sql += ","; sql += aParams.getFieldDef(i)->fieldName;
+      values += ",?";
+    }
+    sql += ") VALUES (" + values + ")";
+    int numValues = 1+(int)aParams.numKeyDefs()+(int)aParams.numFieldDefs();
+    sqlite3pp::query *q = isValidStatement(sql) ? captureQueryFor(numValues) : NULL;
+    if (!q) {
+      // cannot snapshot (table not yet created or columns missing): let the record save itself, after all pending writes
+      flush();
+      nextRowIds.erase(table);
+      return aParams.saveToStore(aParentId, aMultipleInstancesAllowed);
+    }
+    if (aParams.rowid==0) {
+      if (!aMultipleInstancesAllowed) {
+        // single instance per parent: re-use an existing record
+        sqlite3pp::query q(paramStore);
+        if (q.prepare(string_format("SELECT ROWID FROM %s WHERE parentID=?", table).c_str())==SQLITE_OK) {
+          q.bind(1, aParentId, false);
+          sqlite3pp::query::iterator row = q.begin();
+          if (row!=q.end()) aParams.rowid = row->get<long long>(0);
+        }
+      }
+      if (aParams.rowid==0) aParams.rowid = newRowId(table);
+    }
+    // take the snapshot, with the values exactly as bindToStatement() binds them
+    q->reset();
+    q->bind(1, (long long)aParams.rowid);
+    int index = 2;
+    aParams.bindToStatement(*q, index, aParentId, 0);
+    sqlite3pp::query::iterator row = q->begin();
+    if (row==q->end()) {
+      err = paramStore.error();
+    }
+    else {
+      WriteJob job;
+      job.sql = sql;
+      // the record gets marked dirty again when the write fails, so it must stay alive until then
+      job.keepAlive = dynamic_cast<P44Obj *>(&aParams);
+      if (job.keepAlive) job.params = &aParams;
+      job.values.resize(numValues);
+      for (int i=0; i<numValues; i++) {
+        SnapshotValue &v = job.values[i];
+        v.type = row->column_type(i);
+        v.intValue = 0;
+        v.doubleValue = 0;
+        if (v.type==SQLITE_INTEGER) {
+          v.intValue = row->get<long long>(i);
+        }
+        else if (v.type==SQLITE_FLOAT) {
+          v.doubleValue = row->get<double>(i);
+        }
+        else if (v.type==SQLITE_TEXT || v.type==SQLITE_BLOB) {
+          const char *p = (const char *)row->get<const void *>(i);
+          if (p) v.data.assign(p, row->column_bytes(i));
+        }
+      }
+      queueJob(job);
+      aParams.markClean();
+    }
+    q->reset(); // release the bound values
+  }
+  // anyway, save children
+  if (Error::isOK(err)) err = aParams.saveChildren();
+  return err;
+}
+
+
+ErrorPtr PersistenceWorker::deleteParams(PersistentParams &aParams)
+{
+  ErrorPtr err = aParams.deleteChildren();
+  if (aParams.rowid!=0) {
+    write(string_format("DELETE FROM %s WHERE ROWID=%lld", aParams.tableName(), (long long)aParams.rowid));
+    aParams.rowid = 0;
+  }
+  return err;
+}
+
+
+ErrorPtr PersistenceWorker::save(PersistenceWorker *aWorker, PersistentParams &aParams, const char *aParentId, bool aMultipleInstancesAllowed)
+{
+  if (aWorker) return aWorker->saveParams(aParams, aParentId, aMultipleInstancesAllowed);
+  SaveJournal::recordSave(aParams);
+  return CachingParamStore::save(aParams, aParentId, aMultipleInstancesAllowed);
+}
+
+
+ErrorPtr PersistenceWorker::forget(PersistenceWorker *aWorker, PersistentParams &aParams)
+{
+  if (aWorker) return aWorker->deleteParams(aParams);
+  return CachingParamStore::forget(aParams);
+}
+
+
+ErrorPtr PersistenceWorker::execute(PersistenceWorker *aWorker, ParamStore &aParamStore, const string &aSql, StatusCB aDoneCB)
+{
+  if (aWorker) {
+    aWorker->write(aSql, aDoneCB);
+    return ErrorPtr();
+  }
+  ErrorPtr err;
+  if (aParamStore.execute(aSql.c_str())!=SQLITE_OK) err = aParamStore.error();
+  if (aDoneCB) aDoneCB(err);
+  return err;
+}
@@ -0,0 +1,192 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44vdc__persistenceworker__
+#define __p44vdc__persistenceworker__
+
+#include "p44utils_common.hpp"
+
+#include "persistentparams.hpp"
+
+#include <pthread.h>
+#include <set>
+
+using namespace std;
+
+namespace p44 {
+
+  // max number of writes the worker thread executes in one transaction
+  #ifndef PERSISTENCE_WORKER_BATCH_SIZE
+    #define PERSISTENCE_WORKER_BATCH_SIZE 100
+  #endif
+
+  // time in milliseconds a DB connection waits for the other connection's write transaction to finish
+  #ifndef PERSISTENCE_BUSY_TIMEOUT
+    #define PERSISTENCE_BUSY_TIMEOUT 5000
+  #endif
+
+  class PersistenceWorker;
+  typedef boost::intrusive_ptr<PersistenceWorker> PersistenceWorkerPtr;
+
+  /// Worker thread writing persistent params to the DB, so the main loop never has to wait for the disk.
+  /// Writes are snapshotted on the main thread: the values of the record are bound (using bindToStatement()) to a
+  /// query on the main thread's DB connection that just returns them, and are captured with their exact types.
+  /// The worker thread binds these values to its own prepared statements and executes them in order, in batched
+  /// transactions on its own DB connection.
+  /// @note ROWIDs of new records are assigned on the main thread, so parent ROWIDs can be used by children right away.
+  /// @note the DB must use a write-ahead log, so the main thread can still read while the worker writes.
+  /// @note while the worker is running, all writes must be passed to it. The main thread must not write
+  ///   to the DB itself, and must not hold transactions open on its own connection.
+  /// @note records are marked clean when their values are captured. When writing them fails in the worker
+  ///   (including a failed commit of the batch), they are marked dirty again, so the next save retries.
+  class PersistenceWorker : public P44Obj
+  {
+    typedef P44Obj inherited;
+
+    /// a value captured from a record on the main thread
+    class SnapshotValue
+    {
+    public:
+      int type; ///< SQLite fundamental datatype (SQLITE_NULL, SQLITE_INTEGER, ...)
+      long long intValue;
+      double doubleValue;
+      string data; ///< text or blob
+    };
+    typedef vector<SnapshotValue> SnapshotValues;
+
+    /// a write operation
+    class WriteJob
+    {
+    public:
+      string sql; ///< the SQL text, with parameters if values are present, self-contained otherwise
+      SnapshotValues values; ///< the values for the parameters of sql
+      StatusCB doneCB; ///< called on the main thread when written (or failed)
+      PersistentParams *params; ///< the record the values were captured from, NULL if none
+      boost::intrusive_ptr<P44Obj> keepAlive; ///< keeps the record alive until the job is done
+      ErrorPtr err; ///< result
+      WriteJob() : params(NULL) {};
+    };
+    typedef list<WriteJob> WriteJobList;
+
+    /// statement on the worker thread's connection, executed with captured values
+    class WriteCommand : public sqlite3pp::command
+    {
+    public:
+      WriteCommand(sqlite3pp::database &aDb) : sqlite3pp::command(aDb) {};
+      void bindValues(const SnapshotValues &aValues);
+    };
+    typedef map<string, WriteCommand *> WriteCommandMap;
+
+    typedef map<int, sqlite3pp::query *> CaptureQueryMap;
+    typedef set<string> SqlSet;
+    typedef map<string, long long> RowIdMap;
+
+    ParamStore &paramStore; ///< the main thread's DB connection
+    string dbPath; ///< the DB file for the worker's own connection
+    ChildThreadWrapperPtr workerThread; ///< the worker thread
+
+    // main thread only
+    CaptureQueryMap captureQueries; ///< prepared queries for capturing values, by number of values
+    SqlSet validStatements; ///< statements known to be valid for the current DB schema
+    RowIdMap nextRowIds; ///< next ROWID to assign to new records, by table
+
+    // shared with the worker thread
+    pthread_mutex_t queueAccess; ///< protects the following fields
+    pthread_cond_t queueChanged; ///< signalled when jobs are queued or done, and when the worker should terminate
+    WriteJobList pending; ///< jobs not yet taken by the worker
+    WriteJobList completed; ///< jobs done, callbacks not yet run on the main thread
+    bool busy; ///< set while the worker executes a batch
+    bool terminating; ///< set when the worker should terminate
+
+  public:
+
+    /// create the worker
+    /// @param aParamStore the DB connection used on the main thread
+    /// @param aDbPath the path of the DB file, for opening the worker thread's own connection
+    PersistenceWorker(ParamStore &aParamStore, const string aDbPath);
+    virtual ~PersistenceWorker();
+
+    /// start the worker thread
+    void start();
+
+    /// wait for all queued writes to be done and stop the worker thread
+    void stop();
+
+    /// queue a write
+    /// @param aSql the SQL to execute, must be self-contained (no parameters)
+    /// @param aDoneCB called on the main thread when the write is done
+    void write(const string &aSql, StatusCB aDoneCB = NULL);
+
+    /// sync barrier
+    /// @param aSyncedCB called on the main thread when all writes queued so far are done
+    void sync(StatusCB aSyncedCB);
+
+    /// wait until all writes queued so far are done
+    /// @note this blocks the main thread, only use when really needed (shutdown, reading records with pending writes)
+    void flush();
+
+    /// @return true if there are writes not yet done
+    bool hasPendingWrites();
+
+    /// save a record (and its children), like PersistentParams::saveToStore() does
+    /// @param aWorker the worker, can be NULL (then the record is saved directly)
+    /// @param aParams the record
+    /// @param aParentId the parent identifier, can be NULL
+    /// @param aMultipleInstancesAllowed if set, multiple records with the same parent identifier can exist
+    /// @return ok or error
+    /// @note records saved directly are recorded in the started save journal, if any (see SaveJournal::recordSave())
+    static ErrorPtr save(PersistenceWorker *aWorker, PersistentParams &aParams, const char *aParentId, bool aMultipleInstancesAllowed);
+
+    /// delete a record (and its children), like PersistentParams::deleteFromStore() does
+    /// @param aWorker the worker, can be NULL (then the record is deleted directly)
+    /// @param aParams the record
+    /// @return ok or error
+    static ErrorPtr forget(PersistenceWorker *aWorker, PersistentParams &aParams);
+
+    /// execute a SQL statement
+    /// @param aWorker the worker, can be NULL (then the statement is executed directly)
+    /// @param aParamStore the DB connection used on the main thread
+    /// @param aSql the SQL to execute, must be self-contained (no parameters). Can consist of multiple statements,
+    ///   execution stops at the first failing one.
+    /// @param aDoneCB if set, called with the result when the SQL has been executed (on the main thread, and
+    ///   before returning when executed directly)
+    /// @return ok or error (errors occurring in the worker thread are passed to aDoneCB only)
+    static ErrorPtr execute(PersistenceWorker *aWorker, ParamStore &aParamStore, const string &aSql, StatusCB aDoneCB = NULL);
+
+  private:
+
+    ErrorPtr saveParams(PersistentParams &aParams, const char *aParentId, bool aMultipleInstancesAllowed);
+    ErrorPtr deleteParams(PersistentParams &aParams);
+    bool isValidStatement(const string &aSql);
+    sqlite3pp::query *captureQueryFor(int aNumValues);
+    long long newRowId(const char *aTableName);
+    void queueJob(const WriteJob &aJob);
+
+    void workerThreadRoutine(ChildThreadWrapper &aThread);
+    static int executeJob(sqlite3pp::database &aDb, WriteCommandMap &aCommands, const WriteJob &aJob);
+    void workerThreadSignal(ChildThreadWrapper &aChildThread, ThreadSignals aSignalCode);
+    void runCompletedCallbacks();
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__p44vdc__persistenceworker__) */
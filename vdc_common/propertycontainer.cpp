@@ -27,25 +27,391 @@
 #define FOCUSLOGLEVEL 0
 
 #include "propertycontainer.hpp"
+#include "recyclingpool.hpp"
+
+#include <typeinfo>
+#include <algorithm>
 
 // needed to implement reading from CSV
 #include "jsonvdcapi.hpp"
+#include "p44vdc_common.hpp"
 
 using namespace p44;
 
 
+// MARK: ===== PropertyDescriptor
+
+// max number of released descriptor slots kept for re-use
+#ifndef PROPERTY_DESCRIPTOR_POOL_MAX
+  #define PROPERTY_DESCRIPTOR_POOL_MAX 4096
+#endif
+
+#define PROPERTY_DESCRIPTOR_SLOT_SIZE \
+  (sizeof(DynamicPropertyDescriptor)>sizeof(StaticPropertyDescriptor) ? sizeof(DynamicPropertyDescriptor) : sizeof(StaticPropertyDescriptor))
+
+static RecyclingPool<PROPERTY_DESCRIPTOR_SLOT_SIZE, PROPERTY_DESCRIPTOR_POOL_MAX> propertyDescriptorPool;
+
+
+void *PropertyDescriptor::operator new(size_t aSize)
+{
+  return propertyDescriptorPool.allocate(aSize);
+}
+
+
+void PropertyDescriptor::operator delete(void *aPtr, size_t aSize)
+{
+  propertyDescriptorPool.release(aPtr, aSize);
+}
+
+
+// max number of shared descriptors (each about 100 bytes, shared descriptors are never deleted)
+#ifndef PROPERTY_SHARED_DESCRIPTORS_MAX
+  #define PROPERTY_SHARED_DESCRIPTORS_MAX 16384
+#endif
+
+// max number of shared dynamic descriptors per parent (array elements such as scenes, channels or devices)
+#ifndef PROPERTY_SHARED_DYNAMIC_CHILDREN_MAX
+  #define PROPERTY_SHARED_DYNAMIC_CHILDREN_MAX 256
+#endif
+
+static long numSharedDescriptors = 0;
+
+
+namespace p44 {
+
+  /// open addressing hash set of shared descriptors
+  class PropertyDescriptorSet
+  {
+    vector<PropertyDescriptor *> slots; ///< size is a power of 2, NULL for unused slots
+    size_t numUsed;
+
+  public:
+
+    PropertyDescriptorSet() : numUsed(0) {};
+
+    /// @return the descriptor in the set that is the same as aProbe, NULL if none
+    PropertyDescriptor *find(const PropertyDescriptor &aProbe) const
+    {
+      if (slots.empty()) return NULL;
+      size_t mask = slots.size()-1;
+      for (size_t i = aProbe.sharingHash() & mask; slots[i]; i = (i+1) & mask) {
+        if (slots[i]->sameAs(aProbe)) return slots[i];
+      }
+      return NULL;
+    }
+
+    /// add a descriptor not yet in the set
+    void insert(PropertyDescriptor *aDesc)
+    {
+      if ((numUsed+1)*2>slots.size()) {
+        // keep load below 50%
+        vector<PropertyDescriptor *> old;
+        old.swap(slots);
+        slots.resize(old.empty() ? 16 : old.size()*2, NULL);
+        numUsed = 0;
+        for (vector<PropertyDescriptor *>::iterator pos = old.begin(); pos!=old.end(); ++pos) {
+          if (*pos) insert(*pos);
+        }
+      }
+      size_t mask = slots.size()-1;
+      size_t i = aDesc->sharingHash() & mask;
+      while (slots[i]) i = (i+1) & mask;
+      slots[i] = aDesc;
+      numUsed++;
+    }
+  };
+
+
+  /// name index of the properties of one container class at one property level
+  class PropertyNameIndex
+  {
+    const type_info *containerType; ///< the container class
+    int domain;
+    int numProps;
+    bool indexable; ///< cleared when this level has no static properties, or the container does not match the index
+    vector<PropertyDescriptor *> statics; ///< per property index: the shared static descriptor, NULL if the property must be looked at every time
+    vector<int> nextSameName; ///< per property index: the next index of a static property with the same name, -1 if none
+    vector<int> liveSlots; ///< ascending indices of the properties that must be looked at every time
+    vector<int> nameSlots; ///< open addressing hash of names, first index with that name +1, 0 for unused slots
+    typedef map<string, vector<int> > QueryPlanMap;
+    QueryPlanMap plans; ///< wildcard prefix -> ascending indices of the matching static and all live properties
+
+    PropertyNameIndex(PropertyContainer &aContainer, int aDomain, int aNumProps, PropertyDescriptorPtr aParentDescriptor);
+
+    static size_t nameHash(const char *aName);
+    int firstIndexNamed(const char *aName) const;
+    void buildPlan(const string &aPrefix, vector<int> &aPlan) const;
+    void invalidate();
+
+  public:
+
+    /// get the name index for a property level
+    /// @return the index, NULL if the level cannot be indexed
+    static PropertyNameIndex *indexFor(PropertyContainer &aContainer, int aDomain, int aNumProps, PropertyDescriptorPtr aParentDescriptor);
+
+    /// find the first property named aName
+    /// @param aIndex on input: the property index to start searching, on exit: the index of the property found, numProps if none
+    /// @param aDesc set to the descriptor of the property found, NULL if none
+    /// @return false if the container does not match the index. The index is unusable from now on, and the caller must scan.
+    bool findByName(PropertyContainer &aContainer, const string &aName, int &aIndex, PropertyDescriptorPtr &aDesc, PropertyDescriptorPtr aParentDescriptor);
+
+    /// find the first property whose name starts with aPrefix
+    /// @param aPrefix the wildcard query element without the asterisk, must not be empty
+    /// @note see findByName() for the other parameters and the return value
+    bool findByPrefix(PropertyContainer &aContainer, const string &aPrefix, int &aIndex, PropertyDescriptorPtr &aDesc, PropertyDescriptorPtr aParentDescriptor);
+  };
+
+
+  /// the shared child descriptors of a shared descriptor
+  struct PropertyDescriptorChildren
+  {
+    PropertyDescriptorSet descriptors; ///< the shared child descriptors
+    int numDynamic; ///< number of shared dynamic descriptors among them
+    vector<PropertyNameIndex *> nameIndices; ///< name indices for the container classes accessed with this parent
+
+    PropertyDescriptorChildren() : numDynamic(0) {};
+
+    ~PropertyDescriptorChildren()
+    {
+      for (vector<PropertyNameIndex *>::iterator pos = nameIndices.begin(); pos!=nameIndices.end(); ++pos) delete *pos;
+    }
+  };
+
+} // namespace p44
+
+
+PropertyDescriptor::PropertyDescriptor(PropertyDescriptorPtr aParentDescriptor) :
+  refCount(0),
+  sharedDesc(false),
+  children(NULL),
+  rootVariant(NULL),
+  rootOfObject(false),
+  parentDescriptor(aParentDescriptor)
+{
+}
+
+
+PropertyDescriptor::PropertyDescriptor(const PropertyDescriptor &aOther) :
+  refCount(0),
+  sharedDesc(false),
+  children(NULL),
+  rootVariant(NULL),
+  rootOfObject(aOther.rootOfObject),
+  parentDescriptor(aOther.parentDescriptor)
+{
+}
+
+
+PropertyDescriptor::~PropertyDescriptor()
+{
+  delete children;
+}
+
+
+string PropertyDescriptor::poolStatistics()
+{
+  return string_format("%ld shared property descriptors, ", numSharedDescriptors) + "other property descriptors: " + propertyDescriptorPool.statistics();
+}
+
+
+PropertyDescriptorPtr PropertyDescriptor::share(PropertyDescriptorPtr aDesc, bool aStatic)
+{
+  PropertyDescriptor *parent = aDesc->parentDescriptor.get();
+  if (aDesc->sharedDesc || !parent || !parent->sharedDesc) return aDesc; // already shared, or private to one access like its parent
+  if (!parent->children) parent->children = new PropertyDescriptorChildren;
+  PropertyDescriptor *existing = parent->children->descriptors.find(*aDesc);
+  if (existing) return existing;
+  if (numSharedDescriptors>=PROPERTY_SHARED_DESCRIPTORS_MAX) return aDesc;
+  if (!aStatic) {
+    // dynamic properties can be many, limit them per level
+    if (parent->children->numDynamic>=PROPERTY_SHARED_DYNAMIC_CHILDREN_MAX) return aDesc;
+    parent->children->numDynamic++;
+  }
+  // from now on, this descriptor is immutable and lives forever
+  aDesc->sharedDesc = true;
+  numSharedDescriptors++;
+  parent->children->descriptors.insert(aDesc.get());
+  return aDesc;
+}
+
+
+PropertyDescriptor *PropertyDescriptor::findShared(const PropertyDescriptor &aProbe)
+{
+  PropertyDescriptor *parent = aProbe.parentDescriptor.get();
+  if (!parent || !parent->children) return NULL;
+  return parent->children->descriptors.find(aProbe);
+}
+
+
+PropertyDescriptorPtr PropertyDescriptor::shared(PropertyDescriptorPtr aDesc)
+{
+  if (!aDesc) return aDesc;
+  return share(aDesc, dynamic_cast<StaticPropertyDescriptor *>(aDesc.get())!=NULL);
+}
+
+
+PropertyDescriptorPtr PropertyDescriptor::asRootOfObject()
+{
+  if (rootOfObject) return this;
+  if (!sharedDesc) {
+    // private to this access, can be modified
+    rootOfObject = true;
+    return this;
+  }
+  // shared ones are immutable, use the shared root variant
+  if (rootVariant) return rootVariant;
+  PropertyDescriptorPtr variant = PropertyDescriptorPtr(copy());
+  variant->rootOfObject = true;
+  variant = share(variant, true); // there is only one root variant per descriptor
+  if (variant->sharedDesc) rootVariant = variant.get();
+  return variant;
+}
+
+
+PropertyDescriptorPtr RootPropertyDescriptor::forApiVersion(int aApiVersion)
+{
+  static map<int, RootPropertyDescriptor *> roots;
+  RootPropertyDescriptor *&root = roots[aApiVersion];
+  if (!root) {
+    root = new RootPropertyDescriptor(aApiVersion);
+    root->sharedDesc = true;
+    numSharedDescriptors++;
+  }
+  return root;
+}
+
+
+PropertyDescriptorPtr StaticPropertyDescriptor::descriptorFor(const PropertyDescription *aDescP, PropertyDescriptorPtr aParentDescriptor)
+{
+  if (aParentDescriptor->isShared()) {
+    // look up existing shared descriptor without creating a new one
+    StaticPropertyDescriptor probe(aDescP, aParentDescriptor);
+    PropertyDescriptor *existing = findShared(probe);
+    if (existing) return existing;
+  }
+  return share(PropertyDescriptorPtr(new StaticPropertyDescriptor(aDescP, aParentDescriptor)), true);
+}
+
+
+size_t StaticPropertyDescriptor::sharingHash() const
+{
+  // table entries are at least 8 bytes apart
+  return (((uintptr_t)descP)>>3)*2 + (rootOfObject ? 1 : 0);
+}
+
+
+bool StaticPropertyDescriptor::sameAs(const PropertyDescriptor &aOther) const
+{
+  const StaticPropertyDescriptor *other = dynamic_cast<const StaticPropertyDescriptor *>(&aOther);
+  return other && other->descP==descP && other->rootOfObject==rootOfObject;
+}
+
+
+size_t DynamicPropertyDescriptor::sharingHash() const
+{
+  // FNV-1a over the name, plus the keys
+  size_t h = 2166136261u;
+  for (const char *p = propertyName.c_str(); *p; p++) {
+    h = (h ^ (uint8_t)*p) * 16777619u;
+  }
+  return h ^ (propertyFieldKey*31) ^ (size_t)propertyObjectKey;
+}
+
+
+bool DynamicPropertyDescriptor::sameAs(const PropertyDescriptor &aOther) const
+{
+  const DynamicPropertyDescriptor *other = dynamic_cast<const DynamicPropertyDescriptor *>(&aOther);
+  return
+    other &&
+    other->propertyName==propertyName &&
+    other->propertyType==propertyType &&
+    other->propertyFieldKey==propertyFieldKey &&
+    other->propertyObjectKey==propertyObjectKey &&
+    other->arrayContainer==arrayContainer &&
+    other->deletable==deletable &&
+    other->needsReadPrep==needsReadPrep &&
+    other->needsWritePrep==needsWritePrep &&
+    other->rootOfObject==rootOfObject;
+}
+
+
+// MARK: ===== PropertyContainer
+
+// max number of property preparations (usually hardware roundtrips) running at the same time within one property access
+#ifndef PROPERTY_PREPARATION_PARALLELISM
+  #define PROPERTY_PREPARATION_PARALLELISM 8
+#endif
+
+static int preparationParallelism = PROPERTY_PREPARATION_PARALLELISM;
+
+// global change generation counter, counts up with every change of any container
+static uint64_t propertyChangeGeneration = 0;
+// generation of the last addition or removal of a container or array element
+static uint64_t propertyStructureGeneration = 0;
+
+
+PropertyContainer::PropertyContainer() :
+  changeGeneration(++propertyChangeGeneration) // new containers count as changed
+{
+}
+
+
+void PropertyContainer::propertiesChanged()
+{
+  changeGeneration = ++propertyChangeGeneration;
+}
+
+
+uint64_t PropertyContainer::currentChangeGeneration()
+{
+  return propertyChangeGeneration;
+}
+
+
+void PropertyContainer::structureChanged()
+{
+  propertyStructureGeneration = ++propertyChangeGeneration;
+}
+
+
+uint64_t PropertyContainer::structureChangeGeneration()
+{
+  return propertyStructureGeneration;
+}
+
+
+void PropertyContainer::setPreparationParallelism(int aParallelism)
+{
+  preparationParallelism = aParallelism>0 ? aParallelism : 1;
+}
+
+
+// @return true if aObject has at least one field
+static bool hasFields(ApiValuePtr aObject)
+{
+  string key;
+  ApiValuePtr value;
+  aObject->resetKeyIteration();
+  return aObject->nextKeyValue(key, value);
+}
+
 
-void PropertyContainer::accessProperty(PropertyAccessMode aMode, ApiValuePtr aQueryObject, int aDomain, int aApiVersion, PropertyAccessCB aAccessCompleteCB)
+void PropertyContainer::accessProperty(PropertyAccessMode aMode, ApiValuePtr aQueryObject, int aDomain, int aApiVersion, PropertyAccessCB aAccessCompleteCB, uint64_t aSinceGeneration)
 {
   // create a list for possibly needed preparations
   PropertyPrepListPtr prepList = PropertyPrepListPtr(new PropertyPrepList);
-  // create root descriptor
-  PropertyDescriptorPtr parentDescriptor = PropertyDescriptorPtr(new RootPropertyDescriptor(aApiVersion));
+  // get the (shared) root descriptor
+  PropertyDescriptorPtr parentDescriptor = RootPropertyDescriptor::forApiVersion(aApiVersion);
   // first attempt to access
   // - create result object of same API type as query
   ApiValuePtr result;
   if (aMode==access_read) result = aQueryObject->newObject();
-  ErrorPtr err = accessPropertyInternal(aMode, aQueryObject, result, aDomain, parentDescriptor, prepList);
+  if (aMode==access_read && aSinceGeneration>0 && changeGeneration<=aSinceGeneration) {
+    // delta read, but nothing has changed in this object -> empty result
+    if (aAccessCompleteCB) aAccessCompleteCB(result, ErrorPtr());
+    return;
+  }
+  ErrorPtr err = accessPropertyInternal(aMode, aQueryObject, result, aDomain, parentDescriptor, prepList, aSinceGeneration);
   if (prepList->empty()) {
     // no need for preparation, immediately call back
     if (aAccessCompleteCB) aAccessCompleteCB(result, err);
@@ -53,32 +419,77 @@ void PropertyContainer::accessProperty(PropertyAccessMode aMode, ApiValuePtr aQu
     return;
   }
   // need preparation
-  prepareNext(prepList, aMode, aQueryObject, aDomain, parentDescriptor, aAccessCompleteCB, ErrorPtr());
+  PropertyPrepRunPtr prepRun = PropertyPrepRunPtr(new PropertyPrepRun);
+  prepRun->pending = prepList;
+  prepRun->mode = aMode;
+  prepRun->queryObject = aQueryObject;
+  prepRun->domain = aDomain;
+  prepRun->parentDescriptor = parentDescriptor;
+  prepRun->sinceGeneration = aSinceGeneration;
+  prepRun->accessCompleteCB = aAccessCompleteCB;
+  prepareNext(prepRun);
 }
 
 
-void PropertyContainer::prepareNext(PropertyPrepListPtr aPrepList, PropertyAccessMode aMode, ApiValuePtr aQueryObject, int aDomain, PropertyDescriptorPtr aParentDescriptor, PropertyAccessCB aAccessCompleteCB, ErrorPtr aError)
+// Start as many preparations as allowed. Preparations for different targets do not depend on each other
+// and are run concurrently (e.g. hardware roundtrips to different bus devices), those for the same target
+// are run one after the other.
+void PropertyContainer::prepareNext(PropertyPrepRunPtr aPrepRun)
+{
+  while ((int)aPrepRun->busyTargets.size()<preparationParallelism && !aPrepRun->pending->empty()) {
+    PropertyPrep prep = aPrepRun->pending->front();
+    aPrepRun->pending->pop_front();
+    if (aPrepRun->busyTargets.find(prep.target)!=aPrepRun->busyTargets.end()) {
+      // target is busy, start when it is done
+      aPrepRun->deferred[prep.target].push_back(prep);
+      continue;
+    }
+    startPreparation(aPrepRun, prep);
+  }
+}
+
+
+void PropertyContainer::startPreparation(PropertyPrepRunPtr aPrepRun, const PropertyPrep &aPrep)
+{
+  aPrepRun->busyTargets.insert(aPrep.target);
+  aPrep.target->prepareAccess(aPrepRun->mode, aPrep.propertyDescriptor,
+    boost::bind(&PropertyContainer::preparationDone, this, aPrepRun, aPrep.target, _1)
+  );
+}
+
+
+void PropertyContainer::preparationDone(PropertyPrepRunPtr aPrepRun, PropertyContainerPtr aTarget, ErrorPtr aError)
 {
   if (!Error::isOK(aError)) {
     LOG(LOG_WARNING, "- prepraration of property failed with error: %s", aError->description().c_str());
   }
-  if (aPrepList->empty()) {
+  // target is no longer busy
+  aPrepRun->busyTargets.erase(aTarget);
+  map<PropertyContainerPtr, PropertyPrepList>::iterator pos = aPrepRun->deferred.find(aTarget);
+  if (pos!=aPrepRun->deferred.end()) {
+    // next preparation for the same target
+    PropertyPrep prep = pos->second.front();
+    pos->second.pop_front();
+    if (pos->second.empty()) aPrepRun->deferred.erase(pos);
+    startPreparation(aPrepRun, prep);
+    // the run completes when the preparation just started is done
+    if (!aPrepRun->pending->empty()) prepareNext(aPrepRun);
+    return;
+  }
+  if (!aPrepRun->pending->empty()) {
+    // more to prepare
+    prepareNext(aPrepRun);
+    return;
+  }
+  if (aPrepRun->busyTargets.empty()) {
     // all prepared, access again
     // - create result object of same API type as query
     ApiValuePtr result;
-    if (aMode==access_read) result = aQueryObject->newObject();
-    ErrorPtr err = accessPropertyInternal(aMode, aQueryObject, result, aDomain, aParentDescriptor, PropertyPrepListPtr());
+    if (aPrepRun->mode==access_read) result = aPrepRun->queryObject->newObject();
+    ErrorPtr err = accessPropertyInternal(aPrepRun->mode, aPrepRun->queryObject, result, aPrepRun->domain, aPrepRun->parentDescriptor, PropertyPrepListPtr(), aPrepRun->sinceGeneration);
     // call back
-    if (aAccessCompleteCB) aAccessCompleteCB(result, err);
-    // done
-    return;
+    if (aPrepRun->accessCompleteCB) aPrepRun->accessCompleteCB(result, err);
   }
-  // prepare next item on the list
-  PropertyPrep prep = aPrepList->front();
-  aPrepList->pop_front();
-  prep.target->prepareAccess(aMode, prep.propertyDescriptor,
-    boost::bind(&PropertyContainer::prepareNext, this, aPrepList, aMode, aQueryObject, aDomain, aParentDescriptor, aAccessCompleteCB, _1)
-  );
 }
 
 
@@ -98,7 +509,7 @@ void PropertyContainer::finishAccess(PropertyAccessMode aMode, PropertyDescripto
 
 
 
-ErrorPtr PropertyContainer::accessPropertyInternal(PropertyAccessMode aMode, ApiValuePtr aQueryObject, ApiValuePtr aResultObject, int aDomain, PropertyDescriptorPtr aParentDescriptor, PropertyPrepListPtr aPreparationList)
+ErrorPtr PropertyContainer::accessPropertyInternal(PropertyAccessMode aMode, ApiValuePtr aQueryObject, ApiValuePtr aResultObject, int aDomain, PropertyDescriptorPtr aParentDescriptor, PropertyPrepListPtr aPreparationList, uint64_t aSinceGeneration)
 {
   ErrorPtr err;
   assert(aParentDescriptor);
@@ -123,6 +534,8 @@ ErrorPtr PropertyContainer::accessPropertyInternal(PropertyAccessMode aMode, Api
       return Error::err<VdcApiError>(415, "accessing property for read must provide result object");
     aResultObject->setType(apivalue_object); // must be object
   }
+  // writes might add elements to this level
+  int numPropsBefore = aMode!=access_read ? numProps(aDomain, aParentDescriptor) : 0;
   // Iterate trough elements of query object
   aQueryObject->resetKeyIteration();
   string queryName;
@@ -165,6 +578,10 @@ ErrorPtr PropertyContainer::accessPropertyInternal(PropertyAccessMode aMode, Api
               if (!accessField(access_delete, queryValue, propDesc)) { // delete
                 err = Error::err<VdcApiError>(403, "Cannot delete '%s'", propDesc->name());
               }
+              else {
+                propertiesChanged();
+                structureChanged();
+              }
             }
             else if (propDesc->isStructured()) {
               ApiValuePtr subQuery;
@@ -187,21 +604,28 @@ ErrorPtr PropertyContainer::accessPropertyInternal(PropertyAccessMode aMode, Api
                 // addressed property is a container by itself -> recurse
                 // - get the PropertyContainer
                 int containerDomain = aDomain; // default to same, but getContainer may modify it
-                PropertyDescriptorPtr containerPropDesc = propDesc;
-                PropertyContainerPtr container = getContainer(containerPropDesc, containerDomain);
+                // - descriptors of containers are shared, such that the descriptors of the next level are shared, too
+                PropertyDescriptorPtr containerPropDesc = PropertyDescriptor::shared(propDesc);
+                PropertyContainerPtr container = aMode==access_read ? getContainer(containerPropDesc, containerDomain) : getContainerForWrite(containerPropDesc, containerDomain);
                 if (container) {
                   FOCUSLOG("  - container for '%s' is 0x%p", propDesc->name(), container.get());
                   FOCUSLOG("    >>>> RECURSING into accessProperty()");
                   if (container!=this) {
                     // switching to another C++ object -> starting at root level in that object
-                    containerPropDesc->rootOfObject = true;
+                    containerPropDesc = containerPropDesc->asRootOfObject();
                   }
-                  if (aMode==access_read) {
+                  uint64_t since = aMode==access_read ? aSinceGeneration : 0;
+                  if (since>0 && container!=this && container->changeGeneration<=since) {
+                    // delta read, and the container has not changed since -> omit it
+                    FOCUSLOG("    - container for '%s' unchanged since generation %llu -> omitted", propDesc->name(), since);
+                  }
+                  else if (aMode==access_read) {
                     // read needs a result object
                     ApiValuePtr resultValue = queryValue->newValue(apivalue_object);
-                    err = container->accessPropertyInternal(aMode, subQuery, resultValue, containerDomain, containerPropDesc, aPreparationList);
-                    if (Error::isOK(err)) {
+                    err = container->accessPropertyInternal(aMode, subQuery, resultValue, containerDomain, containerPropDesc, aPreparationList, since);
+                    if (Error::isOK(err) && (since==0 || hasFields(resultValue))) {
                       // add to result with actual name (from descriptor)
+                      // Note: in delta reads, levels where all subcontainers were omitted are omitted as well
                       FOCUSLOG("\n  <<<< RETURNED from accessProperty() recursion");
                       FOCUSLOG("  - accessProperty of container for '%s' returns %s", propDesc->name(), resultValue->description().c_str());
                       aResultObject->add(propDesc->name(), resultValue);
@@ -215,6 +639,8 @@ ErrorPtr PropertyContainer::accessPropertyInternal(PropertyAccessMode aMode, Api
                   if ((aMode!=access_read) && Error::isOK(err)) {
                     // give this container a chance to post-process write access
                     err = writtenProperty(aMode, propDesc, aDomain, container);
+                    // something below has changed
+                    propertiesChanged();
                   }
                   // 404 errors are collected, but dont abort the query
                   if (Error::isError(err, VdcApiError::domain(), 404)) {
@@ -248,6 +674,9 @@ ErrorPtr PropertyContainer::accessPropertyInternal(PropertyAccessMode aMode, Api
                 else if (!accessField(aMode, queryValue, propDesc)) { // write
                   err = Error::err<VdcApiError>(403, "Write access to '%s' denied", propDesc->name());
                 }
+                else {
+                  propertiesChanged();
+                }
               }
             }
             if (propDesc->needsPreparation(aMode)) {
@@ -285,6 +714,10 @@ ErrorPtr PropertyContainer::accessPropertyInternal(PropertyAccessMode aMode, Api
     }
     #endif
   }
+  if (aMode!=access_read && numProps(aDomain, aParentDescriptor)!=numPropsBefore) {
+    // elements were added (or removed)
+    structureChanged();
+  }
   return err;
 }
 
@@ -328,6 +761,211 @@ bool PropertyContainer::getNextPropIndex(string aPropMatch, int &aStartIndex)
 
 
 
+// MARK: ===== property name index
+
+// max number of name indices per parent descriptor (one per container class, domain and number of properties)
+#ifndef PROPERTY_NAME_INDEX_VARIANTS_MAX
+  #define PROPERTY_NAME_INDEX_VARIANTS_MAX 4
+#endif
+
+// max number of wildcard query plans kept per name index
+#ifndef PROPERTY_QUERY_PLANS_PER_LEVEL
+  #define PROPERTY_QUERY_PLANS_PER_LEVEL 32
+#endif
+
+
+PropertyNameIndex *PropertyNameIndex::indexFor(PropertyContainer &aContainer, int aDomain, int aNumProps, PropertyDescriptorPtr aParentDescriptor)
+{
+  PropertyDescriptor *parent = aParentDescriptor.get();
+  if (!parent->sharedDesc) return NULL; // private to this access, no place to keep an index
+  if (!parent->children) parent->children = new PropertyDescriptorChildren;
+  vector<PropertyNameIndex *> &indices = parent->children->nameIndices;
+  for (vector<PropertyNameIndex *>::iterator pos = indices.begin(); pos!=indices.end(); ++pos) {
+    PropertyNameIndex *idx = *pos;
+    if (idx->domain==aDomain && idx->numProps==aNumProps && *(idx->containerType)==typeid(aContainer)) {
+      return idx->indexable ? idx : NULL;
+    }
+  }
+  if (indices.size()>=PROPERTY_NAME_INDEX_VARIANTS_MAX) return NULL; // too many variants on this level
+  PropertyNameIndex *idx = new PropertyNameIndex(aContainer, aDomain, aNumProps, aParentDescriptor);
+  indices.push_back(idx);
+  return idx->indexable ? idx : NULL;
+}
+
+
+PropertyNameIndex::PropertyNameIndex(PropertyContainer &aContainer, int aDomain, int aNumProps, PropertyDescriptorPtr aParentDescriptor) :
+  containerType(&typeid(aContainer)),
+  domain(aDomain),
+  numProps(aNumProps),
+  indexable(true)
+{
+  // walk all properties once
+  statics.resize(numProps, NULL);
+  nextSameName.resize(numProps, -1);
+  int numStatics = 0;
+  for (int i=0; i<numProps; i++) {
+    PropertyDescriptorPtr propDesc = aContainer.getDescriptorByIndex(i, aDomain, aParentDescriptor);
+    if (propDesc && propDesc->sharedDesc && dynamic_cast<StaticPropertyDescriptor *>(propDesc.get())) {
+      statics[i] = propDesc.get();
+      numStatics++;
+    }
+    else {
+      // suppressed (possibly only in this instance), dynamic or not shared
+      liveSlots.push_back(i);
+    }
+  }
+  if (numStatics==0) {
+    // nothing to gain, e.g. array-like level
+    invalidate();
+    return;
+  }
+  // hash the names, keep load below 50%
+  size_t sz = 16;
+  while (sz<2*(size_t)numStatics) sz *= 2;
+  nameSlots.resize(sz, 0);
+  size_t mask = sz-1;
+  // backwards, such that the chains of same named properties are ascending
+  for (int i=numProps-1; i>=0; i--) {
+    if (!statics[i]) continue;
+    const char *name = statics[i]->name();
+    size_t h = nameHash(name) & mask;
+    while (nameSlots[h] && strcmp(statics[nameSlots[h]-1]->name(), name)!=0) h = (h+1) & mask;
+    if (nameSlots[h]) nextSameName[i] = nameSlots[h]-1;
+    nameSlots[h] = i+1;
+  }
+}
+
+
+void PropertyNameIndex::invalidate()
+{
+  indexable = false;
+  statics.clear();
+  nextSameName.clear();
+  liveSlots.clear();
+  nameSlots.clear();
+  plans.clear();
+}
+
+
+size_t PropertyNameIndex::nameHash(const char *aName)
+{
+  // FNV-1a
+  size_t h = 2166136261u;
+  for (const char *p = aName; *p; p++) {
+    h = (h ^ (uint8_t)*p) * 16777619u;
+  }
+  return h;
+}
+
+
+int PropertyNameIndex::firstIndexNamed(const char *aName) const
+{
+  size_t mask = nameSlots.size()-1;
+  for (size_t h = nameHash(aName) & mask; nameSlots[h]; h = (h+1) & mask) {
+    int i = nameSlots[h]-1;
+    if (strcmp(statics[i]->name(), aName)==0) return i;
+  }
+  return -1;
+}
+
+
+bool PropertyNameIndex::findByName(PropertyContainer &aContainer, const string &aName, int &aIndex, PropertyDescriptorPtr &aDesc, PropertyDescriptorPtr aParentDescriptor)
+{
+  // candidates are the static properties with that name, and the live ones, in ascending order
+  int s = firstIndexNamed(aName.c_str());
+  while (s>=0 && s<aIndex) s = nextSameName[s];
+  vector<int>::const_iterator lpos = lower_bound(liveSlots.begin(), liveSlots.end(), aIndex);
+  while (s>=0 || lpos!=liveSlots.end()) {
+    if (lpos==liveSlots.end() || (s>=0 && s<*lpos)) {
+      aDesc = aContainer.getDescriptorByIndex(s, domain, aParentDescriptor);
+      if (aDesc.get()==statics[s]) {
+        aIndex = s;
+        return true;
+      }
+      if (aDesc) {
+        // container returns another property than when the index was built
+        LOG(LOG_WARNING, "%s returns different properties at index %d, cannot index its properties", containerType->name(), s);
+        invalidate();
+        return false;
+      }
+      s = nextSameName[s]; // suppressed
+    }
+    else {
+      int l = *lpos++;
+      aDesc = aContainer.getDescriptorByIndex(l, domain, aParentDescriptor);
+      if (aDesc && aName==aDesc->name()) {
+        aIndex = l;
+        return true;
+      }
+    }
+  }
+  aDesc.reset();
+  aIndex = numProps;
+  return true;
+}
+
+
+void PropertyNameIndex::buildPlan(const string &aPrefix, vector<int> &aPlan) const
+{
+  vector<int>::const_iterator lpos = liveSlots.begin();
+  for (int i=0; i<numProps; i++) {
+    if (statics[i]) {
+      if (strncmp(aPrefix.c_str(), statics[i]->name(), aPrefix.size())==0) aPlan.push_back(i);
+    }
+    else if (lpos!=liveSlots.end() && *lpos==i) {
+      aPlan.push_back(i);
+      ++lpos;
+    }
+  }
+}
+
+
+bool PropertyNameIndex::findByPrefix(PropertyContainer &aContainer, const string &aPrefix, int &aIndex, PropertyDescriptorPtr &aDesc, PropertyDescriptorPtr aParentDescriptor)
+{
+  QueryPlanMap::iterator ppos = plans.find(aPrefix);
+  vector<int> tempPlan;
+  const vector<int> *plan;
+  if (ppos!=plans.end()) {
+    plan = &(ppos->second);
+  }
+  else if (plans.size()<PROPERTY_QUERY_PLANS_PER_LEVEL) {
+    vector<int> &newPlan = plans[aPrefix];
+    buildPlan(aPrefix, newPlan);
+    plan = &newPlan;
+  }
+  else {
+    // too many different queries on this level, don't cache
+    buildPlan(aPrefix, tempPlan);
+    plan = &tempPlan;
+  }
+  for (vector<int>::const_iterator pos = lower_bound(plan->begin(), plan->end(), aIndex); pos!=plan->end(); ++pos) {
+    int i = *pos;
+    aDesc = aContainer.getDescriptorByIndex(i, domain, aParentDescriptor);
+    if (statics[i]) {
+      if (aDesc.get()==statics[i]) {
+        aIndex = i;
+        return true;
+      }
+      if (aDesc) {
+        // container returns another property than when the index was built
+        LOG(LOG_WARNING, "%s returns different properties at index %d, cannot index its properties", containerType->name(), i);
+        invalidate(); // Note: this also deletes the plan we are iterating
+        return false;
+      }
+    }
+    else if (aDesc && strncmp(aPrefix.c_str(), aDesc->name(), aPrefix.size())==0) {
+      aIndex = i;
+      return true;
+    }
+  }
+  aDesc.reset();
+  aIndex = numProps;
+  return true;
+}
+
+
+// MARK: ===== PropertyContainer name resolution
+
 // default implementation based on numProps/getDescriptorByIndex
 // Derived classes with array-like container may directly override this method for more efficient access
 PropertyDescriptorPtr PropertyContainer::getDescriptorByName(string aPropMatch, int &aStartIndex, int aDomain, PropertyAccessMode aMode, PropertyDescriptorPtr aParentDescriptor)
@@ -341,6 +979,7 @@ PropertyDescriptorPtr PropertyContainer::getDescriptorByName(string aPropMatch,
     // - #n to access n-th property
     PropertyDescriptorPtr propDesc;
     bool wildcard = false; // assume no wildcard
+    bool byIndex = false;
     if (aPropMatch.empty()) {
       wildcard = true; // implicit wildcard, empty name counts like "*"
     }
@@ -354,6 +993,7 @@ PropertyDescriptorPtr PropertyContainer::getDescriptorByName(string aPropMatch,
       if (sscanf(aPropMatch.c_str()+1, "%d", &newIndex)==1) {
         // name does not matter, pick item at newIndex unless below current start
         wildcard = true;
+        byIndex = true;
         aPropMatch.clear();
         if(newIndex>=aStartIndex)
           aStartIndex = newIndex; // not yet passed this index in iteration -> use it
@@ -361,6 +1001,23 @@ PropertyDescriptorPtr PropertyContainer::getDescriptorByName(string aPropMatch,
           aStartIndex = n; // already passed -> make out of range
       }
     }
+    if (!aPropMatch.empty()) {
+      // use the name index and query plans of this property level, if there are any
+      // Note: matching all needs no index, every property is a match
+      PropertyNameIndex *nameIndex = PropertyNameIndex::indexFor(*this, aDomain, n, aParentDescriptor);
+      int idx = aStartIndex;
+      if (
+        nameIndex && (wildcard ?
+          nameIndex->findByPrefix(*this, aPropMatch, idx, propDesc, aParentDescriptor) :
+          nameIndex->findByName(*this, aPropMatch, idx, propDesc, aParentDescriptor)
+        )
+      ) {
+        aStartIndex = idx<n ? idx+1 : n;
+        if (aStartIndex>=n)
+          aStartIndex=PROPINDEX_NONE;
+        return propDesc;
+      }
+    }
     while (aStartIndex<n) {
       propDesc = getDescriptorByIndex(aStartIndex, aDomain, aParentDescriptor);
       // skip non-existent ones (might happen if subclass suppresses some properties)
@@ -426,7 +1083,14 @@ PropertyDescriptorPtr PropertyContainer::getDescriptorByNumericName(
 
 bool PropertyContainer::readPropsFromCSV(int aDomain, bool aOnlyExplicitlyOverridden, const char *&aCSVCursor, const char *aTextSourceName, int aLineNo)
 {
-  bool anySettingsApplied = false;
+  CompiledPropertySettingsList settings;
+  compilePropsFromCSV(aCSVCursor, aTextSourceName, aLineNo, settings);
+  return applyCompiledProps(aDomain, aOnlyExplicitlyOverridden, settings, aTextSourceName);
+}
+
+
+void PropertyContainer::compilePropsFromCSV(const char *&aCSVCursor, const char *aTextSourceName, int aLineNo, CompiledPropertySettingsList &aSettings)
+{
   string f;
   const char *fp;
   // process properties
@@ -456,13 +1120,10 @@ bool PropertyContainer::readPropsFromCSV(int aDomain, bool aOnlyExplicitlyOverri
       fp++;
       overridden = true; // explicit override
     }
-    // check if we should apply it
-    if (aOnlyExplicitlyOverridden && !overridden) {
-      // skip this property
-      continue;
-    }
-    // now apply
+    // now compile
+    CompiledPropertySetting setting;
     while (nextPart(fp, part, '/')) {
+      setting.pathParts.push_back(part);
       if (*fp) {
         // not last part, add another query level
         ApiValuePtr nextlvl = proplvl->newValue(apivalue_object);
@@ -495,13 +1156,37 @@ bool PropertyContainer::readPropsFromCSV(int aDomain, bool aOnlyExplicitlyOverri
           val = proplvl->newString(v);
         }
         proplvl->add(part, val);
+        setting.value = val;
         break;
       }
     }
+    setting.overridden = overridden;
+    setting.propertyPath = f;
+    setting.property = property;
+    setting.lineNo = aLineNo;
+    aSettings.push_back(setting);
+  }
+}
+
+
+bool PropertyContainer::applyCompiledProps(int aDomain, bool aOnlyExplicitlyOverridden, const CompiledPropertySettingsList &aSettings, const char *aTextSourceName)
+{
+  bool anySettingsApplied = false;
+  for (CompiledPropertySettingsList::const_iterator pos = aSettings.begin(); pos!=aSettings.end(); ++pos) {
+    // check if we should apply it
+    if (aOnlyExplicitlyOverridden && !pos->overridden) {
+      // skip this property
+      continue;
+    }
+    // try writing along the path as resolved for the previous container first
+    if (applyResolvedSetting(aDomain, *pos)) {
+      anySettingsApplied = true;
+      continue;
+    }
     // now access that property (note: preparation is not checked so properties must be writable without preparation)
-    ErrorPtr err = accessPropertyInternal(access_write, property, ApiValuePtr(), aDomain, PropertyDescriptorPtr(), PropertyPrepListPtr());
+    ErrorPtr err = accessPropertyInternal(access_write, pos->property, ApiValuePtr(), aDomain, RootPropertyDescriptor::forApiVersion(VDC_API_VERSION_MAX), PropertyPrepListPtr());
     if (!Error::isOK(err)) {
-      LOG(LOG_ERR, "%s:%d - error writing property '%s': %s", aTextSourceName, aLineNo, f.c_str(), err->description().c_str());
+      LOG(LOG_ERR, "%s:%d - error writing property '%s': %s", aTextSourceName, pos->lineNo, pos->propertyPath.c_str(), err->description().c_str());
     }
     else {
       anySettingsApplied = true;
@@ -511,3 +1196,82 @@ bool PropertyContainer::readPropsFromCSV(int aDomain, bool aOnlyExplicitlyOverri
 }
 
 
+// Write a compiled setting by descriptor index per level instead of resolving names. Indices are resolved once by
+// comparing names and kept in the setting, so applying the same file to many containers of the same kind only
+// needs to verify the names. Returns false without writing anything when the path does not resolve to a writable
+// leaf this way (special syntax, deleting, inserting new elements, structured values), or the write fails;
+// the caller then falls back to a regular write access, which also reports errors.
+bool PropertyContainer::applyResolvedSetting(int aDomain, const CompiledPropertySetting &aSetting)
+{
+  size_t levels = aSetting.pathParts.size();
+  if (levels==0 || !aSetting.value || aSetting.value->isNull()) return false;
+  if (aSetting.resolvedIndices.size()!=levels) aSetting.resolvedIndices.assign(levels, PROPINDEX_NONE);
+  typedef struct {
+    PropertyContainerPtr container;
+    PropertyDescriptorPtr propDesc;
+    int domain;
+    PropertyContainerPtr subContainer;
+  } PathLevel;
+  vector<PathLevel> path;
+  path.reserve(levels);
+  PropertyContainerPtr container = this;
+  PropertyDescriptorPtr parentDescriptor = RootPropertyDescriptor::forApiVersion(VDC_API_VERSION_MAX);
+  int domain = aDomain;
+  PropertyDescriptorPtr propDesc;
+  for (size_t lvl=0; lvl<levels; lvl++) {
+    const string &name = aSetting.pathParts[lvl];
+    int &idx = aSetting.resolvedIndices[lvl];
+    int n = container->numProps(domain, parentDescriptor);
+    propDesc.reset();
+    if (idx>=0 && idx<n) {
+      propDesc = container->getDescriptorByIndex(idx, domain, parentDescriptor);
+      if (propDesc && name!=propDesc->name()) propDesc.reset();
+    }
+    if (!propDesc) {
+      // not resolved yet or resolved differently for the previous container -> resolve by name
+      for (idx=0; idx<n; idx++) {
+        propDesc = container->getDescriptorByIndex(idx, domain, parentDescriptor);
+        if (propDesc && name==propDesc->name()) break;
+        propDesc.reset();
+      }
+      if (!propDesc) {
+        idx = PROPINDEX_NONE;
+        return false;
+      }
+    }
+    bool leaf = lvl==levels-1;
+    if (propDesc->isStructured()==leaf) return false; // path does not match the property structure
+    if (leaf) break;
+    PathLevel pl;
+    pl.container = container;
+    pl.propDesc = propDesc;
+    pl.domain = domain;
+    // - descriptors of containers are shared, such that the descriptors of the next level are shared, too
+    PropertyDescriptorPtr containerPropDesc = PropertyDescriptor::shared(propDesc);
+    pl.subContainer = container->getContainerForWrite(containerPropDesc, domain);
+    if (!pl.subContainer) return false;
+    if (pl.subContainer!=container) {
+      // switching to another C++ object -> starting at root level in that object
+      containerPropDesc = containerPropDesc->asRootOfObject();
+    }
+    path.push_back(pl);
+    container = pl.subContainer;
+    parentDescriptor = containerPropDesc;
+  }
+  // write the leaf
+  if (!container->accessField(access_write, aSetting.value, propDesc)) return false;
+  container->propertiesChanged();
+  if (propDesc->needsPreparation(access_write)) container->finishAccess(access_write, propDesc);
+  // give the containers along the path a chance to post-process the write, innermost first
+  for (vector<PathLevel>::reverse_iterator pos = path.rbegin(); pos!=path.rend(); ++pos) {
+    ErrorPtr err = pos->container->writtenProperty(access_write, pos->propDesc, pos->domain, pos->subContainer);
+    pos->container->propertiesChanged();
+    if (!Error::isOK(err)) {
+      LOG(LOG_ERR, "error writing property '%s': %s", aSetting.propertyPath.c_str(), err->description().c_str());
+      break;
+    }
+  }
+  return true;
+}
+
+
@@ -24,13 +24,18 @@
 
 #include "vdcapi.hpp"
 
+#include <set>
+
 using namespace std;
 
 namespace p44 {
 
   class PropertyContainer;
 
-  struct PropertyDescriptor;
+  class PropertyDescriptor;
+  class PropertyDescriptorSet;
+  struct PropertyDescriptorChildren;
+  class PropertyNameIndex;
 
 
   #define OKEY(x) ((intptr_t)&x) ///< macro to define unique object keys by using address of a variable
@@ -65,13 +70,81 @@ namespace p44 {
   typedef boost::intrusive_ptr<PropertyDescriptor> PropertyDescriptorPtr;
 
   /// description of a property
-  class PropertyDescriptor : public P44Obj
+  /// @note Descriptors are either private to a single property access, or shared. Shared descriptors are created
+  ///   once per parent descriptor (see StaticPropertyDescriptor::descriptorFor() and PropertyDescriptor::shared()),
+  ///   are immutable and are never deleted. PropertyDescriptorPtrs to shared descriptors are just borrowed pointers,
+  ///   copying or releasing them does not touch the reference count.
+  class PropertyDescriptor
   {
-  public:
+    friend void intrusive_ptr_add_ref(PropertyDescriptor *aDesc);
+    friend void intrusive_ptr_release(PropertyDescriptor *aDesc);
+    friend class PropertyDescriptorSet;
+    friend class PropertyContainer;
+    friend class RootPropertyDescriptor;
+    friend class PropertyNameIndex;
+
+    int refCount;
+    bool sharedDesc; ///< set for shared descriptors
+    PropertyDescriptorChildren *children; ///< the shared child descriptors of a shared descriptor, NULL if none yet
+    PropertyDescriptor *rootVariant; ///< the shared root variant of a shared descriptor, NULL if none yet
+
+    PropertyDescriptor &operator=(const PropertyDescriptor &); // not assignable
+
+  protected:
+
     bool rootOfObject;
 
+    /// make a descriptor shared (if its parent is shared, and limits permit)
+    /// @param aDesc a new descriptor, not yet shared
+    /// @param aStatic set if aDesc describes a static property, i.e. one of a limited, fixed set
+    /// @return the shared descriptor equal to aDesc, or aDesc itself if it cannot be shared
+    static PropertyDescriptorPtr share(PropertyDescriptorPtr aDesc, bool aStatic);
+
+    /// @param aProbe a descriptor, usually a temporary one
+    /// @return the shared descriptor equal to aProbe, NULL if there is none (yet)
+    static PropertyDescriptor *findShared(const PropertyDescriptor &aProbe);
+
+    /// @return hash over everything that distinguishes this descriptor from its siblings
+    virtual size_t sharingHash() const { return 0; };
+    /// @return true if aOther describes the same property as this descriptor, in the same way
+    virtual bool sameAs(const PropertyDescriptor &aOther) const { return false; };
+    /// @return a new, not shared copy of this descriptor
+    virtual PropertyDescriptor *copy() const = 0;
+
+    /// copy constructor, the copy is never shared
+    PropertyDescriptor(const PropertyDescriptor &aOther);
+
+  public:
+
     /// constructor
-    PropertyDescriptor(PropertyDescriptorPtr aParentDescriptor) : parentDescriptor(aParentDescriptor), rootOfObject(false) {};
+    PropertyDescriptor(PropertyDescriptorPtr aParentDescriptor);
+
+    virtual ~PropertyDescriptor();
+
+    /// PropertyDescriptors are allocated from a recycling pool
+    /// @note descriptors that are not shared are created (and soon released again) while accessing properties.
+    ///   The pool avoids the malloc/free traffic for these.
+    static void *operator new(size_t aSize);
+    static void operator delete(void *aPtr, size_t aSize);
+
+    /// @return descriptor allocation statistics as text
+    static string poolStatistics();
+
+    /// get the shared descriptor for a descriptor
+    /// @param aDesc a descriptor
+    /// @return the shared descriptor equal to aDesc, or aDesc itself if it is already shared, or cannot be shared
+    ///   because its parent is not shared, or because the limit for shared descriptors is reached
+    /// @note dynamic descriptors must not be modified any more once they have been passed to this method
+    static PropertyDescriptorPtr shared(PropertyDescriptorPtr aDesc);
+
+    /// @return true if this descriptor is shared (immutable and never deleted)
+    bool isShared() const { return sharedDesc; };
+
+    /// get the variant of this descriptor which acts as root of a C++ class hierarchy
+    /// @return this descriptor if it already is the root of an object or is not shared (and thus can be modified),
+    ///   the shared root variant otherwise
+    PropertyDescriptorPtr asRootOfObject();
+
     /// the parent descriptor (NULL at root level of DsAdressables)
     PropertyDescriptorPtr parentDescriptor;
     /// API version
@@ -105,13 +178,34 @@ namespace p44 {
   };
 
 
+  inline void intrusive_ptr_add_ref(PropertyDescriptor *aDesc)
+  {
+    if (!aDesc->sharedDesc) aDesc->refCount++;
+  }
+
+  inline void intrusive_ptr_release(PropertyDescriptor *aDesc)
+  {
+    if (!aDesc->sharedDesc && --aDesc->refCount==0) delete aDesc;
+  }
+
+
   /// description of the root of any property access
   class RootPropertyDescriptor : public PropertyDescriptor
   {
     typedef PropertyDescriptor inherited;
     int apiVersion;
+
+  protected:
+
+    virtual PropertyDescriptor *copy() const P44_OVERRIDE { return new RootPropertyDescriptor(*this); };
+
   public:
     RootPropertyDescriptor(int aApiVersion) : inherited(PropertyDescriptorPtr()) { rootOfObject = true; apiVersion = aApiVersion; };
+
+    /// @param aApiVersion API version
+    /// @return the shared root descriptor for accessing properties with aApiVersion
+    static PropertyDescriptorPtr forApiVersion(int aApiVersion);
+
     virtual const char *name() const P44_OVERRIDE { return "<root>"; };
     virtual ApiValueType type() const P44_OVERRIDE { return apivalue_object; };
     virtual size_t fieldKey() const P44_OVERRIDE { return 0; };
@@ -127,14 +221,27 @@ namespace p44 {
     typedef PropertyDescriptor inherited;
     const PropertyDescription *descP;
 
-  public:
-
     /// create from const table entry
     StaticPropertyDescriptor(const PropertyDescription *aDescP, PropertyDescriptorPtr aParentDescriptor) :
       inherited(aParentDescriptor),
       descP(aDescP)
     {};
 
+  protected:
+
+    virtual size_t sharingHash() const P44_OVERRIDE;
+    virtual bool sameAs(const PropertyDescriptor &aOther) const P44_OVERRIDE;
+    virtual PropertyDescriptor *copy() const P44_OVERRIDE { return new StaticPropertyDescriptor(*this); };
+
+  public:
+
+    /// get the descriptor for a const table entry
+    /// @param aDescP the const table entry describing the property
+    /// @param aParentDescriptor the parent descriptor
+    /// @return the descriptor. If aParentDescriptor is shared, this is the shared descriptor for aDescP,
+    ///   which is created only once.
+    static PropertyDescriptorPtr descriptorFor(const PropertyDescription *aDescP, PropertyDescriptorPtr aParentDescriptor);
+
     virtual const char *name() const P44_OVERRIDE { return descP->propertyName; }
     virtual ApiValueType type() const P44_OVERRIDE { return (ApiValueType)((descP->propertyType) & proptype_mask); }
     virtual size_t fieldKey() const P44_OVERRIDE { return descP->fieldKey; }
@@ -146,10 +253,19 @@ namespace p44 {
 
 
   /// description of a dynamic property (such as an element of a container, created on the fly when accessed)
+  /// @note dynamic descriptors of containers are shared (see PropertyDescriptor::shared()) when the property access
+  ///   recurses into them, so they must not be modified after being returned from getDescriptorByIndex() or
+  ///   getDescriptorByName().
   class DynamicPropertyDescriptor : public PropertyDescriptor
   {
     typedef PropertyDescriptor inherited;
 
+  protected:
+
+    virtual size_t sharingHash() const P44_OVERRIDE;
+    virtual bool sameAs(const PropertyDescriptor &aOther) const P44_OVERRIDE;
+    virtual PropertyDescriptor *copy() const P44_OVERRIDE { return new DynamicPropertyDescriptor(*this); };
+
   public:
     DynamicPropertyDescriptor(PropertyDescriptorPtr aParentDescriptor) :
       inherited(aParentDescriptor),
@@ -196,6 +312,39 @@ namespace p44 {
   typedef list<PropertyPrep> PropertyPrepList;
   typedef boost::shared_ptr<PropertyPrepList> PropertyPrepListPtr;
 
+  /// state of preparing a property access (with possibly multiple preparations running concurrently)
+  class PropertyPrepRun
+  {
+    friend class PropertyContainer;
+
+    PropertyPrepListPtr pending; ///< preparations not yet started
+    set<PropertyContainerPtr> busyTargets; ///< targets with a preparation in progress
+    map<PropertyContainerPtr, PropertyPrepList> deferred; ///< preparations not yet started because their target is busy
+    // the access to perform when all preparations are done
+    PropertyAccessMode mode;
+    ApiValuePtr queryObject;
+    int domain;
+    PropertyDescriptorPtr parentDescriptor;
+    uint64_t sinceGeneration;
+    PropertyAccessCB accessCompleteCB;
+  };
+  typedef boost::shared_ptr<PropertyPrepRun> PropertyPrepRunPtr;
+
+
+  /// a property setting from a CSV settings text, compiled into a ready-to-apply write access tree
+  class CompiledPropertySetting
+  {
+  public:
+    bool overridden; ///< set if explicitly marked with "!" to override settings from persistent storage
+    string propertyPath; ///< the property path as written in the source, for error messages
+    ApiValuePtr property; ///< the write access tree
+    int lineNo; ///< line number within the text source, for error messages
+    vector<string> pathParts; ///< the property path, split into names per level
+    ApiValuePtr value; ///< the value to write to the leaf of the path
+    mutable vector<int> resolvedIndices; ///< descriptor index per level as last resolved, tried first on next apply
+  };
+  typedef list<CompiledPropertySetting> CompiledPropertySettingsList;
+
 
 
   /// Base class for objects providing API properties
@@ -206,9 +355,14 @@ namespace p44 {
   /// provided by base classes, without modifications of the base class.
   class PropertyContainer : public P44Obj
   {
+    friend class PropertyNameIndex;
+
+    uint64_t changeGeneration; ///< generation of the last change in this container or its subcontainers
 
   public:
 
+    PropertyContainer();
+
     /// @name property access API
     /// @{
 
@@ -220,10 +374,41 @@ namespace p44 {
     ///   (but will internally be repaced by a RootPropertyDescriptor)
     /// @param aAccessCompleteCB will be called when property access is complete. Callback's aError
     ///   returns Error 501 if property is unknown, 403 if property exists but cannot be accessed, 415 if value type is incompatible with the property
-    void accessProperty(PropertyAccessMode aMode, ApiValuePtr aQueryObject, int aDomain, int aApiVersion, PropertyAccessCB aAccessCompleteCB);
+    /// @param aSinceGeneration if not 0, a read only returns subcontainers that have changed after this generation
+    void accessProperty(PropertyAccessMode aMode, ApiValuePtr aQueryObject, int aDomain, int aApiVersion, PropertyAccessCB aAccessCompleteCB, uint64_t aSinceGeneration = 0);
+
+    /// @}
+
+    /// @name change tracking
+    /// @{
+
+    /// mark properties of this container changed
+    /// @note this is called for every successful property write. Subclasses must call it for other changes
+    ///   (state updates etc.), and should override it to also mark the object they are part of as changed,
+    ///   such that an object's generation is always at least that of its subcontainers
+    virtual void propertiesChanged();
+
+    /// @return the generation of the last change in this container or its subcontainers
+    uint64_t getChangeGeneration() const { return changeGeneration; };
+
+    /// @return the most recent change generation of all containers
+    static uint64_t currentChangeGeneration();
+
+    /// mark the structure of the property tree changed
+    /// @note must be called when containers or array elements are added or removed. Delta reads cannot report
+    ///   removed elements, so clients which know a generation before the last structure change need a full read.
+    static void structureChanged();
+
+    /// @return the generation of the last structure change
+    static uint64_t structureChangeGeneration();
 
     /// @}
 
+    /// set the number of property preparations that may run at the same time within one property access
+    /// @param aParallelism max number of concurrent preparations (usually hardware roundtrips to different devices),
+    ///   1 to run them one after the other
+    static void setPreparationParallelism(int aParallelism);
+
     /// read properties from CSV formatted text
     /// @param aDomain the domain for which to access properties (different APIs might have different properties for the same PropertyContainer)
     /// @param aOnlyExplicitlyOverridden if set, only properties prefixed with an exclamation mark are applied
@@ -233,6 +418,21 @@ namespace p44 {
     /// @return true if some settings were applied
     bool readPropsFromCSV(int aDomain, bool aOnlyExplicitlyOverridden, const char *&aCSVCursor, const char *aTextSourceName, int aLineNo);
 
+    /// compile properties from CSV formatted text into write access trees, which can be applied (multiple times) later
+    /// @param aCSVCursor must point to a CSV formatted text which is parsed for propertypath/value pairs
+    /// @param aTextSourceName (file)name of where the text comes from, for logging error messages
+    /// @param aLineNo line number within the text source, for logging error messages
+    /// @param aSettings compiled settings will be appended to this list
+    static void compilePropsFromCSV(const char *&aCSVCursor, const char *aTextSourceName, int aLineNo, CompiledPropertySettingsList &aSettings);
+
+    /// apply compiled property settings
+    /// @param aDomain the domain for which to access properties (different APIs might have different properties for the same PropertyContainer)
+    /// @param aOnlyExplicitlyOverridden if set, only properties prefixed with an exclamation mark are applied
+    /// @param aSettings the settings as compiled by compilePropsFromCSV()
+    /// @param aTextSourceName (file)name of where the settings come from, for logging error messages
+    /// @return true if some settings were applied
+    bool applyCompiledProps(int aDomain, bool aOnlyExplicitlyOverridden, const CompiledPropertySettingsList &aSettings, const char *aTextSourceName);
+
   protected:
 
     /// @name methods that should be overriden in concrete subclasses to access properties
@@ -251,6 +451,10 @@ namespace p44 {
     /// @return pointer to property descriptor or NULL if aPropIndex is out of range
     /// @note base class always returns NULL, which means no properties
     /// @note implementation does not need to check aPropIndex, it will always be within the range set by numProps()
+    /// @note the default getDescriptorByName() indexes the names of static properties per parent descriptor, container class,
+    ///   domain and numProps(). So for a given parent descriptor, domain and number of properties, all instances of a class must
+    ///   return the same static property at the same index, or NULL to suppress it. Properties returned as dynamic descriptors
+    ///   are always looked at, so these may differ between instances.
     virtual PropertyDescriptorPtr getDescriptorByIndex(int aPropIndex, int aDomain, PropertyDescriptorPtr aParentDescriptor) { return NULL; }
 
     /// get next property descriptor by name
@@ -277,6 +481,14 @@ namespace p44 {
     /// @note base class always returns NULL, which means no structured or proxy properties
     virtual PropertyContainerPtr getContainer(const PropertyDescriptorPtr &aPropertyDescriptor, int &aDomain) { return NULL; };
 
+    /// get subcontainer for writing (write, write preload or delete access) into a apivalue_object property
+    /// @param aPropertyDescriptor descriptor for a structured (object) property, see getContainer()
+    /// @param aDomain the domain for which to access properties, see getContainer()
+    /// @return PropertyContainer representing the property or property array element
+    /// @note base class returns getContainer(). Containers returning shared, immutable subcontainers from getContainer()
+    ///   must return a private copy here, and commit it in writtenProperty().
+    virtual PropertyContainerPtr getContainerForWrite(const PropertyDescriptorPtr &aPropertyDescriptor, int &aDomain) { return getContainer(aPropertyDescriptor, aDomain); };
+
     /// prepare access to a property (for example if the property needs I/O to update its value before being read).
     /// @param aMode access mode (see PropertyAccessMode: read, write, write preload or delete)
     /// @param aPropertyDescriptor decriptor that signalled a need for preparation
@@ -322,8 +534,9 @@ namespace p44 {
     /// @param aParentDescriptor the descriptor of the parent property, must not be NULL
     /// @param aPreparationList if not NULL, this list will be filled with property descriptors that need preparation before accessing.
     ///   Otherwise, properties are assumed to be prepared already and will be accessed directly
+    /// @param aSinceGeneration if not 0, a read only returns subcontainers that have changed after this generation
     /// @return Error 501 if property is unknown, 403 if property exists but cannot be accessed, 415 if value type is incompatible with the property
-    ErrorPtr accessPropertyInternal(PropertyAccessMode aMode, ApiValuePtr aQueryObject, ApiValuePtr aResultObject, int aDomain, PropertyDescriptorPtr aParentDescriptor, PropertyPrepListPtr aPreparationList);
+    ErrorPtr accessPropertyInternal(PropertyAccessMode aMode, ApiValuePtr aQueryObject, ApiValuePtr aResultObject, int aDomain, PropertyDescriptorPtr aParentDescriptor, PropertyPrepListPtr aPreparationList, uint64_t aSinceGeneration = 0);
 
 
     /// parse aPropmatch for numeric index (both plain number and #n are allowed, plus empty and "*" wildcards)
@@ -361,7 +574,11 @@ namespace p44 {
 
   private:
 
-    void prepareNext(PropertyPrepListPtr aPrepList, PropertyAccessMode aMode, ApiValuePtr aQueryObject, int aDomain, PropertyDescriptorPtr aParentDescriptor, PropertyAccessCB aAccessCompleteCB, ErrorPtr aError);
+    void prepareNext(PropertyPrepRunPtr aPrepRun);
+    void startPreparation(PropertyPrepRunPtr aPrepRun, const PropertyPrep &aPrep);
+    void preparationDone(PropertyPrepRunPtr aPrepRun, PropertyContainerPtr aTarget, ErrorPtr aError);
+
+    bool applyResolvedSetting(int aDomain, const CompiledPropertySetting &aSetting);
 
 
 
@@ -0,0 +1,99 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44vdc__recyclingpool__
+#define __p44vdc__recyclingpool__
+
+#include "p44utils_common.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  /// Pool of recycled memory slots for objects that are created and destroyed at high rates.
+  /// Released slots are kept on a free list for re-use, up to MaxFree slots. Slots beyond that are
+  /// returned to the heap, so a burst of allocations does not pin its peak memory forever.
+  /// @note no locking, pools must only be used from the mainloop thread
+  /// @note meant to be used as a static object: has no constructor, so it is zero-initialized before
+  ///   any static initializer of another compilation unit might allocate from it
+  template<size_t SlotSize, size_t MaxFree> class RecyclingPool
+  {
+    union Slot {
+      Slot *nextFree;
+      char data[SlotSize];
+      double alignDummy; // make sure slots are properly aligned
+    };
+
+    Slot *freeList; ///< released slots available for re-use
+    size_t numFree; ///< number of slots in freeList
+    long numAllocated; ///< total number of allocations
+    long numRecycled; ///< number of allocations served from freeList
+
+  public:
+
+    /// allocate memory for an object
+    /// @param aSize size of the object, objects larger than the slot size are allocated from the heap
+    /// @return memory for the object
+    void *allocate(size_t aSize)
+    {
+      numAllocated++;
+      if (aSize>sizeof(Slot)) return ::operator new(aSize); // too large for pool
+      if (!freeList) return ::operator new(sizeof(Slot));
+      Slot *slot = freeList;
+      freeList = slot->nextFree;
+      numFree--;
+      numRecycled++;
+      return slot;
+    };
+
+    /// release memory obtained from allocate()
+    /// @param aPtr the memory to release, can be NULL
+    /// @param aSize size of the object as passed to allocate()
+    void release(void *aPtr, size_t aSize)
+    {
+      if (!aPtr) return;
+      if (aSize>sizeof(Slot) || numFree>=MaxFree) {
+        // too large for pool, or pool is full
+        ::operator delete(aPtr);
+        return;
+      }
+      Slot *slot = static_cast<Slot *>(aPtr);
+      slot->nextFree = freeList;
+      freeList = slot;
+      numFree++;
+    };
+
+    /// @return allocation statistics as text
+    string statistics() const
+    {
+      return string_format(
+        "%ld allocated, %ld recycled (%.1f%%), %lu slots kept for re-use",
+        numAllocated, numRecycled,
+        numAllocated>0 ? 100.0*numRecycled/numAllocated : 0.0,
+        (unsigned long)numFree
+      );
+    };
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__p44vdc__recyclingpool__) */
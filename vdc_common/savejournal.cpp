@@ -0,0 +1,65 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "savejournal.hpp"
+
+
+using namespace p44;
+
+
+static SaveJournal *currentSaveJournal = NULL;
+
+
+void SaveJournal::start()
+{
+  currentSaveJournal = this;
+}
+
+
+void SaveJournal::stop()
+{
+  if (currentSaveJournal==this) currentSaveJournal = NULL;
+}
+
+
+void SaveJournal::recordSave(PersistentParams &aParams)
+{
+  if (currentSaveJournal) currentSaveJournal->record(aParams);
+}
+
+
+void SaveJournal::record(PersistentParams &aParams)
+{
+  if (aParams.isDirty()) {
+    savedRecords.push_back(make_pair(&aParams, (uint64_t)aParams.rowid));
+  }
+}
+
+
+void SaveJournal::revert()
+{
+  for (SavedRecordsList::iterator pos = savedRecords.begin(); pos!=savedRecords.end(); ++pos) {
+    pos->first->rowid = pos->second; // a record inserted by the failed transaction does not exist
+    pos->first->markDirty();
+  }
+  savedRecords.clear();
+}
@@ -0,0 +1,68 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __p44vdc__savejournal__
+#define __p44vdc__savejournal__
+
+#include "p44utils_common.hpp"
+
+#include "persistentparams.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  /// Records written directly to the DB within a transaction on the main thread's DB connection.
+  /// When the transaction fails, revert() marks them dirty again, so they will be saved again later.
+  /// @note recorded records must not be deleted until the journal is cleared or reverted
+  class SaveJournal
+  {
+    typedef list<pair<PersistentParams *, uint64_t> > SavedRecordsList;
+    SavedRecordsList savedRecords; ///< record and its ROWID before saving
+
+  public:
+
+    /// make this the journal recordSave() records into
+    void start();
+
+    /// stop recording into this journal
+    void stop();
+
+    /// record a record about to be written directly, in the started journal (if any)
+    /// @param aParams the record, will only be recorded when dirty
+    static void recordSave(PersistentParams &aParams);
+
+    /// record a record about to be written
+    /// @param aParams the record, will only be recorded when dirty
+    void record(PersistentParams &aParams);
+
+    /// forget all recorded records (because the transaction was committed)
+    void clear() { savedRecords.clear(); };
+
+    /// mark all recorded records dirty again and forget ROWIDs that were assigned by the failed transaction
+    void revert();
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__p44vdc__savejournal__) */
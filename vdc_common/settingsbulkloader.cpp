@@ -0,0 +1,139 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "settingsbulkloader.hpp"
+#include "cachingparamstore.hpp"
+
+
+using namespace p44;
+
+
+SettingsBulkLoader::SettingsBulkLoader() :
+  rowsDelivered(0)
+{
+}
+
+
+SettingsBulkLoader::~SettingsBulkLoader()
+{
+  for (BulkTableMap::iterator pos = tables.begin(); pos!=tables.end(); ++pos) {
+    if (pos->second.queryP) {
+      delete pos->second.queryP;
+      pos->second.queryP = NULL;
+    }
+  }
+}
+
+
+SettingsBulkLoader::BulkTable *SettingsBulkLoader::tableFor(PersistentParams &aParams)
+{
+  BulkTable &t = tables[aParams.tableName()];
+  if (t.done) return NULL; // already read, too late to register
+  if (!t.queryP) {
+    // first object registered for this table -> create the query for all records now
+    // Note: the object is not needed any more afterwards (children templates are usually temporary)
+    t.queryP = aParams.newLoadAllQuery(NULL);
+  }
+  return &t;
+}
+
+
+void SettingsBulkLoader::expect(PersistentParams &aParams, const string &aParentId)
+{
+  BulkTable *t = tableFor(aParams);
+  if (t) t->expected[aParentId].params = &aParams;
+}
+
+
+void SettingsBulkLoader::expectChildren(PersistentParams &aTemplate, const string &aParentId, RowHandlerCB aHandler)
+{
+  BulkTable *t = tableFor(aTemplate);
+  if (t) t->expected[aParentId].handler = aHandler;
+}
+
+
+long SettingsBulkLoader::load()
+{
+  long before = rowsDelivered;
+  for (BulkTableMap::iterator pos = tables.begin(); pos!=tables.end(); ++pos) {
+    if (!pos->second.done) readTable(pos->first, pos->second);
+  }
+  return rowsDelivered-before;
+}
+
+
+void SettingsBulkLoader::readTable(const string &aTableName, BulkTable &aTable)
+{
+  aTable.done = true;
+  if (!aTable.queryP) {
+    LOG(LOG_WARNING, "bulk load: cannot query table %s -> records will be loaded one by one", aTableName.c_str());
+    return;
+  }
+  long rows = 0;
+  long matched = 0;
+  for (sqlite3pp::query::iterator row = aTable.queryP->begin(); row!=aTable.queryP->end(); ++row) {
+    rows++;
+    // Note: like in every load query, the first two columns are the ROWID and the parent ID
+    const char *parentId = row->get<const char *>(1);
+    if (!parentId) continue;
+    ExpectationMap::iterator e = aTable.expected.find(parentId);
+    if (e==aTable.expected.end()) continue; // not (yet) needed
+    if (e->second.params) {
+      if (e->second.delivered) continue; // only one record per parent for single record objects
+      int index = 0;
+      e->second.params->loadFromRow(row, index, NULL);
+      e->second.params->markClean(); // just loaded, no need to save
+    }
+    else if (e->second.handler) {
+      e->second.handler(row);
+    }
+    e->second.delivered = true;
+    matched++;
+  }
+  delete aTable.queryP; aTable.queryP = NULL;
+  // Only if at least one record could be matched, the row layout is confirmed and the absence of
+  // records for the other expected parents is reliable. Tables with stale records only are not covered,
+  // which just means that the objects load from the DB themselves.
+  aTable.covered = rows==0 || matched>0;
+  rowsDelivered += matched;
+  FOCUSLOG("bulk load: table %s: %ld rows, %ld delivered to %zu expected parents", aTableName.c_str(), rows, matched, aTable.expected.size());
+}
+
+
+bool SettingsBulkLoader::covers(const char *aTableName, const string &aParentId, bool *aDeliveredP)
+{
+  BulkTableMap::iterator t = tables.find(aTableName);
+  if (t==tables.end() || !t->second.covered) return false;
+  ExpectationMap::iterator e = t->second.expected.find(aParentId);
+  if (e==t->second.expected.end()) return false; // was not registered
+  if (aDeliveredP) *aDeliveredP = e->second.delivered;
+  return true;
+}
+
+
+ErrorPtr SettingsBulkLoader::loadParams(SettingsBulkLoader *aLoader, PersistentParams &aParams, const string &aParentId)
+{
+  if (aLoader && aLoader->covers(aParams.tableName(), aParentId)) {
+    // record (if any) is already loaded, only children remain
+    return aParams.loadChildren();
+  }
+  return CachingParamStore::load(aParams, aParentId.c_str());
+}
@@ -0,0 +1,118 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44vdc__settingsbulkloader__
+#define __p44vdc__settingsbulkloader__
+
+#include "p44utils_common.hpp"
+
+#include "persistentparams.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  /// Bulk loader for persistent parameters.
+  /// Instead of querying the DB once per object (and once more per object for its children), objects register
+  /// the record(s) they expect by table and parent ID, and then each table is read in a single query, handing
+  /// the rows to the registered objects.
+  /// @note objects for which the bulk load cannot tell for sure if they have a record (see covers()) must fall back
+  ///   to loading their record the usual way with loadFromStore().
+  class SettingsBulkLoader
+  {
+  public:
+
+    typedef boost::function<void (sqlite3pp::query::iterator &aRow)> RowHandlerCB;
+
+  private:
+
+    /// a registered object or children handler
+    class Expectation
+    {
+    public:
+      Expectation() : params(NULL), delivered(false) {};
+      PersistentParams *params; ///< if set, the single record is loaded into this object
+      RowHandlerCB handler; ///< if set, all records are passed to this handler
+      bool delivered; ///< set when at least one record was delivered
+    };
+    typedef map<string, Expectation> ExpectationMap;
+
+    /// a table to read
+    class BulkTable
+    {
+    public:
+      BulkTable() : queryP(NULL), done(false), covered(false) {};
+      sqlite3pp::query *queryP; ///< the query for all records of the table, NULL when not yet created or already run
+      bool done; ///< set when the table has been read
+      bool covered; ///< set when the table was read successfully and its row layout could be verified
+      ExpectationMap expected; ///< the expected records, by parent ID
+    };
+    typedef map<string, BulkTable> BulkTableMap;
+
+    BulkTableMap tables; ///< the tables, by name
+    long rowsDelivered; ///< number of rows delivered so far
+
+  public:
+
+    SettingsBulkLoader();
+    ~SettingsBulkLoader();
+
+    /// register a single record object
+    /// @param aParams the object to load the record into
+    /// @param aParentId the parent ID of the record
+    void expect(PersistentParams &aParams, const string &aParentId);
+
+    /// register for child records
+    /// @param aTemplate an object of the type of the children, only used for creating the query for the table
+    /// @param aParentId the parent ID of the child records
+    /// @param aHandler called for every record found for aParentId
+    void expectChildren(PersistentParams &aTemplate, const string &aParentId, RowHandlerCB aHandler);
+
+    /// read all tables with expected records that have not yet been read, one query per table
+    /// @return number of rows delivered
+    long load();
+
+    /// check if the records of a parent ID were covered by the bulk load
+    /// @param aTableName the table
+    /// @param aParentId the parent ID
+    /// @param aDeliveredP if not NULL, will be set when at least one record was actually delivered
+    /// @return true if the bulk load has delivered all records for aParentId that exist in the DB (which might be none).
+    ///   false means that the object must load its record(s) itself.
+    bool covers(const char *aTableName, const string &aParentId, bool *aDeliveredP = NULL);
+
+    /// load the record of a single record object, from the bulk load if covered, from the DB otherwise
+    /// @param aLoader the bulk loader, can be NULL (then the record is always loaded from the DB)
+    /// @param aParams the object to load
+    /// @param aParentId the parent ID of the record
+    /// @return ok or error
+    /// @note this is the equivalent of PersistentParams::loadFromStore(), i.e. children are loaded as well
+    static ErrorPtr loadParams(SettingsBulkLoader *aLoader, PersistentParams &aParams, const string &aParentId);
+
+  private:
+
+    BulkTable *tableFor(PersistentParams &aParams);
+    void readTable(const string &aTableName, BulkTable &aTable);
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__p44vdc__settingsbulkloader__) */
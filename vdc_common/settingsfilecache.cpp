@@ -0,0 +1,294 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "settingsfilecache.hpp"
+
+#include <sys/stat.h>
+#include <dirent.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+
+using namespace p44;
+
+
+// file name prefixes of the settings files that are cached
+static const char *settingsFilePrefixes[] = {
+  "vdchostsettings",
+  "vdcsettings_",
+  "devicesettings_",
+  NULL
+};
+
+
+static bool isSettingsFile(const char *aFileName)
+{
+  size_t l = strlen(aFileName);
+  if (l<4 || strcmp(aFileName+l-4, ".csv")!=0) return false;
+  for (const char **pfxP = settingsFilePrefixes; *pfxP; pfxP++) {
+    if (strncmp(aFileName, *pfxP, strlen(*pfxP))==0) return true;
+  }
+  return false;
+}
+
+
+SettingsFileCache::SettingsFileCache(const string aDir) :
+  dir(aDir),
+  scanned(false),
+  dirMTime(0),
+  lastCheck(Never),
+  numCompiled(0),
+  inotifyFd(-1),
+  rescanPending(false)
+{
+}
+
+
+SettingsFileCache::~SettingsFileCache()
+{
+  stopWatching();
+}
+
+
+const CompiledPropertySettingsList *SettingsFileCache::settingsFor(const string &aFileName)
+{
+  checkUpToDate();
+  FileIndex::iterator pos = files.find(aFileName);
+  if (pos==files.end() || !pos->second.compiled) return NULL;
+  return &(pos->second.settings);
+}
+
+
+bool SettingsFileCache::fileExists(const string &aFileName)
+{
+  checkUpToDate();
+  return files.count(aFileName)>0;
+}
+
+
+void SettingsFileCache::checkUpToDate()
+{
+  if (scanned && inotifyFd>=0) return; // inotify keeps us up to date, no need to check
+  MLMicroSeconds now = MainLoop::now();
+  if (scanned && now<lastCheck+SETTINGS_FILE_CACHE_CHECK_INTERVAL) return; // checked recently enough
+  lastCheck = now;
+  bool upToDate = scanned;
+  struct stat st;
+  if (upToDate) {
+    // directory modification time changes when files are added, removed or renamed
+    upToDate = stat(dir.c_str(), &st)==0 && st.st_mtime==dirMTime;
+  }
+  if (upToDate) {
+    // editing a file in place only changes the file's modification time
+    for (FileIndex::iterator pos = files.begin(); pos!=files.end(); ++pos) {
+      if (!pos->second.compiled) continue; // only contents of settings files are cached
+      if (stat((dir+pos->first).c_str(), &st)!=0 || st.st_mtime!=pos->second.mtime) {
+        upToDate = false;
+        break;
+      }
+    }
+  }
+  if (!upToDate) scan();
+}
+
+
+void SettingsFileCache::scan()
+{
+  files.clear();
+  numCompiled = 0;
+  scanned = true;
+  // watch before reading the directory, so no change can get lost in between
+  startWatching();
+  struct stat st;
+  dirMTime = stat(dir.c_str(), &st)==0 ? st.st_mtime : 0;
+  DIR *dirP = opendir(dir.c_str());
+  if (!dirP) {
+    int syserr = errno;
+    if (syserr!=ENOENT) {
+      LOG(LOG_ERR, "failed scanning config directory %s - %s", dir.c_str(), strerror(syserr));
+    }
+    return;
+  }
+  struct dirent *entryP;
+  while ((entryP = readdir(dirP))!=NULL) {
+    if (entryP->d_name[0]=='.') continue; // no hidden files, no . and ..
+    indexFile(entryP->d_name);
+  }
+  closedir(dirP);
+  LOG(LOG_INFO,
+    "Indexed %zu files and compiled %zu settings files from config directory %s%s",
+    files.size(), numCompiled, dir.c_str(), inotifyFd>=0 ? " (watching for changes)" : ""
+  );
+}
+
+
+void SettingsFileCache::indexFile(const string &aFileName)
+{
+  IndexedFile &f = files[aFileName];
+  if (isSettingsFile(aFileName.c_str())) compileFile(aFileName, f);
+}
+
+
+void SettingsFileCache::compileFile(const string &aFileName, IndexedFile &aFile)
+{
+  string fn = dir+aFileName;
+  if (aFile.compiled) {
+    aFile.compiled = false;
+    aFile.settings.clear();
+    numCompiled--;
+  }
+  FILE *file = fopen(fn.c_str(), "r");
+  if (!file) {
+    LOG(LOG_ERR, "failed opening file %s - %s", fn.c_str(), strerror(errno));
+    return;
+  }
+  aFile.compiled = true;
+  numCompiled++;
+  struct stat st;
+  aFile.mtime = fstat(fileno(file), &st)==0 ? st.st_mtime : 0;
+  string line;
+  int lineNo = 0;
+  while (string_fgetline(file, line)) {
+    lineNo++;
+    const char *p = line.c_str();
+    PropertyContainer::compilePropsFromCSV(p, fn.c_str(), lineNo, aFile.settings);
+  }
+  fclose(file);
+}
+
+
+// MARK: ===== watching the directory with inotify
+
+#ifdef __linux__
+
+void SettingsFileCache::startWatching()
+{
+  if (inotifyFd>=0) return; // already watching
+  inotifyFd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+  if (inotifyFd<0) {
+    LOG(LOG_WARNING, "cannot watch config directory (inotify: %s) -> checking modification times", strerror(errno));
+    return;
+  }
+  // Note: files written in place are reported with IN_CLOSE_WRITE, files replaced by rename with IN_MOVED_TO
+  if (inotify_add_watch(inotifyFd, dir.c_str(), IN_CLOSE_WRITE|IN_MOVED_TO|IN_MOVED_FROM|IN_DELETE|IN_DELETE_SELF|IN_MOVE_SELF)<0) {
+    int syserr = errno;
+    if (syserr!=ENOENT) {
+      LOG(LOG_WARNING, "cannot watch config directory %s: %s -> checking modification times", dir.c_str(), strerror(syserr));
+    }
+    close(inotifyFd);
+    inotifyFd = -1;
+    return;
+  }
+  MainLoop::currentMainLoop().registerPollHandler(inotifyFd, POLLIN, boost::bind(&SettingsFileCache::inotifyHandler, this, _1, _2));
+}
+
+
+void SettingsFileCache::stopWatching()
+{
+  if (inotifyFd<0) return;
+  MainLoop::currentMainLoop().unregisterPollHandler(inotifyFd);
+  close(inotifyFd);
+  inotifyFd = -1;
+}
+
+
+bool SettingsFileCache::inotifyHandler(int aFD, int aPollFlags)
+{
+  map<string, bool> changed; // file name -> removed
+  bool needsRescan = false;
+  char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  ssize_t n;
+  while ((n = read(aFD, buf, sizeof(buf)))>0) {
+    for (char *p = buf; p<buf+n; p += sizeof(struct inotify_event)+((struct inotify_event *)p)->len) {
+      struct inotify_event *ev = (struct inotify_event *)p;
+      if (ev->mask & (IN_Q_OVERFLOW|IN_DELETE_SELF|IN_MOVE_SELF|IN_IGNORED)) {
+        // events lost or directory itself gone: index must be rebuilt
+        needsRescan = true;
+        continue;
+      }
+      if (ev->len==0 || ev->name[0]=='.') continue;
+      string name = ev->name;
+      if (ev->mask & (IN_CLOSE_WRITE|IN_MOVED_TO)) {
+        indexFile(name);
+        changed[name] = false;
+      }
+      else {
+        FileIndex::iterator pos = files.find(name);
+        if (pos!=files.end()) {
+          if (pos->second.compiled) numCompiled--;
+          files.erase(pos);
+        }
+        changed[name] = true;
+      }
+    }
+  }
+  if (needsRescan) {
+    if (!rescanPending) {
+      // Note: rescanning re-creates the inotify instance, which must not happen from within its own poll handler
+      LOG(LOG_NOTICE, "config directory %s needs rescan", dir.c_str());
+      rescanPending = true;
+      MainLoop::currentMainLoop().executeOnce(boost::bind(&SettingsFileCache::rescan, SettingsFileCachePtr(this)));
+    }
+    return true;
+  }
+  for (map<string, bool>::iterator pos = changed.begin(); pos!=changed.end(); ++pos) {
+    LOG(LOG_INFO, "config file %s%s %s", dir.c_str(), pos->first.c_str(), pos->second ? "removed" : "changed");
+    if (changedHandler) changedHandler(pos->first, pos->second);
+  }
+  return true;
+}
+
+
+void SettingsFileCache::rescan()
+{
+  rescanPending = false;
+  stopWatching();
+  scan();
+  if (changedHandler) changedHandler("", false); // any file might have changed
+}
+
+#else
+
+void SettingsFileCache::startWatching()
+{
+  // no inotify, modification times are checked instead
+}
+
+
+void SettingsFileCache::stopWatching()
+{
+}
+
+
+bool SettingsFileCache::inotifyHandler(int aFD, int aPollFlags)
+{
+  return false;
+}
+
+
+void SettingsFileCache::rescan()
+{
+}
+
+#endif // __linux__
@@ -0,0 +1,124 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44vdc__settingsfilecache__
+#define __p44vdc__settingsfilecache__
+
+#include "p44utils_common.hpp"
+
+#include "propertycontainer.hpp"
+
+#include <set>
+#include <map>
+
+using namespace std;
+
+namespace p44 {
+
+  // minimal interval between checks for modified settings files
+  #ifndef SETTINGS_FILE_CACHE_CHECK_INTERVAL
+    #define SETTINGS_FILE_CACHE_CHECK_INTERVAL (5*Second)
+  #endif
+
+  class SettingsFileCache;
+  typedef boost::intrusive_ptr<SettingsFileCache> SettingsFileCachePtr;
+
+  /// callback for changed config files
+  /// @param aFileName name of the file (without directory) that was changed, added or removed. Empty if
+  ///   any file might have changed.
+  /// @param aRemoved set if the file was removed (deleted or moved away)
+  typedef boost::function<void (const string &aFileName, bool aRemoved)> ConfigFileChangedCB;
+
+  /// Cache of the CSV settings files (vdchostsettings.csv, vdcsettings_*.csv and devicesettings_*.csv) in the config directory.
+  /// The directory is scanned once and all settings files are compiled into write access trees, which are then applied
+  /// to every matching vdc or device without probing and parsing files again. Files shared by many devices
+  /// (per class, type or vdc) are thus only read once.
+  /// The compiled settings are kept in a single index of all files in the directory, so loaders of other config
+  /// files can check if a file exists without trying to open it, using the same scan and change tracking.
+  /// Where available (Linux), changes are tracked with inotify: only the changed file is recompiled, and
+  /// the change handler is notified. Otherwise, the cache is rebuilt when the directory or one of the files
+  /// has changed (modification time)
+  class SettingsFileCache : public P44Obj
+  {
+    typedef P44Obj inherited;
+
+    /// a file in the config directory
+    class IndexedFile
+    {
+    public:
+      IndexedFile() : compiled(false), mtime(0) {};
+      bool compiled; ///< set for settings files, which are compiled when indexed
+      time_t mtime; ///< modification time of the file when it was compiled
+      CompiledPropertySettingsList settings; ///< the compiled settings
+    };
+    typedef map<string, IndexedFile> FileIndex;
+
+    string dir; ///< the directory, including path delimiter at the end
+    bool scanned; ///< set when the directory has been scanned
+    time_t dirMTime; ///< modification time of the directory when it was scanned
+    MLMicroSeconds lastCheck; ///< when the cache was last checked for being up to date
+    FileIndex files; ///< all files in the directory, with the compiled settings of settings files
+    size_t numCompiled; ///< number of compiled settings files in the index
+    int inotifyFd; ///< inotify instance watching the directory, -1 if none
+    bool rescanPending; ///< set while a rescan is scheduled (inotify only)
+    ConfigFileChangedCB changedHandler; ///< called when config files change (inotify only)
+
+  public:
+
+    /// create cache
+    /// @param aDir the config directory, including path delimiter at the end
+    SettingsFileCache(const string aDir);
+
+    virtual ~SettingsFileCache();
+
+    /// set handler to be called when config files change
+    /// @param aChangedHandler will be called for every file changed, added or removed
+    /// @note changes are only reported when inotify is available, otherwise changes are only picked up
+    ///   by loaders accessing the cache.
+    void setChangedHandler(ConfigFileChangedCB aChangedHandler) { changedHandler = aChangedHandler; };
+
+    /// check if a file exists in the config directory
+    /// @param aFileName name of the file (without directory)
+    /// @return true if the file exists
+    bool fileExists(const string &aFileName);
+
+    /// get compiled settings for a settings file
+    /// @param aFileName name of the settings file (without directory)
+    /// @return compiled settings, or NULL if there is no such settings file
+    /// @note the returned settings are valid until the next call
+    const CompiledPropertySettingsList *settingsFor(const string &aFileName);
+
+  private:
+
+    void checkUpToDate();
+    void scan();
+    void indexFile(const string &aFileName);
+    void compileFile(const string &aFileName, IndexedFile &aFile);
+    void startWatching();
+    void stopWatching();
+    bool inotifyHandler(int aFD, int aPollFlags);
+    void rescan();
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__p44vdc__settingsfilecache__) */
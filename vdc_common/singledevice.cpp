@@ -192,7 +192,7 @@ PropertyDescriptorPtr ValueDescriptor::getDescriptorByIndex(int aPropIndex, int
   };
   if (aParentDescriptor->isRootOfObject()) {
     // root level property of this object hierarchy
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   return PropertyDescriptorPtr();
 }
@@ -750,7 +750,7 @@ PropertyDescriptorPtr DeviceAction::getDescriptorByIndex(int aPropIndex, int aDo
   };
   if (aParentDescriptor->isRootOfObject()) {
     // root level property of this object hierarchy
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   return PropertyDescriptorPtr();
 }
@@ -1051,7 +1051,7 @@ PropertyDescriptorPtr ActionMacro::getDescriptorByIndex(int aPropIndex, int aDom
   };
   if (aParentDescriptor->isRootOfObject()) {
     // root level property of this object hierarchy
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   return PropertyDescriptorPtr();
 }
@@ -1271,6 +1271,16 @@ void CustomAction::bindToStatement(sqlite3pp::statement &aStatement, int &aIndex
 }
 
 
+void CustomAction::markDirty()
+{
+  inheritedParams::markDirty();
+  // persistent settings are properties, too
+  propertiesChanged();
+  // custom actions are saved as part of their device
+  singleDevice.getVdcHost().scheduleSave(singleDevice.getDsUid());
+}
+
+
 // MARK: ===== CustomAction property access
 
 bool CustomAction::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, PropertyDescriptorPtr aPropertyDescriptor)
@@ -1377,7 +1387,7 @@ bool CustomActions::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue
   if (aPropertyDescriptor->hasObjectKey(customactions_key) && aMode==access_delete) {
     // only field-level access is deleting a custom action
     CustomActionPtr da = customActions[aPropertyDescriptor->fieldKey()];
-    da->deleteFromStore(); // remove from store
+    PersistenceWorker::forget(singleDevice.getVdcHost().getPersistenceWorker(), *da); // remove from store
     customActions.erase(customActions.begin()+aPropertyDescriptor->fieldKey()); // remove from container
     return true;
   }
@@ -1418,29 +1428,23 @@ ErrorPtr CustomActions::load()
   string parentID = singleDevice.dSUID.getString();
   // create a template
   CustomActionPtr newAction = CustomActionPtr(new CustomAction(singleDevice));
-  // get the query
-  sqlite3pp::query *queryP = newAction->newLoadAllQuery(parentID.c_str());
-  if (queryP==NULL) {
-    // real error preparing query
-    err = newAction->paramStore.error();
-  }
-  else {
-    for (sqlite3pp::query::iterator row = queryP->begin(); row!=queryP->end(); ++row) {
-      // got record
-      // - load record fields into custom action object
-      int index = 0;
-      newAction->loadFromRow(row, index, NULL);
-      // - put custom action into container
-      customActions.push_back(newAction);
-      // - fresh object for next row
-      newAction = CustomActionPtr(new CustomAction(singleDevice));
-    }
-    delete queryP; queryP = NULL;
-  }
+  // load the records
+  err = CachingParamStore::loadAll(*newAction, parentID.c_str(), boost::bind(&CustomActions::customActionRowLoaded, this, _1));
   return err;
 }
 
 
+void CustomActions::customActionRowLoaded(sqlite3pp::query::iterator &aRow)
+{
+  // - load record fields into fresh custom action object
+  CustomActionPtr newAction = CustomActionPtr(new CustomAction(singleDevice));
+  int index = 0;
+  newAction->loadFromRow(aRow, index, NULL);
+  // - put custom action into container
+  customActions.push_back(newAction);
+}
+
+
 ErrorPtr CustomActions::save()
 {
   ErrorPtr err;
@@ -1449,7 +1453,7 @@ ErrorPtr CustomActions::save()
   string parentID = singleDevice.dSUID.getString();
   // save all elements of the map (only dirty ones will be actually stored to DB
   for (CustomActionsVector::iterator pos = customActions.begin(); pos!=customActions.end(); ++pos) {
-    err = (*pos)->saveToStore(parentID.c_str(), true); // multiple children of same parent allowed
+    err = PersistenceWorker::save(singleDevice.getVdcHost().getPersistenceWorker(), **pos, parentID.c_str(), true); // multiple children of same parent allowed
     if (!Error::isOK(err)) SALOG(singleDevice, LOG_ERR,"Error saving custom action '%s': %s", (*pos)->actionId.c_str(), err->description().c_str());
   }
   return err;
@@ -1460,7 +1464,7 @@ ErrorPtr CustomActions::forget()
 {
   ErrorPtr err;
   for (CustomActionsVector::iterator pos = customActions.begin(); pos!=customActions.end(); ++pos) {
-    err = (*pos)->deleteFromStore();
+    err = PersistenceWorker::forget(singleDevice.getVdcHost().getPersistenceWorker(), **pos);
   }
   return err;
 }
@@ -1711,10 +1715,10 @@ PropertyDescriptorPtr DeviceState::getDescriptorByIndex(int aPropIndex, int aDom
   };
   // check access path, depends on how we access the state (description or actual state)
   if (aParentDescriptor->parentDescriptor->hasObjectKey(devicestatedesc_key)) {
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&descproperties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&descproperties[aPropIndex], aParentDescriptor);
   }
   else if (aParentDescriptor->parentDescriptor->hasObjectKey(devicestate_key)) {
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   return PropertyDescriptorPtr();
 }
@@ -1878,7 +1882,7 @@ PropertyDescriptorPtr DeviceEvent::getDescriptorByIndex(int aPropIndex, int aDom
   };
   // check access path, depends on how we access the event (Note: for now we only have description, so it's not strictly needed yet here)
   if (aParentDescriptor->parentDescriptor->hasObjectKey(deviceeventdesc_key)) {
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&descproperties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&descproperties[aPropIndex], aParentDescriptor);
   }
   return PropertyDescriptorPtr();
 }
@@ -2452,7 +2456,7 @@ PropertyDescriptorPtr SingleDevice::getDescriptorByIndex(int aPropIndex, int aDo
     if (aPropIndex<n)
       return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
     aPropIndex -= n; // rebase to 0 for my own first property
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
   return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor);
 }
@@ -0,0 +1,478 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __p44vdc__treeapivalue__
+#define __p44vdc__treeapivalue__
+
+#include "p44utils_common.hpp"
+
+#include "apivalue.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  // initial capacity of object field lists
+  #ifndef TREE_APIVALUE_INITIAL_FIELDS
+    #define TREE_APIVALUE_INITIAL_FIELDS 8
+  #endif
+
+  /// ApiValue implementation keeping values as a plain tree of nodes, for API encodings which are
+  /// converted to and from their wire format in a single pass (protobuf, MessagePack)
+  /// @note object fields are stored as a flat list in insertion order. vDC API objects almost always have
+  ///   only a few fields, so a linear search in a compact vector is faster and needs far less allocations than a map
+  /// @param T the concrete subclass. All nodes of a tree are of that class, values of other ApiValue
+  ///   implementations can only be assigned (converted), not added.
+  template<class T> class TreeApiValue : public ApiValue
+  {
+    typedef ApiValue inherited;
+
+  public:
+
+    typedef boost::intrusive_ptr<T> NodePtr;
+    typedef pair<string, NodePtr> Field;
+    typedef vector<Field> FieldList;
+    typedef vector<NodePtr> NodeArray;
+
+  protected:
+
+    // the actual storage
+    ApiValueType allocatedType;
+    union {
+      bool boolVal;
+      uint64_t uint64Val;
+      int64_t int64Val;
+      double doubleVal;
+      string *stringP; // for strings and binary values
+      FieldList *objectFieldsP;
+      NodeArray *arrayVectorP;
+    } objectValue;
+
+    size_t keyIndex; ///< index of next field for nextKeyValue()
+
+  public:
+
+    TreeApiValue() : allocatedType(apivalue_null), keyIndex(0) { memset(&objectValue, 0, sizeof(objectValue)); };
+    virtual ~TreeApiValue() { clear(); };
+
+    virtual ApiValuePtr newValue(ApiValueType aObjectType) P44_OVERRIDE;
+
+    virtual void clear() P44_OVERRIDE;
+    virtual void operator=(ApiValue &aApiValue) P44_OVERRIDE;
+
+    virtual void add(const string &aKey, ApiValuePtr aObj) P44_OVERRIDE;
+    virtual ApiValuePtr get(const string &aKey) P44_OVERRIDE;
+    virtual void del(const string &aKey) P44_OVERRIDE;
+    virtual int arrayLength() P44_OVERRIDE;
+    virtual void arrayAppend(ApiValuePtr aObj) P44_OVERRIDE;
+    virtual ApiValuePtr arrayGet(int aAtIndex) P44_OVERRIDE;
+    virtual void arrayPut(int aAtIndex, ApiValuePtr aObj) P44_OVERRIDE;
+    virtual bool resetKeyIteration() P44_OVERRIDE;
+    virtual bool nextKeyValue(string &aKey, ApiValuePtr &aValue) P44_OVERRIDE;
+
+    virtual uint64_t uint64Value() P44_OVERRIDE;
+    virtual int64_t int64Value() P44_OVERRIDE;
+    virtual double doubleValue() P44_OVERRIDE;
+    virtual bool boolValue() P44_OVERRIDE;
+    virtual string binaryValue() P44_OVERRIDE;
+    virtual string stringValue() P44_OVERRIDE;
+
+    virtual void setUint64Value(uint64_t aUint64) P44_OVERRIDE;
+    virtual void setInt64Value(int64_t aInt64) P44_OVERRIDE;
+    virtual void setDoubleValue(double aDouble) P44_OVERRIDE;
+    virtual void setBoolValue(bool aBool) P44_OVERRIDE;
+    virtual void setBinaryValue(const string &aBinary) P44_OVERRIDE;
+    virtual bool setStringValue(const string &aString) P44_OVERRIDE;
+
+  protected:
+
+    void allocate();
+    bool allocateIf(ApiValueType aIsType);
+
+    size_t numObjectFields();
+    typename FieldList::iterator findField(const string &aKey);
+
+  };
+
+
+  // MARK: ===== TreeApiValue implementation
+
+  template<class T> ApiValuePtr TreeApiValue<T>::newValue(ApiValueType aObjectType)
+  {
+    ApiValuePtr newVal = ApiValuePtr(new T);
+    newVal->setType(aObjectType);
+    return newVal;
+  }
+
+
+  template<class T> void TreeApiValue<T>::operator=(ApiValue &aApiValue)
+  {
+    setNull(); // forget old content
+    TreeApiValue<T> *tavP = dynamic_cast<T *>(&aApiValue);
+    if (tavP) {
+      setType(aApiValue.getType());
+      allocate();
+      switch (allocatedType) {
+        case apivalue_string:
+        case apivalue_binary:
+          *(objectValue.stringP) = *(tavP->objectValue.stringP);
+          break;
+        case apivalue_object:
+          *(objectValue.objectFieldsP) = *(tavP->objectValue.objectFieldsP);
+          break;
+        case apivalue_array:
+          *(objectValue.arrayVectorP) = *(tavP->objectValue.arrayVectorP);
+          break;
+        default:
+          objectValue = tavP->objectValue; // copy union containing a scalar value
+          break;
+      }
+    }
+    else
+      inherited::operator=(aApiValue); // cross-type assignment, needs more expensive generic assignment
+  }
+
+
+  template<class T> void TreeApiValue<T>::clear()
+  {
+    // forget allocated type
+    if (allocatedType!=apivalue_null) {
+      switch (allocatedType) {
+        case apivalue_string:
+        case apivalue_binary:
+          if (objectValue.stringP) delete objectValue.stringP;
+          break;
+        case apivalue_object:
+          if (objectValue.objectFieldsP) delete objectValue.objectFieldsP;
+          break;
+        case apivalue_array:
+          if (objectValue.arrayVectorP) delete objectValue.arrayVectorP;
+          break;
+        default:
+          break;
+      }
+      // zero out union
+      memset(&objectValue, 0, sizeof(objectValue));
+      // is now a NULL object
+      allocatedType = apivalue_null;
+    }
+  }
+
+
+  template<class T> void TreeApiValue<T>::allocate()
+  {
+    if (allocatedType!=getType() && allocatedType==apivalue_null) {
+      allocatedType = getType();
+      switch (allocatedType) {
+        case apivalue_string:
+        case apivalue_binary:
+          objectValue.stringP = new string;
+          break;
+        case apivalue_object:
+          objectValue.objectFieldsP = new FieldList;
+          objectValue.objectFieldsP->reserve(TREE_APIVALUE_INITIAL_FIELDS);
+          break;
+        case apivalue_array:
+          objectValue.arrayVectorP = new NodeArray;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+
+  template<class T> bool TreeApiValue<T>::allocateIf(ApiValueType aIsType)
+  {
+    if (getType()==aIsType) {
+      allocate();
+      return true;
+    }
+    return false;
+  }
+
+
+  template<class T> typename TreeApiValue<T>::FieldList::iterator TreeApiValue<T>::findField(const string &aKey)
+  {
+    typename FieldList::iterator pos = objectValue.objectFieldsP->begin();
+    while (pos!=objectValue.objectFieldsP->end()) {
+      if (pos->first==aKey) break;
+      ++pos;
+    }
+    return pos;
+  }
+
+
+  template<class T> void TreeApiValue<T>::add(const string &aKey, ApiValuePtr aObj)
+  {
+    NodePtr val = boost::dynamic_pointer_cast<T>(aObj);
+    if (val && allocateIf(apivalue_object)) {
+      typename FieldList::iterator pos = findField(aKey);
+      if (pos!=objectValue.objectFieldsP->end())
+        pos->second = val; // replace existing
+      else
+        objectValue.objectFieldsP->push_back(Field(aKey, val));
+    }
+  }
+
+
+  template<class T> ApiValuePtr TreeApiValue<T>::get(const string &aKey)
+  {
+    if (allocatedType==apivalue_object) {
+      typename FieldList::iterator pos = findField(aKey);
+      if (pos!=objectValue.objectFieldsP->end())
+        return pos->second;
+    }
+    return ApiValuePtr();
+  }
+
+
+  template<class T> void TreeApiValue<T>::del(const string &aKey)
+  {
+    if (allocatedType==apivalue_object) {
+      typename FieldList::iterator pos = findField(aKey);
+      if (pos!=objectValue.objectFieldsP->end())
+        objectValue.objectFieldsP->erase(pos);
+    }
+  }
+
+
+  template<class T> int TreeApiValue<T>::arrayLength()
+  {
+    if (allocatedType==apivalue_array) {
+      return (int)objectValue.arrayVectorP->size();
+    }
+    return 0;
+  }
+
+
+  template<class T> void TreeApiValue<T>::arrayAppend(ApiValuePtr aObj)
+  {
+    NodePtr val = boost::dynamic_pointer_cast<T>(aObj);
+    if (val && allocateIf(apivalue_array)) {
+      objectValue.arrayVectorP->push_back(val);
+    }
+  }
+
+
+  template<class T> ApiValuePtr TreeApiValue<T>::arrayGet(int aAtIndex)
+  {
+    if (allocatedType==apivalue_array) {
+      if (aAtIndex<objectValue.arrayVectorP->size()) {
+        return objectValue.arrayVectorP->at(aAtIndex);
+      }
+    }
+    return ApiValuePtr();
+  }
+
+
+  template<class T> void TreeApiValue<T>::arrayPut(int aAtIndex, ApiValuePtr aObj)
+  {
+    NodePtr val = boost::dynamic_pointer_cast<T>(aObj);
+    if (val && allocateIf(apivalue_array)) {
+      if (aAtIndex<objectValue.arrayVectorP->size()) {
+        (*objectValue.arrayVectorP)[aAtIndex] = val;
+      }
+    }
+  }
+
+
+  template<class T> size_t TreeApiValue<T>::numObjectFields()
+  {
+    if (allocatedType==apivalue_object) {
+      return objectValue.objectFieldsP->size();
+    }
+    return 0;
+  }
+
+
+  template<class T> bool TreeApiValue<T>::resetKeyIteration()
+  {
+    if (allocatedType==apivalue_object) {
+      keyIndex = 0;
+      return true;
+    }
+    return false; // cannot be iterated
+  }
+
+
+  template<class T> bool TreeApiValue<T>::nextKeyValue(string &aKey, ApiValuePtr &aValue)
+  {
+    if (allocatedType==apivalue_object) {
+      if (keyIndex<objectValue.objectFieldsP->size()) {
+        const Field &field = (*objectValue.objectFieldsP)[keyIndex];
+        aKey = field.first;
+        aValue = field.second;
+        keyIndex++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+
+  template<class T> uint64_t TreeApiValue<T>::uint64Value()
+  {
+    if (allocatedType==apivalue_uint64) {
+      return objectValue.uint64Val;
+    }
+    else if (allocatedType==apivalue_int64 && objectValue.int64Val>=0) {
+      return objectValue.int64Val; // only return positive values
+    }
+    else if (allocatedType==apivalue_double) {
+      // we can get a double as uint (for JSON compatibility needed in upper dSS levels (VDCE, August 2016)
+      return objectValue.doubleVal;
+    }
+    return 0;
+  }
+
+
+  template<class T> int64_t TreeApiValue<T>::int64Value()
+  {
+    if (allocatedType==apivalue_int64) {
+      return objectValue.int64Val;
+    }
+    else if (allocatedType==apivalue_uint64) {
+      return objectValue.uint64Val & 0x7FFFFFFFFFFFFFFFll; // prevent returning sign
+    }
+    else if (allocatedType==apivalue_double) {
+      // we can get a double as int (for JSON compatibility needed in upper dSS levels (VDCE, August 2016)
+      return objectValue.doubleVal;
+    }
+    return 0;
+  }
+
+
+  template<class T> double TreeApiValue<T>::doubleValue()
+  {
+    if (allocatedType==apivalue_double) {
+      return objectValue.doubleVal;
+    }
+    else if (allocatedType==apivalue_uint64) {
+      return objectValue.uint64Val;
+    }
+    else {
+      return int64Value(); // int can also be read as double
+    }
+  }
+
+
+  template<class T> bool TreeApiValue<T>::boolValue()
+  {
+    if (allocatedType==apivalue_bool) {
+      return objectValue.boolVal;
+    }
+    else {
+      return int64Value()!=0; // non-zero int is also true
+    }
+  }
+
+
+  template<class T> string TreeApiValue<T>::binaryValue()
+  {
+    if (allocatedType==apivalue_binary) {
+      return *(objectValue.stringP);
+    }
+    else if (allocatedType==apivalue_string) {
+      return hexToBinaryString(objectValue.stringP->c_str());
+    }
+    else {
+      return ""; // not binary
+    }
+  }
+
+
+  template<class T> string TreeApiValue<T>::stringValue()
+  {
+    if (allocatedType==apivalue_string) {
+      return *(objectValue.stringP);
+    }
+    else if (allocatedType==apivalue_binary) {
+      // render as hex string
+      return binaryToHexString(*(objectValue.stringP));
+    }
+    // let base class render the contents as string
+    return inherited::stringValue();
+  }
+
+
+  template<class T> void TreeApiValue<T>::setUint64Value(uint64_t aUint64)
+  {
+    if (allocateIf(apivalue_uint64)) {
+      objectValue.uint64Val = aUint64;
+    }
+  }
+
+
+  template<class T> void TreeApiValue<T>::setInt64Value(int64_t aInt64)
+  {
+    if (allocateIf(apivalue_int64)) {
+      objectValue.int64Val = aInt64;
+    }
+  }
+
+
+  template<class T> void TreeApiValue<T>::setDoubleValue(double aDouble)
+  {
+    if (allocateIf(apivalue_double)) {
+      objectValue.doubleVal = aDouble;
+    }
+  }
+
+
+  template<class T> void TreeApiValue<T>::setBoolValue(bool aBool)
+  {
+    if (allocateIf(apivalue_bool)) {
+      objectValue.boolVal = aBool;
+    }
+  }
+
+
+  template<class T> void TreeApiValue<T>::setBinaryValue(const string &aBinary)
+  {
+    if (allocateIf(apivalue_binary)) {
+      objectValue.stringP->assign(aBinary);
+    }
+  }
+
+
+  template<class T> bool TreeApiValue<T>::setStringValue(const string &aString)
+  {
+    if (allocateIf(apivalue_string)) {
+      objectValue.stringP->assign(aString);
+      return true;
+    }
+    else if (allocateIf(apivalue_binary)) {
+      // parse string as hex
+      objectValue.stringP->assign(hexToBinaryString(aString.c_str()));
+      return true;
+    }
+    else {
+      // let base class try to convert to type of object
+      return inherited::setStringValue(aString);
+    }
+  }
+
+
+} // namespace p44
+
+#endif /* defined(__p44vdc__treeapivalue__) */
@@ -23,6 +23,8 @@
 
 #include "vdc.hpp"
 
+#include "channelbehaviour.hpp"
+
 using namespace p44;
 
 
@@ -372,6 +374,103 @@ void Vdc::setPeriodicRecollection(MLMicroSeconds aRecollectInterval, RescanMode
 
 
 
+// MARK: ===== warm restart snapshot
+
+bool Vdc::addDevicesToSnapshot(JsonObjectPtr aDevices)
+{
+  // Note: vdcs without devices are always collected, as we can't tell if they could restore devices at all
+  if (devices.empty()) return false;
+  JsonObjectPtr vdcDevices = JsonObject::newArray();
+  for (DeviceVector::iterator pos = devices.begin(); pos!=devices.end(); ++pos) {
+    DevicePtr dev = *pos;
+    JsonObjectPtr info = dev->snapshotInfo();
+    if (!info) return false; // device cannot be restored, vdc must be collected normally
+    JsonObjectPtr d = JsonObject::newObj();
+    d->add("dSUID", JsonObject::newString(dev->getDsUid().getString()));
+    d->add("info", info);
+    // last known channel values
+    JsonObjectPtr channels = JsonObject::newArray();
+    for (int i=0; i<dev->numChannels(); i++) {
+      channels->arrayAppend(JsonObject::newDouble(dev->getChannelByIndex(i)->getChannelValue()));
+    }
+    d->add("channels", channels);
+    vdcDevices->arrayAppend(d);
+  }
+  // all devices can be restored
+  for (int i=0; i<vdcDevices->arrayLength(); i++) {
+    aDevices->arrayAppend(vdcDevices->arrayGet(i));
+  }
+  return true;
+}
+
+
+bool Vdc::restoreFromSnapshot(JsonObjectPtr aDevices)
+{
+  if (!Error::isOK(vdcErr) || !aDevices) return false;
+  // first re-create all devices, to make sure we only add them when all can be restored
+  DeviceList restored;
+  for (int i=0; i<aDevices->arrayLength(); i++) {
+    JsonObjectPtr d = aDevices->arrayGet(i);
+    JsonObjectPtr o;
+    DevicePtr dev;
+    if (d->get("info", o)) dev = restoreDevice(o);
+    if (!dev || !d->get("dSUID", o) || dev->getDsUid().getString()!=o->stringValue()) {
+      ALOG(LOG_WARNING, "device #%d cannot be restored from snapshot -> collecting devices normally", i);
+      return false;
+    }
+    // last known channel values
+    if (d->get("channels", o)) {
+      for (int ci=0; ci<o->arrayLength(); ci++) {
+        ChannelBehaviourPtr ch = dev->getChannelByIndex(ci);
+        if (ch) ch->syncChannelValue(o->arrayGet(ci)->doubleValue());
+      }
+    }
+    restored.push_back(dev);
+  }
+  // now add them
+  for (DeviceList::iterator pos = restored.begin(); pos!=restored.end(); ++pos) {
+    DevicePtr dev = *pos;
+    if (getVdcHost().addDevice(dev)) {
+      devices.push_back(dev);
+      // must be confirmed by verifyRestoredDevices()
+      getVdcHost().unconfirmedDevices.insert(dev->getDsUid());
+    }
+  }
+  ALOG(LOG_NOTICE, "restored %zu devices from snapshot, will be verified after initialisation", restored.size());
+  return true;
+}
+
+
+void Vdc::verifyRestoredDevices(StatusCB aCompletedCB)
+{
+  ALOG(LOG_NOTICE, "verifying devices restored from snapshot");
+  // Note: known devices encountered in the incremental collect are confirmed by VdcHost::addDevice()
+  collectDevices(boost::bind(&Vdc::restoredDevicesVerified, this, aCompletedCB, _1), rescanmode_incremental);
+}
+
+
+void Vdc::restoredDevicesVerified(StatusCB aCompletedCB, ErrorPtr aError)
+{
+  // restored devices not encountered again in the collect are gone
+  DeviceList vanished;
+  for (DeviceVector::iterator pos = devices.begin(); pos!=devices.end(); ++pos) {
+    if (getVdcHost().unconfirmedDevices.erase((*pos)->getDsUid())>0) vanished.push_back(*pos);
+  }
+  if (!Error::isOK(aError)) {
+    // could not collect, we cannot know which devices are really gone
+    ALOG(LOG_WARNING, "could not verify devices restored from snapshot: %s", aError->description().c_str());
+  }
+  else {
+    for (DeviceList::iterator pos = vanished.begin(); pos!=vanished.end(); ++pos) {
+      ALOG(LOG_NOTICE, "device restored from snapshot no longer exists: %s", (*pos)->shortDesc().c_str());
+      (*pos)->hasVanished(false); // keep settings, device might re-appear
+    }
+  }
+  if (aCompletedCB) aCompletedCB(aError);
+}
+
+
+
 // MARK: ===== Managing devices
 
 
@@ -538,7 +637,7 @@ ErrorPtr Vdc::load()
 {
   ErrorPtr err;
   // load the vdc settings
-  err = loadFromStore(dSUID.getString().c_str());
+  err = CachingParamStore::load(*this, dSUID.getString().c_str());
   if (!Error::isOK(err)) ALOG(LOG_ERR,"Error loading settings: %s", err->description().c_str());
   loadSettingsFromFiles();
   return ErrorPtr();
@@ -549,7 +648,7 @@ ErrorPtr Vdc::save()
 {
   ErrorPtr err;
   // save the vdc settings
-  err = saveToStore(dSUID.getString().c_str(), false); // only one record per vdc
+  err = PersistenceWorker::save(getVdcHost().getPersistenceWorker(), *this, dSUID.getString().c_str(), false); // only one record per vdc
   return ErrorPtr();
 }
 
@@ -557,28 +656,57 @@ ErrorPtr Vdc::save()
 ErrorPtr Vdc::forget()
 {
   // delete the vdc settings
-  deleteFromStore();
+  PersistenceWorker::forget(getVdcHost().getPersistenceWorker(), *this);
   return ErrorPtr();
 }
 
 
-void Vdc::loadSettingsFromFiles()
+void Vdc::markDirty()
+{
+  inheritedParams::markDirty();
+  propertiesChanged();
+  getVdcHost().scheduleSave(getDsUid());
+}
+
+
+static const int numVdcSettingsLevels = 2;
+
+string Vdc::settingsFileName(int aLevel)
 {
-  string dir = getVdcHost().getConfigDir();
-  const int numLevels = 2;
-  string levelids[numLevels];
   // Level strategy: most specialized will be active, unless lower levels specify explicit override
   // - Baselines are hardcoded defaults plus settings (already) loaded from persistent store
   // - Level 0 are settings related to the device instance (dSUID)
   // - Level 1 are settings related to the vDC (vdcClassIdentifier())
-  levelids[0] = getDsUid().getString();
-  levelids[1] = vdcClassIdentifier();
-  for(int i=0; i<numLevels; ++i) {
-    // try to open config file
-    string fn = dir+"vdcsettings_"+levelids[i]+".csv";
+  return "vdcsettings_"+(aLevel==0 ? getDsUid().getString() : string(vdcClassIdentifier()))+".csv";
+}
+
+
+void Vdc::loadSettingsFromFiles()
+{
+  for(int i=0; i<numVdcSettingsLevels; ++i) {
+    // apply config file, if any
     // if vdc has already stored properties, only explicitly marked properties will be applied
-    if (loadSettingsFromFile(fn.c_str(), rowid!=0)) markClean();
+    if (loadSettingsFromConfigFile(settingsFileName(i), rowid!=0)) markClean();
+  }
+}
+
+
+bool Vdc::configFileChanged(const string &aFileName, bool aRemoved)
+{
+  bool usesFile = aFileName.empty();
+  for(int i=0; i<numVdcSettingsLevels && !usesFile; ++i) {
+    usesFile = aFileName==settingsFileName(i);
+  }
+  if (!usesFile) return false;
+  if (aRemoved) {
+    // values replaced by the file's settings are not known any more, so these cannot be reverted
+    ALOG(LOG_NOTICE, "config file %s removed - settings applied from it remain in effect until changed", aFileName.c_str());
   }
+  // reloading marks settings clean, so pending changes must be saved first
+  save();
+  loadSettingsFromFiles();
+  ALOG(LOG_INFO, "reloaded settings from changed config file %s", aFileName.empty() ? "(all)" : aFileName.c_str());
+  return true;
 }
 
 
@@ -661,7 +789,7 @@ PropertyDescriptorPtr Vdc::getDescriptorByIndex(int aPropIndex, int aDomain, Pro
       { "dynamicDefinitions", apivalue_bool, capability_dynamicdefinitions_key, OKEY(capabilities_container_key) },
     };
     // simple, all on this level
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&capability_props[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&capability_props[aPropIndex], aParentDescriptor);
   }
   else {
     // vdc level
@@ -677,7 +805,7 @@ PropertyDescriptorPtr Vdc::getDescriptorByIndex(int aPropIndex, int aDomain, Pro
     if (aPropIndex<n)
       return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
     aPropIndex -= n; // rebase to 0 for my own first property
-    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+    return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
   }
 }
 
@@ -786,6 +914,13 @@ void Vdc::bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const c
 // MARK: ===== description/shortDesc/status
 
 
+void Vdc::propertiesChanged()
+{
+  inherited::propertiesChanged();
+  getVdcHost().propertiesChanged();
+}
+
+
 string Vdc::description()
 {
   string d = string_format(
@@ -290,6 +290,32 @@ namespace p44 {
 		/// @}
 
 
+    /// @name warm restart snapshot
+    /// @{
+
+    /// add the information needed to re-create all devices of this vDC without scanning
+    /// @param aDevices JSON array to append one object per device to
+    /// @return false if the vDC has no devices or not all of them can be restored from a snapshot. In this case
+    ///   nothing is added, and the vDC will collect its devices normally at next startup.
+    bool addDevicesToSnapshot(JsonObjectPtr aDevices);
+
+    /// re-create devices from a snapshot instead of collecting them
+    /// @param aDevices JSON array of devices as created by addDevicesToSnapshot()
+    /// @return true if all devices were restored and added. If false, no device was added and the
+    ///   vDC must collect its devices normally.
+    /// @note restored devices are not confirmed to exist, verifyRestoredDevices() must be called later. Until then,
+    ///   they operate with their restored state, without initializeDevice() having accessed the hardware.
+    bool restoreFromSnapshot(JsonObjectPtr aDevices);
+
+    /// verify devices restored from a snapshot against the hardware
+    /// @param aCompletedCB will be called when verification is complete
+    /// @note this runs an incremental collect. Restored devices encountered in this collect get initialized
+    ///   now (see VdcHost::addDevice()), those not encountered are removed via the normal vanish path.
+    void verifyRestoredDevices(StatusCB aCompletedCB);
+
+    /// @}
+
+
     /// @name vdc level property persistence
     /// @{
 
@@ -299,7 +325,7 @@ namespace p44 {
 
     /// save unsaved parameters to persistent DB
     /// @note this is usually called from the device container in regular intervals
-    ErrorPtr save();
+    virtual ErrorPtr save() P44_OVERRIDE;
 
     /// forget any parameters stored in persistent DB
     ErrorPtr forget();
@@ -307,6 +333,12 @@ namespace p44 {
     // load additional settings from files
     void loadSettingsFromFiles();
 
+    /// reload settings from config files after one of them has changed
+    /// @param aFileName name of the changed config file (without directory), empty if any file might have changed
+    /// @param aRemoved set if the file was removed. Settings it had applied remain in effect until changed otherwise.
+    /// @return true if the vdc uses that file and has reloaded its settings from files
+    bool configFileChanged(const string &aFileName, bool aRemoved);
+
 		/// @}
 
 
@@ -362,6 +394,9 @@ namespace p44 {
     /// @}
 
 
+    /// mark properties changed, including the vdc host
+    virtual void propertiesChanged() P44_OVERRIDE;
+
     /// description of object, mainly for debug and logging
     /// @return textual description of object
     virtual string description() P44_OVERRIDE;
@@ -387,6 +422,7 @@ namespace p44 {
     virtual const FieldDefinition *getFieldDef(size_t aIndex) P44_OVERRIDE;
     virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP) P44_OVERRIDE;
     virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags) P44_OVERRIDE;
+    virtual void markDirty() P44_OVERRIDE;
 
     // derive dSUID
     void deriveDsUid();
@@ -404,13 +440,22 @@ namespace p44 {
     ///   and thus cannot remove any settings, either)
     virtual void scanForDevices(StatusCB aCompletedCB, RescanMode aRescanFlags) = 0;
 
+    /// re-create a device from a warm restart snapshot
+    /// @param aSnapshotInfo the information returned by Device::snapshotInfo() when the snapshot was written
+    /// @return the device, identified and ready to be added, or NULL if it cannot be restored (default)
+    /// @note vDCs implementing this must report all present devices, including already known ones, to
+    ///   VdcHost::addDevice() in an incremental collect, as this is how restored devices get confirmed.
+    virtual DevicePtr restoreDevice(JsonObjectPtr aSnapshotInfo) { return DevicePtr(); };
+
 
   private:
 
+    string settingsFileName(int aLevel);
     void collectedDevices(StatusCB aCompletedCB, ErrorPtr aError);
     void schedulePeriodicRecollecting();
     void initiateRecollect(RescanMode aRescanMode);
     void recollectDone();
+    void restoredDevicesVerified(StatusCB aCompletedCB, ErrorPtr aError);
 
     /// utility method for identifyAndAddDevice(s): identify device with retries
     /// @param aNewDevice the device to be identified
@@ -21,6 +21,9 @@
 
 #include "vdcapi.hpp"
 
+#include <sys/time.h>
+#include <unistd.h>
+
 using namespace p44;
 
 
@@ -76,6 +79,25 @@ VdcApiServer::VdcApiServer() :
 }
 
 
+string VdcApiServer::recordingPath()
+{
+  // timestamp with microseconds, so recordings from different runs never overwrite each other
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  struct tm lt;
+  localtime_r(&now.tv_sec, &lt);
+  char ts[32];
+  strftime(ts, sizeof(ts), "%Y%m%d-%H%M%S", &lt);
+  string base = string_format("%s%s.%06ld", recordingPathPrefix.c_str(), ts, (long)now.tv_usec);
+  string path = base + ".vrec";
+  // still make sure not to overwrite an existing recording (clock set back)
+  for (int n=1; access(path.c_str(), F_OK)==0; n++) {
+    path = string_format("%s-%d.vrec", base.c_str(), n);
+  }
+  return path;
+}
+
+
 void VdcApiServer::start()
 {
   inherited::startServer(boost::bind(&VdcApiServer::serverConnectionHandler, this, _1), 3);
@@ -103,6 +125,14 @@ SocketCommPtr VdcApiServer::serverConnectionHandler(SocketCommPtr aServerSocketC
   socketComm->setClearHandlersAtClose(); // to make sure retain cycles are broken
   socketComm->relatedObject = apiConnection; // bind object to connection
   socketComm->setConnectionStatusHandler(boost::bind(&VdcApiServer::connectionStatusHandler, this, _1, _2));
+  if (!recordingPathPrefix.empty()) {
+    // record this connection
+    string path = recordingPath();
+    ErrorPtr err = apiConnection->startRecording(path);
+    if (!Error::isOK(err)) {
+      LOG(LOG_ERR, "Cannot record API connection to %s: %s", path.c_str(), err->description().c_str());
+    }
+  }
   // return the socketComm object which handles this connection
   return socketComm;
 }
@@ -119,13 +149,129 @@ void VdcApiServer::connectionStatusHandler(SocketCommPtr aSocketComm, ErrorPtr a
   }
   if (!Error::isOK(aError)) {
     // connection failed/closed and we don't support reconnect yet
+    VdcApiConnectionPtr apiConnection = boost::dynamic_pointer_cast<VdcApiConnection>(aSocketComm->relatedObject);
+    if (apiConnection) {
+      apiConnection->stopRecording();
+      apiConnection->abortPendingRequests();
+    }
     aSocketComm->relatedObject.reset(); // detach connection object
   }
 }
 
 
+// MARK: ===== VdcApiRecorder
+
+#define VDCAPI_RECORDING_VERSION 1
+
+
+VdcApiRecorder::VdcApiRecorder() :
+  recordFile(NULL),
+  recordingStart(Never)
+{
+}
+
+
+VdcApiRecorder::~VdcApiRecorder()
+{
+  close();
+}
+
+
+ErrorPtr VdcApiRecorder::open(const string &aFilePath, VdcApiEncoding aEncoding)
+{
+  close();
+  recordFile = fopen(aFilePath.c_str(), "w");
+  if (!recordFile) {
+    return SysError::errNo("cannot open recording file: ");
+  }
+  uint8_t hdr[6] = { 'V', 'R', 'E', 'C', VDCAPI_RECORDING_VERSION, (uint8_t)aEncoding };
+  fwrite(hdr, sizeof(hdr), 1, recordFile);
+  recordingStart = MainLoop::now();
+  LOG(LOG_NOTICE, "Started recording API connection to %s", aFilePath.c_str());
+  return ErrorPtr();
+}
+
+
+void VdcApiRecorder::close()
+{
+  if (recordFile) {
+    fclose(recordFile);
+    recordFile = NULL;
+  }
+}
+
+
+void VdcApiRecorder::recordMessage(bool aOutbound, const void *aData, size_t aSize)
+{
+  if (!recordFile) return;
+  uint64_t t = MainLoop::now()-recordingStart;
+  uint8_t hdr[13];
+  for (int i=0; i<8; i++) hdr[i] = (t>>(8*(7-i))) & 0xFF;
+  hdr[8] = aOutbound ? 0x01 : 0x00;
+  for (int i=0; i<4; i++) hdr[9+i] = ((uint32_t)aSize>>(8*(3-i))) & 0xFF;
+  fwrite(hdr, sizeof(hdr), 1, recordFile);
+  fwrite(aData, aSize, 1, recordFile);
+}
+
+
+// MARK: ===== VdcApiDirectNotification
+
+
+VdcApiDirectNotification::VdcApiDirectNotification(DirectNotificationType aType, const char *aMethod) :
+  type(aType),
+  method(aMethod),
+  numDsUids(0),
+  dsUids(NULL),
+  zoneId(-1),
+  group(-1),
+  scene(-1),
+  force(-1),
+  name(NULL),
+  hasValue(false),
+  value(0),
+  channel(-1),
+  channelId(NULL),
+  applyNow(true)
+{
+}
+
+
 // MARK: ===== VdcApiConnection
 
+// default max number of method calls in progress at the same time per connection
+#ifndef DEFAULT_MAX_INFLIGHT_REQUESTS
+  #define DEFAULT_MAX_INFLIGHT_REQUESTS 8
+#endif
+
+
+VdcApiConnection::VdcApiConnection() :
+  apiVersion(0),
+  maxInFlight(DEFAULT_MAX_INFLIGHT_REQUESTS),
+  inFlightRequests(0),
+  processingQueue(false),
+  queueAdvanceTicket(0)
+{
+  VdcApiConnection::statisticsReset();
+}
+
+
+ErrorPtr VdcApiConnection::startRecording(const string &aFilePath)
+{
+  VdcApiRecorderPtr r = VdcApiRecorderPtr(new VdcApiRecorder);
+  ErrorPtr err = r->open(aFilePath, apiEncoding());
+  if (Error::isOK(err)) recorder = r;
+  return err;
+}
+
+
+void VdcApiConnection::stopRecording()
+{
+  if (recorder) {
+    recorder->close();
+    recorder.reset();
+  }
+}
+
 
 void VdcApiConnection::setRequestHandler(VdcApiRequestCB aApiRequestHandler)
 {
@@ -133,8 +279,15 @@ void VdcApiConnection::setRequestHandler(VdcApiRequestCB aApiRequestHandler)
 }
 
 
+void VdcApiConnection::setDirectNotificationHandler(VdcApiDirectNotificationCB aApiDirectNotificationHandler)
+{
+  apiDirectNotificationHandler = aApiDirectNotificationHandler;
+}
+
+
 void VdcApiConnection::closeConnection()
 {
+  abortPendingRequests();
   if (socketConnection()) {
     socketConnection()->closeConnection();
     socketConnection()->clearCallbacks();
@@ -152,8 +305,148 @@ ApiValuePtr VdcApiConnection::newApiValue()
 }
 
 
+ErrorPtr VdcApiConnection::encodeNotification(const string &aMethod, ApiValuePtr aParams, string &aEncodedMessage)
+{
+  return Error::err<VdcApiError>(501, "API implementation cannot pre-encode notifications");
+}
+
+
+ErrorPtr VdcApiConnection::sendEncoded(const string &aEncodedMessage)
+{
+  return Error::err<VdcApiError>(501, "API implementation cannot send pre-encoded messages");
+}
+
+
+void VdcApiConnection::dispatchRequest(VdcApiRequestPtr aRequest, const string &aMethod, ApiValuePtr aParams)
+{
+  if (!apiRequestHandler) return;
+  if (!aRequest) {
+    // notifications are never queued, they must not wait behind slow method calls
+    apiRequestHandler(VdcApiConnectionPtr(this), aRequest, aMethod, aParams);
+    return;
+  }
+  // method call, queue it
+  PendingApiRequest pr;
+  pr.request = aRequest;
+  pr.method = aMethod;
+  pr.params = aParams;
+  pr.queuedAt = MainLoop::now();
+  requestQueue.push_back(pr);
+  if (requestQueue.size()>statMaxQueueDepth) statMaxQueueDepth = requestQueue.size();
+  // dispatch as many as window allows
+  processRequestQueue();
+}
+
+
+void VdcApiConnection::processRequestQueue()
+{
+  // Note: request handlers might dispatch other requests (e.g. by running a nested mainloop cycle).
+  //   The loop below takes care of continuing, so no recursion is needed.
+  if (processingQueue) return;
+  processingQueue = true;
+  VdcApiConnectionPtr keepAlive = VdcApiConnectionPtr(this); // handlers might close the connection
+  while (!requestQueue.empty() && (maxInFlight<=0 || inFlightRequests<maxInFlight) && apiRequestHandler) {
+    PendingApiRequest pr = requestQueue.front();
+    requestQueue.pop_front();
+    // statistics
+    MLMicroSeconds waited = MainLoop::now()-pr.queuedAt;
+    statDispatchedRequests++;
+    statTotalWait += waited;
+    if (waited>statMaxWait) statMaxWait = waited;
+    if (waited>0) {
+      LOG(LOG_DEBUG, "method call '%s' (requestid='%s') waited %lld mS for dispatch", pr.method.c_str(), pr.request->requestId().c_str(), waited/MilliSecond);
+    }
+    // occupy slot until answered
+    inFlightRequests++;
+    pr.request->pipelineConnection = keepAlive;
+    apiRequestHandler(keepAlive, pr.request, pr.method, pr.params);
+  }
+  processingQueue = false;
+}
+
+
+void VdcApiConnection::requestCompleted()
+{
+  if (inFlightRequests>0) inFlightRequests--;
+  // Note: this is called from within sending answers and even from request destructors, so
+  //   dispatching the next request must happen from the mainloop, not from here
+  if (!queueAdvanceTicket && !requestQueue.empty()) {
+    queueAdvanceTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcApiConnection::advanceRequestQueue, this, VdcApiConnectionPtr(this)));
+  }
+}
+
+
+void VdcApiConnection::advanceRequestQueue(VdcApiConnectionPtr aKeepAlive)
+{
+  queueAdvanceTicket = 0;
+  processRequestQueue();
+}
+
+
+void VdcApiConnection::abortPendingRequests()
+{
+  if (!requestQueue.empty()) {
+    LOG(LOG_INFO, "API connection closing: dropping %lu queued method calls", (unsigned long)requestQueue.size());
+    requestQueue.clear();
+  }
+}
+
+
+string VdcApiConnection::statisticsInfo()
+{
+  return string_format(
+    "%d method calls in progress, %lu queued (max %lu), %ld dispatched, avg wait %lld mS, max wait %lld mS",
+    inFlightRequests,
+    (unsigned long)requestQueue.size(),
+    (unsigned long)statMaxQueueDepth,
+    statDispatchedRequests,
+    statDispatchedRequests>0 ? statTotalWait/statDispatchedRequests/MilliSecond : 0,
+    statMaxWait/MilliSecond
+  );
+}
+
+
+void VdcApiConnection::statisticsReset()
+{
+  statMaxQueueDepth = requestQueue.size();
+  statDispatchedRequests = 0;
+  statTotalWait = 0;
+  statMaxWait = 0;
+}
+
+
+
 // MARK: ===== VdcApiRequest
 
+VdcApiRequest::VdcApiRequest() :
+  receivedAt(MainLoop::now())
+{
+}
+
+
+VdcApiRequest::~VdcApiRequest()
+{
+  // a request that is never answered must not block its slot forever
+  answeredHandler = NULL; // ...but was not answered
+  answered();
+}
+
+
+void VdcApiRequest::answered()
+{
+  if (answeredHandler) {
+    SimpleCB cb = answeredHandler;
+    answeredHandler = NULL;
+    cb();
+  }
+  if (pipelineConnection) {
+    VdcApiConnectionPtr c = pipelineConnection;
+    pipelineConnection.reset();
+    c->requestCompleted();
+  }
+}
+
+
 ErrorPtr VdcApiRequest::sendError(ErrorPtr aErrorToSend)
 {
   if (!Error::isOK(aErrorToSend)) {
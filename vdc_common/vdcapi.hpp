@@ -110,6 +110,107 @@ namespace p44 {
   typedef boost::function<void (VdcApiConnectionPtr aApiConnection, ErrorPtr &aError)> VdcApiConnectionCB;
 
 
+  /// notifications which can be delivered via the direct path, see VdcApiDirectNotification
+  typedef enum {
+    directnotification_callScene,
+    directnotification_saveScene,
+    directnotification_undoScene,
+    directnotification_setLocalPriority,
+    directnotification_callSceneMin,
+    directnotification_setControlValue,
+    directnotification_setOutputChannelValue
+  } DirectNotificationType;
+
+  /// Parameters of a frequently used notification, decoded directly from the wire format by API implementations
+  /// which can do so without building a generic ApiValue parameter tree first.
+  /// @note all pointers are borrowed from the decoded message and are valid only during the call
+  ///   of the VdcApiDirectNotificationCB.
+  class VdcApiDirectNotification
+  {
+  public:
+
+    VdcApiDirectNotification(DirectNotificationType aType, const char *aMethod);
+
+    DirectNotificationType type; ///< the notification
+    const char *method; ///< the method name of the notification (same as in generic delivery)
+
+    /// @name audience
+    /// @{
+    size_t numDsUids; ///< number of dSUIDs
+    const char * const *dsUids; ///< dSUIDs as strings
+    int zoneId; ///< zone ID, -1 if not specified
+    int group; ///< group, -1 if not specified
+    /// @}
+
+    /// @name parameters
+    /// @{
+    int scene; ///< scene number, -1 if not specified
+    int force; ///< force flag, -1 if not specified
+    const char *name; ///< control value name, NULL if not specified
+    bool hasValue; ///< set if value is specified
+    double value; ///< control or channel value
+    int channel; ///< channel type, -1 if not specified
+    const char *channelId; ///< channel ID, NULL if not specified
+    bool applyNow; ///< apply_now flag
+    /// @}
+
+  };
+
+  /// callback for delivering a directly decoded notification
+  /// @param aApiConnection the VdcApiConnection calling this handler
+  /// @param aNotification the directly decoded notification
+  /// @return true if the notification was handled, false if the API implementation must deliver it via the generic
+  ///   VdcApiRequestCB path instead.
+  typedef boost::function<bool (VdcApiConnectionPtr aApiConnection, const VdcApiDirectNotification &aNotification)> VdcApiDirectNotificationCB;
+
+
+
+
+  /// wire encoding of a API connection, as stored in session recordings
+  typedef enum {
+    vdcapi_encoding_unknown = 0,
+    vdcapi_encoding_protobuf = 'P',
+    vdcapi_encoding_json = 'J',
+    vdcapi_encoding_msgpack = 'M' ///< config API only
+  } VdcApiEncoding;
+
+
+  class VdcApiRecorder;
+  typedef boost::intrusive_ptr<VdcApiRecorder> VdcApiRecorderPtr;
+
+  /// Records all messages of a API connection with timestamps into a file, for later replay with VdcApiReplayer
+  /// @note file format: 4 bytes "VREC", 1 byte format version, 1 byte VdcApiEncoding, followed by one record
+  ///   per message: 8 bytes timestamp (microseconds since start of recording), 1 byte flags (bit 0 set for outbound),
+  ///   4 bytes message size, message. All numbers are big endian.
+  class VdcApiRecorder : public P44Obj
+  {
+    typedef P44Obj inherited;
+
+    FILE *recordFile;
+    MLMicroSeconds recordingStart;
+
+  public:
+
+    VdcApiRecorder();
+    virtual ~VdcApiRecorder();
+
+    /// start recording
+    /// @param aFilePath path of the recording file, will be overwritten if it exists
+    /// @param aEncoding the encoding of the recorded messages
+    /// @return ok or error
+    ErrorPtr open(const string &aFilePath, VdcApiEncoding aEncoding);
+
+    /// end recording
+    void close();
+
+    /// record a message
+    /// @param aOutbound true for messages sent by the vDC host, false for received messages
+    /// @param aData the message (without transport framing)
+    /// @param aSize size of the message
+    void recordMessage(bool aOutbound, const void *aData, size_t aSize);
+
+  };
+
 
 
   /// a single API connection
@@ -117,19 +218,58 @@ namespace p44 {
   {
     typedef P44Obj inherited;
 
+    friend class VdcApiRequest;
+
+    /// method call waiting to be dispatched
+    typedef struct {
+      VdcApiRequestPtr request;
+      string method;
+      ApiValuePtr params;
+      MLMicroSeconds queuedAt;
+    } PendingApiRequest;
+    typedef list<PendingApiRequest> PendingApiRequestQueue;
+
+    // request pipelining
+    PendingApiRequestQueue requestQueue; ///< method calls waiting for a free slot in the in-flight window
+    int maxInFlight; ///< max number of method calls in progress at the same time, 0=unlimited
+    int inFlightRequests; ///< number of method calls dispatched but not yet answered
+    bool processingQueue; ///< set while dispatching from the queue
+    MLTicket queueAdvanceTicket; ///< set while dispatching the next queued method call is scheduled
+
+    // pipelining statistics
+    size_t statMaxQueueDepth; ///< max number of queued method calls
+    long statDispatchedRequests; ///< number of method calls dispatched
+    MLMicroSeconds statTotalWait; ///< accumulated time method calls waited in the queue
+    MLMicroSeconds statMaxWait; ///< max time a method call waited in the queue
+
   protected:
 
     VdcApiRequestCB apiRequestHandler;
+    VdcApiDirectNotificationCB apiDirectNotificationHandler;
     int apiVersion;
+    VdcApiRecorderPtr recorder; ///< set while this connection is being recorded
+
+    /// deliver a received method call or notification to the request handler
+    /// @param aRequest the request (NULL for notifications)
+    /// @param aMethod the method or notification name
+    /// @param aParams the parameters
+    /// @note notifications are always delivered immediately. Method calls are delivered as long as less than
+    ///   maxInFlight method calls are unanswered, otherwise they are queued until earlier ones are answered.
+    void dispatchRequest(VdcApiRequestPtr aRequest, const string &aMethod, ApiValuePtr aParams);
 
   public:
 
-    VdcApiConnection() : apiVersion(0) {};
+    VdcApiConnection();
 
     /// install callback for received API requests
     /// @param aApiRequestHandler will be called when a API request has been received
     void setRequestHandler(VdcApiRequestCB aApiRequestHandler);
 
+    /// install callback for directly decoded notifications
+    /// @param aApiDirectNotificationHandler will be called for notifications the API implementation can decode directly
+    /// @note API implementations not supporting direct decoding always use the request handler
+    void setDirectNotificationHandler(VdcApiDirectNotificationCB aApiDirectNotificationHandler);
+
     /// end connection
     void closeConnection();
 
@@ -146,6 +286,19 @@ namespace p44 {
     /// @return empty or Error object in case of error
     virtual ErrorPtr sendRequest(const string &aMethod, ApiValuePtr aParams, VdcApiResponseCB aResponseHandler = VdcApiResponseCB()) = 0;
 
+    /// encode a notification once, for sending the same message to multiple connections with sendEncoded()
+    /// @param aMethod the vDC API notification name
+    /// @param aParams the parameters for the notification. Can be NULL.
+    /// @param aEncodedMessage will receive the encoded message
+    /// @return empty or Error object in case of error. API implementations not supporting pre-encoding
+    ///   return a 501 error, callers must use sendRequest() on each connection then.
+    virtual ErrorPtr encodeNotification(const string &aMethod, ApiValuePtr aParams, string &aEncodedMessage);
+
+    /// send a message encoded by encodeNotification() of a connection of the same API implementation
+    /// @param aEncodedMessage the encoded message
+    /// @return empty or Error object in case of error
+    virtual ErrorPtr sendEncoded(const string &aEncodedMessage);
+
     /// request closing connection after last message has been sent
     virtual void closeAfterSend() = 0;
 
@@ -163,6 +316,43 @@ namespace p44 {
     /// @note is effective only when current API version is not defined (==0)
     void setApiVersion(int aApiVersion) { if (apiVersion==0) apiVersion = aApiVersion; };
 
+    /// enable sending and receiving messages exceeding the transport's frame size limit as a sequence of fragments
+    /// @return true if this connection supports fragmentation and has enabled it now
+    /// @note must only be enabled when the peer has indicated (in hello) that it supports fragmentation
+    virtual bool enableFragmentation() { return false; };
+
+    /// set the max number of method calls in progress at the same time
+    /// @param aMaxInFlight max number of unanswered method calls, 0 for unlimited
+    void setMaxInFlight(int aMaxInFlight) { maxInFlight = aMaxInFlight; };
+
+    /// get traffic statistics of this connection
+    /// @return statistics as text
+    virtual string statisticsInfo();
+
+    /// reset traffic statistics of this connection
+    virtual void statisticsReset();
+
+    /// @return the wire encoding of this connection
+    virtual VdcApiEncoding apiEncoding() { return vdcapi_encoding_unknown; };
+
+    /// start recording all messages on this connection
+    /// @param aFilePath path of the recording file
+    /// @return ok or error
+    ErrorPtr startRecording(const string &aFilePath);
+
+    /// stop recording
+    void stopRecording();
+
+    /// drop all method calls still waiting for dispatch
+    /// @note must be called when the connection closes, queued requests would otherwise keep the connection alive
+    void abortPendingRequests();
+
+  private:
+
+    void processRequestQueue();
+    void requestCompleted();
+    void advanceRequestQueue(VdcApiConnectionPtr aKeepAlive);
+
   };
 
 
@@ -174,10 +364,17 @@ namespace p44 {
 
     VdcApiConnectionCB apiConnectionStatusHandler; ///< connection status handler
 
+    string recordingPathPrefix; ///< if set, all connections will be recorded
+
   public:
 
     VdcApiServer();
 
+    /// record all API connections accepted from now on
+    /// @param aPathPrefix path prefix for the recording files, a timestamp of the connection and ".vrec" will be appended.
+    ///   Empty string stops recording new connections.
+    void enableRecording(const string &aPathPrefix) { recordingPathPrefix = aPathPrefix; };
+
     /// set connection status handler
     /// @param aConnectionCB will be called when connections opens, ends or has error
     void setConnectionStatusHandler(VdcApiConnectionCB aConnectionCB);
@@ -205,6 +402,7 @@ namespace p44 {
   private:
 
     SocketCommPtr serverConnectionHandler(SocketCommPtr aServerSocketComm);
+    string recordingPath();
     void connectionStatusHandler(SocketCommPtr aSocketComm, ErrorPtr aError);
 
   };
@@ -216,8 +414,30 @@ namespace p44 {
   {
     typedef P44Obj inherited;
 
+    friend class VdcApiConnection;
+
+    VdcApiConnectionPtr pipelineConnection; ///< set while this request occupies a slot in the connection's in-flight window
+    SimpleCB answeredHandler; ///< called when the answer has been sent
+    MLMicroSeconds receivedAt; ///< when the request arrived on the connection
+
+  protected:
+
+    /// must be called by subclasses when the answer for this request has been sent
+    void answered();
+
   public:
 
+    VdcApiRequest();
+    virtual ~VdcApiRequest();
+
+    /// @return time when this request arrived from the connection (before possibly waiting for dispatch)
+    MLMicroSeconds getReceivedAt() { return receivedAt; };
+
+    /// install callback to be called when the answer for this request has been sent
+    /// @param aAnsweredCB will be called once, when sendResult() or sendError() has been called
+    /// @note will not be called when the request is deleted without having been answered
+    void setAnsweredHandler(SimpleCB aAnsweredCB) { answeredHandler = aAnsweredCB; };
+
     /// return the request ID as a string
     /// @return request ID as string
     virtual string requestId() = 0;
@@ -231,6 +451,16 @@ namespace p44 {
     /// @result empty or object in case of error sending result response
     virtual ErrorPtr sendResult(ApiValuePtr aResult) = 0;
 
+    /// check if the result can be sent in parts
+    /// @return true if sendResultPart() can be used for this request
+    virtual bool canStreamResult() { return false; };
+
+    /// send part of the result object. The fields of all parts and of the final sendResult() together form the result.
+    /// @param aResultPart object containing some of the result's fields. It is encoded right away and not needed afterwards
+    /// @result empty or Error object in case of error sending the part. In case of error, the request must be answered with an error.
+    /// @note must only be used when canStreamResult() returns true
+    virtual ErrorPtr sendResultPart(ApiValuePtr aResultPart) { return Error::err<VdcApiError>(500, "result cannot be sent in parts"); };
+
     /// send a vDC API error (answer for unsuccesful method call)
     /// @param aErrorCode the error code
     /// @param aErrorMessage the error message or NULL to generate a standard text
@@ -0,0 +1,442 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "vdcapireplayer.hpp"
+
+#include "pbufvdcapi.hpp"
+
+#include <algorithm>
+
+
+using namespace p44;
+
+
+// max number of messages sent per mainloop cycle when replaying at maximum speed
+#ifndef REPLAY_MAX_MESSAGES_PER_CYCLE
+  #define REPLAY_MAX_MESSAGES_PER_CYCLE 10
+#endif
+
+// how long to wait for outstanding responses after the last message has been sent
+#ifndef REPLAY_RESPONSE_TIMEOUT
+  #define REPLAY_RESPONSE_TIMEOUT (10*Second)
+#endif
+
+// protobuf API framing, see VdcPbufApiConnection
+#define PBUF_MAX_DATA_SIZE 16384
+#define PBUF_FRAGMENT_CONTINUES 0x8000
+
+
+// MARK: ===== VdcApiReplayer
+
+
+VdcApiReplayer::VdcApiReplayer() :
+  encoding(vdcapi_encoding_unknown),
+  speed(1),
+  nextMessage(0),
+  replayStart(Never),
+  replayEnd(Never),
+  replayTicket(0),
+  peerFragmentation(false),
+  droppedMessages(0)
+{
+}
+
+
+VdcApiReplayer::~VdcApiReplayer()
+{
+  MainLoop::currentMainLoop().cancelExecutionTicket(replayTicket);
+  if (connection) {
+    connection->closeConnection();
+    connection->clearCallbacks();
+  }
+}
+
+
+ErrorPtr VdcApiReplayer::load(const string &aFilePath)
+{
+  messages.clear();
+  FILE *file = fopen(aFilePath.c_str(), "r");
+  if (!file) {
+    return SysError::errNo("cannot open recording: ");
+  }
+  ErrorPtr err;
+  uint8_t hdr[13];
+  if (fread(hdr, 6, 1, file)!=1 || memcmp(hdr, "VREC", 4)!=0 || hdr[4]!=1) {
+    err = TextError::err("%s is not a vDC API recording", aFilePath.c_str());
+  }
+  else {
+    encoding = (VdcApiEncoding)hdr[5];
+    if (encoding!=vdcapi_encoding_protobuf && encoding!=vdcapi_encoding_json) {
+      err = TextError::err("recording %s has unsupported encoding", aFilePath.c_str());
+    }
+    while (Error::isOK(err) && fread(hdr, sizeof(hdr), 1, file)==1) {
+      RecordedMessage m;
+      m.recordedAt = 0;
+      for (int i=0; i<8; i++) m.recordedAt = (m.recordedAt<<8) | hdr[i];
+      bool outbound = hdr[8] & 0x01;
+      size_t size = 0;
+      for (int i=9; i<13; i++) size = (size<<8) | hdr[i];
+      m.message.resize(size);
+      if (size>0 && fread(&m.message[0], size, 1, file)!=1) {
+        err = TextError::err("recording %s is truncated", aFilePath.c_str());
+        break;
+      }
+      // only messages received by the vDC host are replayed, responses refer to IDs of the recorded session
+      if (outbound) continue;
+      if (encoding==vdcapi_encoding_protobuf ? identifyPbufMessage(m) : identifyJsonMessage(m)) {
+        messages.push_back(m);
+      }
+    }
+  }
+  fclose(file);
+  LOG(LOG_NOTICE, "Loaded %zu messages to replay from %s", messages.size(), aFilePath.c_str());
+  return err;
+}
+
+
+void VdcApiReplayer::replay(const char *aHost, const char *aServiceOrPort, double aSpeed, StatusCB aDoneCB)
+{
+  doneCB = aDoneCB;
+  speed = aSpeed;
+  nextMessage = 0;
+  replayStart = Never;
+  pendingCalls.clear();
+  latencies.clear();
+  notifications.clear();
+  receivedData.clear();
+  fragmentedMessage.clear();
+  transmitBuffer.clear();
+  peerFragmentation = false;
+  droppedMessages = 0;
+  if (encoding==vdcapi_encoding_json) {
+    JsonCommPtr jsonComm = JsonCommPtr(new JsonComm(MainLoop::currentMainLoop()));
+    jsonComm->setMessageHandler(boost::bind(&VdcApiReplayer::receivedJsonMessage, this, _1, _2));
+    connection = jsonComm;
+  }
+  else {
+    connection = SocketCommPtr(new SocketComm(MainLoop::currentMainLoop()));
+    connection->setReceiveHandler(boost::bind(&VdcApiReplayer::gotData, this, _1));
+  }
+  connection->setConnectionParams(aHost, aServiceOrPort, SOCK_STREAM, AF_INET);
+  connection->setConnectionStatusHandler(boost::bind(&VdcApiReplayer::connectionStatusHandler, this, _1, _2));
+  ErrorPtr err = connection->initiateConnection();
+  if (!Error::isOK(err)) replayDone(err);
+}
+
+
+void VdcApiReplayer::connectionStatusHandler(SocketCommPtr aSocketComm, ErrorPtr aError)
+{
+  if (!Error::isOK(aError)) {
+    replayDone(aError);
+  }
+  else if (replayStart==Never) {
+    // connected, start replaying
+    LOG(LOG_NOTICE, "Replaying %zu messages at %s", messages.size(), speed>0 ? string_format("%.1fx speed", speed).c_str() : "maximum speed");
+    replayStart = MainLoop::now();
+    sendNext();
+  }
+}
+
+
+void VdcApiReplayer::sendNext()
+{
+  int sent = 0;
+  while (nextMessage<messages.size()) {
+    const RecordedMessage &m = messages[nextMessage];
+    if (speed>0) {
+      // keep (scaled) timing of the recording
+      MLMicroSeconds due = replayStart+(MLMicroSeconds)(m.recordedAt/speed);
+      MLMicroSeconds now = MainLoop::now();
+      if (due>now) {
+        replayTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcApiReplayer::sendNext, this), due-now);
+        return;
+      }
+    }
+    else if (sent>=REPLAY_MAX_MESSAGES_PER_CYCLE) {
+      // give the mainloop a chance to process responses
+      replayTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcApiReplayer::sendNext, this));
+      return;
+    }
+    if (encoding==vdcapi_encoding_json) {
+      JsonCommPtr jsonComm = boost::dynamic_pointer_cast<JsonComm>(connection);
+      jsonComm->sendMessage(m.jsonMessage);
+    }
+    else if (!transmitPbufMessage(m.message)) {
+      LOG(LOG_WARNING, "Replay: %s message of %zu bytes too large, vDC host did not negotiate fragmentation -> skipped", m.method.c_str(), m.message.size());
+      droppedMessages++;
+      nextMessage++;
+      continue;
+    }
+    if (m.id.empty()) {
+      notifications[m.method]++;
+    }
+    else {
+      PendingCall &call = pendingCalls[m.id];
+      call.method = m.method;
+      call.sentAt = MainLoop::now();
+    }
+    nextMessage++;
+    sent++;
+  }
+  // all sent
+  replayEnd = MainLoop::now();
+  if (pendingCalls.empty()) {
+    replayDone(ErrorPtr());
+  }
+  else {
+    replayTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcApiReplayer::replayDone, this, ErrorPtr()), REPLAY_RESPONSE_TIMEOUT);
+  }
+}
+
+
+void VdcApiReplayer::responseReceived(const string &aId)
+{
+  PendingCallMap::iterator pos = pendingCalls.find(aId);
+  if (pos!=pendingCalls.end()) {
+    latencies[pos->second.method].push_back(MainLoop::now()-pos->second.sentAt);
+    pendingCalls.erase(pos);
+  }
+  if (pendingCalls.empty() && nextMessage>=messages.size() && replayStart!=Never) {
+    replayDone(ErrorPtr());
+  }
+}
+
+
+void VdcApiReplayer::replayDone(ErrorPtr aError)
+{
+  MainLoop::currentMainLoop().cancelExecutionTicket(replayTicket);
+  if (replayEnd==Never) replayEnd = MainLoop::now();
+  if (connection) {
+    connection->setConnectionStatusHandler(NULL);
+    connection->closeConnection();
+  }
+  if (!pendingCalls.empty()) {
+    LOG(LOG_WARNING, "Replay: %zu method calls did not get a response", pendingCalls.size());
+  }
+  if (droppedMessages>0) {
+    LOG(LOG_WARNING, "Replay: %zu messages could not be sent", droppedMessages);
+  }
+  LOG(LOG_NOTICE, "Replay finished: %s\n%s", Error::isOK(aError) ? "OK" : aError->description().c_str(), latencyReport().c_str());
+  if (doneCB) {
+    StatusCB cb = doneCB;
+    doneCB = NULL;
+    cb(aError);
+  }
+}
+
+
+static MLMicroSeconds percentile(const vector<MLMicroSeconds> &aSorted, double aFraction)
+{
+  return aSorted[(size_t)(aFraction*(aSorted.size()-1)+0.5)];
+}
+
+
+string VdcApiReplayer::latencyReport()
+{
+  string s;
+  if (replayStart!=Never && replayEnd>replayStart) {
+    double secs = (double)(replayEnd-replayStart)/Second;
+    string_format_append(s, "%zu messages sent in %.3f seconds (%.1f messages/sec)\n", nextMessage, secs, nextMessage/secs);
+  }
+  for (LatencyMap::iterator pos = latencies.begin(); pos!=latencies.end(); ++pos) {
+    LatencyVector l = pos->second;
+    if (l.empty()) continue;
+    sort(l.begin(), l.end());
+    string_format_append(s, "- %-40s %7zu calls, latency [mS] p50=%.2f, p90=%.2f, p99=%.2f, max=%.2f\n",
+      pos->first.c_str(), l.size(),
+      (double)percentile(l, 0.5)/MilliSecond,
+      (double)percentile(l, 0.9)/MilliSecond,
+      (double)percentile(l, 0.99)/MilliSecond,
+      (double)l.back()/MilliSecond
+    );
+  }
+  for (CountMap::iterator pos = notifications.begin(); pos!=notifications.end(); ++pos) {
+    string_format_append(s, "- %-40s %7ld notifications\n", pos->first.c_str(), pos->second);
+  }
+  return s;
+}
+
+
+// MARK: ===== protobuf API replay
+
+
+bool VdcApiReplayer::identifyPbufMessage(RecordedMessage &aMessage)
+{
+  Vdcapi__Message *msg = vdcapi__message__unpack(NULL, aMessage.message.size(), (const uint8_t *)aMessage.message.c_str());
+  if (!msg) return false;
+  bool replay = msg->type!=VDCAPI__TYPE__GENERIC_RESPONSE;
+  if (replay) {
+    const ProtobufCEnumValue *v = protobuf_c_enum_descriptor_get_value(&vdcapi__type__descriptor, msg->type);
+    aMessage.method = v ? v->name : string_format("type_%d", msg->type);
+    if (msg->type==VDCAPI__TYPE__VDSM_REQUEST_GENERIC_REQUEST && msg->vdsm_request_generic_request && msg->vdsm_request_generic_request->methodname) {
+      string_format_append(aMessage.method, ":%s", msg->vdsm_request_generic_request->methodname);
+    }
+    if (msg->has_message_id) aMessage.id = string_format("%u", msg->message_id);
+  }
+  protobuf_c_message_free_unpacked(&msg->base, NULL);
+  return replay;
+}
+
+
+bool VdcApiReplayer::transmitPbufMessage(const string &aMessage)
+{
+  // frame message, fragment if needed
+  if (aMessage.size()>PBUF_MAX_DATA_SIZE && !peerFragmentation) {
+    // vDC host cannot reassemble fragments
+    return false;
+  }
+  size_t pos = 0;
+  do {
+    size_t frameSize = aMessage.size()-pos;
+    uint16_t hdr = frameSize;
+    if (frameSize>PBUF_MAX_DATA_SIZE) {
+      frameSize = PBUF_MAX_DATA_SIZE;
+      hdr = frameSize | PBUF_FRAGMENT_CONTINUES;
+    }
+    transmitBuffer.push_back((char)(hdr>>8));
+    transmitBuffer.push_back((char)(hdr & 0xFF));
+    transmitBuffer.append(aMessage, pos, frameSize);
+    pos += frameSize;
+  } while (pos<aMessage.size());
+  canSendData(ErrorPtr());
+  return true;
+}
+
+
+void VdcApiReplayer::canSendData(ErrorPtr aError)
+{
+  if (!transmitBuffer.empty() && Error::isOK(aError)) {
+    size_t sentBytes = connection->transmitBytes(transmitBuffer.size(), (const uint8_t *)transmitBuffer.c_str(), aError);
+    if (Error::isOK(aError)) {
+      transmitBuffer.erase(0, sentBytes);
+      if (transmitBuffer.empty())
+        connection->setTransmitHandler(NULL);
+      else
+        connection->setTransmitHandler(boost::bind(&VdcApiReplayer::canSendData, this, _1));
+    }
+  }
+}
+
+
+void VdcApiReplayer::gotData(ErrorPtr aError)
+{
+  if (Error::isOK(aError)) {
+    size_t dataSz = connection->numBytesReady();
+    if (dataSz>0) {
+      size_t oldSz = receivedData.size();
+      receivedData.resize(oldSz+dataSz);
+      size_t receivedBytes = connection->receiveBytes(dataSz, (uint8_t *)&receivedData[oldSz], aError);
+      receivedData.resize(oldSz+receivedBytes);
+      size_t pos = 0;
+      while (receivedData.size()-pos>=2) {
+        const uint8_t *p = (const uint8_t *)receivedData.c_str()+pos;
+        uint16_t hdr = (p[0]<<8) + p[1];
+        size_t frameSize = hdr & ~PBUF_FRAGMENT_CONTINUES;
+        if (receivedData.size()-pos-2<frameSize) break; // incomplete
+        if ((hdr & PBUF_FRAGMENT_CONTINUES) || !fragmentedMessage.empty()) {
+          fragmentedMessage.append((const char *)p+2, frameSize);
+          if (!(hdr & PBUF_FRAGMENT_CONTINUES)) {
+            receivedPbufMessage((const uint8_t *)fragmentedMessage.c_str(), fragmentedMessage.size());
+            fragmentedMessage.clear();
+          }
+        }
+        else {
+          receivedPbufMessage(p+2, frameSize);
+        }
+        pos += 2+frameSize;
+      }
+      receivedData.erase(0, pos);
+    }
+  }
+}
+
+
+void VdcApiReplayer::receivedPbufMessage(const uint8_t *aMessage, size_t aSize)
+{
+  Vdcapi__Message *msg = vdcapi__message__unpack(NULL, aSize, aMessage);
+  if (!msg) return;
+  if (msg->has_message_id) {
+    if (
+      msg->type==VDCAPI__TYPE__GENERIC_RESPONSE ||
+      msg->type==VDCAPI__TYPE__VDC_RESPONSE_HELLO ||
+      msg->type==VDCAPI__TYPE__VDC_RESPONSE_GET_PROPERTY
+    ) {
+      // response to a replayed method call
+      if (msg->type==VDCAPI__TYPE__VDC_RESPONSE_HELLO && msg->vdc_response_hello) {
+        // vDC host confirms fragmentation only if the replayed hello has requested it
+        peerFragmentation = msg->vdc_response_hello->has_x_p44_fragmentation && msg->vdc_response_hello->x_p44_fragmentation;
+      }
+      responseReceived(string_format("%u", msg->message_id));
+    }
+    else {
+      // method call from the vDC host, confirm like a vdSM would
+      Vdcapi__Message resp = VDCAPI__MESSAGE__INIT;
+      Vdcapi__GenericResponse genericResp = VDCAPI__GENERIC_RESPONSE__INIT;
+      resp.type = VDCAPI__TYPE__GENERIC_RESPONSE;
+      resp.has_message_id = true;
+      resp.message_id = msg->message_id;
+      resp.generic_response = &genericResp;
+      string packed;
+      packed.resize(vdcapi__message__get_packed_size(&resp));
+      vdcapi__message__pack(&resp, (uint8_t *)&packed[0]);
+      transmitPbufMessage(packed);
+    }
+  }
+  protobuf_c_message_free_unpacked(&msg->base, NULL);
+}
+
+
+// MARK: ===== JSON API replay
+
+
+bool VdcApiReplayer::identifyJsonMessage(RecordedMessage &aMessage)
+{
+  aMessage.jsonMessage = JsonObject::objFromText(aMessage.message.c_str());
+  if (!aMessage.jsonMessage) return false;
+  JsonObjectPtr o = aMessage.jsonMessage->get("method");
+  if (!o) return false; // response, not replayed
+  aMessage.method = o->stringValue();
+  o = aMessage.jsonMessage->get("id");
+  if (o) aMessage.id = o->stringValue();
+  return true;
+}
+
+
+void VdcApiReplayer::receivedJsonMessage(ErrorPtr aError, JsonObjectPtr aMessage)
+{
+  if (!Error::isOK(aError) || !aMessage) return;
+  JsonObjectPtr id = aMessage->get("id");
+  if (aMessage->get("method")) {
+    if (id) {
+      // method call from the vDC host, confirm like a vdSM would
+      JsonObjectPtr resp = JsonObject::newObj();
+      resp->add("jsonrpc", JsonObject::newString("2.0"));
+      resp->add("id", id);
+      resp->add("result", JsonObject::newNull());
+      JsonCommPtr jsonComm = boost::dynamic_pointer_cast<JsonComm>(connection);
+      jsonComm->sendMessage(resp);
+    }
+  }
+  else if (id) {
+    // response to a replayed method call
+    responseReceived(id->stringValue());
+  }
+}
@@ -0,0 +1,134 @@
+//
+//  Copyright (c) 2013-2017 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44vdc__vdcapireplayer__
+#define __p44vdc__vdcapireplayer__
+
+#include "p44utils_common.hpp"
+
+#include "vdcapi.hpp"
+#include "jsoncomm.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  class VdcApiReplayer;
+  typedef boost::intrusive_ptr<VdcApiReplayer> VdcApiReplayerPtr;
+
+  /// Replays the vdSM side of a session recorded with VdcApiRecorder against a running vDC host
+  /// @note the replayer connects to the vDC API port like a vdSM would, sends all recorded inbound messages
+  ///   (except responses, which would refer to stale message IDs) and measures the time until the vDC host
+  ///   responds per method. Method calls the vDC host sends to the vdSM (like announcements) are answered
+  ///   with a generic OK response.
+  class VdcApiReplayer : public P44Obj
+  {
+    typedef P44Obj inherited;
+
+    /// a recorded message to be sent
+    typedef struct {
+      MLMicroSeconds recordedAt; ///< time relative to start of recording
+      string message; ///< the message as recorded
+      JsonObjectPtr jsonMessage; ///< parsed message (JSON only)
+      string method; ///< method or notification name
+      string id; ///< message ID, empty for notifications
+    } RecordedMessage;
+    typedef vector<RecordedMessage> RecordedMessageVector;
+
+    /// a method call sent, waiting for a response
+    typedef struct {
+      string method;
+      MLMicroSeconds sentAt;
+    } PendingCall;
+    typedef map<string, PendingCall> PendingCallMap;
+
+    typedef vector<MLMicroSeconds> LatencyVector;
+    typedef map<string, LatencyVector> LatencyMap;
+    typedef map<string, long> CountMap;
+
+    VdcApiEncoding encoding;
+    RecordedMessageVector messages;
+
+    SocketCommPtr connection;
+    StatusCB doneCB;
+    double speed;
+    size_t nextMessage;
+    MLMicroSeconds replayStart;
+    MLMicroSeconds replayEnd;
+    MLTicket replayTicket;
+
+    // protobuf framing
+    string receivedData;
+    string fragmentedMessage;
+    string transmitBuffer;
+    bool peerFragmentation; ///< set when the vDC host has confirmed fragmentation in its hello response
+    size_t droppedMessages; ///< messages that could not be sent
+
+    PendingCallMap pendingCalls;
+    LatencyMap latencies;
+    CountMap notifications;
+
+  public:
+
+    VdcApiReplayer();
+    virtual ~VdcApiReplayer();
+
+    /// load a recording
+    /// @param aFilePath path of a recording file created by VdcApiRecorder
+    /// @return ok or error
+    ErrorPtr load(const string &aFilePath);
+
+    /// @return the API encoding of the loaded recording
+    VdcApiEncoding getEncoding() { return encoding; };
+
+    /// replay the loaded recording
+    /// @param aHost host of the vDC API to connect to
+    /// @param aServiceOrPort port of the vDC API
+    /// @param aSpeed replay speed relative to the recording, 1 = original timing, 0 = as fast as possible
+    /// @param aDoneCB called when all messages have been sent and all responses have arrived (or timed out)
+    void replay(const char *aHost, const char *aServiceOrPort, double aSpeed, StatusCB aDoneCB);
+
+    /// @return latency percentiles per method and notification counts of the last replay
+    string latencyReport();
+
+  private:
+
+    void connectionStatusHandler(SocketCommPtr aSocketComm, ErrorPtr aError);
+    void sendNext();
+    void responseReceived(const string &aId);
+    void replayDone(ErrorPtr aError);
+
+    // protobuf
+    bool identifyPbufMessage(RecordedMessage &aMessage);
+    void gotData(ErrorPtr aError);
+    void canSendData(ErrorPtr aError);
+    bool transmitPbufMessage(const string &aMessage);
+    void receivedPbufMessage(const uint8_t *aMessage, size_t aSize);
+
+    // JSON
+    bool identifyJsonMessage(RecordedMessage &aMessage);
+    void receivedJsonMessage(ErrorPtr aError, JsonObjectPtr aMessage);
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__p44vdc__vdcapireplayer__) */
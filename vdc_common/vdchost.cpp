@@ -24,6 +24,7 @@
 #include "vdc.hpp"
 
 #include <string.h>
+#include <errno.h>
 
 #include "device.hpp"
 
@@ -77,6 +78,11 @@ using namespace p44;
   #define DEFAULT_DESCRIPTION_TEMPLATE "%V %M%N #%S"
 #endif
 
+// max number of read-only observer sessions in parallel to the vdSM session
+#ifndef MAX_OBSERVER_SESSIONS
+  #define MAX_OBSERVER_SESSIONS 4
+#endif
+
 
 static VdcHost *sharedVdcHostP = NULL;
 
@@ -90,13 +96,27 @@ VdcHost::VdcHost(bool aWithLocalController) :
   allowCloud(false),
   DsAddressable(this),
   collecting(false),
+  bulkLoad(true),
+  bulkLoadPending(false),
+  bulkLoader(NULL),
   lastActivity(0),
   lastPeriodicRun(0),
   learningMode(false),
   announcementTicket(0),
   periodicTaskTicket(0),
+  saveTicket(0),
+  lastFullSave(Never),
+  warmRestartSnapshot(false),
+  lastSnapshot(Never),
+  #if ENABLE_LOCALCONTROLLER
+  localControllerDirty(false),
+  #endif
   localDimDirection(0), // undefined
   mainloopStatsInterval(DEFAULT_MAINLOOP_STATS_INTERVAL),
+  paramStoreWriteAheadLog(false),
+  asyncPersistence(false),
+  sceneBlobStorage(false),
+  lastCheckpoint(0),
   mainLoopStatsCounter(0),
   #if ENABLE_LOCALCONTROLLER
   localController(NULL),
@@ -118,6 +138,10 @@ VdcHost::VdcHost(bool aWithLocalController) :
 
 VdcHost::~VdcHost()
 {
+  // keep the devices for a fast restart (unless we are still collecting them, the snapshot would be incomplete)
+  if (warmRestartSnapshot && !collecting) writeSnapshot();
+  // write everything still pending
+  if (persistenceWorker) persistenceWorker->stop();
   #if ENABLE_LOCALCONTROLLER
   if (localController) delete localController;
   #endif
@@ -189,6 +213,9 @@ void VdcHost::setIdMode(DsUidPtr aExternalDsUid, const string aIfNameForMAC)
 void VdcHost::addVdc(VdcPtr aVdcPtr)
 {
   vdcs[aVdcPtr->getDsUid()] = aVdcPtr;
+  structureChanged();
+  // changes made before the vdc was added could not be scheduled for saving by dSUID
+  scheduleSave(aVdcPtr->getDsUid());
 }
 
 
@@ -229,6 +256,7 @@ void VdcHost::setConfigDir(const char *aConfigDir)
 {
   configDir = nonNullCStr(aConfigDir);
   pathstring_format_append(configDir,""); // make sure filenames can be appended without adding a delimiter
+  settingsFileCache.reset(); // different dir, different files
 }
 
 
@@ -238,6 +266,54 @@ const char *VdcHost::getConfigDir()
 }
 
 
+SettingsFileCache &VdcHost::getSettingsFileCache()
+{
+  if (!settingsFileCache) {
+    settingsFileCache = SettingsFileCachePtr(new SettingsFileCache(configDir));
+    settingsFileCache->setChangedHandler(boost::bind(&VdcHost::configFileChanged, this, _1, _2));
+  }
+  return *settingsFileCache;
+}
+
+
+static bool hasPrefix(const string &aFileName, const char *aPrefix)
+{
+  return aFileName.compare(0, strlen(aPrefix), aPrefix)==0;
+}
+
+
+void VdcHost::configFileChanged(const string &aFileName, bool aRemoved)
+{
+  int reloaded = 0;
+  bool any = aFileName.empty();
+  // host
+  if (any || aFileName=="vdchostsettings.csv") {
+    if (aRemoved) {
+      LOG(LOG_NOTICE, "config file %s removed - settings applied from it remain in effect until changed", aFileName.c_str());
+    }
+    // reloading marks settings clean, so pending changes must be saved first
+    save();
+    loadSettingsFromFiles();
+    reloaded++;
+  }
+  // vdcs
+  if (any || hasPrefix(aFileName, "vdcsettings_")) {
+    for (VdcMap::iterator pos = vdcs.begin(); pos!=vdcs.end(); ++pos) {
+      if (pos->second->configFileChanged(aFileName, aRemoved)) reloaded++;
+    }
+  }
+  // devices
+  if (any || hasPrefix(aFileName, "devicesettings_") || hasPrefix(aFileName, "scenes_")) {
+    for (DsDeviceMap::iterator pos = dSDevices.begin(); pos!=dSDevices.end(); ++pos) {
+      if (pos->second->configFileChanged(aFileName, aRemoved)) reloaded++;
+    }
+  }
+  if (reloaded>0) {
+    LOG(LOG_NOTICE, "config file %s changed -> reloaded settings of %d addressables", any ? "(any)" : aFileName.c_str(), reloaded);
+  }
+}
+
+
 
 
 string VdcHost::publishedDescription()
@@ -308,8 +384,52 @@ bool VdcHost::isNetworkConnected()
 //  1 : alpha/beta phase DB
 //  2 : no schema change, but forced re-creation due to changed scale of brightness (0..100 now, was 0..255 before)
 //  3 : no schema change, but forced re-creation due to bug in storing output behaviour settings
+//  4 : SceneBlobs table for storing all scenes of a device in a single record
 #define DSPARAMS_SCHEMA_MIN_VERSION 3 // minimally supported version, anything older will be deleted
-#define DSPARAMS_SCHEMA_VERSION 3 // current version
+#define DSPARAMS_SCHEMA_VERSION 4 // current version
+
+#ifndef DSPARAMS_WAL_AUTOCHECKPOINT_PAGES
+  #define DSPARAMS_WAL_AUTOCHECKPOINT_PAGES 4000 // only a safety net, checkpoints are done from the idle periodic task
+#endif
+
+
+DsParamStore::DsParamStore() :
+  walMode(false)
+{
+}
+
+
+ErrorPtr DsParamStore::enableWriteAheadLog()
+{
+  // Note: switching to WAL might not be possible (e.g. no shared memory support), so check actual mode
+  string mode;
+  sqlite3pp::query q(*this);
+  if (q.prepare("PRAGMA journal_mode=WAL")==SQLITE_OK) {
+    sqlite3pp::query::iterator row = q.begin();
+    if (row!=q.end()) mode = nonNullCStr(row->get<const char *>(0));
+  }
+  if (mode!="wal") {
+    ErrorPtr err = error();
+    if (Error::isOK(err)) err = TextError::err("journal mode is '%s'", mode.c_str());
+    LOG(LOG_WARNING, "DsParamStore: cannot use write-ahead log: %s", err->description().c_str());
+    return err;
+  }
+  walMode = true;
+  execute("PRAGMA synchronous=NORMAL");
+  execute(string_format("PRAGMA wal_autocheckpoint=%d", DSPARAMS_WAL_AUTOCHECKPOINT_PAGES).c_str());
+  LOG(LOG_INFO, "DsParamStore: using write-ahead log");
+  return ErrorPtr();
+}
+
+
+void DsParamStore::checkpoint()
+{
+  if (!walMode) return;
+  if (execute("PRAGMA wal_checkpoint(TRUNCATE)")!=SQLITE_OK) {
+    LOG(LOG_WARNING, "DsParamStore: checkpoint failed: %s", error()->description().c_str());
+  }
+}
+
 
 string DsParamStore::dbSchemaUpgradeSQL(int aFromVersion, int &aToVersion)
 {
@@ -318,11 +438,16 @@ string DsParamStore::dbSchemaUpgradeSQL(int aFromVersion, int &aToVersion)
     // create DB from scratch
 		// - use standard globs table for schema version
     sql = inherited::dbSchemaUpgradeSQL(aFromVersion, aToVersion);
-		// - no vdchost level table to create at this time
-    //   (PersistentParams create and update their tables as needed)
+		// - scene blobs table (PersistentParams create and update their tables as needed)
+    sql += "CREATE TABLE SceneBlobs (parentID TEXT PRIMARY KEY, scenes BLOB);";
     // reached final version in one step
     aToVersion = DSPARAMS_SCHEMA_VERSION;
   }
+  else if (aFromVersion==3) {
+    // V3->V4: add scene blobs table
+    sql = "CREATE TABLE SceneBlobs (parentID TEXT PRIMARY KEY, scenes BLOB);";
+    aToVersion = 4;
+  }
   return sql;
 }
 
@@ -334,6 +459,16 @@ void VdcHost::prepareForVdcs(bool aFactoryReset)
   string databaseName = getPersistentDataDir();
   string_format_append(databaseName, "DsParams.sqlite3");
   ErrorPtr error = dsParamStore.connectAndInitialize(databaseName.c_str(), DSPARAMS_SCHEMA_VERSION, DSPARAMS_SCHEMA_MIN_VERSION, aFactoryReset);
+  if (Error::isOK(error) && paramStoreWriteAheadLog) {
+    dsParamStore.enableWriteAheadLog();
+  }
+  if (asyncPersistence && dsParamStore.usesWriteAheadLog()) {
+    // device params are written by a worker thread with its own DB connection
+    // - reads must wait for the worker's commits instead of failing
+    dsParamStore.execute(string_format("PRAGMA busy_timeout=%d", PERSISTENCE_BUSY_TIMEOUT).c_str());
+    persistenceWorker = PersistenceWorkerPtr(new PersistenceWorker(dsParamStore, databaseName));
+    persistenceWorker->start();
+  }
   // load the vdc host settings and determine the dSUID (external > stored > mac-derived)
   loadAndFixDsUID();
 }
@@ -410,6 +545,9 @@ void VdcHost::collectDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
 {
   if (!collecting) {
     collecting = true;
+    // persistent params of devices added from now on will be loaded in bulk when all vdcs have collected
+    bulkLoadPending = bulkLoad;
+    devicesToLoad.clear();
     if ((aRescanFlags & rescanmode_incremental)==0) {
       // only for non-incremental collect, close vdsm connection
       if (activeSessionConnection) {
@@ -419,6 +557,13 @@ void VdcHost::collectDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
         activeSessionConnection.reset(); // forget connection
         postEvent(vdchost_vdcapi_disconnected);
       }
+      // at startup, devices can be restored from the warm restart snapshot
+      if (
+        warmRestartSnapshot && dSDevices.empty() &&
+        (aRescanFlags & (rescanmode_exhaustive|rescanmode_clearsettings))==0
+      ) {
+        loadSnapshot();
+      }
       dSDevices.clear(); // forget existing ones
     }
     collectFromNextVdc(aCompletedCB, aRescanFlags, vdcs.begin());
@@ -436,12 +581,20 @@ void VdcHost::collectFromNextVdc(StatusCB aCompletedCB, RescanMode aRescanFlags,
       vdc->vdcClassIdentifier(),
       vdc->getInstanceNumber()
     );
+    if (restoreSnapshot && restoreVdcFromSnapshot(vdc)) {
+      // devices restored, no need to collect them now
+      vdcCollected(aCompletedCB, aRescanFlags, aNextVdc, ErrorPtr());
+      return;
+    }
     vdc->collectDevices(boost::bind(&VdcHost::vdcCollected, this, aCompletedCB, aRescanFlags, aNextVdc, _1), aRescanFlags);
     return;
   }
   // all devices collected, but not yet initialized
+  restoreSnapshot.reset(); // no longer needed
   postEvent(vdchost_devices_collected);
   LOG(LOG_NOTICE, "=== collected devices from all vdcs -> initializing devices now\n");
+  // load persistent params of all collected devices at once
+  loadCollectedDevices();
   // now initialize devices (which are already identified by now!)
   initializeNextDevice(aCompletedCB, dSDevices.begin());
 }
@@ -463,6 +616,15 @@ void VdcHost::vdcCollected(StatusCB aCompletedCB, RescanMode aRescanFlags, VdcMa
 
 void VdcHost::initializeNextDevice(StatusCB aCompletedCB, DsDeviceMap::iterator aNextDevice)
 {
+  while (aNextDevice!=dSDevices.end() && unconfirmedDevices.find(aNextDevice->first)!=unconfirmedDevices.end()) {
+    // restored from snapshot: the hardware is not accessed now (the vdc might not even have found it yet, and
+    // querying it would replace the restored state), but when the device gets confirmed by verifyRestoredVdcs()
+    LOG(LOG_NOTICE, "--- restored device, initialisation deferred until verified: %s", aNextDevice->second->shortDesc().c_str());
+    #if ENABLE_LOCALCONTROLLER
+    if (localController) localController->deviceAdded(aNextDevice->second);
+    #endif
+    ++aNextDevice;
+  }
   if (aNextDevice!=dSDevices.end()) {
     // TODO: now never doing factory reset init, maybe parametrize later
     aNextDevice->second->initializeDevice(boost::bind(&VdcHost::deviceInitialized, this, aCompletedCB, aNextDevice, _1), false);
@@ -482,6 +644,8 @@ void VdcHost::initializeNextDevice(StatusCB aCompletedCB, DsDeviceMap::iterator
   aCompletedCB(vdcInitErr);
   LOG(LOG_NOTICE, "=== initialized all collected devices\n");
   collecting = false;
+  // devices restored from snapshot are in operation now, check if they really exist
+  verifyRestoredVdcs();
 }
 
 
@@ -503,6 +667,90 @@ void VdcHost::deviceInitialized(StatusCB aCompletedCB, DsDeviceMap::iterator aNe
 
 
 
+// MARK: ===== warm restart snapshot
+
+#define SNAPSHOT_FILE_NAME "DeviceSnapshot.json"
+#define SNAPSHOT_VERSION 1
+
+// Snapshot format:
+// { "version":1, "vdcs": { "<vdc dSUID>": [ { "dSUID":"...", "info":{ <Device::snapshotInfo()> }, "channels":[ <values> ] }, ... ] } }
+// Only vdcs where all devices can be restored are included.
+
+string VdcHost::snapshotFilePath()
+{
+  return getPersistentDataDir() + string(SNAPSHOT_FILE_NAME);
+}
+
+
+void VdcHost::writeSnapshot()
+{
+  MLMicroSeconds start = MainLoop::now();
+  JsonObjectPtr snapshot = JsonObject::newObj();
+  snapshot->add("version", JsonObject::newInt32(SNAPSHOT_VERSION));
+  JsonObjectPtr snapshotVdcs = JsonObject::newObj();
+  int numDevices = 0;
+  for (VdcMap::iterator pos = vdcs.begin(); pos!=vdcs.end(); ++pos) {
+    JsonObjectPtr vdcDevices = JsonObject::newArray();
+    if (pos->second->addDevicesToSnapshot(vdcDevices)) {
+      snapshotVdcs->add(pos->first.getString().c_str(), vdcDevices);
+      numDevices += vdcDevices->arrayLength();
+    }
+  }
+  snapshot->add("vdcs", snapshotVdcs);
+  // write to a temp file first, so an interrupted write never leaves a partial snapshot
+  string fn = snapshotFilePath();
+  string tempFn = fn+".tmp";
+  FILE *file = fopen(tempFn.c_str(), "w");
+  if (!file) {
+    LOG(LOG_ERR, "cannot write snapshot file '%s': %s", tempFn.c_str(), strerror(errno));
+    return;
+  }
+  bool ok = fputs(snapshot->json_c_str(), file)>=0;
+  if (fclose(file)!=0) ok = false;
+  if (!ok || rename(tempFn.c_str(), fn.c_str())!=0) {
+    LOG(LOG_ERR, "error writing snapshot file '%s': %s", fn.c_str(), strerror(errno));
+    remove(tempFn.c_str());
+    return;
+  }
+  LOG(LOG_INFO, "written warm restart snapshot of %d devices in %.3f seconds", numDevices, (double)(MainLoop::now()-start)/Second);
+}
+
+
+void VdcHost::loadSnapshot()
+{
+  JsonObjectPtr o;
+  restoreSnapshot = JsonObject::objFromFile(snapshotFilePath().c_str());
+  if (!restoreSnapshot || !restoreSnapshot->get("version", o) || o->int32Value()!=SNAPSHOT_VERSION) {
+    restoreSnapshot.reset();
+    LOG(LOG_NOTICE, "no usable warm restart snapshot -> collecting all devices");
+    return;
+  }
+  LOG(LOG_NOTICE, "warm restart snapshot found -> restoring devices of vdcs supporting it");
+}
+
+
+bool VdcHost::restoreVdcFromSnapshot(VdcPtr aVdc)
+{
+  JsonObjectPtr o;
+  JsonObjectPtr vdcDevices;
+  if (!restoreSnapshot->get("vdcs", o) || !o->get(aVdc->getDsUid().getString().c_str(), vdcDevices)) return false; // vdc not in snapshot
+  if (!aVdc->restoreFromSnapshot(vdcDevices)) return false;
+  restoredVdcs.push_back(aVdc);
+  return true;
+}
+
+
+void VdcHost::verifyRestoredVdcs()
+{
+  while (!restoredVdcs.empty()) {
+    VdcPtr vdc = restoredVdcs.front();
+    restoredVdcs.pop_front();
+    vdc->verifyRestoredDevices(NULL);
+  }
+}
+
+
+
 // MARK: ===== adding/removing devices
 
 
@@ -515,15 +763,31 @@ bool VdcHost::addDevice(DevicePtr aDevice)
   DsDeviceMap::iterator pos = dSDevices.find(aDevice->getDsUid());
   if (pos!=dSDevices.end()) {
     LOG(LOG_INFO, "- device %s already registered, not added again",aDevice->shortDesc().c_str());
+    // encountering a device restored from snapshot confirms it
+    if (unconfirmedDevices.erase(aDevice->getDsUid())>0) {
+      // hardware is known to be there now, do the initialisation skipped at startup
+      DevicePtr restoredDevice = pos->second;
+      restoredDevice->initializeDevice(boost::bind(&VdcHost::restoredDeviceInitialized, this, restoredDevice, _1), false);
+    }
     // first break call chain that triggered deletion, keep aDevice living until then
     MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcHost::duplicateIgnored, this, aDevice));
     return false; // duplicate dSUID, not added
   }
   // set for given dSUID in the container-wide map of devices
   dSDevices[aDevice->getDsUid()] = aDevice;
+  structureChanged();
   LOG(LOG_NOTICE, "--- added device: %s (not yet initialized)",aDevice->shortDesc().c_str());
-  // load the device's persistent params
-  aDevice->load();
+  if (bulkLoadPending) {
+    // persistent params will be loaded for all collected devices at once
+    devicesToLoad.push_back(aDevice);
+  }
+  else {
+    // load the device's persistent params (which must include all pending writes)
+    if (persistenceWorker) persistenceWorker->flush();
+    aDevice->load();
+    // changes made before the device was added could not be scheduled for saving by dSUID
+    scheduleSave(aDevice->getDsUid());
+  }
   // if not collecting, initialize device right away.
   // Otherwise, initialisation will be done when collecting is complete
   if (!collecting) {
@@ -533,6 +797,52 @@ bool VdcHost::addDevice(DevicePtr aDevice)
 }
 
 
+void VdcHost::loadCollectedDevices()
+{
+  // devices added from now on load their params right away
+  bulkLoadPending = false;
+  if (devicesToLoad.empty()) return;
+  MLMicroSeconds start = MainLoop::now();
+  // records must include all pending writes
+  if (persistenceWorker) persistenceWorker->flush();
+  SettingsBulkLoader loader;
+  bulkLoader = &loader;
+  // - register the records of the devices and their behaviours and read them, one query per table
+  for (DeviceList::iterator pos = devicesToLoad.begin(); pos!=devicesToLoad.end(); ++pos) (*pos)->prepareBulkLoad(loader, false);
+  long records = loader.load();
+  // - child records (scenes) need the ROWIDs of their parents loaded above
+  for (DeviceList::iterator pos = devicesToLoad.begin(); pos!=devicesToLoad.end(); ++pos) (*pos)->prepareBulkLoad(loader, true);
+  records += loader.load();
+  // - now let devices load, which takes what the bulk load has delivered and loads everything else from the DB
+  for (DeviceList::iterator pos = devicesToLoad.begin(); pos!=devicesToLoad.end(); ++pos) {
+    // vdcs initialize names of devices they add after addDevice(), which expects the device already loaded.
+    // So load with no name, as if loaded from addDevice(), and then initialize the name again.
+    string initialName = (*pos)->getAssignedName();
+    (*pos)->initializeName("");
+    (*pos)->load();
+    if (!initialName.empty()) (*pos)->initializeName(initialName);
+    // changes made before the device was added could not be scheduled for saving by dSUID
+    scheduleSave((*pos)->getDsUid());
+  }
+  bulkLoader = NULL;
+  LOG(LOG_NOTICE,
+    "=== loaded persistent params of %zu devices in %.3f seconds (%ld records in bulk)",
+    devicesToLoad.size(), (double)(MainLoop::now()-start)/Second, records
+  );
+  devicesToLoad.clear();
+}
+
+
+void VdcHost::restoredDeviceInitialized(DevicePtr aDevice, ErrorPtr aError)
+{
+  if (!Error::isOK(aError)) {
+    LOG(LOG_ERR, "*** error initializing verified restored device %s: %s", aDevice->shortDesc().c_str(), aError->description().c_str());
+    return;
+  }
+  LOG(LOG_NOTICE, "--- initialized verified restored device: %s", aDevice->description().c_str());
+}
+
+
 void VdcHost::duplicateIgnored(DevicePtr aDevice)
 {
   LOG(LOG_NOTICE, "--- ignored duplicate device: %s",aDevice->shortDesc().c_str());
@@ -567,6 +877,8 @@ void VdcHost::removeDevice(DevicePtr aDevice, bool aForget)
   }
   // remove from container-wide map of devices
   dSDevices.erase(aDevice->getDsUid());
+  structureChanged();
+  devicesToLoad.remove(aDevice);
   LOG(LOG_NOTICE, "--- removed device: %s", aDevice->shortDesc().c_str());
   #if ENABLE_LOCALCONTROLLER
   if (localController) localController->deviceRemoved(aDevice);
@@ -664,6 +976,27 @@ bool VdcHost::signalDeviceUserAction(Device &aDevice, bool aRegular)
 
 #define ACTIVITY_PAUSE_INTERVAL (1*Second)
 
+// max delay for saving changed objects when the vdc host does not get idle
+#ifndef DIRTY_SAVE_MAX_DELAY
+  #define DIRTY_SAVE_MAX_DELAY (30*Second)
+#endif
+// max number of changed objects saved in one DB transaction
+#ifndef DIRTY_SAVE_BATCH_SIZE
+  #define DIRTY_SAVE_BATCH_SIZE 50
+#endif
+// interval for syncing the write-ahead log of the parameter DB
+#ifndef PARAMSTORE_CHECKPOINT_INTERVAL
+  #define PARAMSTORE_CHECKPOINT_INTERVAL (10*Minute)
+#endif
+// interval for writing the warm restart snapshot
+#ifndef SNAPSHOT_INTERVAL
+  #define SNAPSHOT_INTERVAL (15*Minute)
+#endif
+// interval for saving all objects, including changes that were not scheduled for saving
+#ifndef FULL_SAVE_INTERVAL
+  #define FULL_SAVE_INTERVAL (60*Minute)
+#endif
+
 void VdcHost::periodicTask(MLMicroSeconds aNow)
 {
   // cancel any pending executions
@@ -679,19 +1012,24 @@ void VdcHost::periodicTask(MLMicroSeconds aNow)
       isNetworkConnected();
       // check again for devices that need to be announced
       startAnnouncing();
-      // do a save run as well
-      // - myself
-      save();
-      #if ENABLE_LOCALCONTROLLER
-      if (localController) localController->save();
-      #endif
-      // - device containers
-      for (VdcMap::iterator pos = vdcs.begin(); pos!=vdcs.end(); ++pos) {
-        pos->second->save();
+      // save what has changed
+      if (lastFullSave==Never || aNow>lastFullSave+FULL_SAVE_INTERVAL) {
+        // once in a while, save everything to catch changes that were not scheduled for saving
+        lastFullSave = aNow;
+        saveAll();
       }
-      // - devices
-      for (DsDeviceMap::iterator pos = dSDevices.begin(); pos!=dSDevices.end(); ++pos) {
-        pos->second->save();
+      else {
+        saveDirty();
+      }
+      // sync write-ahead log to DB
+      if (dsParamStore.usesWriteAheadLog() && aNow>lastCheckpoint+PARAMSTORE_CHECKPOINT_INTERVAL) {
+        lastCheckpoint = aNow;
+        dsParamStore.checkpoint();
+      }
+      // keep warm restart snapshot up to date
+      if (warmRestartSnapshot && aNow>lastSnapshot+SNAPSHOT_INTERVAL) {
+        lastSnapshot = aNow;
+        writeSnapshot();
       }
     }
   }
@@ -700,6 +1038,12 @@ void VdcHost::periodicTask(MLMicroSeconds aNow)
     if (mainLoopStatsCounter<=0) {
       LOG(LOG_INFO, "%s", MainLoop::currentMainLoop().description().c_str());
       MainLoop::currentMainLoop().statistics_reset();
+      LOG(LOG_INFO, "Property access: %s", PropertyDescriptor::poolStatistics().c_str());
+      if (activeSessionConnection) {
+        string stats = activeSessionConnection->statisticsInfo();
+        if (!stats.empty()) LOG(LOG_INFO, "vDC API session connection statistics: %s", stats.c_str());
+        activeSessionConnection->statisticsReset();
+      }
       mainLoopStatsCounter = mainloopStatsInterval;
     }
     else {
@@ -711,6 +1055,149 @@ void VdcHost::periodicTask(MLMicroSeconds aNow)
 }
 
 
+// MARK: ===== write-behind persistence
+
+void VdcHost::scheduleSave(const DsUid &aDsUid)
+{
+  dirtyAddressables.insert(aDsUid);
+  if (!saveTicket) {
+    // make sure it gets saved eventually, even if we never get idle
+    saveTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcHost::saveDirty, this), DIRTY_SAVE_MAX_DELAY);
+  }
+}
+
+
+#if ENABLE_LOCALCONTROLLER
+
+void VdcHost::scheduleLocalControllerSave()
+{
+  localControllerDirty = true;
+  // zones and scenes are local controller properties
+  if (localController) localController->propertiesChanged();
+  if (!saveTicket) {
+    saveTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcHost::saveDirty, this), DIRTY_SAVE_MAX_DELAY);
+  }
+}
+
+#endif
+
+
+void VdcHost::markDirty()
+{
+  inheritedParams::markDirty();
+  propertiesChanged();
+  scheduleSave(getDsUid());
+}
+
+
+bool VdcHost::beginSaveTransaction(SaveJournal &aJournal)
+{
+  // the worker batches writes into transactions on its own connection, a transaction here would only block it
+  if (persistenceWorker) return true;
+  if (dsParamStore.execute("BEGIN")!=SQLITE_OK) {
+    LOG(LOG_ERR, "Cannot start transaction for saving changes: %s", dsParamStore.error()->description().c_str());
+    return false;
+  }
+  aJournal.start();
+  return true;
+}
+
+
+bool VdcHost::commitSaveTransaction(SaveJournal &aJournal)
+{
+  if (persistenceWorker) return true; // no transaction begun
+  aJournal.stop();
+  if (dsParamStore.execute("COMMIT")!=SQLITE_OK) {
+    LOG(LOG_ERR, "Cannot commit saved changes: %s -> rolled back, will retry later", dsParamStore.error()->description().c_str());
+    dsParamStore.execute("ROLLBACK"); // Note: might fail when sqlite has rolled back already
+    aJournal.revert(); // marks records dirty again, which also schedules saving them again
+    return false;
+  }
+  aJournal.clear();
+  return true;
+}
+
+
+void VdcHost::saveDirty()
+{
+  MainLoop::currentMainLoop().cancelExecutionTicket(saveTicket);
+  bool anyDirty = !dirtyAddressables.empty();
+  #if ENABLE_LOCALCONTROLLER
+  anyDirty = anyDirty || localControllerDirty;
+  #endif
+  if (!anyDirty) return;
+  // save a batch in a single transaction
+  SaveJournal journal;
+  if (!beginSaveTransaction(journal)) {
+    // nothing saved, everything remains dirty
+    saveTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcHost::saveDirty, this), DIRTY_SAVE_MAX_DELAY);
+    return;
+  }
+  int n = 0;
+  while (!dirtyAddressables.empty() && n<DIRTY_SAVE_BATCH_SIZE) {
+    DsUid dsuid = *dirtyAddressables.begin();
+    dirtyAddressables.erase(dirtyAddressables.begin());
+    // Note: addressables that are gone in the meantime (or not yet added) are not found
+    DsAddressablePtr a = addressableForDsUid(dsuid);
+    if (a) a->save();
+    n++;
+  }
+  #if ENABLE_LOCALCONTROLLER
+  if (localControllerDirty && n<DIRTY_SAVE_BATCH_SIZE) {
+    localControllerDirty = false;
+    if (localController) localController->save();
+  }
+  #endif
+  bool committed = commitSaveTransaction(journal);
+  FOCUSLOG("saved %d changed objects, %zu remaining", n, dirtyAddressables.size());
+  anyDirty = !dirtyAddressables.empty();
+  #if ENABLE_LOCALCONTROLLER
+  anyDirty = anyDirty || localControllerDirty;
+  #endif
+  if (!committed) {
+    // retry later, not in a tight loop
+    if (anyDirty && !saveTicket) {
+      saveTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcHost::saveDirty, this), DIRTY_SAVE_MAX_DELAY);
+    }
+  }
+  else if (anyDirty) {
+    // more to save, continue in next mainloop cycle
+    saveTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcHost::saveDirty, this));
+  }
+}
+
+
+void VdcHost::saveAllNow()
+{
+  saveAll();
+  if (persistenceWorker) persistenceWorker->flush();
+}
+
+
+void VdcHost::saveAll()
+{
+  MainLoop::currentMainLoop().cancelExecutionTicket(saveTicket);
+  dirtyAddressables.clear();
+  SaveJournal journal;
+  bool inTransaction = beginSaveTransaction(journal); // Note: if not possible, save record by record
+  // - myself
+  save();
+  #if ENABLE_LOCALCONTROLLER
+  localControllerDirty = false;
+  if (localController) localController->save();
+  #endif
+  // - device containers
+  for (VdcMap::iterator pos = vdcs.begin(); pos!=vdcs.end(); ++pos) {
+    pos->second->save();
+  }
+  // - devices
+  for (DsDeviceMap::iterator pos = dSDevices.begin(); pos!=dSDevices.end(); ++pos) {
+    pos->second->save();
+  }
+  if (inTransaction) commitSaveTransaction(journal);
+}
+
+
 // MARK: ===== local operation mode
 
 
@@ -913,6 +1400,28 @@ void VdcHost::deliverToAudience(NotificationAudience &aAudience, VdcApiConnectio
 // MARK: ===== vDC API
 
 
+/// get the name a method call or notification is accounted under in the latency statistics
+/// @param aMethod method or notification name as received from the vdSM
+/// @return aMethod for standard vDC API methods and notifications, "other" for everything else
+/// @note method names are supplied by the peer, so only a fixed set of names may create histograms
+static const char *latencyStatisticsName(const string &aMethod)
+{
+  static const char * const knownNames[] = {
+    // methods
+    "hello", "bye", "getProperty", "setProperty", "genericRequest", "remove",
+    "scanDevices", "pair", "setConfiguration",
+    // notifications
+    "ping", "callScene", "saveScene", "undoScene", "setLocalPriority", "callSceneMin",
+    "dimChannel", "setControlValue", "setOutputChannelValue", "identify",
+    NULL
+  };
+  for (const char * const *n = knownNames; *n; ++n) {
+    if (aMethod==*n) return *n;
+  }
+  return "other";
+}
+
+
 bool VdcHost::sendApiRequest(const string &aMethod, ApiValuePtr aParams, VdcApiResponseCB aResponseHandler)
 {
   if (activeSessionConnection) {
@@ -924,11 +1433,84 @@ bool VdcHost::sendApiRequest(const string &aMethod, ApiValuePtr aParams, VdcApiR
 }
 
 
+/// a broadcast notification prepared for one API encoding
+typedef struct {
+  ApiValuePtr params; ///< the notification parameters, as API values of that encoding
+  bool preEncoded; ///< set if the API implementation has encoded the notification into encoded
+  string encoded; ///< the encoded notification
+} BroadcastNotification;
+typedef map<VdcApiEncoding, BroadcastNotification> BroadcastNotificationsMap;
+
+
+/// send a broadcast notification to one session
+/// @param aConnection the session connection to send to
+/// @param aMethod the notification
+/// @param aParams the parameters object, or NULL if none
+/// @param aParamsEncoding the API encoding the parameters object belongs to
+/// @param aNotifications the notification prepared so far per encoding, so params are converted and encoded only
+///   once for all sessions using the same encoding
+static ErrorPtr sendBroadcastNotification(VdcApiConnectionPtr aConnection, const string &aMethod, ApiValuePtr aParams, VdcApiEncoding aParamsEncoding, BroadcastNotificationsMap &aNotifications)
+{
+  VdcApiEncoding encoding = aConnection->apiEncoding();
+  BroadcastNotificationsMap::iterator pos = aNotifications.find(encoding);
+  if (pos==aNotifications.end()) {
+    // first session with this encoding
+    BroadcastNotification &n = aNotifications[encoding];
+    n.params = aParams;
+    if (aParams && (encoding!=aParamsEncoding || encoding==vdcapi_encoding_unknown)) {
+      // API values of one encoding cannot be used by another one, convert params
+      n.params = aConnection->newApiValue();
+      *(n.params) = *aParams;
+    }
+    // encode only once for all sessions of this encoding, if the API implementation supports it
+    n.preEncoded = encoding!=vdcapi_encoding_unknown && Error::isOK(aConnection->encodeNotification(aMethod, n.params, n.encoded));
+    pos = aNotifications.find(encoding);
+  }
+  if (pos->second.preEncoded) {
+    return aConnection->sendEncoded(pos->second.encoded);
+  }
+  return aConnection->sendRequest(aMethod, pos->second.params);
+}
+
+
+bool VdcHost::broadcastApiNotification(const string &aMethod, ApiValuePtr aParams)
+{
+  if (!activeSessionConnection) return false; // observers only see what the vdSM session would see
+  signalActivity();
+  if (observerConnections.empty()) {
+    // just the vdSM
+    return Error::isOK(activeSessionConnection->sendRequest(aMethod, aParams));
+  }
+  // params are API values of the vdSM session, observers might use another encoding
+  BroadcastNotificationsMap notifications;
+  VdcApiEncoding paramsEncoding = activeSessionConnection->apiEncoding();
+  ErrorPtr err = sendBroadcastNotification(activeSessionConnection, aMethod, aParams, paramsEncoding, notifications);
+  LOG(LOG_INFO, "vdSM+%lu observers <- vDC notification sent: method='%s', params=%s", observerConnections.size(), aMethod.c_str(), aParams ? aParams->description().c_str() : "<none>");
+  for (VdcApiConnectionList::iterator pos = observerConnections.begin(); pos!=observerConnections.end(); ++pos) {
+    ErrorPtr oerr = sendBroadcastNotification(*pos, aMethod, aParams, paramsEncoding, notifications);
+    if (!Error::isOK(oerr)) {
+      LOG(LOG_INFO, "Could not send notification '%s' to observer: %s", aMethod.c_str(), oerr->description().c_str());
+    }
+  }
+  return Error::isOK(err);
+}
+
+
+bool VdcHost::isObserverConnection(VdcApiConnectionPtr aApiConnection)
+{
+  for (VdcApiConnectionList::iterator pos = observerConnections.begin(); pos!=observerConnections.end(); ++pos) {
+    if (*pos==aApiConnection) return true;
+  }
+  return false;
+}
+
+
 void VdcHost::vdcApiConnectionStatusHandler(VdcApiConnectionPtr aApiConnection, ErrorPtr &aError)
 {
   if (Error::isOK(aError)) {
     // new connection, set up reequest handler
     aApiConnection->setRequestHandler(boost::bind(&VdcHost::vdcApiRequestHandler, this, _1, _2, _3, _4));
+    aApiConnection->setDirectNotificationHandler(boost::bind(&VdcHost::vdcApiDirectNotificationHandler, this, _1, _2));
   }
   else {
     // error or connection closed
@@ -942,6 +1524,10 @@ void VdcHost::vdcApiConnectionStatusHandler(VdcApiConnectionPtr aApiConnection,
       postEvent(vdchost_vdcapi_disconnected);
       LOG(LOG_NOTICE, "vDC API session ends because connection closed ");
     }
+    else if (isObserverConnection(aApiConnection)) {
+      observerConnections.remove(aApiConnection);
+      LOG(LOG_NOTICE, "vDC API observer session ends because connection closed, %lu observers remaining", observerConnections.size());
+    }
     else {
       LOG(LOG_NOTICE, "vDC API connection (not yet in session) closed ");
     }
@@ -952,10 +1538,13 @@ void VdcHost::vdcApiConnectionStatusHandler(VdcApiConnectionPtr aApiConnection,
 void VdcHost::vdcApiRequestHandler(VdcApiConnectionPtr aApiConnection, VdcApiRequestPtr aRequest, const string &aMethod, ApiValuePtr aParams)
 {
   ErrorPtr respErr;
+  MLMicroSeconds receivedAt = MainLoop::now();
   signalActivity();
   // now process
   if (aRequest) {
     // Methods
+    // - measure latency from arrival (including time waiting for dispatch) until the method is answered (which might happen later)
+    aRequest->setAnsweredHandler(boost::bind(&VdcHost::methodAnswered, this, latencyStatisticsName(aMethod), aRequest->getReceivedAt()));
     // - Check session init/end methods
     if (aMethod=="hello") {
       respErr = helloHandler(aRequest, aParams);
@@ -964,10 +1553,19 @@ void VdcHost::vdcApiRequestHandler(VdcApiConnectionPtr aApiConnection, VdcApiReq
       respErr = byeHandler(aRequest, aParams);
     }
     else {
-      if (activeSessionConnection) {
+      if (activeSessionConnection && aApiConnection==activeSessionConnection) {
         // session active
         respErr = handleMethodForParams(aRequest, aMethod, aParams);
       }
+      else if (isObserverConnection(aApiConnection)) {
+        // observer session: read-only access
+        if (aMethod=="getProperty") {
+          respErr = handleMethodForParams(aRequest, aMethod, aParams);
+        }
+        else {
+          respErr = Error::err<VdcApiError>(403, "observer session is read-only - cannot call '%s'", aMethod.c_str());
+        }
+      }
       else {
         // all following methods must have an active session
         respErr = Error::err<VdcApiError>(401, "no vDC session - cannot call method");
@@ -977,8 +1575,9 @@ void VdcHost::vdcApiRequestHandler(VdcApiConnectionPtr aApiConnection, VdcApiReq
   else {
     // Notifications
     // Note: out of session, notifications are simply ignored
-    if (activeSessionConnection) {
+    if (activeSessionConnection && aApiConnection==activeSessionConnection) {
       respErr = handleNotificationForParams(aApiConnection, aMethod, aParams);
+      notificationLatencies[latencyStatisticsName(aMethod)].record(MainLoop::now()-receivedAt);
     }
     else {
       LOG(LOG_INFO, "Received notification '%s' out of session -> ignored", aMethod.c_str());
@@ -1003,6 +1602,59 @@ void VdcHost::vdcApiRequestHandler(VdcApiConnectionPtr aApiConnection, VdcApiReq
 }
 
 
+void VdcHost::methodAnswered(const char *aStatisticsName, MLMicroSeconds aReceivedAt)
+{
+  methodLatencies[aStatisticsName].record(MainLoop::now()-aReceivedAt);
+}
+
+
+bool VdcHost::vdcApiDirectNotificationHandler(VdcApiConnectionPtr aApiConnection, const VdcApiDirectNotification &aNotification)
+{
+  MLMicroSeconds receivedAt = MainLoop::now();
+  // Note: out of session, notifications are simply ignored
+  if (!activeSessionConnection || aApiConnection!=activeSessionConnection) {
+    LOG(LOG_INFO, "Received notification '%s' out of session -> ignored", aNotification.method);
+    return true; // handled
+  }
+  // collect audience, same rules as in handleNotificationForParams()
+  NotificationAudience audience;
+  bool audienceOk = false;
+  if (aNotification.numDsUids>0) {
+    audienceOk = true; // non-empty array is a valid audience specification
+    DsUid dsuid;
+    for (size_t i=0; i<aNotification.numDsUids; i++) {
+      dsuid.setAsString(aNotification.dsUids[i]);
+      ErrorPtr err = addToAudienceByDsuid(audience, dsuid);
+      if (!Error::isOK(err)) {
+        LOG(LOG_INFO, "Ignored target for notification '%s': %s", aNotification.method, err->description().c_str());
+      }
+    }
+  }
+  if (audience.empty() && aNotification.zoneId>=0 && aNotification.group>=0) {
+    audienceOk = true; // zone_id/group is valid audience spec
+    addToAudienceByZoneAndGroup(audience, aNotification.zoneId, (DsGroup)aNotification.group);
+  }
+  // direct delivery is possible to devices only
+  for (NotificationAudience::iterator gpos = audience.begin(); gpos!=audience.end(); ++gpos) {
+    if (!gpos->vdc) return false; // non-devices in audience -> must use generic path
+  }
+  signalActivity();
+  if (!audienceOk) {
+    LOG(LOG_WARNING, "Notification '%s' processing error: notification needs dSUID, itemSpec or zone_id/group parameters", aNotification.method);
+    return true; // handled
+  }
+  // deliver
+  for (NotificationAudience::iterator gpos = audience.begin(); gpos!=audience.end(); ++gpos) {
+    LOG(LOG_INFO, "=== Delivering notification '%s' to %lu devices in vDC %s", aNotification.method, gpos->members.size(), gpos->vdc->shortDesc().c_str());
+    for (DsAddressablesList::iterator apos = gpos->members.begin(); apos!=gpos->members.end(); ++apos) {
+      static_cast<Device *>(apos->get())->handleDirectNotification(aApiConnection, aNotification);
+    }
+  }
+  notificationLatencies[latencyStatisticsName(aNotification.method)].record(MainLoop::now()-receivedAt);
+  return true;
+}
+
+
 ErrorPtr VdcHost::helloHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
 {
   ErrorPtr respErr;
@@ -1022,8 +1674,13 @@ ErrorPtr VdcHost::helloHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
       // check dSUID
       DsUid vdsmDsUid;
       if (Error::isOK(respErr = checkDsuidParam(aParams, "dSUID", vdsmDsUid))) {
+        v = aParams->get("x_p44_observer");
+        if (v && v->boolValue()) {
+          // read-only observer session, can coexist with the vdSM session
+          respErr = startObserverSession(aRequest, aParams, vdsmDsUid);
+        }
         // same vdSM can restart session any time. Others will be rejected
-        if (!activeSessionConnection || vdsmDsUid==connectedVdsm) {
+        else if (!activeSessionConnection || vdsmDsUid==connectedVdsm) {
           // ok to start new session
           if (activeSessionConnection) {
             // session connection was already there, re-announce
@@ -1041,10 +1698,20 @@ ErrorPtr VdcHost::helloHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
           LOG(LOG_NOTICE, "=== vdSM %s (%s) starts new session with API Version %d", vdsmDsUid.getString().c_str(), ip, version);
           // - inform interested objects
           postEvent(vdchost_vdcapi_connected);
+          // - check for fragmentation extension (allows messages exceeding the frame size of the connection)
+          bool fragmentation = false;
+          v = aParams->get("x_p44_fragmentation");
+          if (v && v->boolValue()) {
+            fragmentation = activeSessionConnection->enableFragmentation();
+            if (fragmentation) LOG(LOG_INFO, "vdSM supports fragmented messages, enabled for this session");
+          }
           // - create answer
           ApiValuePtr result = activeSessionConnection->newApiValue();
           result->setType(apivalue_object);
           result->add("dSUID", aParams->newBinary(getDsUid().getBinary()));
+          if (fragmentation) {
+            result->add("x_p44_fragmentation", result->newBool(true));
+          }
           aRequest->sendResult(result);
           // - trigger announcing devices
           startAnnouncing();
@@ -1065,6 +1732,45 @@ ErrorPtr VdcHost::helloHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
 }
 
 
+ErrorPtr VdcHost::startObserverSession(VdcApiRequestPtr aRequest, ApiValuePtr aParams, const DsUid &aObserverDsUid)
+{
+  VdcApiConnectionPtr conn = aRequest->connection();
+  if (!isObserverConnection(conn)) {
+    if (conn==activeSessionConnection) {
+      return Error::err<VdcApiError>(409, "connection is already in a vdSM session");
+    }
+    if (observerConnections.size()>=MAX_OBSERVER_SESSIONS) {
+      ErrorPtr err = Error::err<VdcApiError>(503, "too many observer sessions (max %d)", MAX_OBSERVER_SESSIONS);
+      aRequest->sendError(err);
+      conn->closeAfterSend();
+      return ErrorPtr(); // prevent sending error again
+    }
+    observerConnections.push_back(conn);
+  }
+  const char *ip = "<unknown>";
+  if (conn->socketConnection()) {
+    ip = conn->socketConnection()->getHost();
+  }
+  LOG(LOG_NOTICE, "=== observer %s (%s) starts read-only session with API Version %d, %lu observers now", aObserverDsUid.getString().c_str(), ip, conn->getApiVersion(), observerConnections.size());
+  // - fragmentation works the same as for the vdSM session
+  bool fragmentation = false;
+  ApiValuePtr v = aParams->get("x_p44_fragmentation");
+  if (v && v->boolValue()) {
+    fragmentation = conn->enableFragmentation();
+  }
+  // - create answer
+  ApiValuePtr result = conn->newApiValue();
+  result->setType(apivalue_object);
+  result->add("dSUID", aParams->newBinary(getDsUid().getBinary()));
+  result->add("x_p44_observer", result->newBool(true));
+  if (fragmentation) {
+    result->add("x_p44_fragmentation", result->newBool(true));
+  }
+  aRequest->sendResult(result);
+  return ErrorPtr();
+}
+
+
 ErrorPtr VdcHost::byeHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
 {
   // always confirm Bye, even out-of-session, so using aJsonRpcComm directly to answer (jsonSessionComm might not be ready)
@@ -1399,6 +2105,7 @@ static char localController_obj;
 enum {
   vdcs_key,
   valueSources_key,
+  apiLatencies_key,
   #if ENABLE_LOCALCONTROLLER
   localController_key,
   #endif
@@ -1422,6 +2129,7 @@ PropertyDescriptorPtr VdcHost::getDescriptorByIndex(int aPropIndex, int aDomain,
   static const PropertyDescription properties[numVdcHostProperties] = {
     { "x-p44-vdcs", apivalue_object+propflag_container, vdcs_key, OKEY(vdcs_obj) },
     { "x-p44-valueSources", apivalue_null, valueSources_key, OKEY(vdchost_obj) },
+    { "x-p44-apiLatencies", apivalue_null, apiLatencies_key, OKEY(vdchost_obj) },
     #if ENABLE_LOCALCONTROLLER
     { "x-p44-localController", apivalue_object, localController_key, OKEY(localController_obj) },
     #endif
@@ -1430,7 +2138,7 @@ PropertyDescriptorPtr VdcHost::getDescriptorByIndex(int aPropIndex, int aDomain,
   if (aPropIndex<n)
     return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
   aPropIndex -= n; // rebase to 0 for my own first property
-  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+  return StaticPropertyDescriptor::descriptorFor(&properties[aPropIndex], aParentDescriptor);
 }
 
 
@@ -1484,6 +2192,18 @@ bool VdcHost::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Prop
           aPropValue->setType(apivalue_object); // make object (incoming object is NULL)
           createValueSourcesList(aPropValue);
           return true;
+        case apiLatencies_key:
+          aPropValue->setType(apivalue_object); // make object (incoming object is NULL)
+          createLatencyStatistics(aPropValue);
+          return true;
+      }
+    }
+    else {
+      switch (aPropertyDescriptor->fieldKey()) {
+        case apiLatencies_key:
+          // writing anything resets the statistics
+          resetLatencyStatistics();
+          return true;
       }
     }
   }
@@ -1492,6 +2212,42 @@ bool VdcHost::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Prop
 }
 
 
+// MARK: ===== API latency statistics
+
+void VdcHost::recordSceneApplyLatency(const string &aDeviceType, MLMicroSeconds aLatency)
+{
+  sceneApplyLatencies[aDeviceType].record(aLatency);
+}
+
+
+void VdcHost::resetLatencyStatistics()
+{
+  methodLatencies.clear();
+  notificationLatencies.clear();
+  sceneApplyLatencies.clear();
+}
+
+
+static ApiValuePtr latencyHistogramsToApiValue(ApiValuePtr aApiObjectValue, const LatencyHistogramMap &aHistograms)
+{
+  ApiValuePtr histograms = aApiObjectValue->newObject();
+  for (LatencyHistogramMap::const_iterator pos = aHistograms.begin(); pos!=aHistograms.end(); ++pos) {
+    ApiValuePtr stats = histograms->newObject();
+    pos->second.addToApiValue(stats);
+    histograms->add(pos->first, stats);
+  }
+  return histograms;
+}
+
+
+void VdcHost::createLatencyStatistics(ApiValuePtr aApiObjectValue)
+{
+  aApiObjectValue->add("methods", latencyHistogramsToApiValue(aApiObjectValue, methodLatencies));
+  aApiObjectValue->add("notifications", latencyHistogramsToApiValue(aApiObjectValue, notificationLatencies));
+  aApiObjectValue->add("sceneApply", latencyHistogramsToApiValue(aApiObjectValue, sceneApplyLatencies));
+}
+
+
 // MARK: ===== value sources
 
 void VdcHost::createValueSourcesList(ApiValuePtr aApiObjectValue)
@@ -1571,7 +2327,7 @@ ErrorPtr VdcHost::loadAndFixDsUID()
   }
   DsUid originalDsUid = dSUID;
   // load the vdc host settings, which might override the default dSUID
-  err = loadFromStore(entityType()); // is a singleton, identify by type
+  err = CachingParamStore::load(*this, entityType()); // is a singleton, identify by type
   if (!Error::isOK(err)) LOG(LOG_ERR,"Error loading settings for vdc host: %s", err->description().c_str());
   // check for settings from files
   loadSettingsFromFiles();
@@ -1604,7 +2360,7 @@ ErrorPtr VdcHost::save()
 {
   ErrorPtr err;
   // save the vdc settings
-  err = saveToStore(entityType(), false); // is a singleton, identify by type, single instance
+  err = PersistenceWorker::save(getPersistenceWorker(), *this, entityType(), false); // is a singleton, identify by type, single instance
   return ErrorPtr();
 }
 
@@ -1612,7 +2368,7 @@ ErrorPtr VdcHost::save()
 ErrorPtr VdcHost::forget()
 {
   // delete the vdc settings
-  deleteFromStore();
+  PersistenceWorker::forget(getPersistenceWorker(), *this);
   return ErrorPtr();
 }
 
@@ -1620,11 +2376,8 @@ ErrorPtr VdcHost::forget()
 
 void VdcHost::loadSettingsFromFiles()
 {
-  // try to open config file
-  string fn = getConfigDir();
-  fn += "vdchostsettings.csv";
   // if vdc has already stored properties, only explicitly marked properties will be applied
-  if (loadSettingsFromFile(fn.c_str(), rowid!=0)) markClean();
+  if (loadSettingsFromConfigFile("vdchostsettings.csv", rowid!=0)) markClean();
 }
 
 
@@ -27,11 +27,20 @@
 #include "dsdefs.h"
 
 #include "persistentparams.hpp"
+#include "cachingparamstore.hpp"
 #include "dsaddressable.hpp"
 #include "valuesource.hpp"
 #include "digitalio.hpp"
 
 #include "vdcapi.hpp"
+#include "latencyhistogram.hpp"
+#include "settingsfilecache.hpp"
+#include "settingsbulkloader.hpp"
+#include "persistenceworker.hpp"
+#include "savejournal.hpp"
+#include "jsonobject.hpp"
+
+#include <set>
 
 using namespace std;
 
@@ -81,9 +90,30 @@ namespace p44 {
 
 
   /// persistence for digitalSTROM paramters
-  class DsParamStore : public ParamStore
+  /// @note records are loaded, saved and deleted with statements prepared once per table (see CachingParamStore)
+  class DsParamStore : public CachingParamStore
   {
     typedef SQLite3Persistence inherited;
+
+    bool walMode; ///< set when the DB uses a write-ahead log
+
+  public:
+
+    DsParamStore();
+
+    /// switch to write-ahead log journal with reduced syncing
+    /// @return ok or error
+    /// @note this is opt-in, because with synchronous=NORMAL, the most recent transactions might get lost
+    ///   on power failure (but the DB remains consistent). In exchange, commits do not need to fsync.
+    ErrorPtr enableWriteAheadLog();
+
+    /// @return true if the DB uses a write-ahead log
+    bool usesWriteAheadLog() { return walMode; };
+
+    /// transfer the write-ahead log contents into the DB
+    /// @note should be called when idle, as this is where data actually gets synced to disk
+    void checkpoint();
+
   protected:
     /// Get DB Schema creation/upgrade SQL statements
     virtual string dbSchemaUpgradeSQL(int aFromVersion, int &aToVersion);
@@ -96,6 +126,8 @@ namespace p44 {
   typedef map<DsUid, VdcPtr> VdcMap;
   typedef map<DsUid, DevicePtr> DsDeviceMap;
   typedef list<DsAddressablePtr> DsAddressablesList;
+  typedef map<string, LatencyHistogram> LatencyHistogramMap;
+  typedef list<VdcApiConnectionPtr> VdcApiConnectionList;
 
   class NotificationGroup
   {
@@ -136,6 +168,8 @@ namespace p44 {
     string iconDir; ///< the directory where to load icons from
     string persistentDataDir; ///< the directory for the vdc host to store SQLite DBs and possibly other persistent data
     string configDir; ///< the directory to load config files (scene definitions, machine configurations etc.) from
+    SettingsFileCachePtr settingsFileCache; ///< compiled settings files from configDir, created on first use
+    PersistenceWorkerPtr persistenceWorker; ///< worker thread for writing device params, NULL if not enabled
 
     string productName; ///< the name of the vdc host product (model name) as a a whole
     string productVersion; ///< the version string of the vdc host product as a a whole
@@ -144,11 +178,33 @@ namespace p44 {
     string vdcModelNameTemplate; ///< how to generate vdc model names (that's what shows up in HW-Info in dS)
 
     bool collecting;
+    bool bulkLoad; ///< if set, persistent params of collected devices are loaded in bulk
+    bool bulkLoadPending; ///< set while collecting, until the persistent params of collected devices are loaded in bulk
+    typedef list<DevicePtr> DeviceList;
+    DeviceList devicesToLoad; ///< devices added while bulkLoadPending, persistent params not yet loaded
+    SettingsBulkLoader *bulkLoader; ///< the bulk loader while loading collected devices, NULL otherwise
     MLTicket announcementTicket;
     MLTicket periodicTaskTicket;
     MLMicroSeconds lastActivity;
     MLMicroSeconds lastPeriodicRun;
 
+    // write-behind persistence
+    typedef set<DsUid> DsUidSet;
+    DsUidSet dirtyAddressables; ///< addressables (host, vdcs, devices) with unsaved changes
+    #if ENABLE_LOCALCONTROLLER
+    bool localControllerDirty; ///< local controller has unsaved changes
+    #endif
+    MLTicket saveTicket; ///< saving dirty objects at latest after DIRTY_SAVE_MAX_DELAY
+    MLMicroSeconds lastFullSave; ///< last time all objects were saved, regardless of being scheduled
+
+    // warm restart snapshot
+    bool warmRestartSnapshot; ///< if set, devices are restored from a snapshot at startup instead of being collected
+    MLMicroSeconds lastSnapshot; ///< last time the snapshot was written
+    JsonObjectPtr restoreSnapshot; ///< the snapshot to restore devices from, only while collecting at startup
+    typedef list<VdcPtr> VdcList;
+    VdcList restoredVdcs; ///< vdcs with devices restored from the snapshot, to be verified after initialisation
+    DsUidSet unconfirmedDevices; ///< devices restored from the snapshot, not yet confirmed by verification
+
     int8_t localDimDirection;
 
     // learning
@@ -166,6 +222,10 @@ namespace p44 {
 
     // mainloop statistics
     int mainloopStatsInterval; ///< 0=none, N=every PERIODIC_TASK_INTERVAL*N seconds
+    bool paramStoreWriteAheadLog; ///< if set, parameter DB uses a write-ahead log
+    bool asyncPersistence; ///< if set, device params are written by a worker thread
+    bool sceneBlobStorage; ///< if set, scenes of a device are stored in a single record
+    MLMicroSeconds lastCheckpoint; ///< last time the parameter DB write-ahead log was checkpointed
     int mainLoopStatsCounter;
 
     // active vDC API session
@@ -173,6 +233,12 @@ namespace p44 {
     DsUid connectedVdsm;
     MLTicket sessionActivityTicket;
     VdcApiConnectionPtr activeSessionConnection;
+    VdcApiConnectionList observerConnections; ///< read-only observer sessions, receiving the same push notifications as the vdSM
+
+    // API latency statistics
+    LatencyHistogramMap methodLatencies; ///< time from receiving a method call until it is answered, by method name (non-standard methods as "other")
+    LatencyHistogramMap notificationLatencies; ///< time to deliver a notification to its targets, by notification name (non-standard notifications as "other")
+    LatencyHistogramMap sceneApplyLatencies; ///< time from callScene until the scene values are applied, by device type
 
     #if ENABLE_LOCALCONTROLLER
     LocalController *localController;
@@ -275,10 +341,56 @@ namespace p44 {
     /// @return full path to config directory
     const char *getConfigDir();
 
+    /// get the cache of compiled settings files from the config dir
+    /// @return the settings file cache, which also serves as index of all files in the config dir
+    /// @note when files in the config dir change, the settings of affected addressables are reloaded
+    SettingsFileCache &getSettingsFileCache();
+
+    /// Set if the persistent params of collected devices should be loaded in bulk (see SettingsBulkLoader)
+    /// @param aEnable if set (default), params are loaded for all collected devices at once, one query per table.
+    ///   Otherwise, every device loads its params when added.
+    void setBulkLoad(bool aEnable) { bulkLoad = aEnable; };
+
+    /// get the bulk loader for persistent params
+    /// @return the bulk loader while the devices collected are being loaded, NULL otherwise
+    SettingsBulkLoader *getBulkLoader() { return bulkLoader; };
+
     /// Set how often mainloop statistics are printed out log (LOG_INFO)
     /// @param aInterval 0=none, N=every PERIODIC_TASK_INTERVAL*N seconds
     void setMainloopStatsInterval(int aInterval) { mainloopStatsInterval = aInterval; };
 
+    /// Set if the parameter DB should use a write-ahead log with reduced syncing (see DsParamStore::enableWriteAheadLog())
+    /// @param aEnable if set, write-ahead log will be used
+    /// @note must be called before prepareForVdcs()
+    void setParamStoreWriteAheadLog(bool aEnable) { paramStoreWriteAheadLog = aEnable; };
+
+    /// Set if device params should be written to the parameter DB by a worker thread (see PersistenceWorker)
+    /// @param aEnable if set, a worker thread will be used
+    /// @note must be called before prepareForVdcs(). Only effective when the parameter DB uses a write-ahead log.
+    void setAsyncPersistence(bool aEnable) { asyncPersistence = aEnable; };
+
+    /// get the persistence worker
+    /// @return the worker thread for writing device params, NULL if params are written directly
+    PersistenceWorker *getPersistenceWorker() { return persistenceWorker.get(); };
+
+    /// Set if the scenes of a device should be stored in a single record (see SceneDeviceSettings)
+    /// @param aEnable if set, new or changed scenes are stored as scene blobs, and existing scene records are
+    ///   migrated to scene blobs when saved next time
+    void setSceneBlobStorage(bool aEnable) { sceneBlobStorage = aEnable; };
+
+    /// @return true if scenes are stored as scene blobs
+    bool usesSceneBlobStorage() { return sceneBlobStorage; };
+
+    /// Set if a warm restart snapshot of all devices should be written at shutdown and periodically
+    /// @param aEnable if set, devices of vDCs supporting it (see Vdc::restoreDevice()) are restored from the
+    ///   snapshot at startup, announced right away and verified against the hardware in the background.
+    /// @note must be called before collectDevices()
+    void setWarmRestartSnapshot(bool aEnable) { warmRestartSnapshot = aEnable; };
+
+    /// write the warm restart snapshot now
+    /// @note this is done automatically at shutdown and periodically when enabled
+    void writeSnapshot();
+
     /// prepare device container internals for creating and adding vDCs
     /// In particular, this triggers creating/loading the vdc host dSUID, which serves as a base ID
     /// for most class containers and many devices.
@@ -405,6 +517,16 @@ namespace p44 {
     /// get the dsParamStore
     DsParamStore &getDsParamStore() { return dsParamStore; }
 
+    /// schedule saving an addressable with unsaved changes
+    /// @param aDsUid the dSUID of the vdc host, a vdc or a device
+    /// @note the save will happen when the vdc host is idle, but not later than DIRTY_SAVE_MAX_DELAY
+    void scheduleSave(const DsUid &aDsUid);
+
+    #if ENABLE_LOCALCONTROLLER
+    /// schedule saving local controller settings (zones, scenes)
+    void scheduleLocalControllerSave();
+    #endif
+
     /// @}
 
 
@@ -506,7 +628,15 @@ namespace p44 {
 
     /// save unsaved parameters to persistent DB
     /// @note this is usually called from the device container in regular intervals
-    ErrorPtr save();
+    virtual ErrorPtr save() P44_OVERRIDE;
+
+    /// save all persistent params of the vdc host, vdcs and devices now, and wait until they are written
+    /// @note saving is done periodically anyway. Use this at shutdown, or when the DB is needed in its current state.
+    void saveAllNow();
+
+    /// mark dirty and schedule saving
+    /// @note overrides PersistentParams::markDirty() (which is virtual, so setPVar() and other base class code use this, too) to feed the write-behind queue
+    virtual void markDirty() P44_OVERRIDE;
 
     /// forget any parameters stored in persistent DB
     ErrorPtr forget();
@@ -517,6 +647,20 @@ namespace p44 {
     /// @}
 
 
+    /// @name API latency statistics
+    /// @{
+
+    /// record the time a device needed from callScene until its scene values were applied
+    /// @param aDeviceType the device type identifier (as returned by Device::deviceTypeIdentifier())
+    /// @param aLatency the time from receiving callScene until the values were applied
+    void recordSceneApplyLatency(const string &aDeviceType, MLMicroSeconds aLatency);
+
+    /// forget all recorded latencies
+    void resetLatencyStatistics();
+
+    /// @}
+
+
   protected:
 
     /// add a vDC container
@@ -536,6 +680,13 @@ namespace p44 {
     /// @return true if message could be sent, false otherwise (e.g. no vdSM connection)
     bool sendApiRequest(const string &aMethod, ApiValuePtr aParams, VdcApiResponseCB aResponseHandler = VdcApiResponseCB());
 
+    /// send a API notification to the vdSM and all observer sessions
+    /// @param aMethod the notification
+    /// @param aParams the parameters object, or NULL if none
+    /// @return true if notification could be sent to the vdSM, false otherwise (e.g. no vdSM connection)
+    /// @note the notification is encoded only once for all sessions if the API implementation supports it
+    bool broadcastApiNotification(const string &aMethod, ApiValuePtr aParams);
+
 
     /// @}
 
@@ -566,13 +717,25 @@ namespace p44 {
     // derive dSUID
     void deriveDsUid();
 
+    // write-behind persistence
+    void saveDirty();
+    void saveAll();
+    bool beginSaveTransaction(SaveJournal &aJournal);
+    bool commitSaveTransaction(SaveJournal &aJournal);
+
     // initializing and collecting
     void initializeNextVdc(StatusCB aCompletedCB, bool aFactoryReset, VdcMap::iterator aNextVdc);
     void vdcInitialized(StatusCB aCompletedCB, bool aFactoryReset, VdcMap::iterator aNextVdc, ErrorPtr aError);
     void collectFromNextVdc(StatusCB aCompletedCB, RescanMode aRescanFlags, VdcMap::iterator aNextVdc);
     void vdcCollected(StatusCB aCompletedCB, RescanMode aRescanFlags, VdcMap::iterator aNextVdc, ErrorPtr aError);
+    void loadCollectedDevices();
     void initializeNextDevice(StatusCB aCompletedCB, DsDeviceMap::iterator aNextDevice);
     void deviceInitialized(StatusCB aCompletedCB, DsDeviceMap::iterator aNextDevice, ErrorPtr aError);
+    void configFileChanged(const string &aFileName, bool aRemoved);
+    string snapshotFilePath();
+    void loadSnapshot();
+    bool restoreVdcFromSnapshot(VdcPtr aVdc);
+    void verifyRestoredVdcs();
 
     // local operation mode
     void handleClickLocally(ButtonBehaviour &aButtonBehaviour, DsClickType aClickType);
@@ -583,14 +746,19 @@ namespace p44 {
 
     // API request handling
     void vdcApiRequestHandler(VdcApiConnectionPtr aApiConnection, VdcApiRequestPtr aRequest, const string &aMethod, ApiValuePtr aParams);
+    bool vdcApiDirectNotificationHandler(VdcApiConnectionPtr aApiConnection, const VdcApiDirectNotification &aNotification);
+    void methodAnswered(const char *aStatisticsName, MLMicroSeconds aReceivedAt);
 
     // vDC level method and notification handlers
     ErrorPtr helloHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
     ErrorPtr byeHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
+    ErrorPtr startObserverSession(VdcApiRequestPtr aRequest, ApiValuePtr aParams, const DsUid &aObserverDsUid);
+    bool isObserverConnection(VdcApiConnectionPtr aApiConnection);
     ErrorPtr removeHandler(VdcApiRequestPtr aForRequest, DevicePtr aDevice);
     void removeResultHandler(DevicePtr aDevice, VdcApiRequestPtr aForRequest, bool aDisconnected);
     void duplicateIgnored(DevicePtr aDevice);
     void deviceInitialized(DevicePtr aDevice);
+    void restoredDeviceInitialized(DevicePtr aDevice, ErrorPtr aError);
 
     // announcing dSUID addressable entities within the device container (vdc host)
     void resetAnnouncing();
@@ -614,6 +782,9 @@ namespace p44 {
     /// @param aApiObjectValue must be an object typed API value, will receive available value sources as valueSourceID/description key/values
     void createValueSourcesList(ApiValuePtr aApiObjectValue);
 
+    // API latency statistics
+    void createLatencyStatistics(ApiValuePtr aApiObjectValue);
+
   };
 
 } // namespace p44